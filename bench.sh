@@ -0,0 +1,28 @@
+#!/bin/sh
+# Check the encoder against the decoding core, then micro-benchmark the
+# decoding core, and benchmark the dissector if tshark is installed, on the
+# synthetic captures of dlms-bench (built in a temporary directory). Arguments
+# are passed to dlms-bench (for example -s 10 for ten times larger captures). The dissector is timed building the full tree (-V),
+# and filtering in two passes (-2 -Y), where the second pass redissects every
+# frame as the GUI does on a filter change.
+set -e
+corpus=${TMPDIR:-/tmp}/dlms-bench.$$
+mkdir "$corpus"
+trap 'rm -rf "$corpus"' EXIT
+gcc -O2 -Wall -o "$corpus/dlms-bench" dlms_bench.c dlms_core.c dlms_encode.c
+"$corpus/dlms-bench" -r 10000
+"$corpus/dlms-bench" "$@"
+command -v tshark >/dev/null || exit 0
+echo
+printf '%-16s %8s %12s %10s %10s %12s\n' tshark frames frames/s MB/s 'peak KB' 'filter f/s'
+"$corpus/dlms-bench" -w "$corpus" "$@" | while read name frames bytes; do
+    /usr/bin/time -f '%e %M' -o "$corpus/time" \
+        tshark -n -r "$corpus/$name.pcap" -d tcp.port==4059,DLMS -V >/dev/null
+    read seconds rss <"$corpus/time"
+    /usr/bin/time -f '%e' -o "$corpus/time" \
+        tshark -n -r "$corpus/$name.pcap" -d tcp.port==4059,DLMS -2 -Y 'dlms.apdu == 196' >/dev/null
+    read filter_seconds <"$corpus/time"
+    awk -v n="$name" -v f="$frames" -v b="$bytes" -v s="$seconds" -v r="$rss" -v t="$filter_seconds" \
+        'BEGIN { if (s <= 0) s = 0.01; if (t <= 0) t = 0.01
+                 printf "%-16s %8d %12.0f %10.1f %10d %12.0f\n", n, f, f / s, b / s / 1e6, r, f / t }'
+done
@@ -0,0 +1,6 @@
+#!/bin/sh
+gcc -O2 -Wall -pthread -o dlms-export dlms_export.c dlms_core.c -lm -s &&
+gcc -O2 -Wall -o dlms-bench dlms_bench.c dlms_core.c dlms_encode.c -s &&
+gcc -O2 -Wall -o dlms-fuzz dlms_fuzz.c dlms_core.c -s &&
+gcc -O2 -Wall -o dlms-import dlms_import.c -s &&
+exec gcc -O2 -Wall -o dlms-sim dlms_sim.c dlms_core.c dlms_encode.c -s
@@ -6,6 +6,6 @@
 @set wireshark_run_dir=%wireshark_build_dir%\run\RelWithDebInfo
 @set gtk2_dir=..\wireshark-win64-libs-2.6\gtk2
 
-cl.exe /nologo /O2 /I%wireshark_source_dir% /I%wireshark_build_dir% /I%gtk2_dir%\include\glib-2.0 /I%gtk2_dir%\lib\glib-2.0\include /LD dlms.c %wireshark_run_dir%\wireshark.lib
+cl.exe /nologo /O2 /I%wireshark_source_dir% /I%wireshark_build_dir% /I%gtk2_dir%\include\glib-2.0 /I%gtk2_dir%\lib\glib-2.0\include /LD dlms.c dlms_core.c %wireshark_run_dir%\wireshark.lib
 
 copy dlms.dll %wireshark_run_dir%\plugins\2.6\epan\dlms.dll
@@ -21,31 +21,57 @@
 #define WS_BUILD_DLL
 #define NEW_PROTO_TREE_API
 #include <config.h>
+#include <errno.h>
+#include <epan/conversation.h>
+#include <epan/conversation_table.h>
+#include <epan/dissectors/packet-tcp.h>
 #include <epan/exceptions.h>
 #include <epan/expert.h>
 #include <epan/packet.h>
+#include <epan/prefs.h>
+#include <epan/proto_data.h>
 #include <epan/reassemble.h>
+#include <epan/stat_tap_ui.h>
+#include <epan/stats_tree.h>
+#include <epan/tap.h>
+#include <wsutil/file_util.h>
+#ifdef VERSION_RELEASE /* wireshark >= 2.6 */
+#include <wsutil/report_message.h>
+#else /* wireshark < 2.6 */
+#include <wsutil/report_err.h>
+#endif
 #include <ws_symbol_export.h>
+#define DLMS_PUBLIC WS_DLL_PUBLIC_DEF
+#include "dlms.h"
+#include "dlms_core.h"
 #include "obis.h"
 
-/* Choice values for the currently supported ACSE and xDLMS APDUs */
-#define DLMS_DATA_NOTIFICATION 15
-#define DLMS_AARQ 96
-#define DLMS_AARE 97
-#define DLMS_RLRQ 98
-#define DLMS_RLRE 99
-#define DLMS_GET_REQUEST 192
-#define DLMS_SET_REQUEST 193
-#define DLMS_EVENT_NOTIFICATION_REQUEST 194
-#define DLMS_ACTION_REQUEST 195
-#define DLMS_GET_RESPONSE 196
-#define DLMS_SET_RESPONSE 197
-#define DLMS_ACTION_RESPONSE 199
-#define DLMS_EXCEPTION_RESPONSE 216
-#define DLMS_ACCESS_REQUEST 217
-#define DLMS_ACCESS_RESPONSE 218
+/* Names of the currently supported ACSE and xDLMS APDUs (choice values in dlms_core.h) */
 static const value_string dlms_apdu_names[] = {
+    { DLMS_READ_REQUEST, "readRequest" },
+    { DLMS_WRITE_REQUEST, "writeRequest" },
+    { DLMS_READ_RESPONSE, "readResponse" },
+    { DLMS_WRITE_RESPONSE, "writeResponse" },
     { DLMS_DATA_NOTIFICATION, "data-notification" },
+    { DLMS_UNCONFIRMED_WRITE_REQUEST, "unconfirmedWriteRequest" },
+    { 33, "glo-initiateRequest" },
+    { 37, "glo-readRequest" },
+    { 38, "glo-writeRequest" },
+    { 40, "glo-initiateResponse" },
+    { 44, "glo-readResponse" },
+    { 45, "glo-writeResponse" },
+    { 46, "glo-confirmedServiceError" },
+    { 54, "glo-unconfirmedWriteRequest" },
+    { 56, "glo-informationReportRequest" },
+    { 65, "ded-initiateRequest" },
+    { 69, "ded-readRequest" },
+    { 70, "ded-writeRequest" },
+    { 72, "ded-initiateResponse" },
+    { 76, "ded-readResponse" },
+    { 77, "ded-writeResponse" },
+    { 78, "ded-confirmedServiceError" },
+    { 86, "ded-unconfirmedWriteRequest" },
+    { 88, "ded-informationReportRequest" },
     { DLMS_AARQ, "aarq" },
     { DLMS_AARE, "aare" },
     { DLMS_RLRQ, "rlrq" },
@@ -57,9 +83,26 @@ static const value_string dlms_apdu_names[] = {
     { DLMS_GET_RESPONSE, "get-response" },
     { DLMS_SET_RESPONSE, "set-response" },
     { DLMS_ACTION_RESPONSE, "action-response" },
+    { 200, "glo-get-request" },
+    { 201, "glo-set-request" },
+    { 202, "glo-event-notification-request" },
+    { 203, "glo-action-request" },
+    { 204, "glo-get-response" },
+    { 205, "glo-set-response" },
+    { 207, "glo-action-response" },
+    { 208, "ded-get-request" },
+    { 209, "ded-set-request" },
+    { 210, "ded-event-notification-request" },
+    { 211, "ded-action-request" },
+    { 212, "ded-get-response" },
+    { 213, "ded-set-response" },
+    { 215, "ded-action-response" },
     { DLMS_EXCEPTION_RESPONSE, "exception-response" },
     { DLMS_ACCESS_REQUEST, "access-request" },
     { DLMS_ACCESS_RESPONSE, "access-response" },
+    { DLMS_GENERAL_GLO_CIPHERING, "general-glo-ciphering" },
+    { DLMS_GENERAL_DED_CIPHERING, "general-ded-ciphering" },
+    { DLMS_GENERAL_BLOCK_TRANSFER, "general-block-transfer" },
     { 0, 0 }
 };
 
@@ -160,6 +203,47 @@ static const value_string dlms_access_request_names[] = {
     { 0, 0 },
 };
 
+/* Choice values for a Variable-Access-Specification (short name referencing) */
+#define DLMS_VARIABLE_NAME 2
+#define DLMS_DETAILED_ACCESS 3
+#define DLMS_PARAMETERIZED_ACCESS 4
+#define DLMS_BLOCK_NUMBER_ACCESS 5
+#define DLMS_READ_DATA_BLOCK_ACCESS 6
+#define DLMS_WRITE_DATA_BLOCK_ACCESS 7
+static const value_string dlms_variable_access_specification_names[] = {
+    { DLMS_VARIABLE_NAME, "variable-name" },
+    { DLMS_DETAILED_ACCESS, "detailed-access" },
+    { DLMS_PARAMETERIZED_ACCESS, "parameterized-access" },
+    { DLMS_BLOCK_NUMBER_ACCESS, "block-number-access" },
+    { DLMS_READ_DATA_BLOCK_ACCESS, "read-data-block-access" },
+    { DLMS_WRITE_DATA_BLOCK_ACCESS, "write-data-block-access" },
+    { 0, 0 },
+};
+
+/* Choice values for the results of a ReadResponse */
+#define DLMS_READ_DATA 0
+#define DLMS_READ_DATA_ACCESS_ERROR 1
+#define DLMS_READ_DATA_BLOCK_RESULT 2
+#define DLMS_READ_BLOCK_NUMBER 3
+static const value_string dlms_read_data_result_names[] = {
+    { DLMS_READ_DATA, "data" },
+    { DLMS_READ_DATA_ACCESS_ERROR, "data-access-error" },
+    { DLMS_READ_DATA_BLOCK_RESULT, "data-block-result" },
+    { DLMS_READ_BLOCK_NUMBER, "block-number" },
+    { 0, 0 },
+};
+
+/* Choice values for the results of a WriteResponse */
+#define DLMS_WRITE_SUCCESS 0
+#define DLMS_WRITE_DATA_ACCESS_ERROR 1
+#define DLMS_WRITE_BLOCK_NUMBER 2
+static const value_string dlms_write_data_result_names[] = {
+    { DLMS_WRITE_SUCCESS, "success" },
+    { DLMS_WRITE_DATA_ACCESS_ERROR, "data-access-error" },
+    { DLMS_WRITE_BLOCK_NUMBER, "block-number" },
+    { 0, 0 },
+};
+
 /* Choice values for an Access-Response-Specification */
 static const value_string dlms_access_response_names[] = {
     { 1, "access-response-get" },
@@ -250,6 +334,137 @@ static const value_string dlms_processing_option_names[] = {
     { 0, 0 }
 };
 
+/* Names of the application context names (last arc of 2.16.756.5.8.1) */
+static const value_string dlms_application_context_names[] = {
+    { 1, "Logical_Name_Referencing_No_Ciphering" },
+    { 2, "Short_Name_Referencing_No_Ciphering" },
+    { 3, "Logical_Name_Referencing_With_Ciphering" },
+    { 4, "Short_Name_Referencing_With_Ciphering" },
+    { 0, 0 }
+};
+
+/* Names of the authentication mechanism names (last arc of 2.16.756.5.8.2) */
+static const value_string dlms_mechanism_names[] = {
+    { 0, "lowest-level-security" },
+    { 1, "low-level-security" },
+    { 2, "high-level-security" },
+    { 3, "high-level-security-md5" },
+    { 4, "high-level-security-sha1" },
+    { 5, "high-level-security-gmac" },
+    { 6, "high-level-security-sha256" },
+    { 7, "high-level-security-ecdsa" },
+    { 0, 0 }
+};
+
+/* Enumerated values for the result of an AARE */
+static const value_string dlms_association_result_names[] = {
+    { 0, "accepted" },
+    { 1, "rejected-permanent" },
+    { 2, "rejected-transient" },
+    { 0, 0 }
+};
+
+/* Enumerated values for the acse-service-user result-source-diagnostic of an AARE */
+static const value_string dlms_acse_service_user_names[] = {
+    { 0, "null" },
+    { 1, "no-reason-given" },
+    { 2, "application-context-name-not-supported" },
+    { 3, "calling-AP-title-not-recognized" },
+    { 4, "calling-AP-invocation-identifier-not-recognized" },
+    { 5, "calling-AE-qualifier-not-recognized" },
+    { 6, "calling-AE-invocation-identifier-not-recognized" },
+    { 7, "called-AP-title-not-recognized" },
+    { 8, "called-AP-invocation-identifier-not-recognized" },
+    { 9, "called-AE-qualifier-not-recognized" },
+    { 10, "called-AE-invocation-identifier-not-recognized" },
+    { 11, "authentication-mechanism-name-not-recognised" },
+    { 12, "authentication-mechanism-name-required" },
+    { 13, "authentication-failure" },
+    { 14, "authentication-required" },
+    { 0, 0 }
+};
+
+/* Enumerated values for the acse-service-provider result-source-diagnostic of an AARE */
+static const value_string dlms_acse_service_provider_names[] = {
+    { 0, "null" },
+    { 1, "no-reason-given" },
+    { 2, "no-common-acse-version" },
+    { 0, 0 }
+};
+
+/* Key set bit of the security control byte of a ciphered APDU */
+static const value_string dlms_key_set_names[] = {
+    { 0, "unicast" },
+    { 1, "broadcast" },
+    { 0, 0 }
+};
+
+/* Choice values for the xDLMS APDU in the user-information of an AARQ or AARE */
+#define DLMS_INITIATE_REQUEST 1
+#define DLMS_INITIATE_RESPONSE 8
+#define DLMS_CONFIRMED_SERVICE_ERROR 14
+static const value_string dlms_xdlms_apdu_names[] = {
+    { DLMS_INITIATE_REQUEST, "initiate-request" },
+    { DLMS_INITIATE_RESPONSE, "initiate-response" },
+    { DLMS_CONFIRMED_SERVICE_ERROR, "confirmed-service-error" },
+    { DLMS_GLO_INITIATE_REQUEST, "glo-initiate-request" },
+    { DLMS_GLO_INITIATE_RESPONSE, "glo-initiate-response" },
+    { DLMS_DED_INITIATE_REQUEST, "ded-initiate-request" },
+    { DLMS_DED_INITIATE_RESPONSE, "ded-initiate-response" },
+    { 0, 0 }
+};
+
+/* Choice values for a ConfirmedServiceError */
+static const value_string dlms_confirmed_service_error_names[] = {
+    { 1, "initiateError" },
+    { 2, "getStatus" },
+    { 3, "getNameList" },
+    { 4, "getVariableAttribute" },
+    { 5, "read" },
+    { 6, "write" },
+    { 7, "getDataSetAttribute" },
+    { 8, "getTIAttribute" },
+    { 9, "changeScope" },
+    { 10, "start" },
+    { 11, "stop" },
+    { 12, "resume" },
+    { 13, "makeUsable" },
+    { 14, "initiateLoad" },
+    { 15, "loadSegment" },
+    { 16, "terminateLoad" },
+    { 17, "initiateUpLoad" },
+    { 18, "upLoadSegment" },
+    { 19, "terminateUpLoad" },
+    { 0, 0 }
+};
+
+/* Choice values for a ServiceError */
+#define DLMS_SERVICE_ERROR_INITIATE 6
+static const value_string dlms_service_error_type_names[] = {
+    { 0, "application-reference" },
+    { 1, "hardware-resource" },
+    { 2, "vde-state-error" },
+    { 3, "service" },
+    { 4, "definition" },
+    { 5, "access" },
+    { DLMS_SERVICE_ERROR_INITIATE, "initiate" },
+    { 7, "load-data-set" },
+    { 8, "change-scope" },
+    { 9, "task" },
+    { 10, "other" },
+    { 0, 0 }
+};
+
+/* Enumerated values for an initiate ServiceError */
+static const value_string dlms_initiate_error_names[] = {
+    { 0, "other" },
+    { 1, "dlms-version-too-low" },
+    { 2, "incompatible-conformance" },
+    { 3, "pdu-size-too-short" },
+    { 4, "refused-by-the-VDE-Handler" },
+    { 0, 0 }
+};
+
 /* HDLC frame names for the control field values (with the RRR, P/F, and SSS bits masked off) */
 static const value_string dlms_hdlc_frame_names[] = {
     { 0x00, "I (Information)" },
@@ -272,10 +487,14 @@ struct dlms_cosem_class {
 };
 typedef struct dlms_cosem_class dlms_cosem_class;
 
-/* Get the DLMS/COSEM class with the specified class_id */
-static const dlms_cosem_class *
-dlms_get_class(int class_id) {
-    const short ids[] = {
+/* The DLMS/COSEM classes (dlms_cosem_class by class_id), built-in and registered */
+static GHashTable *dlms_classes;
+
+/* Create the index of the classes, with the built-in ones */
+static void
+dlms_index_classes(void)
+{
+    static const short ids[] = {
         1, /* data */
         3, /* register */
         4, /* extended register */
@@ -633,13 +852,40 @@ dlms_get_class(int class_id) {
     };
     unsigned i;
 
+    dlms_classes = g_hash_table_new(g_direct_hash, g_direct_equal);
     for (i = 0; i < array_length(ids); i++) {
-        if (ids[i] == class_id) {
-            return &classes[i];
-        }
+        g_hash_table_insert(dlms_classes, GINT_TO_POINTER(ids[i]), (gpointer)&classes[i]);
     }
+}
 
-    return 0;
+/* Get the DLMS/COSEM class with the specified class_id */
+static const dlms_cosem_class *
+dlms_get_class(int class_id) {
+    if (!dlms_classes) {
+        dlms_index_classes();
+    }
+    return (const dlms_cosem_class *)g_hash_table_lookup(dlms_classes, GINT_TO_POINTER(class_id));
+}
+
+/* Register the names of a class, merging them into the index of the classes (see dlms.h) */
+void
+dlms_register_class(unsigned class_id, const char *name, const char *const *attributes, const char *const *methods)
+{
+    dlms_cosem_class *c;
+    unsigned i;
+
+    if (!dlms_classes) {
+        dlms_index_classes();
+    }
+    c = g_new0(dlms_cosem_class, 1);
+    c->name = name;
+    for (i = 0; attributes && attributes[i] && i < array_length(c->attributes); i++) {
+        c->attributes[i] = attributes[i];
+    }
+    for (i = 0; methods && methods[i] && i < array_length(c->methods); i++) {
+        c->methods[i] = methods[i];
+    }
+    g_hash_table_insert(dlms_classes, GUINT_TO_POINTER(class_id), c);
 }
 
 static const char *
@@ -663,6 +909,9 @@ dlms_get_method_name(const dlms_cosem_class *c, int method_id) {
 /* The DLMS protocol handle */
 static int dlms_proto;
 
+/* The dissectors of the values of the attributes and methods of each class (see dlms.h) */
+static dissector_table_t dlms_class_table;
+
 /* The DLMS header_field_info (hfi) structures */
 static struct {
     /* HDLC */
@@ -671,6 +920,8 @@ static struct {
     header_field_info hdlc_segmentation; /* frame format segmentation bit */
     header_field_info hdlc_length; /* frame format length sub-field */
     header_field_info hdlc_address; /* destination/source address */
+    header_field_info hdlc_logical_device; /* upper HDLC address of 2 and 4 byte addresses */
+    header_field_info hdlc_physical_device; /* lower HDLC address of 2 and 4 byte addresses */
     header_field_info hdlc_frame_i; /* control field & 0x01 (I) */
     header_field_info hdlc_frame_rr_rnr; /* control field & 0x0f (RR or RNR) */
     header_field_info hdlc_frame_other; /* control field & 0xef (all other) */
@@ -681,14 +932,59 @@ static struct {
     header_field_info hdlc_fcs; /* frame check sequence */
     header_field_info hdlc_parameter; /* information field parameter */
     header_field_info hdlc_llc; /* LLC header */
+    header_field_info hdlc_analysis_window; /* I frames sent in a row by the sender of the frame */
+    header_field_info hdlc_analysis_negotiated_window; /* window size negotiated for the sender of the frame */
+    header_field_info hdlc_analysis_information_fill; /* information field length in percent of the negotiated maximum */
+    header_field_info hdlc_analysis_expected_ssn; /* N(S) that the receiver expected */
+    header_field_info hdlc_analysis_rnr_stall; /* time the sender of the frame was not ready */
     /* IEC 4-32 LLC */
     header_field_info iec432llc;
     /* Wrapper Protocol Data Unit (WPDU) */
     header_field_info wrapper_header;
+    header_field_info wrapper_version;
+    header_field_info wrapper_source_wport;
+    header_field_info wrapper_destination_wport;
+    header_field_info wrapper_length;
+    /* Endpoints (wrapper wPorts or HDLC addresses) */
+    header_field_info srcport;
+    header_field_info dstport;
+    header_field_info port;
     /* APDU */
     header_field_info apdu;
     header_field_info client_max_receive_pdu_size;
     header_field_info server_max_receive_pdu_size;
+    /* AARQ and AARE */
+    header_field_info acse_protocol_version;
+    header_field_info application_context_name;
+    header_field_info application_context;
+    header_field_info called_ap_title;
+    header_field_info called_ae_qualifier;
+    header_field_info calling_ap_title;
+    header_field_info calling_ae_qualifier;
+    header_field_info responding_ap_title;
+    header_field_info responding_ae_qualifier;
+    header_field_info acse_requirements;
+    header_field_info mechanism_name;
+    header_field_info mechanism;
+    header_field_info calling_authentication_value;
+    header_field_info responding_authentication_value;
+    header_field_info implementation_information;
+    header_field_info association_result;
+    header_field_info acse_service_user;
+    header_field_info acse_service_provider;
+    header_field_info acse_field;
+    /* xDLMS InitiateRequest, InitiateResponse and ConfirmedServiceError */
+    header_field_info xdlms_apdu;
+    header_field_info dedicated_key;
+    header_field_info response_allowed;
+    header_field_info proposed_quality_of_service;
+    header_field_info negotiated_quality_of_service;
+    header_field_info proposed_dlms_version_number;
+    header_field_info negotiated_dlms_version_number;
+    header_field_info vaa_name;
+    header_field_info confirmed_service_error;
+    header_field_info service_error_type;
+    header_field_info service_error_value;
     header_field_info get_request;
     header_field_info set_request;
     header_field_info action_request;
@@ -697,6 +993,10 @@ static struct {
     header_field_info action_response;
     header_field_info access_request;
     header_field_info access_response;
+    header_field_info variable_access_specification;
+    header_field_info variable_name;
+    header_field_info read_data_result;
+    header_field_info write_data_result;
     header_field_info class_id;
     header_field_info instance_id;
     header_field_info attribute_id;
@@ -708,10 +1008,64 @@ static struct {
     header_field_info last_block;
     header_field_info type_description;
     header_field_info data;
+    header_field_info data_skipped;
     header_field_info date_time;
     header_field_info length;
     header_field_info state_error;
     header_field_info service_error;
+    header_field_info response_in;
+    header_field_info response_to;
+    header_field_info response_time;
+    /* General-Block-Transfer */
+    header_field_info gbt_last_block;
+    header_field_info gbt_streaming;
+    header_field_info gbt_window;
+    header_field_info gbt_block_number;
+    header_field_info gbt_block_number_ack;
+    /* Block transfer efficiency */
+    header_field_info transfer_blocks;
+    header_field_info transfer_bytes;
+    header_field_info transfer_pdu_size;
+    header_field_info transfer_fill;
+    /* Connection setup */
+    header_field_info setup_snrm_ua;
+    header_field_info setup_ua_aarq;
+    header_field_info setup_aarq_aare;
+    header_field_info setup_aare_hls;
+    header_field_info setup_hls;
+    header_field_info setup_first_request;
+    header_field_info setup_total;
+    /* Image transfer */
+    header_field_info image_session;
+    header_field_info image_block_number;
+    header_field_info image_size;
+    header_field_info image_block_size;
+    header_field_info image_blocks_sent;
+    header_field_info image_blocks;
+    header_field_info image_retransmissions;
+    header_field_info image_missing;
+    header_field_info image_missing_blocks;
+    header_field_info image_throughput;
+    header_field_info image_verify_time;
+    header_field_info image_activate_time;
+    /* Push analysis */
+    header_field_info push_number;
+    header_field_info push_interval;
+    header_field_info push_same_second;
+    header_field_info push_clock_drift;
+    /* Security header of ciphered APDUs */
+    header_field_info system_title;
+    header_field_info security_control;
+    header_field_info security_suite;
+    header_field_info security_authentication;
+    header_field_info security_encryption;
+    header_field_info security_key_set;
+    header_field_info security_compression;
+    header_field_info invocation_counter;
+    header_field_info ciphered_text;
+    header_field_info authentication_tag;
+    header_field_info previous_invocation_counter;
+    header_field_info invocation_counter_lost;
     /* Invoke-Id-And-Priority */
     header_field_info invoke_id;
     header_field_info service_class;
@@ -763,6 +1117,8 @@ static struct {
     { "Segmentation", "dlms.hdlc.segmentation", FT_UINT16, BASE_DEC, 0, 0x0800, 0, HFILL },
     { "Length", "dlms.hdlc.length", FT_UINT16, BASE_DEC, 0, 0x07ff, 0, HFILL },
     { "Upper HDLC Address", "dlms.hdlc.address", FT_UINT8, BASE_DEC, 0, 0xfe, 0, HFILL },
+    { "Logical Device Address", "dlms.hdlc.logical_device", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    { "Physical Device Address", "dlms.hdlc.physical_device", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
     { "Frame", "dlms.hdlc.frame", FT_UINT8, BASE_DEC, dlms_hdlc_frame_names, 0x01, 0, HFILL },
     { "Frame", "dlms.hdlc.frame", FT_UINT8, BASE_DEC, dlms_hdlc_frame_names, 0x0f, 0, HFILL },
     { "Frame", "dlms.hdlc.frame", FT_UINT8, BASE_DEC, dlms_hdlc_frame_names, 0xef, 0, HFILL },
@@ -773,14 +1129,59 @@ static struct {
     { "Frame Check Sequence", "dlms.hdlc.fcs", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
     { "Parameter", "dlms.hdlc.parameter", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
     { "LLC Header", "dlms.hdlc.llc", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
+    { "Frames In Window", "dlms.hdlc.analysis.window", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Negotiated Window Size", "dlms.hdlc.analysis.negotiated_window", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Information Field Fill", "dlms.hdlc.analysis.information_fill", FT_UINT8, BASE_DEC, 0, 0, 0, HFILL },
+    { "Expected Send Sequence Number", "dlms.hdlc.analysis.expected_ssn", FT_UINT8, BASE_DEC, 0, 0, 0, HFILL },
+    { "RNR Stall Time", "dlms.hdlc.analysis.rnr_stall", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
     /* IEC 4-32 LLC */
     { "IEC 4-32 LLC Header", "dlms.iec432llc", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
     /* Wrapper Protocol Data Unit (WPDU) */
     { "Wrapper Header", "dlms.wrapper", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
+    { "Version", "dlms.wrapper.version", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    { "Source wPort", "dlms.wrapper.source_wport", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    { "Destination wPort", "dlms.wrapper.destination_wport", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    { "Length", "dlms.wrapper.length", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    /* Endpoints (wrapper wPorts or HDLC addresses) */
+    { "Source Port", "dlms.srcport", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Destination Port", "dlms.dstport", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Source or Destination Port", "dlms.port", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
     /* APDU */
     { "APDU", "dlms.apdu", FT_UINT8, BASE_DEC, dlms_apdu_names, 0, 0, HFILL },
     { "Client Max Receive PDU Size", "dlms.client_max_receive_pdu_size", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
     { "Server Max Receive PDU Size", "dlms.server_max_receive_pdu_size", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    /* AARQ and AARE */
+    { "Protocol Version", "dlms.acse.protocol_version", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Application Context Name", "dlms.acse.application_context_name", FT_OID, BASE_NONE, 0, 0, 0, HFILL },
+    { "Application Context", "dlms.acse.application_context", FT_UINT8, BASE_DEC, dlms_application_context_names, 0, 0, HFILL },
+    { "Called AP Title", "dlms.acse.called_ap_title", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Called AE Qualifier", "dlms.acse.called_ae_qualifier", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Calling AP Title", "dlms.acse.calling_ap_title", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Calling AE Qualifier", "dlms.acse.calling_ae_qualifier", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Responding AP Title", "dlms.acse.responding_ap_title", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Responding AE Qualifier", "dlms.acse.responding_ae_qualifier", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "ACSE Requirements", "dlms.acse.requirements", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Mechanism Name", "dlms.acse.mechanism_name", FT_OID, BASE_NONE, 0, 0, 0, HFILL },
+    { "Mechanism", "dlms.acse.mechanism", FT_UINT8, BASE_DEC, dlms_mechanism_names, 0, 0, HFILL },
+    { "Calling Authentication Value", "dlms.acse.calling_authentication_value", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Responding Authentication Value", "dlms.acse.responding_authentication_value", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Implementation Information", "dlms.acse.implementation_information", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Result", "dlms.acse.result", FT_UINT8, BASE_DEC, dlms_association_result_names, 0, 0, HFILL },
+    { "Result Source Diagnostic (ACSE Service User)", "dlms.acse.service_user", FT_UINT8, BASE_DEC, dlms_acse_service_user_names, 0, 0, HFILL },
+    { "Result Source Diagnostic (ACSE Service Provider)", "dlms.acse.service_provider", FT_UINT8, BASE_DEC, dlms_acse_service_provider_names, 0, 0, HFILL },
+    { "Unknown ACSE Field", "dlms.acse.field", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    /* xDLMS InitiateRequest, InitiateResponse and ConfirmedServiceError */
+    { "xDLMS APDU", "dlms.xdlms_apdu", FT_UINT8, BASE_DEC, dlms_xdlms_apdu_names, 0, 0, HFILL },
+    { "Dedicated Key", "dlms.dedicated_key", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Response Allowed", "dlms.response_allowed", FT_BOOLEAN, BASE_NONE, 0, 0, 0, HFILL },
+    { "Proposed Quality Of Service", "dlms.proposed_quality_of_service", FT_INT8, BASE_DEC, 0, 0, 0, HFILL },
+    { "Negotiated Quality Of Service", "dlms.negotiated_quality_of_service", FT_INT8, BASE_DEC, 0, 0, 0, HFILL },
+    { "Proposed DLMS Version Number", "dlms.proposed_dlms_version_number", FT_UINT8, BASE_DEC, 0, 0, 0, HFILL },
+    { "Negotiated DLMS Version Number", "dlms.negotiated_dlms_version_number", FT_UINT8, BASE_DEC, 0, 0, 0, HFILL },
+    { "VAA Name", "dlms.vaa_name", FT_UINT16, BASE_HEX, 0, 0, 0, HFILL },
+    { "Confirmed Service Error", "dlms.confirmed_service_error", FT_UINT8, BASE_DEC, dlms_confirmed_service_error_names, 0, 0, HFILL },
+    { "Service Error", "dlms.service_error_type", FT_UINT8, BASE_DEC, dlms_service_error_type_names, 0, 0, HFILL },
+    { "Service Error Value", "dlms.service_error_value", FT_UINT8, BASE_DEC, 0, 0, 0, HFILL },
     { "Get Request", "dlms.get_request", FT_UINT8, BASE_DEC, dlms_get_request_names, 0, 0, HFILL },
     { "Set Request", "dlms.set_request", FT_UINT8, BASE_DEC, dlms_set_request_names, 0, 0, HFILL },
     { "Action Request", "dlms.action_request", FT_UINT8, BASE_DEC, dlms_action_request_names, 0, 0, HFILL },
@@ -789,6 +1190,10 @@ static struct {
     { "Action Response", "dlms.action_response", FT_UINT8, BASE_DEC, dlms_action_response_names, 0, 0, HFILL },
     { "Access Request", "dlms.action_request", FT_UINT8, BASE_DEC, dlms_access_request_names, 0, 0, HFILL },
     { "Access Response", "dlms.action_response", FT_UINT8, BASE_DEC, dlms_access_response_names, 0, 0, HFILL },
+    { "Variable Access Specification", "dlms.variable_access_specification", FT_UINT8, BASE_DEC, dlms_variable_access_specification_names, 0, 0, HFILL },
+    { "Variable Name", "dlms.variable_name", FT_UINT16, BASE_HEX, 0, 0, 0, HFILL },
+    { "Read Result", "dlms.read_result", FT_UINT8, BASE_DEC, dlms_read_data_result_names, 0, 0, HFILL },
+    { "Write Result", "dlms.write_result", FT_UINT8, BASE_DEC, dlms_write_data_result_names, 0, 0, HFILL },
     { "Class Id", "dlms.class_id", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
     { "Instance Id", "dlms.instance_id", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
     { "Attribute Id", "dlms.attribute_id", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
@@ -800,10 +1205,64 @@ static struct {
     { "Last Block", "dlms.last_block", FT_BOOLEAN, BASE_DEC, 0, 0, 0, HFILL },
     { "Type Description", "dlms.type_description", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
     { "Data", "dlms.data", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
+    { "Data (not of interest)", "dlms.data_skipped", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
     { "Date-Time", "dlms.date_time", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
     { "Length", "dlms.length", FT_NONE, BASE_NONE, 0, 0, 0, HFILL },
     { "State Error", "dlms.state_error", FT_UINT8, BASE_DEC, dlms_state_error_names, 0, 0, HFILL },
     { "Service Error", "dlms.service_error", FT_UINT8, BASE_DEC, dlms_service_error_names, 0, 0, HFILL },
+    { "Response In", "dlms.response_in", FT_FRAMENUM, BASE_NONE, FRAMENUM_TYPE(FT_FRAMENUM_RESPONSE), 0, 0, HFILL },
+    { "Response To", "dlms.response_to", FT_FRAMENUM, BASE_NONE, FRAMENUM_TYPE(FT_FRAMENUM_REQUEST), 0, 0, HFILL },
+    { "Response Time", "dlms.response_time", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    /* General-Block-Transfer */
+    { "Last Block", "dlms.gbt.last_block", FT_UINT8, BASE_DEC, 0, 0x80, 0, HFILL },
+    { "Streaming", "dlms.gbt.streaming", FT_UINT8, BASE_DEC, 0, 0x40, 0, HFILL },
+    { "Window", "dlms.gbt.window", FT_UINT8, BASE_DEC, 0, 0x3f, 0, HFILL },
+    { "Block Number", "dlms.gbt.block_number", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    { "Block Number Ack", "dlms.gbt.block_number_ack", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    /* Block transfer efficiency */
+    { "Transfer Blocks", "dlms.transfer.blocks", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Transfer Bytes", "dlms.transfer.bytes", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Negotiated PDU Size", "dlms.transfer.pdu_size", FT_UINT16, BASE_DEC, 0, 0, 0, HFILL },
+    { "Average Block Fill", "dlms.transfer.fill", FT_UINT8, BASE_DEC, 0, 0, 0, HFILL },
+    /* Connection setup */
+    { "SNRM To UA", "dlms.setup.snrm_ua", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    { "UA To AARQ", "dlms.setup.ua_aarq", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    { "AARQ To AARE", "dlms.setup.aarq_aare", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    { "AARE To HLS Pass 3", "dlms.setup.aare_hls", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    { "HLS Pass 3 To Pass 4", "dlms.setup.hls", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    { "Setup To First Request", "dlms.setup.first_request", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    { "Total Setup Time", "dlms.setup.total", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    /* Image transfer */
+    { "Image Transfer Session", "dlms.image.session", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Image Block Number", "dlms.image.block_number", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Image Size", "dlms.image.size", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Image Block Size", "dlms.image.block_size", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Image Blocks Sent", "dlms.image.blocks_sent", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Image Blocks Transferred", "dlms.image.blocks", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Image Blocks Retransmitted", "dlms.image.retransmissions", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Image Blocks Missing", "dlms.image.missing", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Missing Image Blocks", "dlms.image.missing_blocks", FT_STRING, BASE_NONE, 0, 0, 0, HFILL },
+    { "Image Transfer Throughput", "dlms.image.throughput", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Image Verify Time", "dlms.image.verify_time", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    { "Image Activate Time", "dlms.image.activate_time", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    /* Push analysis */
+    { "Push Number", "dlms.push.number", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Time Since Previous Push", "dlms.push.interval", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    { "Pushes In The Same Second", "dlms.push.same_second", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Clock Drift", "dlms.push.clock_drift", FT_RELATIVE_TIME, BASE_NONE, 0, 0, 0, HFILL },
+    /* Security header of ciphered APDUs */
+    { "System Title", "dlms.security.system_title", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Security Control", "dlms.security.control", FT_UINT8, BASE_HEX, 0, 0, 0, HFILL },
+    { "Security Suite", "dlms.security.suite", FT_UINT8, BASE_DEC, 0, DLMS_SECURITY_SUITE, 0, HFILL },
+    { "Authentication", "dlms.security.authentication", FT_UINT8, BASE_DEC, 0, DLMS_SECURITY_AUTHENTICATION, 0, HFILL },
+    { "Encryption", "dlms.security.encryption", FT_UINT8, BASE_DEC, 0, DLMS_SECURITY_ENCRYPTION, 0, HFILL },
+    { "Key Set", "dlms.security.key_set", FT_UINT8, BASE_DEC, dlms_key_set_names, DLMS_SECURITY_BROADCAST_KEY, 0, HFILL },
+    { "Compression", "dlms.security.compression", FT_UINT8, BASE_DEC, 0, DLMS_SECURITY_COMPRESSION, 0, HFILL },
+    { "Invocation Counter", "dlms.security.invocation_counter", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "Ciphered Text", "dlms.security.ciphered_text", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Authentication Tag", "dlms.security.authentication_tag", FT_BYTES, BASE_NONE, 0, 0, 0, HFILL },
+    { "Previous Invocation Counter", "dlms.security.previous_invocation_counter", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
+    { "APDUs Lost", "dlms.security.lost", FT_UINT32, BASE_DEC, 0, 0, 0, HFILL },
     /* Invoke-Id-And-Priority */
     { "Invoke Id", "dlms.invoke_id", FT_UINT8, BASE_DEC, 0, 0x0f, 0, HFILL },
     { "Service Class", "dlms.service_class", FT_UINT8, BASE_DEC, dlms_service_class_names, 0x40, 0, HFILL },
@@ -858,18 +1317,27 @@ static struct {
     gint hdlc_address;
     gint hdlc_control;
     gint hdlc_information;
+    gint hdlc_analysis;
+    gint wrapper;
     gint invoke_id_and_priority;
     gint access_request_specification;
     gint access_request;
     gint access_response_specification;
     gint access_response;
+    gint variable_access_specification;
+    gint sn_result; /* ReadResponse and WriteResponse results */
     gint cosem_attribute_or_method_descriptor;
     gint selective_access_descriptor;
     gint composite_data;
     gint user_information; /* AARQ and AARE user-information field */
     gint conformance; /* InitiateRequest proposed-conformance and InitiateResponse negotiated-confirmance */
     gint datablock;
+    gint block_control;
     gint data;
+    gint image;
+    gint push;
+    gint security;
+    gint security_control;
     /* fragment_items */
     gint fragment;
     gint fragments;
@@ -880,12 +1348,29 @@ static struct {
     expert_field no_success;
     expert_field not_implemented;
     expert_field check_sequence; /* bad HDLC check sequence (HCS or FCS) value */
+    expert_field low_block_fill; /* blocks use a small part of the negotiated PDU size */
+    expert_field unneeded_block_transfer; /* block transfer of data that would fit in a single PDU */
+    expert_field hdlc_retransmission; /* HDLC I frame with an N(S) that was already sent */
+    expert_field hdlc_out_of_sequence; /* HDLC I frame with an N(S) other than expected */
+    expert_field hdlc_window_exceeded; /* more HDLC I frames sent in a row than the negotiated window size */
+    expert_field image_retransmission; /* image block that was already transferred in the session */
+    expert_field image_missing; /* image verified or activated with blocks not transferred */
+    expert_field invocation_counter_gap; /* invocation counter past the next one of the sender */
+    expert_field invocation_counter_duplicate; /* invocation counter equal to the previous one of the sender */
+    expert_field invocation_counter_regression; /* invocation counter below the previous one of the sender */
+    expert_field reassembly_evicted; /* last fragment of a reassembly chain evicted later */
+    expert_field reassembly_discarded; /* fragment of an evicted reassembly chain */
 } dlms_ei;
 
 /*
- * The reassembly table is used for reassembling both
- * HDLC I frame segments and DLMS APDU datablocks.
- * The reassembly id is used as hash key to distinguish between the two.
+ * The reassembly table is used for reassembling HDLC I frame segments,
+ * DLMS APDU datablocks, General-Block-Transfer blocks and pblocks.
+ * The HDLC segments, datablocks and General-Block-Transfer blocks are
+ * reassembled per association and direction, and the pblocks per association,
+ * direction and Invoke-Id: their key is the address of a member of the
+ * association (passed as the data of the fragment functions), which is unique,
+ * so that the transfers of the meters behind the same gateway or on the same
+ * multi-drop line are kept apart. The reassembly id tells the kinds apart.
  */
 static reassembly_table dlms_reassembly_table;
 
@@ -893,6 +1378,8 @@ enum {
     /* Do not use 0 as id because that would return a NULL key */
     DLMS_REASSEMBLY_ID_HDLC = 1,
     DLMS_REASSEMBLY_ID_DATABLOCK,
+    DLMS_REASSEMBLY_ID_GBT,
+    DLMS_REASSEMBLY_ID_PBLOCK,
 };
 
 static guint
@@ -910,7 +1397,7 @@ dlms_reassembly_equal_func(gconstpointer key1, gconstpointer key2)
 static gpointer
 dlms_reassembly_key_func(const packet_info *pinfo, guint32 id, const void *data)
 {
-    return (gpointer)(gsize)id;
+    return data ? (gpointer)data : (gpointer)(gsize)id;
 }
 
 static void
@@ -935,1179 +1422,5312 @@ static const fragment_items dlms_fragment_items = {
     "Fragments"
 };
 
-static void
-dlms_dissect_invoke_id_and_priority(proto_tree *tree, tvbuff_t *tvb, gint *offset)
-{
-    proto_tree *subtree;
+/*
+ * Limits of the reassembly chains that are not complete yet (0 for no
+ * limit), so that the chains left by meters that drop mid-transfer do not
+ * pile up in long captures: the bytes of a chain, the bytes of all of them,
+ * and the frames and seconds since the last fragment of a chain.
+ */
+static guint dlms_reassembly_max_chain_bytes = 4 << 20;
+static guint dlms_reassembly_max_pending_bytes = 64 << 20;
+static guint dlms_reassembly_max_idle_frames = 0;
+static guint dlms_reassembly_max_idle_seconds = 600;
 
-    subtree = proto_tree_add_subtree(tree, tvb, *offset, 1, dlms_ett.invoke_id_and_priority, 0, "Invoke Id And Priority");
-    proto_tree_add_item(subtree, &dlms_hfi.invoke_id, tvb, *offset, 1, ENC_NA);
-    proto_tree_add_item(subtree, &dlms_hfi.service_class, tvb, *offset, 1, ENC_NA);
-    proto_tree_add_item(subtree, &dlms_hfi.priority, tvb, *offset, 1, ENC_NA);
-    *offset += 1;
-}
+/* Whether to reassemble the wrapper PDUs and HDLC frames split across TCP segments */
+static gboolean dlms_desegment = TRUE;
 
-static void
-dlms_dissect_long_invoke_id_and_priority(proto_tree *tree, tvbuff_t *tvb, gint *offset)
-{
-    proto_tree *subtree;
+/* The DLMS tap handle */
+static int dlms_tap;
 
-    subtree = proto_tree_add_subtree(tree, tvb, *offset, 4, dlms_ett.invoke_id_and_priority, 0, "Long Invoke Id And Priority");
-    proto_tree_add_item(subtree, &dlms_hfi.long_invoke_id, tvb, *offset, 4, ENC_BIG_ENDIAN);
-    proto_tree_add_item(subtree, &dlms_hfi.long_self_descriptive, tvb, *offset, 4, ENC_BIG_ENDIAN);
-    proto_tree_add_item(subtree, &dlms_hfi.long_processing_option, tvb, *offset, 4, ENC_BIG_ENDIAN);
-    proto_tree_add_item(subtree, &dlms_hfi.long_service_class, tvb, *offset, 4, ENC_BIG_ENDIAN);
-    proto_tree_add_item(subtree, &dlms_hfi.long_priority, tvb, *offset, 4, ENC_BIG_ENDIAN);
-    *offset += 4;
-}
+/* The DLMS dissector handle, which the heuristic dissectors attach to the conversations they recognise */
+static dissector_handle_t dlms_handle;
 
-static void
-dlms_dissect_cosem_attribute_or_method_descriptor(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset, int is_attribute)
-{
-    unsigned class_id, attribute_method_id;
-    const dlms_cosem_class *cosem_class;
-    const char *attribute_method_name;
-    const gchar *instance_name;
-    proto_tree *subtree;
-    proto_item *item;
+/* Keys of the DLMS protocol data attached to a packet */
+enum {
+    DLMS_PROTO_DATA_PACKET, /* dlms_frame_pdus, in packet scope */
+    DLMS_PROTO_DATA_FRAME, /* dlms_frame_data, in file scope, plus the index of the PDU in the frame */
+};
 
-    class_id = tvb_get_ntohs(tvb, *offset);
-    attribute_method_id = tvb_get_guint8(tvb, *offset + 8);
+/* Kinds of block transfer, which are accounted for separately */
+enum {
+    DLMS_TRANSFER_DATABLOCK,
+    DLMS_TRANSFER_GBT,
+    DLMS_TRANSFER_PBLOCK,
+    DLMS_TRANSFERS
+};
 
-    cosem_class = dlms_get_class(class_id);
-    if (cosem_class) {
-        col_append_fstr(pinfo->cinfo, COL_INFO, " %s", cosem_class->name);
-        if (is_attribute) {
-            attribute_method_name = dlms_get_attribute_name(cosem_class, attribute_method_id);
-        } else {
-            attribute_method_name = dlms_get_method_name(cosem_class, attribute_method_id);
-        }
-    } else {
-        col_append_fstr(pinfo->cinfo, COL_INFO, " %u", class_id);
-        attribute_method_name = 0;
-    }
+/*
+ * Blocks whose APDUs average less than this percentage of the negotiated
+ * PDU size are reported as wasting round trips.
+ */
+#define DLMS_LOW_BLOCK_FILL 75
 
-    if (attribute_method_name) {
-        col_append_fstr(pinfo->cinfo, COL_INFO, ".%s", attribute_method_name);
-    } else {
-        col_append_fstr(pinfo->cinfo, COL_INFO, ".%u", attribute_method_id);
-    }
-
-	instance_name = try_val64_to_str(tvb_get_ntoh48(tvb, *offset + 2), obis_code_names);
-	if (instance_name) {
-		col_append_fstr(pinfo->cinfo, COL_INFO, " %s", instance_name);
-	}
-	else {
-		col_append_fstr(pinfo->cinfo, COL_INFO, " %u.%u.%u.%u.%u.%u",
-			tvb_get_guint8(tvb, *offset + 2),
-			tvb_get_guint8(tvb, *offset + 3),
-			tvb_get_guint8(tvb, *offset + 4),
-			tvb_get_guint8(tvb, *offset + 5),
-			tvb_get_guint8(tvb, *offset + 6),
-			tvb_get_guint8(tvb, *offset + 7));
-	}
+/* Bytes of a Get-Response-Normal APDU before its data */
+#define DLMS_GET_RESPONSE_NORMAL_OVERHEAD 4
 
-    subtree = proto_tree_add_subtree(tree, tvb, *offset, 9, dlms_ett.cosem_attribute_or_method_descriptor, 0,
-                                     is_attribute ? "COSEM Attribute Descriptor" : "COSEM Method Descriptor");
+/* Stages of the connection setup of an association, in the order they happen */
+enum {
+    DLMS_SETUP_NONE,
+    DLMS_SETUP_SNRM,
+    DLMS_SETUP_UA,
+    DLMS_SETUP_AARQ,
+    DLMS_SETUP_AARE,
+    DLMS_SETUP_HLS_PASS_3, /* reply_to_hls_authentication action-request */
+    DLMS_SETUP_HLS_PASS_4, /* reply_to_hls_authentication action-response */
+    DLMS_SETUP_FIRST_REQUEST, /* first data request after the association is established */
+    DLMS_SETUP_STAGES
+};
 
-    item = proto_tree_add_item(subtree, &dlms_hfi.class_id, tvb, *offset, 2, ENC_BIG_ENDIAN);
-    if (cosem_class) {
-        proto_item_append_text(item, ": %s (%u)", cosem_class->name, class_id);
-    } else {
-        proto_item_append_text(item, ": Unknown (%u)", class_id);
-        expert_add_info(pinfo, item, &dlms_ei.not_implemented);
-    }
-    *offset += 2;
+/* Names of the time spent reaching each stage of the connection setup */
+static const value_string dlms_setup_stage_names[] = {
+    { DLMS_SETUP_UA, "SNRM to UA" },
+    { DLMS_SETUP_AARQ, "UA to AARQ" },
+    { DLMS_SETUP_AARE, "AARQ to AARE" },
+    { DLMS_SETUP_HLS_PASS_3, "AARE to HLS pass 3" },
+    { DLMS_SETUP_HLS_PASS_4, "HLS pass 3 to pass 4" },
+    { DLMS_SETUP_FIRST_REQUEST, "Setup to first request" },
+    { DLMS_SETUP_STAGES, "Total setup time" },
+    { 0, 0 }
+};
 
-    item = proto_tree_add_item(subtree, &dlms_hfi.instance_id, tvb, *offset, 6, ENC_NA);
-    proto_item_append_text(item, ": %s (%u.%u.%u.%u.%u.%u)",
-                           instance_name ? instance_name : "Unknown",
-                           tvb_get_guint8(tvb, *offset),
-                           tvb_get_guint8(tvb, *offset + 1),
-                           tvb_get_guint8(tvb, *offset + 2),
-                           tvb_get_guint8(tvb, *offset + 3),
-                           tvb_get_guint8(tvb, *offset + 4),
-                           tvb_get_guint8(tvb, *offset + 5));
-    *offset += 6;
+/* Directions of the pblock transfers of an association */
+enum {
+    DLMS_PBLOCK_REQUEST,
+    DLMS_PBLOCK_RESPONSE,
+};
 
-    item = proto_tree_add_item(subtree,
-                               is_attribute ? &dlms_hfi.attribute_id : &dlms_hfi.method_id,
-                               tvb, *offset, 1, ENC_BIG_ENDIAN);
-    if (attribute_method_name) {
-        proto_item_append_text(item, ": %s (%u)", attribute_method_name, attribute_method_id);
-    } else {
-        proto_item_append_text(item, ": Unknown (%u)", attribute_method_id);
-    }
-    *offset += 1;
+/* Efficiency of a complete block transfer, reported on its last block */
+struct dlms_transfer_result {
+    guint32 blocks; /* number of blocks */
+    guint32 bytes; /* number of bytes in the data of all blocks */
+    guint32 pdu_size; /* negotiated max receive PDU size of the receiver (0 if unknown) */
+    guint32 fill; /* average size of the APDUs of all but the last block, in percent of pdu_size */
+};
+typedef struct dlms_transfer_result dlms_transfer_result;
+
+/* Connection setup stage reached in a frame */
+struct dlms_setup_result {
+    int stage; /* DLMS_SETUP_* */
+    nstime_t duration; /* time since the previous stage */
+    nstime_t total; /* time since the first stage (for DLMS_SETUP_FIRST_REQUEST) */
+};
+typedef struct dlms_setup_result dlms_setup_result;
+
+/* Default HDLC window size and maximum information field length, used when SNRM/UA do not negotiate them */
+#define DLMS_HDLC_DEFAULT_WINDOW 1
+#define DLMS_HDLC_DEFAULT_INFORMATION_LENGTH 128
+
+/* HDLC link parameters of an SNRM or UA information field, from the point of view of its sender */
+struct dlms_hdlc_parameters {
+    guint32 max_information_length_transmit;
+    guint32 max_information_length_receive;
+    guint32 window_transmit;
+    guint32 window_receive;
+};
+typedef struct dlms_hdlc_parameters dlms_hdlc_parameters;
+
+/* Flags of the HDLC link analysis of a frame */
+#define DLMS_HDLC_I_FRAME 0x01
+#define DLMS_HDLC_FINAL 0x02 /* I frame with the poll/final bit set, which closes a window */
+#define DLMS_HDLC_RETRANSMISSION 0x04
+#define DLMS_HDLC_OUT_OF_SEQUENCE 0x08
+#define DLMS_HDLC_WINDOW_EXCEEDED 0x10
+#define DLMS_HDLC_RNR_STALL 0x20 /* first frame of a side after its RNR */
+
+/* HDLC link analysis of a frame */
+struct dlms_hdlc_result {
+    guint32 flags; /* DLMS_HDLC_* */
+    guint32 expected_ssn; /* N(S) expected instead (for DLMS_HDLC_OUT_OF_SEQUENCE) */
+    guint32 window; /* I frames sent in a row by the sender, up to this one */
+    guint32 negotiated_window; /* window size negotiated for the sender */
+    guint32 information_length; /* length of the information field of an I frame */
+    guint32 max_information_length; /* maximum information field length negotiated for the sender */
+    nstime_t rnr_stall; /* time since the RNR of the sender (for DLMS_HDLC_RNR_STALL) */
+};
+typedef struct dlms_hdlc_result dlms_hdlc_result;
+
+/*
+ * State of the image transfer session (class 18) of a meter, from its
+ * image_transfer_initiate to the next one. The transferred and retransmitted
+ * blocks are kept in bitmaps of one bit per block number.
+ */
+struct dlms_image_session {
+    const gchar *meter; /* name of the meter */
+    guint32 number; /* of the session among those of the meter, from 1 */
+    guint32 image_size; /* from the image_transfer_initiate (0 if not seen) */
+    guint32 block_size; /* largest image_block_value seen */
+    guint32 blocks_sent; /* image_block_transfer invocations, including retransmissions */
+    guint32 blocks; /* distinct blocks transferred */
+    guint32 retransmissions; /* image_block_transfer invocations of blocks already transferred */
+    guint32 bytes; /* bytes of the distinct blocks transferred */
+    guint32 bitmap_blocks; /* number of blocks the bitmaps have room for */
+    guint8 *transferred; /* bitmap of the blocks transferred */
+    guint8 *retransmitted; /* bitmap of the blocks retransmitted */
+    nstime_t start; /* time of the image_transfer_initiate, or else of the first block */
+    guint32 verify_frame; /* frame of the last image_verify request (0 if none) */
+    guint32 activate_frame; /* frame of the last image_activate request (0 if none) */
+    nstime_t verify_start; /* time of the first image_verify request */
+    nstime_t activate_start; /* time of the first image_activate request */
+    gboolean verified; /* whether an image_verify succeeded */
+    gboolean activated; /* whether an image_activate succeeded */
+};
+typedef struct dlms_image_session dlms_image_session;
+
+/* Block numbers past this are left out of the bitmaps (and so of the missing blocks) */
+#define DLMS_IMAGE_MAX_BLOCKS 0x100000
+
+/* Flags of the image transfer analysis of a frame */
+#define DLMS_IMAGE_BLOCK 0x01 /* image_block_transfer request */
+#define DLMS_IMAGE_RETRANSMISSION 0x02 /* of a block already transferred */
+#define DLMS_IMAGE_VERIFY_REQUEST 0x04 /* image_verify request */
+#define DLMS_IMAGE_ACTIVATE_REQUEST 0x08 /* image_activate request */
+#define DLMS_IMAGE_VERIFIED 0x10 /* first successful response to an image_verify */
+#define DLMS_IMAGE_ACTIVATED 0x20 /* first successful response to an image_activate */
+
+/* Image transfer analysis of a frame: the state of its session after the frame */
+struct dlms_image_result {
+    const dlms_image_session *session;
+    guint32 flags; /* DLMS_IMAGE_* */
+    guint32 block_number; /* for DLMS_IMAGE_BLOCK */
+    guint32 image_size;
+    guint32 block_size;
+    guint32 blocks_sent;
+    guint32 blocks;
+    guint32 retransmissions;
+    guint32 missing; /* blocks of the image not transferred (0 if the image size is not known) */
+    const gchar *missing_blocks; /* ranges of the missing block numbers (for DLMS_IMAGE_VERIFY_REQUEST and DLMS_IMAGE_ACTIVATE_REQUEST) */
+    guint32 throughput; /* bytes of distinct blocks per second since the start of the session */
+    nstime_t duration; /* from the first request (for DLMS_IMAGE_VERIFIED and DLMS_IMAGE_ACTIVATED) */
+};
+typedef struct dlms_image_result dlms_image_result;
+
+/* Current image transfer sessions (dlms_image_session by meter name), reset with each capture file */
+static wmem_map_t *dlms_image_sessions;
+
+/* Pushes (Data-Notification and Event-Notification APDUs) of a meter so far */
+struct dlms_push_state {
+    guint32 pushes;
+    nstime_t last; /* time of the last push */
+};
+typedef struct dlms_push_state dlms_push_state;
+
+/* Flags of the push analysis of a frame */
+#define DLMS_PUSH_INTERVAL 0x01 /* the meter pushed before */
+#define DLMS_PUSH_CLOCK_DRIFT 0x02 /* the APDU has a date-time that specifies a single time */
+
+/* Push analysis of a frame */
+struct dlms_push_result {
+    const gchar *meter;
+    guint32 flags; /* DLMS_PUSH_* */
+    guint32 number; /* of the push among those of the meter, from 1 */
+    guint32 same_second; /* pushes of all the meters in the same second of capture time, up to this one */
+    nstime_t interval; /* since the previous push of the meter */
+    nstime_t clock_drift; /* time of the APDU date-time minus capture time */
+};
+typedef struct dlms_push_result dlms_push_result;
+
+/*
+ * Pushes seen so far (dlms_push_state by meter name), and the number of
+ * pushes in each second of capture time (by second), reset with each capture file
+ */
+static wmem_map_t *dlms_push_meters;
+static wmem_map_t *dlms_push_seconds;
+
+/* Times a meter was first and last seen, for the meters statistics */
+struct dlms_meter_times {
+    nstime_t first_seen;
+    nstime_t last_seen;
+};
+typedef struct dlms_meter_times dlms_meter_times;
+
+/* Times of the meters seen so far (dlms_meter_times by meter name), reset with each capture file */
+static wmem_map_t *dlms_meter_times_map;
+
+/* Flags of the invocation counter analysis of a frame */
+#define DLMS_SECURITY_FIRST 0x01 /* first ciphered APDU of the sender */
+#define DLMS_SECURITY_GAP 0x02 /* invocation counter past the next one */
+#define DLMS_SECURITY_DUPLICATE 0x04 /* invocation counter equal to the previous one */
+#define DLMS_SECURITY_REGRESSION 0x08 /* invocation counter below the previous one */
+
+/* Reasons of the eviction of a reassembly chain */
+#define DLMS_EVICTED_CHAIN_BYTES 1 /* past dlms_reassembly_max_chain_bytes */
+#define DLMS_EVICTED_PENDING_BYTES 2 /* least recently extended when past dlms_reassembly_max_pending_bytes */
+#define DLMS_EVICTED_IDLE 3 /* past dlms_reassembly_max_idle_frames or dlms_reassembly_max_idle_seconds */
+#define DLMS_EVICTED_REASONS 4
+
+static const value_string dlms_evicted_names[] = {
+    { DLMS_EVICTED_CHAIN_BYTES, "Chain Too Long" },
+    { DLMS_EVICTED_PENDING_BYTES, "Too Many Pending Bytes" },
+    { DLMS_EVICTED_IDLE, "Idle" },
+    { 0, 0 }
+};
+
+/* Reassembly of the fragments of a frame that belong to a reassembly (id and data) */
+struct dlms_fragment_result {
+    guint32 id;
+    const void *data;
+    gboolean discarded; /* whether they belong to an evicted chain, and are not reassembled */
+    guint32 evicted; /* DLMS_EVICTED_* if the last of them was the last fragment of a chain evicted later (0 if none) */
+    struct dlms_fragment_result *next; /* of another reassembly in the same frame */
+};
+typedef struct dlms_fragment_result dlms_fragment_result;
+
+/* Reassembly of the fragments (HDLC segments or blocks) of a frame */
+struct dlms_reassembly_result {
+    dlms_fragment_result *fragments; /* by reassembly */
+    guint32 discarded; /* fragments not reassembled, as they belong to evicted chains */
+    guint32 evictions[DLMS_EVICTED_REASONS]; /* chains evicted in this frame, by reason */
+    guint32 evicted_bytes; /* bytes of the chains evicted in this frame */
+    guint32 pending_bytes; /* bytes of all the chains not complete yet, after this frame */
+};
+typedef struct dlms_reassembly_result dlms_reassembly_result;
+
+/* A reassembly chain that is not complete yet (see dlms_add_fragment) */
+struct dlms_reassembly_chain {
+    guint32 id; /* the reassembly id and data of its fragments */
+    const void *data;
+    gboolean discarding; /* whether it was evicted, and its fragments are skipped up to its last one */
+    guint32 bytes; /* of its fragments so far (0 if discarding) */
+    guint32 last_frame; /* of its last fragment so far */
+    nstime_t last_time;
+    dlms_fragment_result *last; /* of its last fragment so far */
+    struct dlms_reassembly_chain *older, *newer; /* in the list of the chains with pending bytes */
+};
+typedef struct dlms_reassembly_chain dlms_reassembly_chain;
+
+/*
+ * Reassembly chains by reassembly key, and the list of those with pending
+ * bytes from the least to the most recently extended, reset with each capture file
+ */
+static wmem_map_t *dlms_reassembly_chains;
+static struct {
+    dlms_reassembly_chain *oldest, *newest;
+    guint32 bytes;
+} dlms_reassembly_pending;
+
+/* Invocation counter analysis of a ciphered APDU */
+struct dlms_security_result {
+    const gchar *meter; /* name of the meter of the association (NULL if not known) */
+    const gchar *sender; /* the sender and key the invocation counter belongs to */
+    guint32 flags; /* DLMS_SECURITY_* */
+    guint32 previous; /* previous invocation counter of the sender (unless DLMS_SECURITY_FIRST) */
+    guint32 lost; /* APDUs skipped by a DLMS_SECURITY_GAP */
+};
+typedef struct dlms_security_result dlms_security_result;
+
+/* Last invocation counter of a sender and key (see dlms_track_invocation_counter) */
+struct dlms_invocation_state {
+    const gchar *sender;
+    guint32 counter;
+};
+typedef struct dlms_invocation_state dlms_invocation_state;
+
+/* Invocation counters (dlms_invocation_state by sender), reset with each capture file */
+static wmem_map_t *dlms_invocation_counters;
+
+/* Verdicts of the check sequences of an HDLC frame */
+#define DLMS_HDLC_CHECKED 0x01 /* the check sequences were verified */
+#define DLMS_HDLC_HCS_OK 0x02
+#define DLMS_HDLC_FCS_OK 0x04
+
+/*
+ * Texts of a COSEM attribute or method descriptor, formatted once per
+ * (class, OBIS code, attribute or method) and shared by every frame with it
+ */
+struct dlms_descriptor_text {
+    dlms_class_value value; /* the attribute or method, for the dlms.class_id dissectors */
+    gboolean class_known; /* whether the class is implemented */
+    const gchar *info; /* for the Info column, as " class.attribute instance" */
+    const gchar *class_text; /* appended to the class id item */
+    const gchar *instance_text; /* appended to the instance id item */
+    const gchar *member_text; /* appended to the attribute or method id item */
+};
+typedef struct dlms_descriptor_text dlms_descriptor_text;
+
+/* Key of the descriptor texts */
+struct dlms_descriptor_key {
+    guint64 class_instance; /* class id in the top 16 bits, OBIS code in the lower 48 bits */
+    guint32 member; /* attribute id, or method id + 0x100 */
+};
+typedef struct dlms_descriptor_key dlms_descriptor_key;
+
+/* Descriptor texts (dlms_descriptor_text by dlms_descriptor_key), reset with each capture file */
+static wmem_map_t *dlms_descriptor_texts;
+
+/*
+ * An entry of the object_list of an association SN object, which maps the
+ * base name of a COSEM object to its class and logical name
+ */
+struct dlms_sn_object {
+    guint32 base_name; /* short name of attribute 1, the names of the other attributes follow 8 apart */
+    guint32 class_id;
+    guint64 logical_name; /* OBIS code, in the lower 48 bits */
+};
+typedef struct dlms_sn_object dlms_sn_object;
+
+/* The object list of a meter, sorted by base name */
+struct dlms_sn_objects {
+    guint count;
+    const dlms_sn_object *objects;
+};
+typedef struct dlms_sn_objects dlms_sn_objects;
+
+/*
+ * Object lists (dlms_sn_objects by meter name), reset with each capture file.
+ * A list is replaced, never changed, when the meter sends it again,
+ * so that the names already resolved with it stay valid.
+ */
+static wmem_map_t *dlms_sn_object_lists;
+
+/* Base name of the current association SN object, unless the InitiateResponse tells otherwise */
+#define DLMS_SN_CURRENT_ASSOCIATION 0xfa00
+
+/* Extent of a Data value, as decoded on the first pass */
+struct dlms_data_extent {
+    guint32 end_offset; /* offset past the value (or where decoding stopped) */
+    gint status; /* DLMS_CORE_* result of the decoding */
+};
+typedef struct dlms_data_extent dlms_data_extent;
+
+/*
+ * Per-frame state, computed on the first pass.
+ * The descriptors and data arrays are in the order they were dissected,
+ * which is the same on every pass over the frame.
+ */
+struct dlms_frame_data {
+    guint32 frame; /* number of this frame */
+    nstime_t time; /* absolute time of this frame */
+    guint32 request_frame; /* frame with the request this frame responds to (0 if none) */
+    guint32 response_frame; /* frame with the response to this request (0 if none) */
+    nstime_t response_time; /* time elapsed between the request and this response */
+    dlms_transfer_result *transfer; /* set on the last block of a block transfer */
+    dlms_setup_result *setup; /* set on frames that reach a connection setup stage */
+    dlms_hdlc_result *hdlc; /* set on HDLC frames */
+    dlms_image_result *image; /* set on image transfer requests and responses */
+    dlms_push_result *push; /* set on Data-Notification and Event-Notification APDUs */
+    dlms_security_result *security; /* set on ciphered APDUs */
+    dlms_reassembly_result *reassembly; /* set on frames with fragments to reassemble */
+    const dlms_descriptor_text *request_descriptor; /* on responses, the descriptor of a request with a single one */
+    gboolean pblock_list; /* whether the pblocks reassembled in this frame carry a list of Data */
+    guint32 hdlc_checks; /* DLMS_HDLC_CHECKED, DLMS_HDLC_HCS_OK and DLMS_HDLC_FCS_OK */
+    wmem_array_t *descriptors; /* const dlms_descriptor_text pointers */
+    wmem_array_t *data; /* dlms_data_extent of the outermost Data values */
+};
+typedef struct dlms_frame_data dlms_frame_data;
+
+/* Per-association state, for a client/server pair within a conversation */
+struct dlms_association {
+    gboolean server_known; /* whether the direction of an APDU told us which side is the server */
+    const gchar *meter; /* name of the server endpoint (the meter) */
+    dlms_frame_data *pending[DLMS_REQUEST_SLOTS]; /* confirmed requests awaiting a response */
+    wmem_map_t *access_pending; /* confirmed ACCESS requests awaiting a response, by long invoke id */
+    int last_slot; /* slot (or long invoke id) of the most recent request, answered by an exception-response */
+    gboolean last_access; /* whether the most recent request was an ACCESS request */
+    guint32 server_port; /* wPort or HDLC address of the server, if server_known */
+    gchar hdlc_segments[2]; /* indexed by side, their addresses are the reassembly keys of the HDLC segments */
+    gchar datablocks[2]; /* likewise, of the datablocks */
+    gchar gbt_blocks[2]; /* likewise, of the General-Block-Transfer blocks */
+    /* Association parameters from the AARQ, AARE, InitiateRequest and InitiateResponse */
+    guint32 application_context; /* last arc of the application-context-name (0 if unknown) */
+    guint32 mechanism; /* last arc of the mechanism-name (0, lowest-level-security, if absent) */
+    guint32 result; /* AARE result */
+    gboolean accepted; /* whether an AARE accepted the association */
+    guint64 calling_ap_title; /* client system title (0 if absent) */
+    guint64 responding_ap_title; /* server system title (0 if absent) */
+    guint32 dlms_version; /* negotiated (or else proposed) DLMS version number */
+    guint32 proposed_conformance; /* conformance bits of the InitiateRequest */
+    guint32 negotiated_conformance; /* conformance bits of the InitiateResponse */
+    guint32 client_max_receive_pdu_size; /* from the InitiateRequest (0 if unknown) */
+    guint32 server_max_receive_pdu_size; /* from the InitiateResponse (0 if unknown) */
+    guint32 vaa_name; /* from the InitiateResponse */
+    guint32 dedicated_key_frame; /* frame of the InitiateRequest that carried a dedicated key in clear (0 if none) */
+    gboolean sn_object_list_pending; /* whether the client is reading the object_list of the current association SN */
+    struct {
+        guint32 blocks; /* blocks received so far */
+        guint32 bytes; /* bytes of block data received so far */
+        guint32 apdu_bytes; /* bytes of the APDUs of the blocks received so far, except the last */
+    } transfers[DLMS_TRANSFERS]; /* block transfers in progress */
+    struct { /* indexed by DLMS_PBLOCK_* and Invoke-Id */
+        gchar key; /* its address is the reassembly key of the pblocks */
+        gboolean list; /* whether the pblocks carry a list of Data (instead of a single Data) */
+        guint32 class_id; /* of the method descriptor of a single method */
+        guint32 method_id;
+    } pblocks[2][16];
+    struct {
+        int stage; /* last stage reached (DLMS_SETUP_*) */
+        nstime_t start; /* time of the first stage */
+        nstime_t last; /* time of the last stage */
+        guint32 hls_frame; /* frame of the HLS pass 3 request */
+    } setup;
+    struct { /* indexed by side, see dlms_track_hdlc */
+        guint32 window[2]; /* window size negotiated for the I frames sent by each side (0 if default) */
+        guint32 max_information_length[2]; /* negotiated for the I frames sent by each side (0 if default) */
+        guint32 next_ssn[2]; /* N(S) of the next new I frame of each side */
+        guint32 acked_ssn[2]; /* N(S) of the oldest I frame of each side not acknowledged by the other side */
+        guint32 burst[2]; /* I frames sent in a row by each side */
+        gboolean rnr[2]; /* whether each side sent an RNR and has not become ready since */
+        nstime_t rnr_time[2]; /* time of that RNR */
+    } hdlc;
+};
+typedef struct dlms_association dlms_association;
+
+/* Per-conversation state */
+struct dlms_conversation {
+    wmem_map_t *associations; /* dlms_association, by ordered pair of wPorts or HDLC addresses */
+};
+typedef struct dlms_conversation dlms_conversation;
+
+/* A Data value of a packet, for the export tap to decode */
+struct dlms_export_value {
+    tvbuff_t *tvb;
+    gint offset;
+    const dlms_class_value *descriptor; /* attribute or method the value belongs to (NULL if unknown) */
+};
+typedef struct dlms_export_value dlms_export_value;
+
+/* Number of export tap listeners, which need the Data values of each packet */
+static guint dlms_export_listeners;
+
+/* Per-packet information, shared by the dissection functions and the tap listeners */
+struct dlms_packet_info {
+    address src; /* network source address (if any) */
+    address dst; /* network destination address (if any) */
+    guint32 srcport; /* wrapper source wPort or HDLC source address (see dlms_hdlc_port) */
+    guint32 dstport; /* wrapper destination wPort or HDLC destination address */
+    gboolean has_ports; /* whether srcport and dstport were present in the frame */
+    gboolean is_hdlc; /* whether srcport and dstport are HDLC addresses (instead of wPorts) */
+    guint length; /* number of bytes in the DLMS frame */
+    int direction; /* DLMS_DIRECTION_* */
+    guint apdu_length; /* number of bytes in the outermost APDU */
+    guint descriptors; /* COSEM descriptors dissected so far in this pass */
+    guint data; /* outermost Data values dissected so far in this pass */
+    const dlms_descriptor_text *descriptor; /* last COSEM descriptor dissected (NULL if none) */
+    wmem_array_t *values; /* dlms_export_value of the Data values, if the export tap is on */
+    dlms_association *association;
+    dlms_frame_data *frame_data;
+    guint pdu; /* index of the PDU in the frame (a TCP segment may carry several) */
+};
+typedef struct dlms_packet_info dlms_packet_info;
+
+/* The DLMS PDUs of a frame dissected so far in this pass */
+struct dlms_frame_pdus {
+    guint count;
+    dlms_packet_info *current; /* of the PDU being dissected */
+};
+typedef struct dlms_frame_pdus dlms_frame_pdus;
+
+static dlms_packet_info *
+dlms_get_packet_info(packet_info *pinfo)
+{
+    dlms_frame_pdus *pdus;
+
+    pdus = (dlms_frame_pdus *)p_get_proto_data(pinfo->pool, pinfo, dlms_proto, DLMS_PROTO_DATA_PACKET);
+    return pdus ? pdus->current : 0;
 }
 
-static void
-dlms_dissect_cosem_attribute_descriptor(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+/* Start the packet info of the next PDU of the frame */
+static dlms_packet_info *
+dlms_new_packet_info(packet_info *pinfo)
 {
-    dlms_dissect_cosem_attribute_or_method_descriptor(tvb, pinfo, tree, offset, 1);
+    dlms_frame_pdus *pdus;
+    dlms_packet_info *pi;
+
+    pdus = (dlms_frame_pdus *)p_get_proto_data(pinfo->pool, pinfo, dlms_proto, DLMS_PROTO_DATA_PACKET);
+    if (!pdus) {
+        pdus = wmem_new0(pinfo->pool, dlms_frame_pdus);
+        p_add_proto_data(pinfo->pool, pinfo, dlms_proto, DLMS_PROTO_DATA_PACKET, pdus);
+    }
+    pi = wmem_new0(pinfo->pool, dlms_packet_info);
+    pi->pdu = pdus->count++;
+    pdus->current = pi;
+
+    return pi;
 }
 
-static void
-dlms_dissect_cosem_method_descriptor(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+/*
+ * Get the state of the current PDU of the frame, creating it on the first
+ * pass. Each PDU of a frame has its own, so that the PDUs of a TCP segment
+ * neither share their caches nor count twice in the statistics.
+ */
+static dlms_frame_data *
+dlms_get_frame_data(packet_info *pinfo)
 {
-    dlms_dissect_cosem_attribute_or_method_descriptor(tvb, pinfo, tree, offset, 0);
+    dlms_frame_data *fd;
+    guint32 key;
+
+    key = DLMS_PROTO_DATA_FRAME + dlms_get_packet_info(pinfo)->pdu;
+    fd = (dlms_frame_data *)p_get_proto_data(wmem_file_scope(), pinfo, dlms_proto, key);
+    if (!fd && !PINFO_FD_VISITED(pinfo)) {
+        fd = wmem_new0(wmem_file_scope(), dlms_frame_data);
+        fd->frame = pinfo->num;
+        fd->time = pinfo->abs_ts;
+        p_add_proto_data(wmem_file_scope(), pinfo, dlms_proto, key, fd);
+    }
+
+    return fd;
 }
 
-static void
-dlms_dissect_data_access_result(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+/*
+ * The port of an HDLC address: the upper HDLC address, and the lower HDLC
+ * address (physical device) in the high-order 16 bits for 2 and 4 byte
+ * addresses, so that the devices behind the same network address (on a
+ * multi-drop line) are told apart.
+ */
+static guint32
+dlms_hdlc_port(const dlms_core_hdlc_address *address)
 {
-    proto_item *item;
-    int result;
+    return address->length == 1 ? address->upper : (address->lower << 16) | address->upper;
+}
 
-    item = proto_tree_add_item(tree, &dlms_hfi.data_access_result, tvb, *offset, 1, ENC_NA);
-    result = tvb_get_guint8(tvb, *offset);
-    *offset += 1;
-    if (result != 0) {
-        const gchar *str = val_to_str_const(result, dlms_data_access_result_names, "unknown result");
-        col_append_fstr(pinfo->cinfo, COL_INFO, " (%s)", str);
-        expert_add_info(pinfo, item, &dlms_ei.no_success);
+/* Name a wPort or HDLC address (upper/lower for 2 and 4 byte HDLC addresses) */
+static const gchar *
+dlms_port_name(wmem_allocator_t *scope, guint32 port, gboolean is_hdlc)
+{
+    if (is_hdlc && (port >> 16)) {
+        return wmem_strdup_printf(scope, "%u/%u", port & 0xffff, port >> 16);
     }
+    return wmem_strdup_printf(scope, "%u", port);
 }
 
-/* Get the value encoded in the specified length octets in definite form */
-static unsigned
-dlms_get_length(tvbuff_t *tvb, gint *offset)
+/* Name an endpoint by its network address (if any) and its wPort or HDLC address */
+static const gchar *
+dlms_endpoint_name(wmem_allocator_t *scope, const address *addr, guint32 port, gboolean is_hdlc)
 {
-    unsigned length;
+    const gchar *kind = is_hdlc ? "HDLC" : "wPort";
+    const gchar *name = dlms_port_name(wmem_packet_scope(), port, is_hdlc);
 
-    length = tvb_get_guint8(tvb, *offset);
-    if ((length & 0x80) == 0) {
-        *offset += 1;
-    } else {
-        unsigned i, n = length & 0x7f;
-        length = 0;
-        for (i = 0; i < n; i++) {
-            length = (length << 8) + tvb_get_guint8(tvb, *offset + 1 + i);
-        }
-        *offset += 1 + n;
+    if (addr->type == AT_NONE) {
+        return wmem_strdup_printf(scope, "%s %s", kind, name);
     }
-
-    return length;
+    return wmem_strdup_printf(scope, "%s %s %s", address_to_str(wmem_packet_scope(), addr), kind, name);
 }
 
-static unsigned
-dlms_dissect_length(tvbuff_t *tvb, proto_tree *tree, gint *offset)
+/* Get the state of the association that the current packet belongs to */
+static dlms_association *
+dlms_get_association(packet_info *pinfo, dlms_packet_info *pi)
 {
-    gint start;
-    unsigned length;
-    proto_item *item;
+    conversation_t *conversation;
+    dlms_conversation *dc;
+    dlms_association *association;
+    guint64 key, *persistent_key;
 
-    start = *offset;
-    length = dlms_get_length(tvb, offset);
-    item = proto_tree_add_item(tree, &dlms_hfi.length, tvb, start, *offset - start, ENC_NA);
-    proto_item_append_text(item, ": %u", length);
+    if (pi->association) {
+        return pi->association;
+    }
 
-    return length;
+    conversation = find_or_create_conversation(pinfo);
+    dc = (dlms_conversation *)conversation_get_proto_data(conversation, dlms_proto);
+    if (!dc) {
+        dc = wmem_new0(wmem_file_scope(), dlms_conversation);
+        dc->associations = wmem_map_new(wmem_file_scope(), g_int64_hash, g_int64_equal);
+        conversation_add_proto_data(conversation, dlms_proto, dc);
+    }
+
+    key = pi->srcport < pi->dstport
+        ? ((guint64)pi->srcport << 32) | pi->dstport
+        : ((guint64)pi->dstport << 32) | pi->srcport;
+    association = (dlms_association *)wmem_map_lookup(dc->associations, &key);
+    if (!association) {
+        persistent_key = wmem_new(wmem_file_scope(), guint64);
+        *persistent_key = key;
+        association = wmem_new0(wmem_file_scope(), dlms_association);
+        wmem_map_insert(dc->associations, persistent_key, association);
+    }
+    pi->association = association;
+
+    return association;
 }
 
-/* Calculate the number of bytes used by a TypeDescription of a compact array */
+/*
+ * Get the side of the sender of the current packet in its association (0 or 1),
+ * to index the members of the association that are kept per direction
+ */
 static int
-dlms_get_type_description_length(tvbuff_t *tvb, gint offset)
-{
-    int choice = tvb_get_guint8(tvb, offset);
-    if (choice == 1) { // array
-        return 1 + 2 + dlms_get_type_description_length(tvb, offset + 3);
-    } else if (choice == 2) { // structure
-        gint end_offset = offset + 1;
-        int sequence_of = dlms_get_length(tvb, &end_offset);
-        while (sequence_of--) {
-            end_offset += dlms_get_type_description_length(tvb, end_offset);
-        }
-        return end_offset - offset;
-    } else {
-        return 1;
+dlms_get_side(packet_info *pinfo, const dlms_packet_info *pi)
+{
+    if (pi->srcport != pi->dstport) {
+        return pi->srcport > pi->dstport;
     }
+
+    return cmp_address(&pinfo->src, &pinfo->dst) > 0;
 }
 
-/* Attempt to parse a date-time from an octet-string */
+/* Advance the connection setup state machine of the association of the current frame (first pass only) */
 static void
-dlms_append_date_time_maybe(tvbuff_t *tvb, proto_item *item, gint offset, unsigned length)
+dlms_track_setup(packet_info *pinfo, dlms_packet_info *pi, int stage)
 {
-    unsigned year, month, day_of_month, day_of_week;
-    unsigned hour, minute, second, hundredths;
-    /* TODO: unsigned deviation, clock; */
+    dlms_association *association;
+    dlms_frame_data *fd;
+    dlms_setup_result *result;
+
+    association = dlms_get_association(pinfo, pi);
+    fd = dlms_get_frame_data(pinfo);
+
+    if (stage == DLMS_SETUP_SNRM || (stage == DLMS_SETUP_AARQ && association->setup.stage != DLMS_SETUP_UA)) {
+        /* Start of a new connection setup (wrapper connections start with the AARQ) */
+        association->setup.stage = stage;
+        association->setup.start = fd->time;
+        association->setup.last = fd->time;
+        return;
+    }
+    if (stage != association->setup.stage + 1
+        && !(stage == DLMS_SETUP_FIRST_REQUEST && association->setup.stage == DLMS_SETUP_AARE)) {
+        return;
+    }
 
-    if (length != 12) return;
-    year = tvb_get_ntohs(tvb, offset);
-    month = tvb_get_guint8(tvb, offset + 2);
-    if (month < 1 || (month > 12 && month < 0xfd)) return;
-    day_of_month = tvb_get_guint8(tvb, offset + 3);
-    if (day_of_month < 1 || (day_of_month > 31 && day_of_month < 0xfd)) return;
-    day_of_week = tvb_get_guint8(tvb, offset + 4);
-    if (day_of_week < 1 || (day_of_week > 7 && day_of_week < 0xff)) return;
-    hour = tvb_get_guint8(tvb, offset + 5);
-    if (hour > 23 && hour < 0xff) return;
-    minute = tvb_get_guint8(tvb, offset + 6);
-    if (minute > 59 && minute < 0xff) return;
-    second = tvb_get_guint8(tvb, offset + 7);
-    if (second > 59 && second < 0xff) return;
-    hundredths = tvb_get_guint8(tvb, offset + 8);
-    if (hundredths > 99 && hundredths < 0xff) return;
-
-    proto_item_append_text(item, year < 0xffff ? " (%u" : " (%X", year);
-    proto_item_append_text(item, month < 13 ? "/%02u" : "/%02X", month);
-    proto_item_append_text(item, day_of_month < 32 ? "/%02u" : "/%02X", day_of_month);
-    proto_item_append_text(item, hour < 24 ? " %02u" : " %02X", hour);
-    proto_item_append_text(item, minute < 60 ? ":%02u" : ":%02X", minute);
-    proto_item_append_text(item, second < 60 ? ":%02u" : ":%02X", second);
-    proto_item_append_text(item, hundredths < 100 ? ".%02u)" : ".%02X)", hundredths);
-}
-
-/* Set the value of an item with a planar data type (not array nor structure) */
-static void
-dlms_set_data_value(tvbuff_t *tvb, proto_item *item, gint choice, gint *offset)
-{
-    if (choice == 0) {
-        proto_item_set_text(item, "Null");
-    } else if (choice == 3) {
-        gboolean value = tvb_get_guint8(tvb, *offset);
-        proto_item_set_text(item, "Boolean: %s", value ? "true" : "false");
-        *offset += 1;
-    } else if (choice == 4) {
-        guint bits = dlms_get_length(tvb, offset);
-        guint bytes = (bits + 7) / 8;
-        proto_item_set_text(item, "Bit-string (bits: %u, bytes: %u):", bits, bytes);
-        *offset += bytes;
-    } else if (choice == 5) {
-        gint32 value = tvb_get_ntohl(tvb, *offset);
-        proto_item_set_text(item, "Double Long: %d", value);
-        *offset += 4;
-    } else if (choice == 6) {
-        guint32 value = tvb_get_ntohl(tvb, *offset);
-        proto_item_set_text(item, "Double Long Unsigned: %u", value);
-        *offset += 4;
-    } else if (choice == 9) {
-        guint length = dlms_get_length(tvb, offset);
-        proto_item_set_text(item, "Octet String (length %u)", length);
-        dlms_append_date_time_maybe(tvb, item, *offset, length);
-        *offset += length;
-    } else if (choice == 10) {
-        guint length = dlms_get_length(tvb, offset);
-        proto_item_set_text(item, "Visible String (length %u)", length);
-        *offset += length;
-    } else if (choice == 12) {
-        guint length = dlms_get_length(tvb, offset);
-        proto_item_set_text(item, "UTF8 String (length %u)", length);
-        *offset += length;
-    } else if (choice == 13) {
-        guint value = tvb_get_guint8(tvb, *offset);
-        proto_item_set_text(item, "BCD: 0x%02x", value);
-        *offset += 1;
-    } else if (choice == 15) {
-	gint8 value = tvb_get_guint8(tvb, *offset);
-        proto_item_set_text(item, "Integer: %d", value);
-        *offset += 1;
-    } else if (choice == 16) {
-        gint16 value = tvb_get_ntohs(tvb, *offset);
-        proto_item_set_text(item, "Long: %d", value);
-        *offset += 2;
-    } else if (choice == 17) {
-        guint8 value = tvb_get_guint8(tvb, *offset);
-        proto_item_set_text(item, "Unsigned: %u", value);
-        *offset += 1;
-    } else if (choice == 18) {
-        guint16 value = tvb_get_ntohs(tvb, *offset);
-        proto_item_set_text(item, "Long Unsigned: %u", value);
-        *offset += 2;
-    } else if (choice == 20) {
-        gint64 value = tvb_get_ntoh64(tvb, *offset);
-        proto_item_set_text(item, "Long64: %ld", value);
-        *offset += 8;
-    } else if (choice == 21) {
-        guint64 value = tvb_get_ntoh64(tvb, *offset);
-        proto_item_set_text(item, "Long64 Unsigned: %lu", value);
-        *offset += 8;
-    } else if (choice == 22) {
-        guint8 value = tvb_get_guint8(tvb, *offset);
-        proto_item_set_text(item, "Enum: %u", value);
-        *offset += 1;
-    } else if (choice == 23) {
-        gfloat value = tvb_get_ntohieee_float(tvb, *offset);
-        proto_item_set_text(item, "Float32: %f", value);
-        *offset += 4;
-    } else if (choice == 24) {
-        gdouble value = tvb_get_ntohieee_double(tvb, *offset);
-        proto_item_set_text(item, "Float64: %f", value);
-        *offset += 8;
-    } else if (choice == 25) {
-        proto_item_set_text(item, "Date Time");
-        *offset += 12;
-    } else if (choice == 26) {
-        proto_item_set_text(item, "Date");
-        *offset += 5;
-    } else if (choice == 27) {
-        proto_item_set_text(item, "Time");
-        *offset += 4;
-    } else if (choice == 255) {
-        proto_item_set_text(item, "Don't Care");
-    } else {
-        DISSECTOR_ASSERT_HINT(choice, "Invalid data type");
+    result = wmem_new0(wmem_file_scope(), dlms_setup_result);
+    result->stage = stage;
+    nstime_delta(&result->duration, &fd->time, &association->setup.last);
+    if (stage == DLMS_SETUP_FIRST_REQUEST) {
+        nstime_delta(&result->total, &fd->time, &association->setup.start);
+    } else if (stage == DLMS_SETUP_HLS_PASS_3) {
+        association->setup.hls_frame = fd->frame;
     }
+    fd->setup = result;
+    association->setup.stage = stage;
+    association->setup.last = fd->time;
 }
 
-static proto_item *
-dlms_dissect_compact_array_content(tvbuff_t *tvb, proto_tree *tree, gint description_offset, gint *content_offset)
+/*
+ * Analyse an HDLC frame against the state of its link (first pass only).
+ * The parameters are those of an SNRM or UA frame, which (re)initialise the link.
+ */
+static void
+dlms_track_hdlc(packet_info *pinfo, dlms_packet_info *pi, unsigned control, unsigned information_length,
+                const dlms_hdlc_parameters *parameters)
 {
-    proto_item *item, *subitem;
-    proto_tree *subtree;
-    unsigned choice;
+    dlms_association *association;
+    dlms_frame_data *fd;
+    dlms_hdlc_result *result;
+    int side, other;
+
+    association = dlms_get_association(pinfo, pi);
+    fd = dlms_get_frame_data(pinfo);
+    result = wmem_new0(wmem_file_scope(), dlms_hdlc_result);
+    fd->hdlc = result;
+
+    /* The two sides of a link, as the reassembly of its segments tells them apart */
+    side = dlms_get_side(pinfo, pi);
+    other = !side;
+
+    if (parameters) {
+        association->hdlc.max_information_length[side] = parameters->max_information_length_transmit;
+        association->hdlc.max_information_length[other] = parameters->max_information_length_receive;
+        association->hdlc.window[side] = parameters->window_transmit;
+        association->hdlc.window[other] = parameters->window_receive;
+        memset(association->hdlc.next_ssn, 0, sizeof association->hdlc.next_ssn);
+        memset(association->hdlc.acked_ssn, 0, sizeof association->hdlc.acked_ssn);
+        memset(association->hdlc.burst, 0, sizeof association->hdlc.burst);
+        memset(association->hdlc.rnr, 0, sizeof association->hdlc.rnr);
+        return;
+    }
 
-    item = proto_tree_add_item(tree, &dlms_hfi.data, tvb, *content_offset, 0, ENC_NA);
-    choice = tvb_get_guint8(tvb, description_offset);
-    description_offset += 1;
-    if (choice == 1) { /* array */
-        guint16 i, elements = tvb_get_ntohs(tvb, description_offset);
-        description_offset += 2;
-        proto_item_set_text(item, "Array (%u elements)", elements);
-        subtree = proto_item_add_subtree(item, dlms_ett.composite_data);
-        for (i = 0; i < elements; i++) {
-            subitem = dlms_dissect_compact_array_content(tvb, subtree, description_offset, content_offset);
-            proto_item_prepend_text(subitem, "[%u] ", i + 1);
-        }
-    } else if (choice == 2) { /* structure */
-        guint32 elements = dlms_get_length(tvb, &description_offset);
-        proto_item_set_text(item, "Structure");
-        subtree = proto_item_add_subtree(item, dlms_ett.composite_data);
-        while (elements--) {
-            dlms_dissect_compact_array_content(tvb, subtree, description_offset, content_offset);
-            description_offset += dlms_get_type_description_length(tvb, description_offset);
+    /* Any frame of this side closes the window of the other side */
+    association->hdlc.burst[other] = 0;
+
+    if ((control & 0x01) == 0x00 || (control & 0x0b) == 0x01) { /* I, RR or RNR */
+        /* N(R) acknowledges the I frames of the other side up to N(R) - 1 */
+        association->hdlc.acked_ssn[other] = (control >> 5) & 7;
+        if ((control & 0x0f) == 0x05) {
+            if (!association->hdlc.rnr[side]) {
+                association->hdlc.rnr[side] = TRUE;
+                association->hdlc.rnr_time[side] = fd->time;
+            }
+        } else if (association->hdlc.rnr[side]) {
+            association->hdlc.rnr[side] = FALSE;
+            nstime_delta(&result->rnr_stall, &fd->time, &association->hdlc.rnr_time[side]);
+            result->flags |= DLMS_HDLC_RNR_STALL;
         }
-    } else { /* planar type */
-        dlms_set_data_value(tvb, item, choice, content_offset);
     }
-    proto_item_set_end(item, tvb, *content_offset);
-
-    return item;
-}
 
-static proto_item *
-dlms_dissect_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
-{
-    proto_item *item, *subitem;
-    proto_tree *subtree;
-    unsigned choice, length, i;
+    if ((control & 0x01) == 0x00) {
+        unsigned ssn = (control >> 1) & 7;
+        unsigned next = association->hdlc.next_ssn[side];
+        unsigned acked = association->hdlc.acked_ssn[side];
 
-    item = proto_tree_add_item(tree, &dlms_hfi.data, tvb, *offset, 1, ENC_NA);
-    choice = tvb_get_guint8(tvb, *offset);
-    *offset += 1;
-    if (choice == 1) { /* array */
-        length = dlms_get_length(tvb, offset);
-        proto_item_set_text(item, "Array (%u elements)", length);
-        subtree = proto_item_add_subtree(item, dlms_ett.composite_data);
-        for (i = 0; i < length; i++) {
-            subitem = dlms_dissect_data(tvb, pinfo, subtree, offset);
-            proto_item_prepend_text(subitem, "[%u] ", i + 1);
-        }
-    } else if (choice == 2) { /* structure */
-        length = dlms_get_length(tvb, offset);
-        proto_item_set_text(item, "Structure");
-        subtree = proto_item_add_subtree(item, dlms_ett.composite_data);
-        for (i = 0; i < length; i++) {
-            dlms_dissect_data(tvb, pinfo, subtree, offset);
-        }
-    } else if (choice == 19) { /* compact-array */
-        int description_offset = *offset;
-        int description_length = dlms_get_type_description_length(tvb, *offset);
-        int content_end;
-        unsigned elements;
-        subtree = proto_item_add_subtree(item, dlms_ett.composite_data);
-        proto_tree_add_item(subtree, &dlms_hfi.type_description, tvb, description_offset, description_length, ENC_NA);
-        *offset += description_length;
-        length = dlms_dissect_length(tvb, subtree, offset);
-        elements = 0;
-        content_end = *offset + length;
-        while (*offset < content_end) {
-            subitem = dlms_dissect_compact_array_content(tvb, subtree, description_offset, offset);
-            proto_item_prepend_text(subitem, "[%u] ", ++elements);
-        }
-        proto_item_set_text(item, "Compact Array (%u elements)", elements);
-    } else { /* planar type */
-        dlms_set_data_value(tvb, item, choice, offset);
+        result->flags |= DLMS_HDLC_I_FRAME;
+        if (control & 0x10) {
+            result->flags |= DLMS_HDLC_FINAL;
+        }
+        result->window = ++association->hdlc.burst[side];
+        result->negotiated_window = association->hdlc.window[side] ? association->hdlc.window[side] : DLMS_HDLC_DEFAULT_WINDOW;
+        if (result->window > result->negotiated_window) {
+            result->flags |= DLMS_HDLC_WINDOW_EXCEEDED;
+        }
+        result->information_length = information_length;
+        result->max_information_length = association->hdlc.max_information_length[side]
+            ? association->hdlc.max_information_length[side] : DLMS_HDLC_DEFAULT_INFORMATION_LENGTH;
+        if (ssn != next) {
+            if (((ssn - acked) & 7) < ((next - acked) & 7)) {
+                /* Sent before, and not acknowledged yet */
+                result->flags |= DLMS_HDLC_RETRANSMISSION;
+            } else {
+                /* Frames were lost (or the capture missed them) */
+                result->flags |= DLMS_HDLC_OUT_OF_SEQUENCE;
+                result->expected_ssn = next;
+            }
+        }
+        association->hdlc.next_ssn[side] = (ssn + 1) & 7;
     }
-    proto_item_set_end(item, tvb, *offset);
+}
 
-    return item;
+/* Information field length of an I frame in percent of the negotiated maximum (0 if it is 0) */
+static guint32
+dlms_hdlc_information_fill(const dlms_hdlc_result *result)
+{
+    return result->max_information_length ? result->information_length * 100 / result->max_information_length : 0;
 }
 
+/* Add the HDLC link analysis of a frame to the tree */
 static void
-dlms_dissect_list_of_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset, const char *name)
+dlms_dissect_hdlc_analysis(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, const dlms_hdlc_result *result)
 {
-    proto_tree *item;
     proto_tree *subtree;
-    int sequence_of, i;
+    proto_item *item;
 
-    subtree = proto_tree_add_subtree(tree, tvb, *offset, 0, dlms_ett.data, &item, name);
-    sequence_of = dlms_get_length(tvb, offset);
-    for (i = 0; i < sequence_of; i++) {
-        proto_item *subitem = dlms_dissect_data(tvb, pinfo, subtree, offset);
-        proto_item_prepend_text(subitem, "[%u] ", i + 1);
+    if (!(result->flags & (DLMS_HDLC_I_FRAME | DLMS_HDLC_RNR_STALL))) {
+        return;
+    }
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.hdlc_analysis, &item, "Link Analysis");
+    PROTO_ITEM_SET_GENERATED(item);
+
+    if (result->flags & DLMS_HDLC_I_FRAME) {
+        item = proto_tree_add_uint(subtree, &dlms_hfi.hdlc_analysis_window, tvb, 0, 0, result->window);
+        PROTO_ITEM_SET_GENERATED(item);
+        if (result->flags & DLMS_HDLC_WINDOW_EXCEEDED) {
+            expert_add_info(pinfo, item, &dlms_ei.hdlc_window_exceeded);
+        }
+        item = proto_tree_add_uint(subtree, &dlms_hfi.hdlc_analysis_negotiated_window, tvb, 0, 0, result->negotiated_window);
+        PROTO_ITEM_SET_GENERATED(item);
+        item = proto_tree_add_uint_format_value(subtree, &dlms_hfi.hdlc_analysis_information_fill, tvb, 0, 0,
+            dlms_hdlc_information_fill(result), "%u%% (%u of %u bytes)",
+            dlms_hdlc_information_fill(result), result->information_length, result->max_information_length);
+        PROTO_ITEM_SET_GENERATED(item);
+        if (result->flags & DLMS_HDLC_RETRANSMISSION) {
+            item = proto_tree_add_expert(subtree, pinfo, &dlms_ei.hdlc_retransmission, tvb, 0, 0);
+            PROTO_ITEM_SET_GENERATED(item);
+        }
+        if (result->flags & DLMS_HDLC_OUT_OF_SEQUENCE) {
+            item = proto_tree_add_uint(subtree, &dlms_hfi.hdlc_analysis_expected_ssn, tvb, 0, 0, result->expected_ssn);
+            PROTO_ITEM_SET_GENERATED(item);
+            expert_add_info(pinfo, item, &dlms_ei.hdlc_out_of_sequence);
+        }
+    }
+    if (result->flags & DLMS_HDLC_RNR_STALL) {
+        item = proto_tree_add_time(subtree, &dlms_hfi.hdlc_analysis_rnr_stall, tvb, 0, 0, &result->rnr_stall);
+        PROTO_ITEM_SET_GENERATED(item);
     }
-    proto_item_set_end(item, tvb, *offset);
 }
 
+/* Add the connection setup durations of a frame to the tree */
 static void
-dlms_dissect_datablock_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, proto_tree *subtree, gint *offset, unsigned block_number, unsigned last_block)
+dlms_dissect_setup(tvbuff_t *tvb, proto_tree *tree, const dlms_setup_result *result)
 {
-    unsigned saved_offset, raw_data_length;
+    static header_field_info * const hfis[DLMS_SETUP_STAGES] = {
+        0,
+        0,
+        &dlms_hfi.setup_snrm_ua,
+        &dlms_hfi.setup_ua_aarq,
+        &dlms_hfi.setup_aarq_aare,
+        &dlms_hfi.setup_aare_hls,
+        &dlms_hfi.setup_hls,
+        &dlms_hfi.setup_first_request,
+    };
     proto_item *item;
-    fragment_head *frags;
-    tvbuff_t *rtvb;
 
-    col_append_fstr(pinfo->cinfo, COL_INFO, " (block %u)", block_number);
-    if (last_block) {
-        col_append_str(pinfo->cinfo, COL_INFO, " (last block)");
-    }
-
-    saved_offset = *offset;
-    raw_data_length = dlms_get_length(tvb, offset);
-    item = proto_tree_add_item(subtree, &dlms_hfi.data, tvb, saved_offset, *offset - saved_offset + raw_data_length, ENC_NA);
-    proto_item_append_text(item, " (length %u)", raw_data_length);
-
-    if (block_number == 1) {
-        fragment_delete(&dlms_reassembly_table, pinfo, DLMS_REASSEMBLY_ID_DATABLOCK, 0);
-    }
-    frags = fragment_add_seq_next(&dlms_reassembly_table, tvb, *offset, pinfo, DLMS_REASSEMBLY_ID_DATABLOCK, 0, raw_data_length, last_block == 0);
-    rtvb = process_reassembled_data(tvb, *offset, pinfo, "Reassembled", frags, &dlms_fragment_items, 0, tree);
-    if (rtvb) {
-        gint offset = 0;
-        subtree = proto_tree_add_subtree(tree, rtvb, 0, 0, dlms_ett.data, 0, "Reassembled Data");
-        dlms_dissect_data(rtvb, pinfo, subtree, &offset);
+    item = proto_tree_add_time(tree, hfis[result->stage], tvb, 0, 0, &result->duration);
+    PROTO_ITEM_SET_GENERATED(item);
+    if (result->stage == DLMS_SETUP_FIRST_REQUEST) {
+        item = proto_tree_add_time(tree, &dlms_hfi.setup_total, tvb, 0, 0, &result->total);
+        PROTO_ITEM_SET_GENERATED(item);
     }
-
-    *offset += raw_data_length;
 }
 
 static void
-dlms_dissect_datablock_g(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+dlms_dissect_invoke_id_and_priority(proto_tree *tree, tvbuff_t *tvb, gint *offset)
 {
     proto_tree *subtree;
-    unsigned last_block, block_number;
-    int result;
 
-    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.datablock, 0, "Datablock G");
-
-    proto_tree_add_item(subtree, &dlms_hfi.last_block, tvb, *offset, 1, ENC_NA);
-    last_block = tvb_get_guint8(tvb, *offset);
+    subtree = proto_tree_add_subtree(tree, tvb, *offset, 1, dlms_ett.invoke_id_and_priority, 0, "Invoke Id And Priority");
+    proto_tree_add_item(subtree, &dlms_hfi.invoke_id, tvb, *offset, 1, ENC_NA);
+    proto_tree_add_item(subtree, &dlms_hfi.service_class, tvb, *offset, 1, ENC_NA);
+    proto_tree_add_item(subtree, &dlms_hfi.priority, tvb, *offset, 1, ENC_NA);
     *offset += 1;
+}
+
+static void
+dlms_dissect_long_invoke_id_and_priority(proto_tree *tree, tvbuff_t *tvb, gint *offset)
+{
+    proto_tree *subtree;
 
-    proto_tree_add_item(subtree, &dlms_hfi.block_number, tvb, *offset, 4, ENC_BIG_ENDIAN);
-    block_number = tvb_get_ntohl(tvb, *offset);
+    subtree = proto_tree_add_subtree(tree, tvb, *offset, 4, dlms_ett.invoke_id_and_priority, 0, "Long Invoke Id And Priority");
+    proto_tree_add_item(subtree, &dlms_hfi.long_invoke_id, tvb, *offset, 4, ENC_BIG_ENDIAN);
+    proto_tree_add_item(subtree, &dlms_hfi.long_self_descriptive, tvb, *offset, 4, ENC_BIG_ENDIAN);
+    proto_tree_add_item(subtree, &dlms_hfi.long_processing_option, tvb, *offset, 4, ENC_BIG_ENDIAN);
+    proto_tree_add_item(subtree, &dlms_hfi.long_service_class, tvb, *offset, 4, ENC_BIG_ENDIAN);
+    proto_tree_add_item(subtree, &dlms_hfi.long_priority, tvb, *offset, 4, ENC_BIG_ENDIAN);
     *offset += 4;
+}
 
-    result = tvb_get_guint8(tvb, *offset);
-    *offset += 1;
-    if (result == 0) {
-        dlms_dissect_datablock_data(tvb, pinfo, tree, subtree, offset, block_number, last_block);
-    } else if (result == 1) {
-        dlms_dissect_data_access_result(tvb, pinfo, subtree, offset);
-    }
+static guint
+dlms_descriptor_hash_func(gconstpointer key)
+{
+    const dlms_descriptor_key *k = (const dlms_descriptor_key *)key;
+
+    return g_int64_hash(&k->class_instance) ^ (k->member * 0x9e3779b1u);
 }
 
-static void
-dlms_dissect_datablock_sa(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+static gboolean
+dlms_descriptor_equal_func(gconstpointer key1, gconstpointer key2)
 {
-    proto_tree *subtree;    
-    unsigned last_block, block_number;
+    const dlms_descriptor_key *k1 = (const dlms_descriptor_key *)key1;
+    const dlms_descriptor_key *k2 = (const dlms_descriptor_key *)key2;
 
-    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.datablock, 0, "Datablock SA");
+    return k1->class_instance == k2->class_instance && k1->member == k2->member;
+}
 
-    proto_tree_add_item(subtree, &dlms_hfi.last_block, tvb, *offset, 1, ENC_NA);
-    last_block = tvb_get_guint8(tvb, *offset);
-    *offset += 1;
+/* Format the texts of a descriptor */
+static dlms_descriptor_text *
+dlms_format_descriptor_text(const dlms_descriptor_key *key)
+{
+    dlms_descriptor_text *text;
+    const dlms_cosem_class *cosem_class;
+    const char *member_name;
+    const gchar *instance_name;
+    unsigned class_id, member_id;
+    gchar obis[24];
+    guint64 instance;
+    wmem_strbuf_t *info;
+
+    class_id = (unsigned)(key->class_instance >> 48);
+    instance = key->class_instance & G_GUINT64_CONSTANT(0xffffffffffff);
+    member_id = key->member & 0xff;
+    cosem_class = dlms_get_class(class_id);
+    member_name = 0;
+    if (cosem_class) {
+        member_name = key->member < 0x100
+            ? dlms_get_attribute_name(cosem_class, member_id)
+            : dlms_get_method_name(cosem_class, member_id);
+    }
+    instance_name = try_val64_to_str(instance, obis_code_names);
+    g_snprintf(obis, sizeof obis, "%u.%u.%u.%u.%u.%u",
+               (unsigned)(instance >> 40) & 0xff, (unsigned)(instance >> 32) & 0xff,
+               (unsigned)(instance >> 24) & 0xff, (unsigned)(instance >> 16) & 0xff,
+               (unsigned)(instance >> 8) & 0xff, (unsigned)instance & 0xff);
 
-    proto_tree_add_item(subtree, &dlms_hfi.block_number, tvb, *offset, 4, ENC_BIG_ENDIAN);
-    block_number = tvb_get_ntohl(tvb, *offset);
-    *offset += 4;
+    info = wmem_strbuf_sized_new(wmem_file_scope(), 64, 0);
+    if (cosem_class) {
+        wmem_strbuf_append_printf(info, " %s", cosem_class->name);
+    } else {
+        wmem_strbuf_append_printf(info, " %u", class_id);
+    }
+    if (member_name) {
+        wmem_strbuf_append_printf(info, ".%s", member_name);
+    } else {
+        wmem_strbuf_append_printf(info, ".%u", member_id);
+    }
+    wmem_strbuf_append_printf(info, " %s", instance_name ? instance_name : obis);
+
+    text = wmem_new(wmem_file_scope(), dlms_descriptor_text);
+    text->value.class_id = class_id;
+    text->value.instance_id = instance;
+    text->value.member_id = member_id;
+    text->value.is_method = key->member >= 0x100;
+    text->class_known = cosem_class != 0;
+    text->info = wmem_strbuf_finalize(info);
+    text->class_text = cosem_class
+        ? wmem_strdup_printf(wmem_file_scope(), ": %s (%u)", cosem_class->name, class_id)
+        : wmem_strdup_printf(wmem_file_scope(), ": Unknown (%u)", class_id);
+    text->instance_text = wmem_strdup_printf(wmem_file_scope(), ": %s (%s)",
+                                             instance_name ? instance_name : "Unknown", obis);
+    text->member_text = member_name
+        ? wmem_strdup_printf(wmem_file_scope(), ": %s (%u)", member_name, member_id)
+        : wmem_strdup_printf(wmem_file_scope(), ": Unknown (%u)", member_id);
+
+    return text;
+}
+
+/* Find the texts of a descriptor, formatting them the first time */
+static const dlms_descriptor_text *
+dlms_find_descriptor_text(const dlms_descriptor_key *key)
+{
+    const dlms_descriptor_text *text;
+    dlms_descriptor_key *persistent_key;
+
+    text = (const dlms_descriptor_text *)wmem_map_lookup(dlms_descriptor_texts, key);
+    if (!text) {
+        persistent_key = (dlms_descriptor_key *)wmem_memdup(wmem_file_scope(), key, sizeof *key);
+        text = dlms_format_descriptor_text(key);
+        wmem_map_insert(dlms_descriptor_texts, persistent_key, (void *)text);
+    }
 
-    dlms_dissect_datablock_data(tvb, pinfo, tree, subtree, offset, block_number, last_block);
+    return text;
 }
 
-static void
-dlms_dissect_selective_access_descriptor(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+/*
+ * Get the descriptor texts cached in the frame for the next descriptor,
+ * if this is a later pass. Returns FALSE on the first pass.
+ */
+static gboolean
+dlms_get_cached_descriptor_text(packet_info *pinfo, const dlms_descriptor_text **text)
 {
-    proto_item *item;
-    proto_tree *subtree = proto_tree_add_subtree(tree, tvb, *offset, 0, dlms_ett.selective_access_descriptor, &item, "Selective Access Descriptor");
-    int selector = tvb_get_guint8(tvb, *offset);
-    proto_tree_add_item(subtree, &dlms_hfi.access_selector, tvb, *offset, 1, ENC_NA);
-    *offset += 1;
-    if (selector) {
-        dlms_dissect_data(tvb, pinfo, subtree, offset);
+    dlms_packet_info *pi;
+    dlms_frame_data *fd;
+
+    pi = dlms_get_packet_info(pinfo);
+    fd = dlms_get_frame_data(pinfo);
+    if (fd && fd->descriptors && pi->descriptors < wmem_array_get_count(fd->descriptors)) {
+        *text = *(const dlms_descriptor_text **)wmem_array_index(fd->descriptors, pi->descriptors++);
+        return TRUE;
     }
-    proto_item_set_end(item, tvb, *offset);
+
+    return FALSE;
 }
 
+/* Cache the texts of the next descriptor in the frame (first pass only) */
 static void
-dlms_dissect_access_request_specification(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+dlms_cache_descriptor_text(packet_info *pinfo, const dlms_descriptor_text *text)
 {
-    proto_item *item, *subitem;
-    proto_tree *subtree, *subsubtree;
-    int sequence_of, i;
-
-    subtree = proto_tree_add_subtree(tree, tvb, *offset, 0, dlms_ett.access_request_specification, &item, "Access Request Specification");
-    sequence_of = dlms_get_length(tvb, offset);
-    for (i = 0; i < sequence_of; i++) {
-        int choice = tvb_get_guint8(tvb, *offset);
-        subitem = proto_tree_add_item(subtree, &dlms_hfi.access_request, tvb, *offset, 1, ENC_NA);
-        proto_item_prepend_text(subitem, "[%u] ", i + 1);
-        subsubtree = proto_item_add_subtree(subitem, dlms_ett.access_request);
-        *offset += 1;
-        switch (choice) {
-        case DLMS_ACCESS_REQUEST_GET:
-        case DLMS_ACCESS_REQUEST_SET:
-            dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, subsubtree, offset);
-            break;
-        case DLMS_ACCESS_REQUEST_ACTION:
-            dlms_dissect_cosem_method_descriptor(tvb, pinfo, subsubtree, offset);
-            break;
-        case DLMS_ACCESS_REQUEST_GET_WITH_SELECTION:
-        case DLMS_ACCESS_REQUEST_SET_WITH_SELECTION:
-            dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, subsubtree, offset);
-            dlms_dissect_selective_access_descriptor(tvb, pinfo, subsubtree, offset);
-            break;
-        default:
-            DISSECTOR_ASSERT_HINT(choice, "Invalid Access-Request-Specification CHOICE");
+    dlms_packet_info *pi;
+    dlms_frame_data *fd;
+
+    pi = dlms_get_packet_info(pinfo);
+    fd = dlms_get_frame_data(pinfo);
+    if (fd && !PINFO_FD_VISITED(pinfo)) {
+        if (!fd->descriptors) {
+            fd->descriptors = wmem_array_new(wmem_file_scope(), sizeof text);
         }
+        wmem_array_append_one(fd->descriptors, text);
+        pi->descriptors++;
     }
-    proto_item_set_end(item, tvb, *offset);
 }
 
-static void
-dlms_dissect_conformance(tvbuff_t *tvb, proto_tree *tree, gint offset)
+/*
+ * Get the texts of the COSEM descriptor at offset: from the frame on later
+ * passes, or else from those formatted for the same descriptor in other frames.
+ */
+static const dlms_descriptor_text *
+dlms_get_descriptor_text(tvbuff_t *tvb, packet_info *pinfo, gint offset, int is_attribute)
 {
-    proto_tree *subtree;
-    header_field_info *hfi;
+    const dlms_descriptor_text *text;
+    dlms_descriptor_key key;
 
-    subtree = proto_tree_add_subtree(tree, tvb, offset, 7, dlms_ett.conformance, 0, "Conformance");
-    for (hfi = &dlms_hfi.conformance_general_protection; hfi <= &dlms_hfi.conformance_action; hfi++) {
-        proto_tree_add_item(subtree, hfi, tvb, offset + 4, 3, ENC_BIG_ENDIAN);
+    if (dlms_get_cached_descriptor_text(pinfo, &text)) {
+        return text;
     }
+
+    key.class_instance = ((guint64)tvb_get_ntohs(tvb, offset) << 48) | tvb_get_ntoh48(tvb, offset + 2);
+    key.member = tvb_get_guint8(tvb, offset + 8) + (is_attribute ? 0 : 0x100);
+    text = dlms_find_descriptor_text(&key);
+    dlms_cache_descriptor_text(pinfo, text);
+
+    return text;
 }
 
 static void
-dlms_dissect_data_notification(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_dissect_cosem_attribute_or_method_descriptor(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset, int is_attribute)
 {
-    gint date_time_offset;
-    gint date_time_length;
+    const dlms_descriptor_text *text;
+    proto_tree *subtree;
     proto_item *item;
 
-    col_set_str(pinfo->cinfo, COL_INFO, "Data-Notification");
+    text = dlms_get_descriptor_text(tvb, pinfo, *offset, is_attribute);
+    dlms_get_packet_info(pinfo)->descriptor = text;
+    col_append_str(pinfo->cinfo, COL_INFO, text->info);
 
-    dlms_dissect_long_invoke_id_and_priority(tree, tvb, &offset);
+    subtree = proto_tree_add_subtree(tree, tvb, *offset, 9, dlms_ett.cosem_attribute_or_method_descriptor, 0,
+                                     is_attribute ? "COSEM Attribute Descriptor" : "COSEM Method Descriptor");
+
+    item = proto_tree_add_item(subtree, &dlms_hfi.class_id, tvb, *offset, 2, ENC_BIG_ENDIAN);
+    proto_item_append_text(item, "%s", text->class_text);
+    if (!text->class_known) {
+        expert_add_info(pinfo, item, &dlms_ei.not_implemented);
+    }
+    *offset += 2;
 
-    date_time_offset = offset;
-    date_time_length = dlms_get_length(tvb, &offset);
-    item = proto_tree_add_item(tree, &dlms_hfi.date_time, tvb, date_time_offset, offset - date_time_offset + date_time_length, ENC_NA);
-    dlms_append_date_time_maybe(tvb, item, offset, date_time_length);
+    item = proto_tree_add_item(subtree, &dlms_hfi.instance_id, tvb, *offset, 6, ENC_NA);
+    proto_item_append_text(item, "%s", text->instance_text);
+    *offset += 6;
 
-    /* notification-body */
-    dlms_dissect_data(tvb, pinfo, tree, &offset);
+    item = proto_tree_add_item(subtree,
+                               is_attribute ? &dlms_hfi.attribute_id : &dlms_hfi.method_id,
+                               tvb, *offset, 1, ENC_BIG_ENDIAN);
+    proto_item_append_text(item, "%s", text->member_text);
+    *offset += 1;
 }
 
 static void
-dlms_dissect_aarq(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_dissect_cosem_attribute_descriptor(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
 {
-    proto_tree *subtree;
-    int end, length, tag;
+    dlms_dissect_cosem_attribute_or_method_descriptor(tvb, pinfo, tree, offset, 1);
+}
 
-    col_set_str(pinfo->cinfo, COL_INFO, "AARQ");
-    length = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    end = offset + length;
-    while (offset < end) {
-        tag = tvb_get_guint8(tvb, offset);
-        length = tvb_get_guint8(tvb, offset + 1);
-        if (tag == 0xbe) { /* user-information */
-            subtree = proto_tree_add_subtree(tree, tvb, offset, 2 + length, dlms_ett.user_information, 0, "User-Information");
-            dlms_dissect_conformance(tvb, subtree, offset + 2 + length - 9);
-            proto_tree_add_item(subtree, &dlms_hfi.client_max_receive_pdu_size, tvb, offset + 2 + length - 2, 2, ENC_BIG_ENDIAN);
-        }
-        offset += 2 + length;
-    }
+static void
+dlms_dissect_cosem_method_descriptor(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    dlms_dissect_cosem_attribute_or_method_descriptor(tvb, pinfo, tree, offset, 0);
 }
 
 static void
-dlms_dissect_aare(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_dissect_data_access_result(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
 {
-    proto_tree *subtree;
-    int end, length, tag;
+    proto_item *item;
+    int result;
 
-    col_set_str(pinfo->cinfo, COL_INFO, "AARE");
-    length = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    end = offset + length;
-    while (offset < end) {
-        tag = tvb_get_guint8(tvb, offset);
-        length = tvb_get_guint8(tvb, offset + 1);
-        if (tag == 0xbe) { /* user-information */
-            subtree = proto_tree_add_subtree(tree, tvb, offset, 2 + length, dlms_ett.user_information, 0, "User-Information");
-            dlms_dissect_conformance(tvb, subtree, offset + 2 + length - 11);
-            proto_tree_add_item(subtree, &dlms_hfi.server_max_receive_pdu_size, tvb, offset + 2 + length - 4, 2, ENC_BIG_ENDIAN);
-        }
-        offset += 2 + length;
+    item = proto_tree_add_item(tree, &dlms_hfi.data_access_result, tvb, *offset, 1, ENC_NA);
+    result = tvb_get_guint8(tvb, *offset);
+    *offset += 1;
+    if (result != 0) {
+        const gchar *str = val_to_str_const(result, dlms_data_access_result_names, "unknown result");
+        col_append_fstr(pinfo->cinfo, COL_INFO, " (%s)", str);
+        expert_add_info(pinfo, item, &dlms_ei.no_success);
     }
 }
 
-static void
-dlms_dissect_get_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+/* Get the captured bytes of a tvb, for the dlms_core parse functions */
+static const guint8 *
+dlms_get_data(tvbuff_t *tvb, size_t *size)
 {
-    int choice;
-    unsigned block_number;
+    *size = tvb_captured_length(tvb);
+    return *size ? tvb_get_ptr(tvb, 0, (gint)*size) : (const guint8 *)"";
+}
 
-    proto_tree_add_item(tree, &dlms_hfi.get_request, tvb, offset, 1, ENC_NA);
-    choice = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
-    if (choice == DLMS_GET_REQUEST_NORMAL) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Get-Request-Normal");
-        dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, tree, &offset);
-        dlms_dissect_selective_access_descriptor(tvb, pinfo, tree, &offset);
-    } else if (choice == DLMS_GET_REQUEST_NEXT) {
-        proto_tree_add_item(tree, &dlms_hfi.block_number, tvb, offset, 4, ENC_BIG_ENDIAN);
-        block_number = tvb_get_ntohl(tvb, offset);
-        offset += 4;
-        col_add_fstr(pinfo->cinfo, COL_INFO, "Get-Request-Next (block %u)", block_number);
-    } else {
-        col_set_str(pinfo->cinfo, COL_INFO, "Get-Request");
+/* Throw the exception for the result of a dlms_core parse function, as the tvb accessors would */
+static void
+dlms_check_status(tvbuff_t *tvb, int status)
+{
+    if (status == DLMS_CORE_TRUNCATED) {
+        THROW(tvb_captured_length(tvb) < tvb_reported_length(tvb) ? BoundsError : ReportedBoundsError);
+    } else if (status == DLMS_CORE_INVALID) {
+        THROW(ReportedBoundsError);
     }
 }
 
-static void
-dlms_dissect_set_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+/* Parse the fields of the service APDU whose tag is at offset with the core, and return the status */
+static int
+dlms_parse_service(tvbuff_t *tvb, gint offset, dlms_core_service *service)
 {
-    int choice;
-    proto_tree *subtree;
+    const guint8 *data;
+    size_t size;
 
-    proto_tree_add_item(tree, &dlms_hfi.set_request, tvb, offset, 1, ENC_NA);
-    choice = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
-    if (choice == DLMS_SET_REQUEST_NORMAL) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Set-Request-Normal");
-        dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, tree, &offset);
-        dlms_dissect_selective_access_descriptor(tvb, pinfo, tree, &offset);
-        subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Data");
-        dlms_dissect_data(tvb, pinfo, subtree, &offset);
-    } else if (choice == DLMS_SET_REQUEST_WITH_FIRST_DATABLOCK) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Set-Request-With-First-Datablock");
-        dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, tree, &offset);
-        dlms_dissect_selective_access_descriptor(tvb, pinfo, tree, &offset);
-        dlms_dissect_datablock_sa(tvb, pinfo, tree, &offset);
-    } else if (choice == DLMS_SET_REQUEST_WITH_DATABLOCK) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Set-Request-With-Datablock");
-        dlms_dissect_datablock_sa(tvb, pinfo, tree, &offset);
-    } else {
-        col_set_str(pinfo->cinfo, COL_INFO, "Set-Request");
-    }
+    data = dlms_get_data(tvb, &size);
+    return dlms_core_parse_service(data, size, offset, service);
+}
+
+/* Get the value encoded in the specified length octets in definite form */
+static unsigned
+dlms_get_length(tvbuff_t *tvb, gint *offset)
+{
+    const guint8 *data;
+    size_t size, position;
+    guint32 length;
+
+    data = dlms_get_data(tvb, &size);
+    position = *offset;
+    dlms_check_status(tvb, dlms_core_get_length(data, size, &position, &length));
+    *offset = (gint)position;
+
+    return length;
+}
+
+static unsigned
+dlms_dissect_length(tvbuff_t *tvb, proto_tree *tree, gint *offset)
+{
+    gint start;
+    unsigned length;
+    proto_item *item;
+
+    start = *offset;
+    length = dlms_get_length(tvb, offset);
+    item = proto_tree_add_item(tree, &dlms_hfi.length, tvb, start, *offset - start, ENC_NA);
+    proto_item_append_text(item, ": %u", length);
+
+    return length;
 }
 
+/* Attempt to parse a date-time from an octet-string */
 static void
-dlms_dissect_event_notification_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_append_date_time_maybe(tvbuff_t *tvb, proto_item *item, gint offset, unsigned length)
 {
-    proto_tree *subtree;
+    dlms_core_date_time dt;
 
-    col_add_str(pinfo->cinfo, COL_INFO, "Event-Notification-Request");
-    offset += 1; /* time OPTIONAL (assume it is not present) */
-    dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, tree, &offset);
-    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Data");
-    dlms_dissect_data(tvb, pinfo, subtree, &offset);
+    if (length != 12) return;
+    if (dlms_core_parse_date_time(tvb_get_ptr(tvb, offset, length), length, &dt) != DLMS_CORE_OK) return;
+
+    proto_item_append_text(item, dt.year < 0xffff ? " (%u" : " (%X", dt.year);
+    proto_item_append_text(item, dt.month < 13 ? "/%02u" : "/%02X", dt.month);
+    proto_item_append_text(item, dt.day_of_month < 32 ? "/%02u" : "/%02X", dt.day_of_month);
+    proto_item_append_text(item, dt.hour < 24 ? " %02u" : " %02X", dt.hour);
+    proto_item_append_text(item, dt.minute < 60 ? ":%02u" : ":%02X", dt.minute);
+    proto_item_append_text(item, dt.second < 60 ? ":%02u" : ":%02X", dt.second);
+    proto_item_append_text(item, dt.hundredths < 100 ? ".%02u)" : ".%02X)", dt.hundredths);
 }
 
+/* Add the date-time octet string of a service APDU */
 static void
-dlms_dissect_action_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_dissect_service_date_time(tvbuff_t *tvb, proto_tree *tree, const dlms_core_service *service)
 {
-    int choice, method_invocation_parameters;
-    proto_tree *subtree;
+    proto_item *item;
 
-    proto_tree_add_item(tree, &dlms_hfi.action_request, tvb, offset, 1, ENC_NA);
-    choice = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
-    if (choice == DLMS_ACTION_REQUEST_NORMAL) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Action-Request-Normal");
-        dlms_dissect_cosem_method_descriptor(tvb, pinfo, tree, &offset);
-        method_invocation_parameters = tvb_get_guint8(tvb, offset);
-        if (method_invocation_parameters) {
-            offset += 1;
-            subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Data");
-            dlms_dissect_data(tvb, pinfo, subtree, &offset);
-        }
+    item = proto_tree_add_item(tree, &dlms_hfi.date_time, tvb, (gint)service->date_time_offset,
+                               (gint)(service->date_time_contents_offset - service->date_time_offset + service->date_time_length),
+                               ENC_NA);
+    dlms_append_date_time_maybe(tvb, item, (gint)service->date_time_contents_offset, service->date_time_length);
+}
+
+/* Set the text of an item with a planar data type (not array nor structure) */
+static void
+dlms_set_data_value(tvbuff_t *tvb, proto_item *item, const dlms_core_data *d)
+{
+    if (d->choice == 0) {
+        proto_item_set_text(item, "Null");
+    } else if (d->choice == 3) {
+        proto_item_set_text(item, "Boolean: %s", d->value.u ? "true" : "false");
+    } else if (d->choice == 4) {
+        proto_item_set_text(item, "Bit-string (bits: %u, bytes: %u):", d->length, (d->length + 7) / 8);
+    } else if (d->choice == 5) {
+        proto_item_set_text(item, "Double Long: %d", (gint32)d->value.i);
+    } else if (d->choice == 6) {
+        proto_item_set_text(item, "Double Long Unsigned: %u", (guint32)d->value.u);
+    } else if (d->choice == 9) {
+        proto_item_set_text(item, "Octet String (length %u)", d->length);
+        dlms_append_date_time_maybe(tvb, item, (gint)d->contents_offset, d->length);
+    } else if (d->choice == 10) {
+        proto_item_set_text(item, "Visible String (length %u)", d->length);
+    } else if (d->choice == 12) {
+        proto_item_set_text(item, "UTF8 String (length %u)", d->length);
+    } else if (d->choice == 13) {
+        proto_item_set_text(item, "BCD: 0x%02x", (guint)d->value.u);
+    } else if (d->choice == 15) {
+        proto_item_set_text(item, "Integer: %d", (gint)d->value.i);
+    } else if (d->choice == 16) {
+        proto_item_set_text(item, "Long: %d", (gint)d->value.i);
+    } else if (d->choice == 17) {
+        proto_item_set_text(item, "Unsigned: %u", (guint)d->value.u);
+    } else if (d->choice == 18) {
+        proto_item_set_text(item, "Long Unsigned: %u", (guint)d->value.u);
+    } else if (d->choice == 20) {
+        proto_item_set_text(item, "Long64: %" G_GINT64_MODIFIER "d", (gint64)d->value.i);
+    } else if (d->choice == 21) {
+        proto_item_set_text(item, "Long64 Unsigned: %" G_GINT64_MODIFIER "u", (guint64)d->value.u);
+    } else if (d->choice == 22) {
+        proto_item_set_text(item, "Enum: %u", (guint)d->value.u);
+    } else if (d->choice == 23) {
+        proto_item_set_text(item, "Float32: %f", d->value.f);
+    } else if (d->choice == 24) {
+        proto_item_set_text(item, "Float64: %f", d->value.f);
+    } else if (d->choice == 25) {
+        proto_item_set_text(item, "Date Time");
+    } else if (d->choice == 26) {
+        proto_item_set_text(item, "Date");
+    } else if (d->choice == 27) {
+        proto_item_set_text(item, "Time");
+    } else if (d->choice == 255) {
+        proto_item_set_text(item, "Don't Care");
     } else {
-        col_set_str(pinfo->cinfo, COL_INFO, "Action-Request");
+        proto_item_set_text(item, "Invalid Data Type (%u)", d->choice);
     }
 }
 
-static void
-dlms_dissect_get_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+/* Dissection of Data, as a dlms_core data visitor */
+struct dlms_data_context {
+    tvbuff_t *tvb;
+    proto_item *item; /* item of the outermost value */
+};
+typedef struct dlms_data_context dlms_data_context;
+
+/* A composite value, as parent of its elements */
+struct dlms_data_parent {
+    proto_tree *tree;
+    proto_item *item;
+};
+typedef struct dlms_data_parent dlms_data_parent;
+
+static proto_item *
+dlms_add_data_item(dlms_data_context *dc, dlms_data_parent *parent, const dlms_core_data *d, gint length)
 {
-    int choice, result;
-    proto_tree *subtree;
+    proto_item *item;
 
-    proto_tree_add_item(tree, &dlms_hfi.get_response, tvb, offset, 1, ENC_NA);
-    choice = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
-    if (choice == DLMS_GET_RESPONSE_NORMAL) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Get-Response-Normal");
-        result = tvb_get_guint8(tvb, offset);
-        offset += 1;
-        if (result == 0) {
-            subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Data");
-            dlms_dissect_data(tvb, pinfo, subtree, &offset);
-        } else if (result == 1) {
-            dlms_dissect_data_access_result(tvb, pinfo, tree, &offset);
-        }
-    } else if (choice == DLMS_GET_RESPONSE_WITH_DATABLOCK) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Get-Response-With-Datablock");
-        dlms_dissect_datablock_g(tvb, pinfo, tree, &offset);
-    } else {
-        col_set_str(pinfo->cinfo, COL_INFO, "Get-Response");
+    item = proto_tree_add_item(parent->tree, &dlms_hfi.data, dc->tvb, (gint)d->offset, length, ENC_NA);
+    if (d->depth == 0) {
+        dc->item = item;
+    }
+
+    return item;
+}
+
+static void *
+dlms_data_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    dlms_data_context *dc = (dlms_data_context *)context;
+    dlms_data_parent *element_parent;
+    gint offset;
+
+    element_parent = wmem_new(wmem_packet_scope(), dlms_data_parent);
+    element_parent->item = dlms_add_data_item(dc, (dlms_data_parent *)parent, d, d->compact ? 0 : 1);
+    element_parent->tree = proto_item_add_subtree(element_parent->item, dlms_ett.composite_data);
+    if (d->choice == 19) { /* compact-array */
+        proto_tree_add_item(element_parent->tree, &dlms_hfi.type_description, dc->tvb,
+                            (gint)d->description_offset, (gint)d->description_length, ENC_NA);
+        offset = (gint)d->length_offset;
+        dlms_dissect_length(dc->tvb, element_parent->tree, &offset);
     }
+
+    return element_parent;
 }
 
 static void
-dlms_dissect_set_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_data_end(void *context, void *parent, void *element_parent, const dlms_core_data *d)
 {
-    unsigned choice, block_number;
+    dlms_data_context *dc = (dlms_data_context *)context;
+    proto_item *item = ((dlms_data_parent *)element_parent)->item;
 
-    proto_tree_add_item(tree, &dlms_hfi.set_response, tvb, offset, 1, ENC_NA);
-    choice = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
-    if (choice == DLMS_SET_RESPONSE_NORMAL) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Set-Response-Normal");
-        dlms_dissect_data_access_result(tvb, pinfo, tree, &offset);
-    } else if (choice == DLMS_SET_RESPONSE_DATABLOCK) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Set-Response-Datablock");
-        proto_tree_add_item(tree, &dlms_hfi.block_number, tvb, offset, 4, ENC_BIG_ENDIAN);
-        block_number = tvb_get_ntohl(tvb, offset);
-        col_append_fstr(pinfo->cinfo, COL_INFO, " (block %u)", block_number);
-    } else if (choice == DLMS_SET_RESPONSE_LAST_DATABLOCK) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Set-Response-Last-Datablock");
-        dlms_dissect_data_access_result(tvb, pinfo, tree, &offset);
-        proto_tree_add_item(tree, &dlms_hfi.block_number, tvb, offset, 4, ENC_BIG_ENDIAN);
-        block_number = tvb_get_ntohl(tvb, offset);
-        col_append_fstr(pinfo->cinfo, COL_INFO, " (block %u)", block_number);
+    if (d->choice == 1) {
+        proto_item_set_text(item, "Array (%u elements)", d->length);
+    } else if (d->choice == 2) {
+        proto_item_set_text(item, "Structure");
     } else {
-        col_set_str(pinfo->cinfo, COL_INFO, "Set-Response");
+        proto_item_set_text(item, "Compact Array (%u elements)", d->length);
+    }
+    if (d->index) {
+        proto_item_prepend_text(item, "[%u] ", d->index);
     }
+    proto_item_set_end(item, dc->tvb, (gint)d->end_offset);
 }
 
 static void
-dlms_dissect_action_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_data_value(void *context, void *parent, const dlms_core_data *d)
 {
-    unsigned choice, result;
-    const gchar *result_name;
+    dlms_data_context *dc = (dlms_data_context *)context;
     proto_item *item;
 
-    proto_tree_add_item(tree, &dlms_hfi.action_response, tvb, offset, 1, ENC_NA);
-    choice = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
-    if (choice == DLMS_ACTION_RESPONSE_NORMAL) {
-        col_add_str(pinfo->cinfo, COL_INFO, "Action-Response-Normal");
-        item = proto_tree_add_item(tree, &dlms_hfi.action_result, tvb, offset, 1, ENC_NA);
-        result = tvb_get_guint8(tvb, offset);
-        offset += 1;
-        if (result) {
-            result_name = val_to_str_const(result, dlms_action_result_names, "unknown");
-            col_append_fstr(pinfo->cinfo, COL_INFO, " (%s)", result_name);
-            expert_add_info(pinfo, item, &dlms_ei.no_success);
-        }
-    } else {
-        col_set_str(pinfo->cinfo, COL_INFO, "Action-Response");
+    item = dlms_add_data_item(dc, (dlms_data_parent *)parent, d, (gint)(d->end_offset - d->offset));
+    dlms_set_data_value(dc->tvb, item, d);
+    if (d->index) {
+        proto_item_prepend_text(item, "[%u] ", d->index);
     }
 }
 
-static void
-dlms_dissect_exception_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+/*
+ * Dissect a Data value. On later passes, when its items are not needed
+ * (no tree, or a filter that does not refer to them), the value is skipped
+ * to where its decoding ended on the first pass.
+ */
+static proto_item *
+dlms_dissect_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
 {
-    proto_item *item;
+    static const dlms_core_data_visitor visitor = { dlms_data_begin, dlms_data_end, dlms_data_value };
+    dlms_data_context dc;
+    dlms_data_parent parent;
+    dlms_packet_info *pi;
+    dlms_frame_data *fd;
+    dlms_data_extent extent;
+    const guint8 *data;
+    size_t size, position;
+    int status;
+
+    pi = dlms_get_packet_info(pinfo);
+    fd = dlms_get_frame_data(pinfo);
+    if (fd && fd->data && pi->data < wmem_array_get_count(fd->data)) {
+        extent = *(const dlms_data_extent *)wmem_array_index(fd->data, pi->data++);
+        if (!proto_field_is_referenced(tree, dlms_hfi.data.id)) {
+            *offset = (gint)extent.end_offset;
+            dlms_check_status(tvb, extent.status);
+            return 0;
+        }
+    }
 
-    col_set_str(pinfo->cinfo, COL_INFO, "Exception-Response");
-    item = proto_tree_add_item(tree, &dlms_hfi.state_error, tvb, offset, 1, ENC_NA);
-    expert_add_info(pinfo, item, &dlms_ei.no_success);
-    item = proto_tree_add_item(tree, &dlms_hfi.service_error, tvb, offset + 1, 1, ENC_NA);
-    expert_add_info(pinfo, item, &dlms_ei.no_success);
+    dc.tvb = tvb;
+    dc.item = 0;
+    parent.tree = tree;
+    parent.item = 0;
+    data = dlms_get_data(tvb, &size);
+    position = *offset;
+    status = dlms_core_parse_data(data, size, &position, &visitor, &dc, &parent);
+    *offset = (gint)position;
+    if (fd && !PINFO_FD_VISITED(pinfo)) {
+        if (!fd->data) {
+            fd->data = wmem_array_new(wmem_file_scope(), sizeof extent);
+        }
+        extent.end_offset = (guint32)position;
+        extent.status = status;
+        wmem_array_append_one(fd->data, extent);
+        pi->data++;
+    }
+    dlms_check_status(tvb, status);
+
+    return dc.item;
 }
 
+/* Record a Data value of the packet for the export tap, if it is on */
 static void
-dlms_dissect_access_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_add_export_value(tvbuff_t *tvb, packet_info *pinfo, gint offset, const dlms_descriptor_text *descriptor)
 {
-    gint date_time_offset;
-    int date_time_length;
-    proto_item *item;
+    dlms_packet_info *pi;
+    dlms_export_value value;
 
-    col_set_str(pinfo->cinfo, COL_INFO, "Access-Request");
+    if (!dlms_export_listeners) {
+        return;
+    }
+    pi = dlms_get_packet_info(pinfo);
+    if (!pi->values) {
+        pi->values = wmem_array_new(wmem_packet_scope(), sizeof value);
+    }
+    value.tvb = tvb;
+    value.offset = offset;
+    value.descriptor = descriptor ? &descriptor->value : 0;
+    wmem_array_append_one(pi->values, value);
+}
 
-    dlms_dissect_long_invoke_id_and_priority(tree, tvb, &offset);
+/*
+ * Objects of interest (preference objects_of_interest): the attributes and
+ * methods whose values are decoded, by OBIS code, when the preference is set.
+ * The values of the other objects are skipped, which speeds up the
+ * processing of long captures with tshark.
+ */
+#define DLMS_INTEREST_ANY G_MAXUINT32
+
+struct dlms_interest {
+    guint32 class_id; /* DLMS_INTEREST_ANY for any class */
+    guint32 member_id; /* attribute_id or method_id, DLMS_INTEREST_ANY for any attribute or method */
+    gboolean is_method;
+};
+typedef struct dlms_interest dlms_interest;
 
-    date_time_offset = offset;
-    date_time_length = dlms_get_length(tvb, &offset);
-    item = proto_tree_add_item(tree, &dlms_hfi.date_time, tvb, date_time_offset, offset - date_time_offset + date_time_length, ENC_NA);
-    dlms_append_date_time_maybe(tvb, item, offset, date_time_length);
+static const char *dlms_interest_pref = "";
+static GHashTable *dlms_interests; /* GArray of dlms_interest by OBIS code (NULL if every object is of interest) */
 
-    dlms_dissect_access_request_specification(tvb, pinfo, tree, &offset);
+/*
+ * Parse an object of interest, obis[/class_id[/attribute_id or m method_id]],
+ * with the OBIS code in either the a.b.c.d.e.f or a-b:c.d.e*f form, and *
+ * for any class or member
+ */
+static gboolean
+dlms_parse_interest(const gchar *text, guint64 *obis, dlms_interest *interest)
+{
+    gchar **fields;
+    const gchar *p;
+    gchar *end;
+    gulong group;
+    gboolean ok = TRUE;
+    int i;
+
+    fields = g_strsplit(text, "/", 3);
+    *obis = 0;
+    p = fields[0];
+    for (i = 0; i < 6 && ok; i++) {
+        group = strtoul(p, &end, 10);
+        ok = end != p && group <= 255 && (i == 5 ? *end == 0 : strchr(".-:*", *end) && *end);
+        *obis = (*obis << 8) | group;
+        p = end + 1;
+    }
 
-    dlms_dissect_list_of_data(tvb, pinfo, tree, &offset, "Access Request List Of Data");
+    interest->class_id = DLMS_INTEREST_ANY;
+    interest->member_id = DLMS_INTEREST_ANY;
+    interest->is_method = FALSE;
+    if (ok && fields[1] && strcmp(fields[1], "*")) {
+        interest->class_id = (guint32)strtoul(fields[1], &end, 10);
+        ok = end != fields[1] && *end == 0 && interest->class_id <= G_MAXUINT16;
+    }
+    if (ok && fields[1] && fields[2] && strcmp(fields[2], "*")) {
+        p = fields[2];
+        interest->is_method = *p == 'm';
+        p += interest->is_method;
+        interest->member_id = (guint32)strtoul(p, &end, 10);
+        ok = end != p && *end == 0 && interest->member_id <= 255;
+    }
+    g_strfreev(fields);
+
+    return ok;
 }
 
 static void
-dlms_dissect_access_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_free_interests(gpointer value)
 {
-    gint date_time_offset;
-    int date_time_length;
-    proto_item *item;
-    proto_tree *subtree, *subsubtree;
-    int sequence_of, i;
+    g_array_free((GArray *)value, TRUE);
+}
 
-    col_set_str(pinfo->cinfo, COL_INFO, "Access-Response");
+/* Compile the objects of interest of the preference, separated by commas, semicolons or spaces */
+static void
+dlms_apply_prefs(void)
+{
+    gchar **entries;
+    guint64 obis;
+    guint64 *key;
+    dlms_interest interest;
+    GArray *interests;
+    int i;
+
+    if (dlms_interests) {
+        g_hash_table_destroy(dlms_interests);
+        dlms_interests = 0;
+    }
+    entries = g_strsplit_set(dlms_interest_pref ? dlms_interest_pref : "", ",; \t", -1);
+    for (i = 0; entries[i]; i++) {
+        if (!entries[i][0]) {
+            continue;
+        }
+        if (!dlms_parse_interest(entries[i], &obis, &interest)) {
+            report_failure("DLMS objects of interest: %s is not obis[/class_id[/attribute_id or m<method_id>]]", entries[i]);
+            continue;
+        }
+        if (!dlms_interests) {
+            dlms_interests = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, dlms_free_interests);
+        }
+        interests = (GArray *)g_hash_table_lookup(dlms_interests, &obis);
+        if (!interests) {
+            key = g_new(guint64, 1);
+            *key = obis;
+            interests = g_array_new(FALSE, FALSE, sizeof interest);
+            g_hash_table_insert(dlms_interests, key, interests);
+        }
+        g_array_append_val(interests, interest);
+    }
+    g_strfreev(entries);
+}
 
-    dlms_dissect_long_invoke_id_and_priority(tree, tvb, &offset);
+/* Whether the value of an attribute or method is to be decoded */
+static gboolean
+dlms_is_of_interest(const dlms_class_value *value)
+{
+    const GArray *interests;
+    const dlms_interest *interest;
+    guint i;
 
-    date_time_offset = offset;
-    date_time_length = dlms_get_length(tvb, &offset);
-    item = proto_tree_add_item(tree, &dlms_hfi.date_time, tvb, date_time_offset, offset - date_time_offset + date_time_length, ENC_NA);
-    dlms_append_date_time_maybe(tvb, item, offset, date_time_length);
+    if (!dlms_interests) {
+        return TRUE;
+    }
+    interests = (const GArray *)g_hash_table_lookup(dlms_interests, &value->instance_id);
+    for (i = 0; interests && i < interests->len; i++) {
+        interest = &g_array_index(interests, dlms_interest, i);
+        if ((interest->class_id == DLMS_INTEREST_ANY || interest->class_id == value->class_id)
+            && (interest->member_id == DLMS_INTEREST_ANY
+                || (interest->member_id == value->member_id && interest->is_method == value->is_method))) {
+            return TRUE;
+        }
+    }
 
-    dlms_dissect_access_request_specification(tvb, pinfo, tree, &offset);
+    return FALSE;
+}
 
-    dlms_dissect_list_of_data(tvb, pinfo, tree, &offset, "Access Response List Of Data");
+/*
+ * Skip a Data value of an object that is not of interest, adding its bytes
+ * to the tree; its extent is kept per frame as in dlms_dissect_data
+ */
+static void
+dlms_skip_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    dlms_packet_info *pi;
+    dlms_frame_data *fd;
+    dlms_data_extent extent;
+    const guint8 *data;
+    size_t size, position;
+    int status;
+    gint start;
 
-    subtree = proto_tree_add_subtree(tree, tvb, offset, 0, dlms_ett.access_response_specification, 0, "Access Response Specification");
-    sequence_of = dlms_get_length(tvb, &offset);
-    for (i = 0; i < sequence_of; i++) {
-        item = proto_tree_add_item(subtree, &dlms_hfi.access_response, tvb, offset, 1, ENC_NA);
-        proto_item_prepend_text(item, "[%u] ", i + 1);
-        subsubtree = proto_item_add_subtree(item, dlms_ett.access_request);
-        offset += 1;
-        dlms_dissect_data_access_result(tvb, pinfo, subsubtree, &offset);
+    pi = dlms_get_packet_info(pinfo);
+    fd = dlms_get_frame_data(pinfo);
+    start = *offset;
+    if (fd && fd->data && pi->data < wmem_array_get_count(fd->data)) {
+        extent = *(const dlms_data_extent *)wmem_array_index(fd->data, pi->data++);
+        position = extent.end_offset;
+        status = extent.status;
+    } else {
+        data = dlms_get_data(tvb, &size);
+        position = *offset;
+        status = dlms_core_skip_data(data, size, &position);
+        if (fd && !PINFO_FD_VISITED(pinfo)) {
+            if (!fd->data) {
+                fd->data = wmem_array_new(wmem_file_scope(), sizeof extent);
+            }
+            extent.end_offset = (guint32)position;
+            extent.status = status;
+            wmem_array_append_one(fd->data, extent);
+            pi->data++;
+        }
     }
+    *offset = (gint)position;
+    proto_tree_add_item(tree, &dlms_hfi.data_skipped, tvb, start, *offset - start, ENC_NA);
+    dlms_check_status(tvb, status);
 }
 
-/* Dissect a DLMS Application Packet Data Unit (APDU) */
+/* Get the descriptor of the request that the current response answers, if it has a single one */
+static const dlms_descriptor_text *
+dlms_get_request_descriptor(packet_info *pinfo)
+{
+    const dlms_frame_data *fd = dlms_get_packet_info(pinfo)->frame_data;
+
+    return fd ? fd->request_descriptor : 0;
+}
+
+/*
+ * Dissect the Data value of an attribute, or the parameters of a method,
+ * and hand it to the dissector registered for its class in the
+ * dlms.class_id table, if any (see dlms.h)
+ */
 static void
-dlms_dissect_apdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+dlms_dissect_class_value(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset,
+                         const dlms_descriptor_text *descriptor)
 {
-    unsigned choice;
+    dissector_handle_t handle;
+    gint start;
 
-    proto_tree_add_item(tree, &dlms_hfi.apdu, tvb, offset, 1, ENC_NA);
-    choice = tvb_get_guint8(tvb, offset);
-    offset += 1;
-    if (choice == DLMS_DATA_NOTIFICATION) {
-        dlms_dissect_data_notification(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_AARQ) {
-        dlms_dissect_aarq(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_AARE) {
-        dlms_dissect_aare(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_RLRQ) {
-        col_set_str(pinfo->cinfo, COL_INFO, "RLRQ");
-    } else if (choice == DLMS_RLRE) {
-        col_set_str(pinfo->cinfo, COL_INFO, "RLRE");
-    } else if (choice == DLMS_GET_REQUEST) {
-        dlms_dissect_get_request(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_SET_REQUEST) {
-        dlms_dissect_set_request(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_EVENT_NOTIFICATION_REQUEST) {
-        dlms_dissect_event_notification_request(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_ACTION_REQUEST) {
-        dlms_dissect_action_request(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_GET_RESPONSE) {
-        dlms_dissect_get_response(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_SET_RESPONSE) {
-        dlms_dissect_set_response(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_ACTION_RESPONSE) {
-        dlms_dissect_action_response(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_EXCEPTION_RESPONSE) {
-        dlms_dissect_exception_response(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_ACCESS_REQUEST) {
-        dlms_dissect_access_request(tvb, pinfo, tree, offset);
-    } else if (choice == DLMS_ACCESS_RESPONSE) {
-        dlms_dissect_access_response(tvb, pinfo, tree, offset);
-    } else {
-        col_set_str(pinfo->cinfo, COL_INFO, "Unknown APDU");
+    start = *offset;
+    if (descriptor && !dlms_is_of_interest(&descriptor->value)) {
+        dlms_skip_data(tvb, pinfo, tree, offset);
+        return;
+    }
+    dlms_add_export_value(tvb, pinfo, start, descriptor);
+    dlms_dissect_data(tvb, pinfo, tree, offset);
+    if (descriptor) {
+        handle = dissector_get_uint_handle(dlms_class_table, descriptor->value.class_id);
+        if (handle) {
+            call_dissector_with_data(handle, tvb_new_subset_length(tvb, start, *offset - start), pinfo, tree,
+                                     (void *)&descriptor->value);
+        }
     }
 }
 
-/* Dissect a check sequence field (HCS or FCS) of an HDLC frame */
 static void
-dlms_dissect_hdlc_check_sequence(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, int offset, int length, header_field_info *hfi)
+dlms_dissect_list_of_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset, const char *name)
+{
+    proto_tree *item;
+    proto_tree *subtree;
+    int sequence_of, i;
+
+    subtree = proto_tree_add_subtree(tree, tvb, *offset, 0, dlms_ett.data, &item, name);
+    sequence_of = dlms_get_length(tvb, offset);
+    for (i = 0; i < sequence_of; i++) {
+        proto_item *subitem = dlms_dissect_data(tvb, pinfo, subtree, offset);
+        proto_item_prepend_text(subitem, "[%u] ", i + 1);
+    }
+    proto_item_set_end(item, tvb, *offset);
+}
+
+/*
+ * Account for one block of a block transfer, and on the last block
+ * compare the transfer with the PDU size negotiated by its receiver.
+ */
+static void
+dlms_account_block(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, int kind, unsigned block_number, unsigned last_block, unsigned length)
+{
+    dlms_packet_info *pi;
+    dlms_association *association;
+    dlms_transfer_result *result;
+    proto_item *item;
+
+    pi = dlms_get_packet_info(pinfo);
+    association = dlms_get_association(pinfo, pi);
+    if (!PINFO_FD_VISITED(pinfo)) {
+        if (block_number == 1) {
+            memset(&association->transfers[kind], 0, sizeof association->transfers[kind]);
+        }
+        association->transfers[kind].blocks += 1;
+        association->transfers[kind].bytes += length;
+        if (!last_block) {
+            association->transfers[kind].apdu_bytes += pi->apdu_length;
+        } else if (pi->frame_data) {
+            result = wmem_new0(wmem_file_scope(), dlms_transfer_result);
+            result->blocks = association->transfers[kind].blocks;
+            result->bytes = association->transfers[kind].bytes;
+            if (pi->direction == DLMS_DIRECTION_CLIENT_TO_SERVER) {
+                result->pdu_size = association->server_max_receive_pdu_size;
+            } else if (pi->direction == DLMS_DIRECTION_SERVER_TO_CLIENT) {
+                result->pdu_size = association->client_max_receive_pdu_size;
+            }
+            if (result->pdu_size && result->blocks > 1) {
+                result->fill = (guint32)(G_GUINT64_CONSTANT(100) * association->transfers[kind].apdu_bytes / (result->blocks - 1) / result->pdu_size);
+            }
+            pi->frame_data->transfer = result;
+        }
+    }
+
+    result = pi->frame_data ? pi->frame_data->transfer : 0;
+    if (!last_block || !result) {
+        return;
+    }
+    item = proto_tree_add_uint(tree, &dlms_hfi.transfer_blocks, tvb, 0, 0, result->blocks);
+    PROTO_ITEM_SET_GENERATED(item);
+    if (result->pdu_size && result->bytes + DLMS_GET_RESPONSE_NORMAL_OVERHEAD <= result->pdu_size) {
+        expert_add_info_format(pinfo, item, &dlms_ei.unneeded_block_transfer,
+                               "Block transfer of %u bytes would fit in a single PDU of the negotiated size (%u)",
+                               result->bytes, result->pdu_size);
+    }
+    item = proto_tree_add_uint(tree, &dlms_hfi.transfer_bytes, tvb, 0, 0, result->bytes);
+    PROTO_ITEM_SET_GENERATED(item);
+    if (result->pdu_size) {
+        item = proto_tree_add_uint(tree, &dlms_hfi.transfer_pdu_size, tvb, 0, 0, result->pdu_size);
+        PROTO_ITEM_SET_GENERATED(item);
+        if (result->blocks > 1) {
+            item = proto_tree_add_uint_format_value(tree, &dlms_hfi.transfer_fill, tvb, 0, 0, result->fill, "%u%%", result->fill);
+            PROTO_ITEM_SET_GENERATED(item);
+            if (result->fill < DLMS_LOW_BLOCK_FILL) {
+                expert_add_info_format(pinfo, item, &dlms_ei.low_block_fill,
+                                       "Blocks average %u%% of the negotiated PDU size (%u)",
+                                       result->fill, result->pdu_size);
+            }
+        }
+    }
+}
+
+/* Take a reassembly chain off the list of those with pending bytes */
+static void
+dlms_unlink_chain(dlms_reassembly_chain *chain)
+{
+    if (chain->bytes) {
+        *(chain->older ? &chain->older->newer : &dlms_reassembly_pending.oldest) = chain->newer;
+        *(chain->newer ? &chain->newer->older : &dlms_reassembly_pending.newest) = chain->older;
+        chain->older = chain->newer = 0;
+        dlms_reassembly_pending.bytes -= chain->bytes;
+        chain->bytes = 0;
+    }
+}
+
+/* Put a reassembly chain with pending bytes at the most recently extended end of the list */
+static void
+dlms_link_chain(dlms_reassembly_chain *chain, guint32 bytes)
+{
+    chain->older = dlms_reassembly_pending.newest;
+    *(chain->older ? &chain->older->newer : &dlms_reassembly_pending.oldest) = chain;
+    dlms_reassembly_pending.newest = chain;
+    dlms_reassembly_pending.bytes += bytes;
+    chain->bytes = bytes;
+}
+
+/* Delete the fragments of a reassembly chain, and skip those that follow up to its last one */
+static void
+dlms_evict_chain(packet_info *pinfo, dlms_reassembly_chain *chain, guint32 reason, dlms_reassembly_result *result)
+{
+    fragment_delete(&dlms_reassembly_table, pinfo, chain->id, chain->data);
+    result->evictions[reason]++;
+    result->evicted_bytes += chain->bytes;
+    if (chain->last) {
+        chain->last->evicted = reason;
+        chain->last = 0;
+    }
+    chain->discarding = TRUE;
+    dlms_unlink_chain(chain);
+}
+
+/* Get the reassembly result of the fragments of a frame that belong to a reassembly, adding it on the first pass */
+static dlms_fragment_result *
+dlms_get_fragment_result(packet_info *pinfo, dlms_reassembly_result *result, guint32 id, const void *data)
+{
+    dlms_fragment_result *fragment;
+
+    for (fragment = result->fragments; fragment; fragment = fragment->next) {
+        if (fragment->id == id && fragment->data == data) {
+            return fragment;
+        }
+    }
+    if (PINFO_FD_VISITED(pinfo)) {
+        return 0;
+    }
+    fragment = wmem_new0(wmem_file_scope(), dlms_fragment_result);
+    fragment->id = id;
+    fragment->data = data;
+    fragment->next = result->fragments;
+    result->fragments = fragment;
+
+    return fragment;
+}
+
+/*
+ * Add a fragment to a reassembly chain, as fragment_add_seq_next does
+ * (deleting the chain first if restart), within the limits of the
+ * reassembly. On the first pass, the chains idle for too long, a chain
+ * that would grow past its limit, and the least recently extended chains
+ * while all of them hold too many bytes are evicted. The expert infos are
+ * added on the last fragment of each evicted chain (when the frame is
+ * dissected again) and on the fragments skipped after it. Once visited,
+ * fragment_add_seq_next only looks up the reassembled fragments, which the
+ * skipped ones are not.
+ */
+static fragment_head *
+dlms_add_fragment(tvbuff_t *tvb, gint offset, packet_info *pinfo, proto_tree *tree, guint32 id, const void *data,
+                  guint32 length, gboolean more_frags, gboolean restart)
+{
+    dlms_frame_data *fd;
+    dlms_reassembly_result *result;
+    dlms_fragment_result *fragment;
+    dlms_reassembly_chain *chain;
+    const void *key;
+    fragment_head *frags = 0;
+
+    if (restart) {
+        fragment_delete(&dlms_reassembly_table, pinfo, id, data);
+    }
+
+    fd = dlms_get_frame_data(pinfo);
+    if (!fd) {
+        return fragment_add_seq_next(&dlms_reassembly_table, tvb, offset, pinfo, id, data, length, more_frags);
+    }
+    if (!PINFO_FD_VISITED(pinfo)) {
+        result = fd->reassembly;
+        if (!result) {
+            fd->reassembly = result = wmem_new0(wmem_file_scope(), dlms_reassembly_result);
+        }
+        fragment = dlms_get_fragment_result(pinfo, result, id, data);
+
+        /* Evict the chains idle for too long (the least recently extended come first) */
+        while ((chain = dlms_reassembly_pending.oldest) != 0
+               && ((dlms_reassembly_max_idle_frames && pinfo->num - chain->last_frame > dlms_reassembly_max_idle_frames)
+                   || (dlms_reassembly_max_idle_seconds
+                       && pinfo->abs_ts.secs - chain->last_time.secs > (time_t)dlms_reassembly_max_idle_seconds))) {
+            dlms_evict_chain(pinfo, chain, DLMS_EVICTED_IDLE, result);
+        }
+
+        key = dlms_reassembly_key_func(pinfo, id, data);
+        chain = (dlms_reassembly_chain *)wmem_map_lookup(dlms_reassembly_chains, key);
+        if (!chain) {
+            chain = wmem_new0(wmem_file_scope(), dlms_reassembly_chain);
+            chain->id = id;
+            chain->data = data;
+            wmem_map_insert(dlms_reassembly_chains, key, chain);
+        } else if (restart) {
+            dlms_unlink_chain(chain);
+            chain->discarding = FALSE;
+            chain->last = 0;
+        }
+        chain->last_frame = pinfo->num;
+        chain->last_time = pinfo->abs_ts;
+
+        if (chain->discarding) {
+            fragment->discarded = TRUE;
+            result->discarded++;
+            chain->discarding = more_frags;
+        } else if (!more_frags) {
+            frags = fragment_add_seq_next(&dlms_reassembly_table, tvb, offset, pinfo, id, data, length, FALSE);
+            dlms_unlink_chain(chain);
+            chain->last = 0;
+        } else if (dlms_reassembly_max_chain_bytes && chain->bytes + length > dlms_reassembly_max_chain_bytes) {
+            /* this fragment is not added, so the chain ends with the previous one */
+            dlms_evict_chain(pinfo, chain, DLMS_EVICTED_CHAIN_BYTES, result);
+            fragment->discarded = TRUE;
+            result->discarded++;
+        } else {
+            guint32 bytes = chain->bytes + length;
+            frags = fragment_add_seq_next(&dlms_reassembly_table, tvb, offset, pinfo, id, data, length, TRUE);
+            dlms_unlink_chain(chain);
+            dlms_link_chain(chain, bytes);
+            chain->last = fragment;
+        }
+
+        /* Evict the least recently extended chains while they hold too many bytes */
+        while (dlms_reassembly_max_pending_bytes && dlms_reassembly_pending.bytes > dlms_reassembly_max_pending_bytes) {
+            dlms_evict_chain(pinfo, dlms_reassembly_pending.oldest, DLMS_EVICTED_PENDING_BYTES, result);
+        }
+        result->pending_bytes = dlms_reassembly_pending.bytes;
+    } else {
+        frags = fragment_add_seq_next(&dlms_reassembly_table, tvb, offset, pinfo, id, data, length, more_frags);
+        fragment = fd->reassembly ? dlms_get_fragment_result(pinfo, fd->reassembly, id, data) : 0;
+    }
+
+    if (fragment && fragment->discarded) {
+        proto_tree_add_expert(tree, pinfo, &dlms_ei.reassembly_discarded, tvb, offset, (gint)length);
+    }
+    if (fragment && fragment->evicted) {
+        proto_tree_add_expert_format(tree, pinfo, &dlms_ei.reassembly_evicted, tvb, offset, (gint)length,
+                                     "Reassembly evicted (%s) after this fragment",
+                                     val_to_str_const(fragment->evicted, dlms_evicted_names, "Unknown"));
+    }
+
+    return frags;
+}
+
+/* Reset the reassembly chains with each capture file */
+static void
+dlms_reassembly_init(void)
+{
+    dlms_reassembly_pending.oldest = dlms_reassembly_pending.newest = 0;
+    dlms_reassembly_pending.bytes = 0;
+}
+
+/*
+ * Dissect the raw data of a block of a kind of transfer (DLMS_TRANSFER_*),
+ * and the Data (or list of Data) reassembled on the last block, which is returned.
+ * The reassembly key is that of the pblocks, or 0 for the datablocks, which
+ * are reassembled per association and direction.
+ */
+static tvbuff_t *
+dlms_dissect_datablock_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, proto_tree *subtree, const dlms_core_block *block,
+                            int kind, const void *key, gboolean is_list)
+{
+    proto_item *item;
+    fragment_head *frags;
+    tvbuff_t *rtvb;
+    guint32 id;
+
+    col_append_fstr(pinfo->cinfo, COL_INFO, " (block %u)", block->block_number);
+    if (block->last_block) {
+        col_append_str(pinfo->cinfo, COL_INFO, " (last block)");
+    }
+
+    item = proto_tree_add_item(subtree, &dlms_hfi.data, tvb, (gint)block->length_offset,
+                               (gint)(block->data_offset - block->length_offset + block->data_length), ENC_NA);
+    proto_item_append_text(item, " (length %u)", block->data_length);
+
+    dlms_account_block(tvb, pinfo, tree, kind, block->block_number, block->last_block, block->data_length);
+
+    if (key) {
+        id = DLMS_REASSEMBLY_ID_PBLOCK;
+    } else {
+        dlms_packet_info *pi = dlms_get_packet_info(pinfo);
+        id = DLMS_REASSEMBLY_ID_DATABLOCK;
+        key = &dlms_get_association(pinfo, pi)->datablocks[dlms_get_side(pinfo, pi)];
+    }
+    frags = dlms_add_fragment(tvb, (gint)block->data_offset, pinfo, subtree, id, key, block->data_length,
+                              block->last_block == 0, block->block_number == 1);
+    rtvb = process_reassembled_data(tvb, (gint)block->data_offset, pinfo, "Reassembled", frags, &dlms_fragment_items, 0, tree);
+    if (rtvb && is_list) {
+        gint offset = 0;
+        dlms_dissect_list_of_data(rtvb, pinfo, tree, &offset, "Reassembled List Of Data");
+    } else if (rtvb) {
+        const dlms_descriptor_text *descriptor = dlms_get_request_descriptor(pinfo);
+        gint offset = 0;
+        subtree = proto_tree_add_subtree(tree, rtvb, 0, 0, dlms_ett.data, 0, "Reassembled Data");
+        if (descriptor && !dlms_is_of_interest(&descriptor->value)) {
+            dlms_skip_data(rtvb, pinfo, subtree, &offset);
+        } else {
+            dlms_add_export_value(rtvb, pinfo, 0, descriptor);
+            dlms_dissect_data(rtvb, pinfo, subtree, &offset);
+        }
+    }
+
+    return rtvb;
+}
+
+static void
+dlms_dissect_datablock_g(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    proto_tree *subtree;
+    dlms_core_block block;
+    const guint8 *data;
+    size_t size, position;
+    int status;
+
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.datablock, 0, "Datablock G");
+
+    data = dlms_get_data(tvb, &size);
+    position = *offset;
+    status = dlms_core_parse_datablock_g(data, size, &position, &block);
+    proto_tree_add_item(subtree, &dlms_hfi.last_block, tvb, *offset, 1, ENC_NA);
+    proto_tree_add_item(subtree, &dlms_hfi.block_number, tvb, *offset + 1, 4, ENC_BIG_ENDIAN);
+    dlms_check_status(tvb, status);
+
+    if (block.result == 0) {
+        dlms_dissect_datablock_data(tvb, pinfo, tree, subtree, &block, DLMS_TRANSFER_DATABLOCK, 0, FALSE);
+    } else {
+        gint result_offset = *offset + 6;
+        dlms_dissect_data_access_result(tvb, pinfo, subtree, &result_offset);
+    }
+    *offset = (gint)position;
+}
+
+static void
+dlms_dissect_datablock_sa(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    proto_tree *subtree;
+    dlms_core_block block;
+    const guint8 *data;
+    size_t size, position;
+    int status;
+
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.datablock, 0, "Datablock SA");
+
+    data = dlms_get_data(tvb, &size);
+    position = *offset;
+    status = dlms_core_parse_datablock_sa(data, size, &position, &block);
+    proto_tree_add_item(subtree, &dlms_hfi.last_block, tvb, *offset, 1, ENC_NA);
+    proto_tree_add_item(subtree, &dlms_hfi.block_number, tvb, *offset + 1, 4, ENC_BIG_ENDIAN);
+    dlms_check_status(tvb, status);
+
+    dlms_dissect_datablock_data(tvb, pinfo, tree, subtree, &block, DLMS_TRANSFER_DATABLOCK, 0, FALSE);
+    *offset = (gint)position;
+}
+
+static void
+dlms_dissect_selective_access_descriptor(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    proto_item *item;
+    proto_tree *subtree = proto_tree_add_subtree(tree, tvb, *offset, 0, dlms_ett.selective_access_descriptor, &item, "Selective Access Descriptor");
+    int selector = tvb_get_guint8(tvb, *offset);
+    proto_tree_add_item(subtree, &dlms_hfi.access_selector, tvb, *offset, 1, ENC_NA);
+    *offset += 1;
+    if (selector) {
+        dlms_dissect_data(tvb, pinfo, subtree, offset);
+    }
+    proto_item_set_end(item, tvb, *offset);
+}
+
+static void
+dlms_dissect_access_request_specification(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    proto_item *item, *subitem;
+    proto_tree *subtree, *subsubtree;
+    int sequence_of, i;
+
+    subtree = proto_tree_add_subtree(tree, tvb, *offset, 0, dlms_ett.access_request_specification, &item, "Access Request Specification");
+    sequence_of = dlms_get_length(tvb, offset);
+    for (i = 0; i < sequence_of; i++) {
+        int choice = tvb_get_guint8(tvb, *offset);
+        subitem = proto_tree_add_item(subtree, &dlms_hfi.access_request, tvb, *offset, 1, ENC_NA);
+        proto_item_prepend_text(subitem, "[%u] ", i + 1);
+        subsubtree = proto_item_add_subtree(subitem, dlms_ett.access_request);
+        *offset += 1;
+        switch (choice) {
+        case DLMS_ACCESS_REQUEST_GET:
+        case DLMS_ACCESS_REQUEST_SET:
+            dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, subsubtree, offset);
+            break;
+        case DLMS_ACCESS_REQUEST_ACTION:
+            dlms_dissect_cosem_method_descriptor(tvb, pinfo, subsubtree, offset);
+            break;
+        case DLMS_ACCESS_REQUEST_GET_WITH_SELECTION:
+        case DLMS_ACCESS_REQUEST_SET_WITH_SELECTION:
+            dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, subsubtree, offset);
+            dlms_dissect_selective_access_descriptor(tvb, pinfo, subsubtree, offset);
+            break;
+        default: /* invalid Access-Request-Specification CHOICE, so the rest cannot be dissected */
+            THROW(ReportedBoundsError);
+        }
+    }
+    proto_item_set_end(item, tvb, *offset);
+}
+
+static void
+dlms_dissect_conformance(tvbuff_t *tvb, proto_tree *tree, gint offset)
+{
+    proto_tree *subtree;
+    header_field_info *hfi;
+
+    subtree = proto_tree_add_subtree(tree, tvb, offset, 7, dlms_ett.conformance, 0, "Conformance");
+    for (hfi = &dlms_hfi.conformance_general_protection; hfi <= &dlms_hfi.conformance_action; hfi++) {
+        proto_tree_add_item(subtree, hfi, tvb, offset + 4, 3, ENC_BIG_ENDIAN);
+    }
+}
+
+/*
+ * Get the UTC time of a date-time of 12 bytes, if it specifies a single time.
+ * DLMS defines the deviation as UTC minus local time, in minutes.
+ * A date-time with an unspecified deviation is taken as UTC.
+ */
+static gboolean
+dlms_get_date_time_utc(tvbuff_t *tvb, gint offset, unsigned length, nstime_t *time)
+{
+    dlms_core_date_time dt;
+    gint deviation, year, month, era, year_of_era, day_of_year, days;
+
+    if (length != 12) return FALSE;
+    if (dlms_core_parse_date_time(tvb_get_ptr(tvb, offset, length), length, &dt) != DLMS_CORE_OK) return FALSE;
+    if (dt.year == 0xffff || dt.month < 1 || dt.month > 12 || dt.day_of_month < 1 || dt.day_of_month > 31
+        || dt.hour > 23 || dt.minute > 59 || dt.second > 59) {
+        return FALSE;
+    }
+    deviation = (gint16)tvb_get_ntohs(tvb, offset + 9);
+    if (deviation == -0x8000) {
+        deviation = 0;
+    } else if (deviation < -840 || deviation > 840) {
+        return FALSE;
+    }
+
+    /* Days since 1970-01-01 in the proleptic Gregorian calendar */
+    year = (gint)dt.year - (dt.month <= 2);
+    month = (gint)dt.month;
+    era = year / 400;
+    year_of_era = year - era * 400;
+    day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + (gint)dt.day_of_month - 1;
+    days = era * 146097 + year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year - 719468;
+
+    time->secs = (time_t)days * 86400 + dt.hour * 3600 + dt.minute * 60 + dt.second + deviation * 60;
+    time->nsecs = dt.hundredths < 100 ? (int)dt.hundredths * 10000000 : 0;
+
+    return TRUE;
+}
+
+/*
+ * Track a Data-Notification or Event-Notification of the current frame (first pass only),
+ * with its date-time (if any) at date_time_offset.
+ */
+static void
+dlms_track_push(tvbuff_t *tvb, packet_info *pinfo, gint date_time_offset, unsigned date_time_length)
+{
+    dlms_packet_info *pi;
+    dlms_frame_data *fd;
+    dlms_push_state *state;
+    dlms_push_result *result;
+    nstime_t apdu_time;
+    gpointer second;
+
+    pi = dlms_get_packet_info(pinfo);
+    fd = pi->frame_data;
+    if (PINFO_FD_VISITED(pinfo) || !fd || !pi->association || !pi->association->meter) {
+        return;
+    }
+    result = wmem_new0(wmem_file_scope(), dlms_push_result);
+    result->meter = pi->association->meter;
+
+    state = (dlms_push_state *)wmem_map_lookup(dlms_push_meters, result->meter);
+    if (!state) {
+        state = wmem_new0(wmem_file_scope(), dlms_push_state);
+        wmem_map_insert(dlms_push_meters, result->meter, state);
+    } else {
+        result->flags |= DLMS_PUSH_INTERVAL;
+        nstime_delta(&result->interval, &fd->time, &state->last);
+    }
+    result->number = ++state->pushes;
+    state->last = fd->time;
+
+    second = GUINT_TO_POINTER((guint)fd->time.secs);
+    result->same_second = GPOINTER_TO_UINT(wmem_map_lookup(dlms_push_seconds, second)) + 1;
+    wmem_map_insert(dlms_push_seconds, second, GUINT_TO_POINTER(result->same_second));
+
+    if (date_time_offset >= 0 && dlms_get_date_time_utc(tvb, date_time_offset, date_time_length, &apdu_time)) {
+        result->flags |= DLMS_PUSH_CLOCK_DRIFT;
+        nstime_delta(&result->clock_drift, &apdu_time, &fd->time);
+    }
+    fd->push = result;
+}
+
+/* Add the push analysis of the current frame (if any) to the tree */
+static void
+dlms_dissect_push_result(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+    const dlms_packet_info *pi;
+    const dlms_push_result *result;
+    proto_tree *subtree;
+    proto_item *item;
+
+    pi = dlms_get_packet_info(pinfo);
+    result = pi->frame_data ? pi->frame_data->push : 0;
+    if (!result) {
+        return;
+    }
+
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.push, &item, "Push Analysis");
+    PROTO_ITEM_SET_GENERATED(item);
+    item = proto_tree_add_uint(subtree, &dlms_hfi.push_number, tvb, 0, 0, result->number);
+    PROTO_ITEM_SET_GENERATED(item);
+    if (result->flags & DLMS_PUSH_INTERVAL) {
+        item = proto_tree_add_time(subtree, &dlms_hfi.push_interval, tvb, 0, 0, &result->interval);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+    item = proto_tree_add_uint(subtree, &dlms_hfi.push_same_second, tvb, 0, 0, result->same_second);
+    PROTO_ITEM_SET_GENERATED(item);
+    if (result->flags & DLMS_PUSH_CLOCK_DRIFT) {
+        item = proto_tree_add_time(subtree, &dlms_hfi.push_clock_drift, tvb, 0, 0, &result->clock_drift);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+}
+
+static void
+dlms_dissect_data_notification(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+
+    col_set_str(pinfo->cinfo, COL_INFO, "Data-Notification");
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    dlms_dissect_long_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+
+    dlms_dissect_service_date_time(tvb, tree, &service);
+    dlms_track_push(tvb, pinfo, (gint)service.date_time_contents_offset, service.date_time_length);
+    dlms_dissect_push_result(tvb, pinfo, tree);
+
+    /* notification-body */
+    offset = (gint)service.data_offset;
+    dlms_add_export_value(tvb, pinfo, offset, 0);
+    dlms_dissect_data(tvb, pinfo, tree, &offset);
+}
+
+/* Get the last arc of a DLMS-UA object identifier (2.16.756.5.8.x.y), or -1 for other OIDs */
+static int
+dlms_get_dlms_ua_oid_arc(tvbuff_t *tvb, gint offset, unsigned length, unsigned kind)
+{
+    static const guint8 prefix[] = { 0x60, 0x85, 0x74, 0x05, 0x08 };
+    unsigned i;
+
+    if (length != sizeof prefix + 2) return -1;
+    for (i = 0; i < sizeof prefix; i++) {
+        if (tvb_get_guint8(tvb, offset + i) != prefix[i]) return -1;
+    }
+    if (tvb_get_guint8(tvb, offset + sizeof prefix) != kind) return -1;
+
+    return tvb_get_guint8(tvb, offset + sizeof prefix + 1);
+}
+
+/* Dissect an object identifier in the DLMS-UA arc, and return its last arc */
+static int
+dlms_dissect_dlms_ua_oid(tvbuff_t *tvb, proto_tree *tree, gint offset, unsigned length, unsigned kind, header_field_info *oid_hfi, header_field_info *arc_hfi)
+{
+    proto_item *item;
+    int arc;
+
+    proto_tree_add_item(tree, oid_hfi, tvb, offset, length, ENC_NA);
+    arc = dlms_get_dlms_ua_oid_arc(tvb, offset, length, kind);
+    if (arc >= 0) {
+        item = proto_tree_add_uint(tree, arc_hfi, tvb, offset + length - 1, 1, arc);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+
+    return arc;
+}
+
+/*
+ * Get the length of the single field wrapped by a BER field value (EXPLICIT tagging),
+ * and the offset of the content of that inner field in *inner_offset.
+ */
+static unsigned
+dlms_get_ber_inner(tvbuff_t *tvb, gint offset, gint *inner_offset)
+{
+    *inner_offset = offset + 1;
+    return dlms_get_length(tvb, inner_offset);
+}
+
+/* Get an AP title (system title) as a number, for keeping in the association state */
+static guint64
+dlms_get_ap_title(tvbuff_t *tvb, gint offset, unsigned length)
+{
+    guint64 title = 0;
+    unsigned i;
+
+    for (i = 0; i < length && i < 8; i++) {
+        title = (title << 8) | tvb_get_guint8(tvb, offset + i);
+    }
+
+    return title;
+}
+
+static void
+dlms_dissect_initiate_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset, dlms_association *association)
+{
+    unsigned length, conformance, pdu_size, version;
+    gboolean dedicated_key = FALSE;
+
+    /* dedicated-key OCTET STRING OPTIONAL */
+    if (tvb_get_guint8(tvb, offset)) {
+        offset += 1;
+        length = dlms_get_length(tvb, &offset);
+        proto_tree_add_item(tree, &dlms_hfi.dedicated_key, tvb, offset, length, ENC_NA);
+        offset += length;
+        dedicated_key = TRUE;
+    } else {
+        offset += 1;
+    }
+
+    /* response-allowed BOOLEAN DEFAULT TRUE */
+    if (tvb_get_guint8(tvb, offset)) {
+        proto_tree_add_item(tree, &dlms_hfi.response_allowed, tvb, offset + 1, 1, ENC_NA);
+        offset += 2;
+    } else {
+        offset += 1;
+    }
+
+    /* proposed-quality-of-service [0] IMPLICIT Integer8 OPTIONAL */
+    if (tvb_get_guint8(tvb, offset)) {
+        proto_tree_add_item(tree, &dlms_hfi.proposed_quality_of_service, tvb, offset + 1, 1, ENC_NA);
+        offset += 2;
+    } else {
+        offset += 1;
+    }
+
+    proto_tree_add_item(tree, &dlms_hfi.proposed_dlms_version_number, tvb, offset, 1, ENC_NA);
+    version = tvb_get_guint8(tvb, offset);
+    offset += 1;
+
+    dlms_dissect_conformance(tvb, tree, offset);
+    conformance = tvb_get_ntoh24(tvb, offset + 4);
+    offset += 7;
+
+    proto_tree_add_item(tree, &dlms_hfi.client_max_receive_pdu_size, tvb, offset, 2, ENC_BIG_ENDIAN);
+    pdu_size = tvb_get_ntohs(tvb, offset);
+
+    if (!PINFO_FD_VISITED(pinfo)) {
+        association->dlms_version = version;
+        association->proposed_conformance = conformance;
+        association->client_max_receive_pdu_size = pdu_size;
+        association->dedicated_key_frame = dedicated_key ? pinfo->num : 0;
+    }
+}
+
+static void
+dlms_dissect_initiate_response(tvbuff_t *tvb, proto_tree *tree, gint offset, dlms_association *association, gboolean visited)
+{
+    unsigned conformance, pdu_size, version, vaa_name;
+
+    /* negotiated-quality-of-service [0] IMPLICIT Integer8 OPTIONAL */
+    if (tvb_get_guint8(tvb, offset)) {
+        proto_tree_add_item(tree, &dlms_hfi.negotiated_quality_of_service, tvb, offset + 1, 1, ENC_NA);
+        offset += 2;
+    } else {
+        offset += 1;
+    }
+
+    proto_tree_add_item(tree, &dlms_hfi.negotiated_dlms_version_number, tvb, offset, 1, ENC_NA);
+    version = tvb_get_guint8(tvb, offset);
+    offset += 1;
+
+    dlms_dissect_conformance(tvb, tree, offset);
+    conformance = tvb_get_ntoh24(tvb, offset + 4);
+    offset += 7;
+
+    proto_tree_add_item(tree, &dlms_hfi.server_max_receive_pdu_size, tvb, offset, 2, ENC_BIG_ENDIAN);
+    pdu_size = tvb_get_ntohs(tvb, offset);
+    offset += 2;
+
+    proto_tree_add_item(tree, &dlms_hfi.vaa_name, tvb, offset, 2, ENC_BIG_ENDIAN);
+    vaa_name = tvb_get_ntohs(tvb, offset);
+
+    if (!visited) {
+        association->dlms_version = version;
+        association->negotiated_conformance = conformance;
+        association->server_max_receive_pdu_size = pdu_size;
+        association->vaa_name = vaa_name;
+    }
+}
+
+static void
+dlms_dissect_confirmed_service_error(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    proto_item *item;
+    unsigned type, value;
+
+    proto_tree_add_item(tree, &dlms_hfi.confirmed_service_error, tvb, offset, 1, ENC_NA);
+    proto_tree_add_item(tree, &dlms_hfi.service_error_type, tvb, offset + 1, 1, ENC_NA);
+    type = tvb_get_guint8(tvb, offset + 1);
+    item = proto_tree_add_item(tree, &dlms_hfi.service_error_value, tvb, offset + 2, 1, ENC_NA);
+    value = tvb_get_guint8(tvb, offset + 2);
+    if (type == DLMS_SERVICE_ERROR_INITIATE) {
+        const gchar *str = val_to_str_const(value, dlms_initiate_error_names, "unknown");
+        proto_item_append_text(item, " (%s)", str);
+        col_append_fstr(pinfo->cinfo, COL_INFO, " (%s)", str);
+    }
+    expert_add_info(pinfo, item, &dlms_ei.no_success);
+}
+
+/*
+ * Track the invocation counter of a ciphered APDU of the current frame (first pass only).
+ * The counters are kept per sender and key: the system title of the sender
+ * (from the APDU, or else from the AARQ or AARE of the association), or else
+ * its endpoint name, followed by the meter for the APDUs sent to a meter,
+ * since a client has a key per meter, and by the key set.
+ */
+static void
+dlms_track_invocation_counter(tvbuff_t *tvb, packet_info *pinfo, const dlms_core_security *security)
+{
+    dlms_packet_info *pi;
+    dlms_association *association;
+    dlms_frame_data *fd;
+    dlms_security_result *result;
+    dlms_invocation_state *state;
+    const gchar *sender;
+    guint64 title;
+
+    pi = dlms_get_packet_info(pinfo);
+    association = dlms_get_association(pinfo, pi);
+    fd = pi->frame_data;
+    if (PINFO_FD_VISITED(pinfo) || !fd || fd->security) {
+        return;
+    }
+
+    if (security->system_title_length) {
+        title = dlms_get_ap_title(tvb, (gint)security->system_title_offset, security->system_title_length);
+    } else if (pi->direction == DLMS_DIRECTION_CLIENT_TO_SERVER) {
+        title = association->calling_ap_title;
+    } else if (pi->direction == DLMS_DIRECTION_SERVER_TO_CLIENT) {
+        title = association->responding_ap_title;
+    } else {
+        title = 0;
+    }
+    if (title) {
+        sender = wmem_strdup_printf(wmem_packet_scope(), "%016" G_GINT64_MODIFIER "x", title);
+    } else {
+        sender = dlms_endpoint_name(wmem_packet_scope(), &pi->src, pi->srcport, pi->is_hdlc);
+    }
+    if (pi->direction == DLMS_DIRECTION_CLIENT_TO_SERVER && association->meter) {
+        sender = wmem_strdup_printf(wmem_packet_scope(), "%s to %s", sender, association->meter);
+    }
+    if (security->security_control & DLMS_SECURITY_BROADCAST_KEY) {
+        sender = wmem_strdup_printf(wmem_packet_scope(), "%s (broadcast key)", sender);
+    } else if ((security->choice >= 65 && security->choice <= 88) /* ded- short name services */
+               || (security->choice >= DLMS_GLO_GET_REQUEST + 8 && security->choice <= DLMS_DED_ACTION_RESPONSE)
+               || security->choice == DLMS_GENERAL_DED_CIPHERING) {
+        /* ded- APDUs: the dedicated key, and so its invocation counter, is that of the current association */
+        sender = association->dedicated_key_frame
+            ? wmem_strdup_printf(wmem_packet_scope(), "%s (dedicated key of frame %u)", sender, association->dedicated_key_frame)
+            : wmem_strdup_printf(wmem_packet_scope(), "%s (dedicated key)", sender);
+    }
+
+    result = wmem_new0(wmem_file_scope(), dlms_security_result);
+    result->meter = association->meter;
+    state = (dlms_invocation_state *)wmem_map_lookup(dlms_invocation_counters, sender);
+    if (!state) {
+        state = wmem_new(wmem_file_scope(), dlms_invocation_state);
+        state->sender = wmem_strdup(wmem_file_scope(), sender);
+        wmem_map_insert(dlms_invocation_counters, state->sender, state);
+        result->flags = DLMS_SECURITY_FIRST;
+    } else {
+        result->previous = state->counter;
+        if (security->invocation_counter == state->counter) {
+            result->flags = DLMS_SECURITY_DUPLICATE;
+        } else if (security->invocation_counter < state->counter) {
+            result->flags = DLMS_SECURITY_REGRESSION;
+        } else if (security->invocation_counter - state->counter > 1) {
+            result->flags = DLMS_SECURITY_GAP;
+            result->lost = security->invocation_counter - state->counter - 1;
+        }
+    }
+    result->sender = state->sender;
+    state->counter = security->invocation_counter;
+    fd->security = result;
+}
+
+/*
+ * Dissect the tag and security header of a ciphered APDU at offset, and
+ * its ciphered text, which stays opaque without the keys
+ */
+static void
+dlms_dissect_ciphered_apdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    static header_field_info *const control_fields[] = {
+        &dlms_hfi.security_suite, &dlms_hfi.security_authentication, &dlms_hfi.security_encryption,
+        &dlms_hfi.security_key_set, &dlms_hfi.security_compression,
+    };
+    dlms_core_security security;
+    const dlms_packet_info *pi;
+    const dlms_security_result *result;
+    const guint8 *data;
+    size_t size, position;
+    proto_tree *subtree, *control_tree;
+    proto_item *item;
+    guint32 text_length;
+    unsigned i;
+
+    data = dlms_get_data(tvb, &size);
+    position = offset;
+    dlms_check_status(tvb, dlms_core_parse_security_header(data, size, &position, &security));
+    dlms_track_invocation_counter(tvb, pinfo, &security);
+
+    subtree = proto_tree_add_subtree(tree, tvb, offset, (gint)(position - offset), dlms_ett.security, 0, "Ciphered APDU");
+    if (security.system_title_length) {
+        proto_tree_add_item(subtree, &dlms_hfi.system_title, tvb, (gint)security.system_title_offset, security.system_title_length, ENC_NA);
+    }
+    item = proto_tree_add_item(subtree, &dlms_hfi.security_control, tvb, (gint)security.security_control_offset, 1, ENC_NA);
+    control_tree = proto_item_add_subtree(item, dlms_ett.security_control);
+    for (i = 0; i < array_length(control_fields); i++) {
+        proto_tree_add_item(control_tree, control_fields[i], tvb, (gint)security.security_control_offset, 1, ENC_NA);
+    }
+    item = proto_tree_add_item(subtree, &dlms_hfi.invocation_counter, tvb, (gint)security.security_control_offset + 1, 4, ENC_BIG_ENDIAN);
+
+    pi = dlms_get_packet_info(pinfo);
+    result = pi->frame_data ? pi->frame_data->security : 0;
+    if (result) {
+        if (result->flags & DLMS_SECURITY_GAP) {
+            expert_add_info_format(pinfo, item, &dlms_ei.invocation_counter_gap,
+                                   "Invocation counter gap: %u APDUs lost", result->lost);
+        } else if (result->flags & DLMS_SECURITY_DUPLICATE) {
+            expert_add_info(pinfo, item, &dlms_ei.invocation_counter_duplicate);
+        } else if (result->flags & DLMS_SECURITY_REGRESSION) {
+            expert_add_info(pinfo, item, &dlms_ei.invocation_counter_regression);
+        }
+        if (!(result->flags & DLMS_SECURITY_FIRST)) {
+            item = proto_tree_add_uint(subtree, &dlms_hfi.previous_invocation_counter, tvb, 0, 0, result->previous);
+            PROTO_ITEM_SET_GENERATED(item);
+        }
+        if (result->flags & DLMS_SECURITY_GAP) {
+            item = proto_tree_add_uint(subtree, &dlms_hfi.invocation_counter_lost, tvb, 0, 0, result->lost);
+            PROTO_ITEM_SET_GENERATED(item);
+        }
+    }
+
+    text_length = security.ciphered_length;
+    if ((security.security_control & DLMS_SECURITY_AUTHENTICATION) && text_length >= DLMS_SECURITY_TAG_LENGTH) {
+        text_length -= DLMS_SECURITY_TAG_LENGTH;
+    }
+    proto_tree_add_item(subtree, &dlms_hfi.ciphered_text, tvb, (gint)security.ciphered_offset, text_length, ENC_NA);
+    if (text_length < security.ciphered_length) {
+        proto_tree_add_item(subtree, &dlms_hfi.authentication_tag, tvb, (gint)security.ciphered_offset + text_length,
+                            DLMS_SECURITY_TAG_LENGTH, ENC_NA);
+    }
+}
+
+/* Dissect the user-information field of an AARQ or AARE, which carries an xDLMS APDU */
+static void
+dlms_dissect_user_information(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset, unsigned length, dlms_association *association)
+{
+    proto_tree *subtree;
+    gint inner_offset;
+    unsigned choice;
+
+    subtree = proto_tree_add_subtree(tree, tvb, offset, length, dlms_ett.user_information, 0, "User-Information");
+    dlms_get_ber_inner(tvb, offset, &inner_offset); /* OCTET STRING */
+    proto_tree_add_item(subtree, &dlms_hfi.xdlms_apdu, tvb, inner_offset, 1, ENC_NA);
+    choice = tvb_get_guint8(tvb, inner_offset);
+    inner_offset += 1;
+    if (choice == DLMS_INITIATE_REQUEST) {
+        dlms_dissect_initiate_request(tvb, pinfo, subtree, inner_offset, association);
+    } else if (choice == DLMS_INITIATE_RESPONSE) {
+        dlms_dissect_initiate_response(tvb, subtree, inner_offset, association, PINFO_FD_VISITED(pinfo));
+    } else if (choice == DLMS_CONFIRMED_SERVICE_ERROR) {
+        dlms_dissect_confirmed_service_error(tvb, pinfo, subtree, inner_offset);
+    } else if (dlms_core_is_ciphered_apdu(choice)) {
+        dlms_dissect_ciphered_apdu(tvb, pinfo, subtree, inner_offset - 1);
+    }
+}
+
+/*
+ * Dissect the fields of an AARQ or AARE, whose context-specific tags
+ * have different meanings in each of the two APDUs.
+ */
+static void
+dlms_dissect_aarq_aare(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset, int is_aare)
+{
+    dlms_association *association;
+    proto_item *item;
+    gint end, field_offset, inner_offset;
+    unsigned tag, length, inner_length, value;
+    gboolean visited;
+
+    association = dlms_get_association(pinfo, dlms_get_packet_info(pinfo));
+    visited = PINFO_FD_VISITED(pinfo);
+    if (!visited && !is_aare) {
+        /* A new association: forget what was negotiated by the previous one */
+        association->application_context = 0;
+        association->mechanism = 0;
+        association->result = 0;
+        association->accepted = FALSE;
+        association->calling_ap_title = 0;
+        association->responding_ap_title = 0;
+        association->dlms_version = 0;
+        association->proposed_conformance = 0;
+        association->negotiated_conformance = 0;
+        association->client_max_receive_pdu_size = 0;
+        association->server_max_receive_pdu_size = 0;
+        association->vaa_name = 0;
+        association->dedicated_key_frame = 0;
+    }
+
+    length = dlms_get_length(tvb, &offset);
+    end = offset + length;
+    while (offset < end) {
+        field_offset = offset;
+        tag = tvb_get_guint8(tvb, offset);
+        offset += 1;
+        length = dlms_get_length(tvb, &offset);
+        if (tag == 0x80) { /* protocol-version */
+            proto_tree_add_item(tree, &dlms_hfi.acse_protocol_version, tvb, offset, length, ENC_NA);
+        } else if (tag == 0xa1) { /* application-context-name */
+            inner_length = dlms_get_ber_inner(tvb, offset, &inner_offset);
+            value = dlms_dissect_dlms_ua_oid(tvb, tree, inner_offset, inner_length, 1,
+                                             &dlms_hfi.application_context_name, &dlms_hfi.application_context);
+            if (!visited && (int)value >= 0) {
+                association->application_context = value;
+            }
+        } else if (tag == (is_aare ? 0x89u : 0x8bu)) { /* mechanism-name */
+            value = dlms_dissect_dlms_ua_oid(tvb, tree, offset, length, 2, &dlms_hfi.mechanism_name, &dlms_hfi.mechanism);
+            if (!visited && (int)value >= 0) {
+                association->mechanism = value;
+            }
+        } else if (tag == (is_aare ? 0x88u : 0x8au)) { /* sender-acse-requirements or responder-acse-requirements */
+            proto_tree_add_item(tree, &dlms_hfi.acse_requirements, tvb, offset, length, ENC_NA);
+        } else if (tag == (is_aare ? 0xaau : 0xacu)) { /* calling-authentication-value or responding-authentication-value */
+            inner_length = dlms_get_ber_inner(tvb, offset, &inner_offset);
+            proto_tree_add_item(tree, is_aare ? &dlms_hfi.responding_authentication_value : &dlms_hfi.calling_authentication_value,
+                                tvb, inner_offset, inner_length, ENC_NA);
+        } else if (tag == 0xbd) { /* implementation-information */
+            proto_tree_add_item(tree, &dlms_hfi.implementation_information, tvb, offset, length, ENC_NA);
+        } else if (tag == 0xbe) { /* user-information */
+            dlms_dissect_user_information(tvb, pinfo, tree, offset, length, association);
+        } else if (!is_aare && (tag == 0xa2 || tag == 0xa6)) { /* called-AP-title or calling-AP-title */
+            inner_length = dlms_get_ber_inner(tvb, offset, &inner_offset);
+            proto_tree_add_item(tree, tag == 0xa2 ? &dlms_hfi.called_ap_title : &dlms_hfi.calling_ap_title,
+                                tvb, inner_offset, inner_length, ENC_NA);
+            if (!visited && tag == 0xa6) {
+                association->calling_ap_title = dlms_get_ap_title(tvb, inner_offset, inner_length);
+            }
+        } else if (!is_aare && (tag == 0xa3 || tag == 0xa7)) { /* called-AE-qualifier or calling-AE-qualifier */
+            inner_length = dlms_get_ber_inner(tvb, offset, &inner_offset);
+            proto_tree_add_item(tree, tag == 0xa3 ? &dlms_hfi.called_ae_qualifier : &dlms_hfi.calling_ae_qualifier,
+                                tvb, inner_offset, inner_length, ENC_NA);
+        } else if (is_aare && tag == 0xa2) { /* result */
+            dlms_get_ber_inner(tvb, offset, &inner_offset); /* INTEGER */
+            item = proto_tree_add_item(tree, &dlms_hfi.association_result, tvb, inner_offset, 1, ENC_NA);
+            value = tvb_get_guint8(tvb, inner_offset);
+            if (value) {
+                col_append_fstr(pinfo->cinfo, COL_INFO, " (%s)", val_to_str_const(value, dlms_association_result_names, "unknown"));
+                expert_add_info(pinfo, item, &dlms_ei.no_success);
+            }
+            if (!visited) {
+                association->result = value;
+                association->accepted = value == 0;
+            }
+        } else if (is_aare && tag == 0xa3) { /* result-source-diagnostic */
+            unsigned choice = tvb_get_guint8(tvb, offset);
+            dlms_get_ber_inner(tvb, offset, &inner_offset); /* acse-service-user or acse-service-provider */
+            dlms_get_ber_inner(tvb, inner_offset, &inner_offset); /* INTEGER */
+            proto_tree_add_item(tree, choice == 0xa1 ? &dlms_hfi.acse_service_user : &dlms_hfi.acse_service_provider,
+                                tvb, inner_offset, 1, ENC_NA);
+        } else if (is_aare && tag == 0xa4) { /* responding-AP-title */
+            inner_length = dlms_get_ber_inner(tvb, offset, &inner_offset);
+            proto_tree_add_item(tree, &dlms_hfi.responding_ap_title, tvb, inner_offset, inner_length, ENC_NA);
+            if (!visited) {
+                association->responding_ap_title = dlms_get_ap_title(tvb, inner_offset, inner_length);
+            }
+        } else if (is_aare && tag == 0xa5) { /* responding-AE-qualifier */
+            inner_length = dlms_get_ber_inner(tvb, offset, &inner_offset);
+            proto_tree_add_item(tree, &dlms_hfi.responding_ae_qualifier, tvb, inner_offset, inner_length, ENC_NA);
+        } else { /* AP/AE invocation identifiers, and fields unknown to this dissector */
+            item = proto_tree_add_item(tree, &dlms_hfi.acse_field, tvb, field_offset, offset - field_offset + length, ENC_NA);
+            proto_item_append_text(item, " (tag 0x%02x)", tag);
+        }
+        offset += length;
+    }
+}
+
+static void
+dlms_dissect_aarq(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    col_set_str(pinfo->cinfo, COL_INFO, "AARQ");
+    dlms_dissect_aarq_aare(tvb, pinfo, tree, offset, 0);
+}
+
+static void
+dlms_dissect_aare(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    col_set_str(pinfo->cinfo, COL_INFO, "AARE");
+    dlms_dissect_aarq_aare(tvb, pinfo, tree, offset, 1);
+}
+
+/* Methods of the image transfer class (18) */
+#define DLMS_IMAGE_TRANSFER_CLASS 18
+#define DLMS_IMAGE_TRANSFER_INITIATE 1
+#define DLMS_IMAGE_BLOCK_TRANSFER 2
+#define DLMS_IMAGE_VERIFY 3
+#define DLMS_IMAGE_ACTIVATE 4
+
+/* Number of blocks of the image of a session (0 if not known yet) */
+static guint32
+dlms_image_blocks(const dlms_image_session *session)
+{
+    if (!session->image_size || !session->block_size) {
+        return 0;
+    }
+    return (guint32)(((guint64)session->image_size + session->block_size - 1) / session->block_size);
+}
+
+/* Format the ranges of the block numbers of the image that were not transferred */
+static const gchar *
+dlms_image_missing_blocks(const dlms_image_session *session)
+{
+    wmem_strbuf_t *ranges;
+    guint32 total, blocks, first, i;
+
+    total = dlms_image_blocks(session);
+    blocks = MIN(total, session->bitmap_blocks);
+    ranges = wmem_strbuf_sized_new(wmem_file_scope(), 0, ITEM_LABEL_LENGTH);
+    for (i = 0; i < blocks; i++) {
+        if (session->transferred[i / 8] & (1 << (i % 8))) {
+            continue;
+        }
+        first = i;
+        while (i + 1 < blocks && !(session->transferred[(i + 1) / 8] & (1 << ((i + 1) % 8)))) {
+            i++;
+        }
+        if (wmem_strbuf_get_len(ranges)) {
+            wmem_strbuf_append_c(ranges, ',');
+        }
+        if (first == i) {
+            wmem_strbuf_append_printf(ranges, "%u", first);
+        } else {
+            wmem_strbuf_append_printf(ranges, "%u-%u", first, i);
+        }
+    }
+    if (total > blocks) { /* none of the blocks past the bitmap was transferred */
+        if (wmem_strbuf_get_len(ranges)) {
+            wmem_strbuf_append_c(ranges, ',');
+        }
+        wmem_strbuf_append_printf(ranges, "%u-%u", blocks, total - 1);
+    }
+
+    return wmem_strbuf_finalize(ranges);
+}
+
+/* Mark a block as transferred, and tell whether it was already (first pass only) */
+static gboolean
+dlms_image_mark_block(dlms_image_session *session, guint32 block_number)
+{
+    guint32 bitmap_blocks;
+    guint8 mask;
+
+    if (block_number >= DLMS_IMAGE_MAX_BLOCKS) {
+        return FALSE;
+    }
+    if (block_number >= session->bitmap_blocks) {
+        bitmap_blocks = MAX(MAX(session->bitmap_blocks * 2, 1024), (block_number + 8) & ~7u);
+        bitmap_blocks = (MIN(MAX(bitmap_blocks, dlms_image_blocks(session)), DLMS_IMAGE_MAX_BLOCKS) + 7) & ~7u;
+        session->transferred = (guint8 *)wmem_realloc(wmem_file_scope(), session->transferred, bitmap_blocks / 8);
+        session->retransmitted = (guint8 *)wmem_realloc(wmem_file_scope(), session->retransmitted, bitmap_blocks / 8);
+        memset(session->transferred + session->bitmap_blocks / 8, 0, (bitmap_blocks - session->bitmap_blocks) / 8);
+        memset(session->retransmitted + session->bitmap_blocks / 8, 0, (bitmap_blocks - session->bitmap_blocks) / 8);
+        session->bitmap_blocks = bitmap_blocks;
+    }
+    mask = (guint8)(1 << (block_number % 8));
+    if (session->transferred[block_number / 8] & mask) {
+        session->retransmitted[block_number / 8] |= mask;
+        return TRUE;
+    }
+    session->transferred[block_number / 8] |= mask;
+
+    return FALSE;
+}
+
+/* Record the state of a session in the image transfer analysis of the current frame (first pass only) */
+static dlms_image_result *
+dlms_image_add_result(dlms_frame_data *fd, const dlms_image_session *session, guint32 flags)
+{
+    dlms_image_result *result;
+    nstime_t elapsed;
+    double seconds;
+    guint32 blocks;
+
+    result = wmem_new0(wmem_file_scope(), dlms_image_result);
+    result->session = session;
+    result->flags = flags;
+    result->image_size = session->image_size;
+    result->block_size = session->block_size;
+    result->blocks_sent = session->blocks_sent;
+    result->blocks = session->blocks;
+    result->retransmissions = session->retransmissions;
+    blocks = dlms_image_blocks(session);
+    result->missing = blocks > session->blocks ? blocks - session->blocks : 0;
+    nstime_delta(&elapsed, &fd->time, &session->start);
+    seconds = nstime_to_sec(&elapsed);
+    if (seconds > 0) {
+        result->throughput = (guint32)(session->bytes / seconds);
+    }
+    fd->image = result;
+
+    return result;
+}
+
+/*
+ * Track an image transfer action request of the current frame (first pass only),
+ * with the method parameters (if any) at data_offset.
+ */
+static void
+dlms_track_image_request(tvbuff_t *tvb, packet_info *pinfo, guint32 class_id, guint32 method, gint data_offset)
+{
+    dlms_packet_info *pi;
+    dlms_association *association;
+    dlms_frame_data *fd;
+    dlms_image_session *session, *previous;
+    dlms_image_result *result;
+    const guint8 *data;
+    size_t size, position;
+    guint32 length, block_number;
+
+    pi = dlms_get_packet_info(pinfo);
+    association = dlms_get_association(pinfo, pi);
+    fd = pi->frame_data;
+    if (PINFO_FD_VISITED(pinfo) || !fd || !association->meter || class_id != DLMS_IMAGE_TRANSFER_CLASS) {
+        return;
+    }
+    data = dlms_get_data(tvb, &size);
+    previous = (dlms_image_session *)wmem_map_lookup(dlms_image_sessions, association->meter);
+    session = previous;
+
+    if (method == DLMS_IMAGE_TRANSFER_INITIATE || (method == DLMS_IMAGE_BLOCK_TRANSFER && !session)) {
+        session = wmem_new0(wmem_file_scope(), dlms_image_session);
+        session->meter = association->meter;
+        session->number = previous ? previous->number + 1 : 1;
+        session->start = fd->time;
+        wmem_map_insert(dlms_image_sessions, association->meter, session);
+    }
+    if (!session) {
+        return;
+    }
+
+    switch (method) {
+    case DLMS_IMAGE_TRANSFER_INITIATE: /* structure { image_identifier octet-string, image_size double-long-unsigned } */
+        position = data_offset + 3;
+        if (data_offset >= 0 && position < size && data[data_offset] == 2 && data[data_offset + 1] == 2
+            && data[data_offset + 2] == 9 && dlms_core_get_length(data, size, &position, &length) == DLMS_CORE_OK
+            && position + length + 5 <= size && data[position + length] == 6) {
+            session->image_size = tvb_get_ntohl(tvb, (gint)(position + length + 1));
+        }
+        dlms_image_add_result(fd, session, 0);
+        break;
+    case DLMS_IMAGE_BLOCK_TRANSFER: /* structure { image_block_number double-long-unsigned, image_block_value octet-string } */
+        position = data_offset + 8;
+        if (data_offset < 0 || position > size || data[data_offset] != 2 || data[data_offset + 1] != 2
+            || data[data_offset + 2] != 6 || data[data_offset + 7] != 9
+            || dlms_core_get_length(data, size, &position, &length) != DLMS_CORE_OK) {
+            return;
+        }
+        block_number = tvb_get_ntohl(tvb, data_offset + 3);
+        session->block_size = MAX(session->block_size, length);
+        session->blocks_sent++;
+        if (dlms_image_mark_block(session, block_number)) {
+            session->retransmissions++;
+            result = dlms_image_add_result(fd, session, DLMS_IMAGE_BLOCK | DLMS_IMAGE_RETRANSMISSION);
+        } else {
+            session->blocks++;
+            session->bytes += length;
+            result = dlms_image_add_result(fd, session, DLMS_IMAGE_BLOCK);
+        }
+        result->block_number = block_number;
+        break;
+    case DLMS_IMAGE_VERIFY:
+    case DLMS_IMAGE_ACTIVATE:
+        if (method == DLMS_IMAGE_VERIFY) {
+            if (!session->verify_frame) {
+                session->verify_start = fd->time;
+            }
+            session->verify_frame = fd->frame;
+        } else {
+            if (!session->activate_frame) {
+                session->activate_start = fd->time;
+            }
+            session->activate_frame = fd->frame;
+        }
+        result = dlms_image_add_result(fd, session,
+                                       method == DLMS_IMAGE_VERIFY ? DLMS_IMAGE_VERIFY_REQUEST : DLMS_IMAGE_ACTIVATE_REQUEST);
+        result->missing_blocks = dlms_image_missing_blocks(session);
+        break;
+    }
+}
+
+/* Track the response to an image_verify or image_activate request (first pass only) */
+static void
+dlms_track_image_response(packet_info *pinfo, unsigned action_result)
+{
+    dlms_packet_info *pi;
+    dlms_frame_data *fd;
+    dlms_image_session *session;
+    dlms_image_result *result;
+
+    pi = dlms_get_packet_info(pinfo);
+    fd = pi->frame_data;
+    if (PINFO_FD_VISITED(pinfo) || !fd || !fd->request_frame || action_result != 0
+        || !pi->association || !pi->association->meter) {
+        return;
+    }
+    session = (dlms_image_session *)wmem_map_lookup(dlms_image_sessions, pi->association->meter);
+    if (!session) {
+        return;
+    }
+    if (fd->request_frame == session->verify_frame && !session->verified) {
+        session->verified = TRUE;
+        result = dlms_image_add_result(fd, session, DLMS_IMAGE_VERIFIED);
+        nstime_delta(&result->duration, &fd->time, &session->verify_start);
+    } else if (fd->request_frame == session->activate_frame && !session->activated) {
+        session->activated = TRUE;
+        result = dlms_image_add_result(fd, session, DLMS_IMAGE_ACTIVATED);
+        nstime_delta(&result->duration, &fd->time, &session->activate_start);
+    }
+}
+
+/* Add the image transfer analysis of the current frame (if any) to the tree */
+static void
+dlms_dissect_image_result(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+    const dlms_packet_info *pi;
+    const dlms_image_result *result;
+    proto_tree *subtree;
+    proto_item *item;
+
+    pi = dlms_get_packet_info(pinfo);
+    result = pi->frame_data ? pi->frame_data->image : 0;
+    if (!result) {
+        return;
+    }
+
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.image, &item, "Image Transfer Analysis");
+    PROTO_ITEM_SET_GENERATED(item);
+    item = proto_tree_add_uint(subtree, &dlms_hfi.image_session, tvb, 0, 0, result->session->number);
+    PROTO_ITEM_SET_GENERATED(item);
+    if (result->flags & DLMS_IMAGE_BLOCK) {
+        item = proto_tree_add_uint(subtree, &dlms_hfi.image_block_number, tvb, 0, 0, result->block_number);
+        PROTO_ITEM_SET_GENERATED(item);
+        if (result->flags & DLMS_IMAGE_RETRANSMISSION) {
+            expert_add_info(pinfo, item, &dlms_ei.image_retransmission);
+        }
+    }
+    if (result->image_size) {
+        item = proto_tree_add_uint(subtree, &dlms_hfi.image_size, tvb, 0, 0, result->image_size);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+    if (result->block_size) {
+        item = proto_tree_add_uint(subtree, &dlms_hfi.image_block_size, tvb, 0, 0, result->block_size);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+    item = proto_tree_add_uint(subtree, &dlms_hfi.image_blocks_sent, tvb, 0, 0, result->blocks_sent);
+    PROTO_ITEM_SET_GENERATED(item);
+    item = proto_tree_add_uint(subtree, &dlms_hfi.image_blocks, tvb, 0, 0, result->blocks);
+    PROTO_ITEM_SET_GENERATED(item);
+    item = proto_tree_add_uint(subtree, &dlms_hfi.image_retransmissions, tvb, 0, 0, result->retransmissions);
+    PROTO_ITEM_SET_GENERATED(item);
+    item = proto_tree_add_uint(subtree, &dlms_hfi.image_missing, tvb, 0, 0, result->missing);
+    PROTO_ITEM_SET_GENERATED(item);
+    if (result->missing && (result->flags & (DLMS_IMAGE_VERIFY_REQUEST | DLMS_IMAGE_ACTIVATE_REQUEST))) {
+        expert_add_info_format(pinfo, item, &dlms_ei.image_missing, "%u image blocks were not transferred", result->missing);
+    }
+    if (result->missing_blocks && *result->missing_blocks) {
+        item = proto_tree_add_string(subtree, &dlms_hfi.image_missing_blocks, tvb, 0, 0, result->missing_blocks);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+    item = proto_tree_add_uint_format_value(subtree, &dlms_hfi.image_throughput, tvb, 0, 0, result->throughput,
+                                            "%u bytes/s", result->throughput);
+    PROTO_ITEM_SET_GENERATED(item);
+    if (result->flags & (DLMS_IMAGE_VERIFIED | DLMS_IMAGE_ACTIVATED)) {
+        item = proto_tree_add_time(subtree,
+                                   result->flags & DLMS_IMAGE_VERIFIED ? &dlms_hfi.image_verify_time : &dlms_hfi.image_activate_time,
+                                   tvb, 0, 0, &result->duration);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+}
+
+static void
+dlms_dissect_get_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    proto_tree_add_item(tree, &dlms_hfi.get_request, tvb, offset, 1, ENC_NA);
+    offset += 1;
+    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+    if (service.service == DLMS_GET_REQUEST_NORMAL) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Get-Request-Normal");
+        dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, tree, &offset);
+        dlms_dissect_selective_access_descriptor(tvb, pinfo, tree, &offset);
+    } else if (service.service == DLMS_GET_REQUEST_NEXT) {
+        proto_tree_add_item(tree, &dlms_hfi.block_number, tvb, (gint)service.block_number_offset, 4, ENC_BIG_ENDIAN);
+        col_add_fstr(pinfo->cinfo, COL_INFO, "Get-Request-Next (block %u)", service.block_number);
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Get-Request");
+    }
+}
+
+static void
+dlms_dissect_set_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+    proto_tree *subtree;
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    proto_tree_add_item(tree, &dlms_hfi.set_request, tvb, offset, 1, ENC_NA);
+    offset += 1;
+    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+    if (service.service == DLMS_SET_REQUEST_NORMAL) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Set-Request-Normal");
+        dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, tree, &offset);
+        dlms_dissect_selective_access_descriptor(tvb, pinfo, tree, &offset);
+        subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Data");
+        dlms_dissect_class_value(tvb, pinfo, subtree, &offset, dlms_get_packet_info(pinfo)->descriptor);
+    } else if (service.service == DLMS_SET_REQUEST_WITH_FIRST_DATABLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Set-Request-With-First-Datablock");
+        dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, tree, &offset);
+        dlms_dissect_selective_access_descriptor(tvb, pinfo, tree, &offset);
+        dlms_dissect_datablock_sa(tvb, pinfo, tree, &offset);
+    } else if (service.service == DLMS_SET_REQUEST_WITH_DATABLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Set-Request-With-Datablock");
+        dlms_dissect_datablock_sa(tvb, pinfo, tree, &offset);
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Set-Request");
+    }
+}
+
+static void
+dlms_dissect_event_notification_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+    proto_tree *subtree;
+
+    col_add_str(pinfo->cinfo, COL_INFO, "Event-Notification-Request");
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    dlms_check_status(tvb, status);
+
+    /* time OCTET STRING OPTIONAL */
+    if (service.has_date_time) {
+        dlms_dissect_service_date_time(tvb, tree, &service);
+        dlms_track_push(tvb, pinfo, (gint)service.date_time_contents_offset, service.date_time_length);
+    } else {
+        dlms_track_push(tvb, pinfo, -1, 0);
+    }
+    dlms_dissect_push_result(tvb, pinfo, tree);
+
+    offset = (gint)service.descriptor.offset;
+    dlms_dissect_cosem_attribute_descriptor(tvb, pinfo, tree, &offset);
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Data");
+    dlms_dissect_class_value(tvb, pinfo, subtree, &offset, dlms_get_packet_info(pinfo)->descriptor);
+}
+
+/*
+ * Dissect a pblock (DataBlock-SA) of an action request or response, which
+ * starts a transfer if first is set. The method parameters of a request
+ * of a single method are tracked once they are reassembled.
+ */
+static void
+dlms_dissect_pblock(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset, int direction, unsigned invoke_id,
+                    gboolean first, gboolean is_list, guint32 class_id, guint32 method_id)
+{
+    dlms_packet_info *pi;
+    dlms_association *association;
+    proto_tree *subtree;
+    dlms_core_block block;
+    const guint8 *data;
+    size_t size, position;
+    int status;
+    tvbuff_t *rtvb;
+
+    pi = dlms_get_packet_info(pinfo);
+    association = dlms_get_association(pinfo, pi);
+
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.datablock, 0, "Pblock");
+    data = dlms_get_data(tvb, &size);
+    position = *offset;
+    status = dlms_core_parse_datablock_sa(data, size, &position, &block);
+    proto_tree_add_item(subtree, &dlms_hfi.last_block, tvb, *offset, 1, ENC_NA);
+    proto_tree_add_item(subtree, &dlms_hfi.block_number, tvb, *offset + 1, 4, ENC_BIG_ENDIAN);
+    dlms_check_status(tvb, status);
+
+    if (!PINFO_FD_VISITED(pinfo)) {
+        if (first) {
+            association->pblocks[direction][invoke_id].list = is_list;
+            association->pblocks[direction][invoke_id].class_id = class_id;
+            association->pblocks[direction][invoke_id].method_id = method_id;
+        }
+        if (block.last_block && pi->frame_data) {
+            pi->frame_data->pblock_list = association->pblocks[direction][invoke_id].list;
+        }
+    }
+    is_list = pi->frame_data && pi->frame_data->pblock_list;
+
+    rtvb = dlms_dissect_datablock_data(tvb, pinfo, tree, subtree, &block, DLMS_TRANSFER_PBLOCK,
+                                       &association->pblocks[direction][invoke_id].key, is_list);
+    if (rtvb && direction == DLMS_PBLOCK_REQUEST && !is_list) {
+        dlms_track_image_request(rtvb, pinfo, association->pblocks[direction][invoke_id].class_id,
+                                 association->pblocks[direction][invoke_id].method_id, 0);
+        dlms_dissect_image_result(tvb, pinfo, tree);
+    }
+    *offset = (gint)position;
+}
+
+/* Dissect a list of COSEM method descriptors */
+static void
+dlms_dissect_cosem_method_descriptor_list(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    proto_item *item;
+    proto_tree *subtree;
+    int sequence_of, i;
+
+    subtree = proto_tree_add_subtree(tree, tvb, *offset, 0, dlms_ett.cosem_attribute_or_method_descriptor, &item,
+                                     "COSEM Method Descriptor List");
+    sequence_of = dlms_get_length(tvb, offset);
+    for (i = 0; i < sequence_of; i++) {
+        dlms_dissect_cosem_method_descriptor(tvb, pinfo, subtree, offset);
+    }
+    proto_item_set_end(item, tvb, *offset);
+}
+
+static void
+dlms_dissect_action_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+    gint data_offset;
+    unsigned invoke_id;
+    proto_tree *subtree;
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    proto_tree_add_item(tree, &dlms_hfi.action_request, tvb, offset, 1, ENC_NA);
+    offset += 1;
+    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+    invoke_id = service.invoke_id & 0x0f;
+    if (service.service == DLMS_ACTION_REQUEST_NORMAL) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Action-Request-Normal");
+        dlms_dissect_cosem_method_descriptor(tvb, pinfo, tree, &offset);
+        data_offset = -1;
+        if (service.has_data) {
+            offset = data_offset = (gint)service.data_offset;
+            subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Data");
+            dlms_dissect_class_value(tvb, pinfo, subtree, &offset, dlms_get_packet_info(pinfo)->descriptor);
+        }
+        dlms_track_image_request(tvb, pinfo, service.descriptor.class_id, service.descriptor.member_id, data_offset);
+        dlms_dissect_image_result(tvb, pinfo, tree);
+    } else if (service.service == DLMS_ACTION_REQUEST_NEXT_PBLOCK) {
+        proto_tree_add_item(tree, &dlms_hfi.block_number, tvb, (gint)service.block_number_offset, 4, ENC_BIG_ENDIAN);
+        col_add_fstr(pinfo->cinfo, COL_INFO, "Action-Request-Next-Pblock (block %u)", service.block_number);
+    } else if (service.service == DLMS_ACTION_REQUEST_WITH_LIST) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Action-Request-With-List");
+        dlms_dissect_cosem_method_descriptor_list(tvb, pinfo, tree, &offset);
+        dlms_dissect_list_of_data(tvb, pinfo, tree, &offset, "Method Invocation Parameters");
+    } else if (service.service == DLMS_ACTION_REQUEST_WITH_FIRST_PBLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Action-Request-With-First-Pblock");
+        dlms_dissect_cosem_method_descriptor(tvb, pinfo, tree, &offset);
+        dlms_dissect_pblock(tvb, pinfo, tree, &offset, DLMS_PBLOCK_REQUEST, invoke_id, TRUE, FALSE,
+                            service.descriptor.class_id, service.descriptor.member_id);
+    } else if (service.service == DLMS_ACTION_REQUEST_WITH_LIST_AND_FIRST_PBLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Action-Request-With-List-And-First-Pblock");
+        dlms_dissect_cosem_method_descriptor_list(tvb, pinfo, tree, &offset);
+        dlms_dissect_pblock(tvb, pinfo, tree, &offset, DLMS_PBLOCK_REQUEST, invoke_id, TRUE, TRUE, 0, 0);
+    } else if (service.service == DLMS_ACTION_REQUEST_WITH_PBLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Action-Request-With-Pblock");
+        dlms_dissect_pblock(tvb, pinfo, tree, &offset, DLMS_PBLOCK_REQUEST, invoke_id, FALSE, FALSE, 0, 0);
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Action-Request");
+    }
+}
+
+static void
+dlms_dissect_get_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+    proto_tree *subtree;
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    proto_tree_add_item(tree, &dlms_hfi.get_response, tvb, offset, 1, ENC_NA);
+    offset += 1;
+    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+    if (service.service == DLMS_GET_RESPONSE_NORMAL) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Get-Response-Normal");
+        if (service.has_data) {
+            offset = (gint)service.data_offset;
+            subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Data");
+            dlms_dissect_class_value(tvb, pinfo, subtree, &offset, dlms_get_request_descriptor(pinfo));
+        } else if (service.has_data_access_result) {
+            offset = (gint)service.data_access_result_offset;
+            dlms_dissect_data_access_result(tvb, pinfo, tree, &offset);
+        }
+    } else if (service.service == DLMS_GET_RESPONSE_WITH_DATABLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Get-Response-With-Datablock");
+        dlms_dissect_datablock_g(tvb, pinfo, tree, &offset);
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Get-Response");
+    }
+}
+
+static void
+dlms_dissect_set_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    proto_tree_add_item(tree, &dlms_hfi.set_response, tvb, offset, 1, ENC_NA);
+    offset += 1;
+    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+    if (service.service == DLMS_SET_RESPONSE_NORMAL) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Set-Response-Normal");
+    } else if (service.service == DLMS_SET_RESPONSE_DATABLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Set-Response-Datablock");
+    } else if (service.service == DLMS_SET_RESPONSE_LAST_DATABLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Set-Response-Last-Datablock");
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Set-Response");
+    }
+    if (service.has_data_access_result) {
+        offset = (gint)service.data_access_result_offset;
+        dlms_dissect_data_access_result(tvb, pinfo, tree, &offset);
+    }
+    if (service.has_block_number) {
+        proto_tree_add_item(tree, &dlms_hfi.block_number, tvb, (gint)service.block_number_offset, 4, ENC_BIG_ENDIAN);
+        col_append_fstr(pinfo->cinfo, COL_INFO, " (block %u)", service.block_number);
+    }
+}
+
+/*
+ * Dissect an Action-Response-With-Optional-Data, and return its result.
+ * The descriptor is that of the method, if known.
+ */
+static unsigned
+dlms_dissect_action_response_with_optional_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset,
+                                                const dlms_descriptor_text *descriptor)
+{
+    dlms_core_service service;
+    const guint8 *data;
+    size_t size, position;
+    int status;
+    const gchar *result_name;
+    proto_item *item;
+    proto_tree *subtree;
+
+    memset(&service, 0, sizeof service);
+    data = dlms_get_data(tvb, &size);
+    position = *offset;
+    status = dlms_core_parse_action_response_with_optional_data(data, size, &position, &service);
+    item = proto_tree_add_item(tree, &dlms_hfi.action_result, tvb, *offset, 1, ENC_NA);
+    dlms_check_status(tvb, status);
+    if (service.action_result) {
+        result_name = val_to_str_const(service.action_result, dlms_action_result_names, "unknown");
+        col_append_fstr(pinfo->cinfo, COL_INFO, " (%s)", result_name);
+        expert_add_info(pinfo, item, &dlms_ei.no_success);
+    }
+    if (service.has_data) {
+        *offset = (gint)service.data_offset;
+        subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.data, 0, "Return Parameters");
+        dlms_dissect_class_value(tvb, pinfo, subtree, offset, descriptor);
+        return service.action_result;
+    }
+    if (service.has_data_access_result) {
+        *offset = (gint)service.data_access_result_offset;
+        dlms_dissect_data_access_result(tvb, pinfo, tree, offset);
+    }
+    *offset = (gint)position;
+
+    return service.action_result;
+}
+
+static void
+dlms_dissect_action_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+    unsigned result, invoke_id;
+    proto_item *item;
+    proto_tree *subtree;
+    int sequence_of, i;
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    proto_tree_add_item(tree, &dlms_hfi.action_response, tvb, offset, 1, ENC_NA);
+    offset += 1;
+    dlms_dissect_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+    invoke_id = service.invoke_id & 0x0f;
+    if (service.service == DLMS_ACTION_RESPONSE_NORMAL) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Action-Response-Normal");
+        result = dlms_dissect_action_response_with_optional_data(tvb, pinfo, tree, &offset,
+                                                                 dlms_get_request_descriptor(pinfo));
+        dlms_track_image_response(pinfo, result);
+        dlms_dissect_image_result(tvb, pinfo, tree);
+    } else if (service.service == DLMS_ACTION_RESPONSE_WITH_PBLOCK) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Action-Response-With-Pblock");
+        dlms_dissect_pblock(tvb, pinfo, tree, &offset, DLMS_PBLOCK_RESPONSE, invoke_id,
+                            tvb_get_ntohl(tvb, offset + 1) == 1, FALSE, 0, 0);
+    } else if (service.service == DLMS_ACTION_RESPONSE_WITH_LIST) {
+        col_add_str(pinfo->cinfo, COL_INFO, "Action-Response-With-List");
+        subtree = proto_tree_add_subtree(tree, tvb, offset, 0, dlms_ett.data, &item, "List Of Responses");
+        sequence_of = dlms_get_length(tvb, &offset);
+        for (i = 0; i < sequence_of; i++) {
+            dlms_dissect_action_response_with_optional_data(tvb, pinfo, subtree, &offset, 0);
+        }
+        proto_item_set_end(item, tvb, offset);
+    } else if (service.service == DLMS_ACTION_RESPONSE_NEXT_PBLOCK) {
+        proto_tree_add_item(tree, &dlms_hfi.block_number, tvb, (gint)service.block_number_offset, 4, ENC_BIG_ENDIAN);
+        col_add_fstr(pinfo->cinfo, COL_INFO, "Action-Response-Next-Pblock (block %u)", service.block_number);
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Action-Response");
+    }
+}
+
+static void
+dlms_dissect_exception_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    proto_item *item;
+
+    col_set_str(pinfo->cinfo, COL_INFO, "Exception-Response");
+    item = proto_tree_add_item(tree, &dlms_hfi.state_error, tvb, offset, 1, ENC_NA);
+    expert_add_info(pinfo, item, &dlms_ei.no_success);
+    item = proto_tree_add_item(tree, &dlms_hfi.service_error, tvb, offset + 1, 1, ENC_NA);
+    expert_add_info(pinfo, item, &dlms_ei.no_success);
+}
+
+static void
+dlms_dissect_access_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+
+    col_set_str(pinfo->cinfo, COL_INFO, "Access-Request");
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    dlms_dissect_long_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+
+    dlms_dissect_service_date_time(tvb, tree, &service);
+    offset = (gint)service.offset;
+
+    dlms_dissect_access_request_specification(tvb, pinfo, tree, &offset);
+
+    dlms_dissect_list_of_data(tvb, pinfo, tree, &offset, "Access Request List Of Data");
+}
+
+static void
+dlms_dissect_access_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_core_service service;
+    int status;
+    proto_item *item;
+    proto_tree *subtree, *subsubtree;
+    int sequence_of, i;
+
+    col_set_str(pinfo->cinfo, COL_INFO, "Access-Response");
+
+    status = dlms_parse_service(tvb, offset - 1, &service);
+    dlms_dissect_long_invoke_id_and_priority(tree, tvb, &offset);
+    dlms_check_status(tvb, status);
+
+    dlms_dissect_service_date_time(tvb, tree, &service);
+    offset = (gint)service.offset;
+
+    dlms_dissect_access_request_specification(tvb, pinfo, tree, &offset);
+
+    dlms_dissect_list_of_data(tvb, pinfo, tree, &offset, "Access Response List Of Data");
+
+    subtree = proto_tree_add_subtree(tree, tvb, offset, 0, dlms_ett.access_response_specification, 0, "Access Response Specification");
+    sequence_of = dlms_get_length(tvb, &offset);
+    for (i = 0; i < sequence_of; i++) {
+        item = proto_tree_add_item(subtree, &dlms_hfi.access_response, tvb, offset, 1, ENC_NA);
+        proto_item_prepend_text(item, "[%u] ", i + 1);
+        subsubtree = proto_item_add_subtree(item, dlms_ett.access_request);
+        offset += 1;
+        dlms_dissect_data_access_result(tvb, pinfo, subsubtree, &offset);
+    }
+}
+
+/* Context of the data visitor that collects the entries of an SN object_list */
+struct dlms_sn_object_list_context {
+    const guint8 *data;
+    wmem_array_t *objects; /* dlms_sn_object */
+    dlms_sn_object object; /* entry being collected */
+    guint fields; /* fields of the entry collected so far */
+};
+typedef struct dlms_sn_object_list_context dlms_sn_object_list_context;
+
+static void *
+dlms_sn_object_list_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    dlms_sn_object_list_context *c = (dlms_sn_object_list_context *)context;
+
+    if (d->depth == 1) {
+        memset(&c->object, 0, sizeof c->object);
+        c->fields = 0;
+    } else if (d->depth == 2) {
+        c->fields = 5; /* not an object_list entry */
+    }
+    return parent;
+}
+
+static void
+dlms_sn_object_list_end(void *context, void *parent _U_, void *element_parent _U_, const dlms_core_data *d)
+{
+    dlms_sn_object_list_context *c = (dlms_sn_object_list_context *)context;
+
+    if (d->depth == 1 && c->fields == 4) {
+        wmem_array_append_one(c->objects, c->object);
+    }
+}
+
+/* Collect the base_name, class_id, version and logical_name of an object_list entry */
+static void
+dlms_sn_object_list_value(void *context, void *parent _U_, const dlms_core_data *d)
+{
+    dlms_sn_object_list_context *c = (dlms_sn_object_list_context *)context;
+    const guint8 *p;
+
+    if (d->depth != 2) {
+        return;
+    }
+    if (c->fields == 0) {
+        c->object.base_name = (guint32)d->value.i & 0xffff;
+    } else if (c->fields == 1) {
+        c->object.class_id = (guint32)d->value.u;
+    } else if (c->fields == 3 && d->length == 6) {
+        p = c->data + d->contents_offset;
+        c->object.logical_name = ((guint64)p[0] << 40) | ((guint64)p[1] << 32) | ((guint64)p[2] << 24)
+                               | ((guint64)p[3] << 16) | ((guint64)p[4] << 8) | p[5];
+    } else if (c->fields == 3) {
+        c->fields = 5; /* not an OBIS code, so the entry is left out */
+    }
+    c->fields++;
+}
+
+static int
+dlms_sn_object_compare(const void *a, const void *b)
+{
+    const dlms_sn_object *o1 = (const dlms_sn_object *)a;
+    const dlms_sn_object *o2 = (const dlms_sn_object *)b;
+
+    return o1->base_name < o2->base_name ? -1 : o1->base_name > o2->base_name;
+}
+
+/*
+ * Learn the object list of the meter from the object_list attribute value
+ * at offset, when the client is reading it (first pass only)
+ */
+static void
+dlms_learn_sn_object_list(tvbuff_t *tvb, packet_info *pinfo, gint offset)
+{
+    static const dlms_core_data_visitor visitor = {
+        dlms_sn_object_list_begin, dlms_sn_object_list_end, dlms_sn_object_list_value
+    };
+    dlms_association *association;
+    dlms_sn_object_list_context c;
+    dlms_sn_objects *objects;
+    size_t size, position;
+
+    association = dlms_get_association(pinfo, dlms_get_packet_info(pinfo));
+    if (PINFO_FD_VISITED(pinfo) || !association->sn_object_list_pending || !association->meter) {
+        return;
+    }
+    association->sn_object_list_pending = FALSE;
+
+    c.data = dlms_get_data(tvb, &size);
+    c.objects = wmem_array_new(wmem_file_scope(), sizeof(dlms_sn_object));
+    c.fields = 0;
+    position = offset;
+    if (dlms_core_parse_data(c.data, size, &position, &visitor, &c, 0) != DLMS_CORE_OK) {
+        return;
+    }
+
+    objects = wmem_new(wmem_file_scope(), dlms_sn_objects);
+    objects->count = wmem_array_get_count(c.objects);
+    objects->objects = (const dlms_sn_object *)wmem_array_get_raw(c.objects);
+    qsort((void *)objects->objects, objects->count, sizeof(dlms_sn_object), dlms_sn_object_compare);
+    wmem_map_insert(dlms_sn_object_lists, association->meter, objects);
+}
+
+/* Find the object with the highest base name up to a variable name, by binary search */
+static const dlms_sn_object *
+dlms_find_sn_object(const dlms_sn_objects *objects, guint32 name)
+{
+    guint low, high, middle;
+
+    low = 0;
+    high = objects->count;
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (objects->objects[middle].base_name <= name) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low ? &objects->objects[low - 1] : 0;
+}
+
+/*
+ * Get the texts of the attribute that the variable name at offset refers to,
+ * resolved with the object list of the meter known at the first pass,
+ * or 0 if it cannot be resolved. The variable names of the methods follow
+ * those of the attributes at offsets that are specific to each class,
+ * so they appear as the attributes past the last one.
+ */
+static const dlms_descriptor_text *
+dlms_get_sn_descriptor_text(tvbuff_t *tvb, packet_info *pinfo, gint offset)
+{
+    dlms_association *association;
+    const dlms_sn_objects *objects;
+    const dlms_sn_object *object;
+    const dlms_descriptor_text *text;
+    dlms_descriptor_key key;
+    guint32 name, attribute;
+
+    if (dlms_get_cached_descriptor_text(pinfo, &text)) {
+        return text;
+    }
+
+    text = 0;
+    association = dlms_get_association(pinfo, dlms_get_packet_info(pinfo));
+    objects = association->meter
+        ? (const dlms_sn_objects *)wmem_map_lookup(dlms_sn_object_lists, association->meter)
+        : 0;
+    name = tvb_get_ntohs(tvb, offset);
+    object = objects ? dlms_find_sn_object(objects, name) : 0;
+    if (object && (name - object->base_name) % 8 == 0) {
+        attribute = (name - object->base_name) / 8 + 1;
+        if (attribute < 0x100) {
+            key.class_instance = ((guint64)object->class_id << 48) | object->logical_name;
+            key.member = attribute;
+            text = dlms_find_descriptor_text(&key);
+        }
+    }
+    dlms_cache_descriptor_text(pinfo, text);
+
+    return text;
+}
+
+static void
+dlms_dissect_variable_name(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    const dlms_descriptor_text *text;
+    proto_item *item;
+
+    text = dlms_get_sn_descriptor_text(tvb, pinfo, *offset);
+    item = proto_tree_add_item(tree, &dlms_hfi.variable_name, tvb, *offset, 2, ENC_BIG_ENDIAN);
+    if (text) {
+        proto_item_append_text(item, " (%s)", text->info + 1);
+        col_append_str(pinfo->cinfo, COL_INFO, text->info);
+    } else {
+        col_append_fstr(pinfo->cinfo, COL_INFO, " 0x%04x", tvb_get_ntohs(tvb, *offset));
+    }
+    *offset += 2;
+}
+
+/* Dissect the last-block and block-number of a short name block transfer */
+static dlms_core_block
+dlms_dissect_sn_block(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset, gboolean has_data)
+{
+    dlms_core_block block;
+    const guint8 *data;
+    size_t size, position;
+    int status;
+
+    proto_tree_add_item(tree, &dlms_hfi.last_block, tvb, *offset, 1, ENC_NA);
+    proto_tree_add_item(tree, &dlms_hfi.block_number, tvb, *offset + 1, 2, ENC_BIG_ENDIAN);
+    if (!has_data) {
+        memset(&block, 0, sizeof block);
+        block.last_block = tvb_get_guint8(tvb, *offset);
+        block.block_number = tvb_get_ntohs(tvb, *offset + 1);
+        col_append_fstr(pinfo->cinfo, COL_INFO, " (block %u)", block.block_number);
+        *offset += 3;
+        return block;
+    }
+
+    data = dlms_get_data(tvb, &size);
+    position = *offset;
+    status = dlms_core_parse_data_block_result(data, size, &position, &block);
+    dlms_check_status(tvb, status);
+    *offset = (gint)position;
+
+    return block;
+}
+
+static void
+dlms_dissect_variable_access_specification(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint *offset)
+{
+    proto_item *item, *subitem;
+    proto_tree *subtree, *subsubtree;
+    dlms_core_block block;
+    int sequence_of, i, choice;
+
+    subtree = proto_tree_add_subtree(tree, tvb, *offset, 0, dlms_ett.variable_access_specification, &item, "Variable Access Specification");
+    sequence_of = dlms_get_length(tvb, offset);
+    for (i = 0; i < sequence_of; i++) {
+        choice = tvb_get_guint8(tvb, *offset);
+        subitem = proto_tree_add_item(subtree, &dlms_hfi.variable_access_specification, tvb, *offset, 1, ENC_NA);
+        proto_item_prepend_text(subitem, "[%u] ", i + 1);
+        subsubtree = proto_item_add_subtree(subitem, dlms_ett.variable_access_specification);
+        *offset += 1;
+        switch (choice) {
+        case DLMS_VARIABLE_NAME:
+            dlms_dissect_variable_name(tvb, pinfo, subsubtree, offset);
+            break;
+        case DLMS_PARAMETERIZED_ACCESS:
+            dlms_dissect_variable_name(tvb, pinfo, subsubtree, offset);
+            proto_tree_add_item(subsubtree, &dlms_hfi.access_selector, tvb, *offset, 1, ENC_NA);
+            *offset += 1;
+            dlms_dissect_data(tvb, pinfo, subsubtree, offset);
+            break;
+        case DLMS_BLOCK_NUMBER_ACCESS:
+            proto_tree_add_item(subsubtree, &dlms_hfi.block_number, tvb, *offset, 2, ENC_BIG_ENDIAN);
+            col_append_fstr(pinfo->cinfo, COL_INFO, " (block %u)", tvb_get_ntohs(tvb, *offset));
+            *offset += 2;
+            break;
+        case DLMS_READ_DATA_BLOCK_ACCESS:
+            block = dlms_dissect_sn_block(tvb, pinfo, subsubtree, offset, TRUE);
+            dlms_dissect_datablock_data(tvb, pinfo, tree, subsubtree, &block, DLMS_TRANSFER_DATABLOCK, 0, FALSE);
+            break;
+        case DLMS_WRITE_DATA_BLOCK_ACCESS:
+            dlms_dissect_sn_block(tvb, pinfo, subsubtree, offset, FALSE);
+            break;
+        default: /* detailed-access is not used by DLMS/COSEM, so the rest cannot be dissected */
+            THROW(ReportedBoundsError);
+        }
+    }
+    proto_item_set_end(item, tvb, *offset);
+}
+
+static void
+dlms_dissect_read_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_association *association;
+    guint32 object_list_name;
+    int choice;
+
+    col_set_str(pinfo->cinfo, COL_INFO, "Read-Request");
+
+    /* Is the client reading the object list (or asking for its next block)? */
+    association = dlms_get_association(pinfo, dlms_get_packet_info(pinfo));
+    if (!PINFO_FD_VISITED(pinfo) && tvb_get_guint8(tvb, offset) == 1) {
+        choice = tvb_get_guint8(tvb, offset + 1);
+        object_list_name = (association->vaa_name && association->vaa_name != 0x0007
+                            ? association->vaa_name : DLMS_SN_CURRENT_ASSOCIATION) + 8;
+        if (choice == DLMS_VARIABLE_NAME) {
+            association->sn_object_list_pending = tvb_get_ntohs(tvb, offset + 2) == object_list_name;
+        } else if (choice != DLMS_BLOCK_NUMBER_ACCESS) {
+            association->sn_object_list_pending = FALSE;
+        }
+    }
+
+    dlms_dissect_variable_access_specification(tvb, pinfo, tree, &offset);
+}
+
+static void
+dlms_dissect_write_request(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset, const char *name)
+{
+    col_set_str(pinfo->cinfo, COL_INFO, name);
+    dlms_dissect_variable_access_specification(tvb, pinfo, tree, &offset);
+    dlms_dissect_list_of_data(tvb, pinfo, tree, &offset, "List Of Data");
+}
+
+static void
+dlms_dissect_read_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    proto_item *item, *subitem;
+    proto_tree *subtree, *subsubtree;
+    dlms_core_block block;
+    tvbuff_t *rtvb;
+    int sequence_of, i, choice;
+    gint data_offset;
+
+    col_set_str(pinfo->cinfo, COL_INFO, "Read-Response");
+
+    subtree = proto_tree_add_subtree(tree, tvb, offset, 0, dlms_ett.sn_result, &item, "Results");
+    sequence_of = dlms_get_length(tvb, &offset);
+    for (i = 0; i < sequence_of; i++) {
+        choice = tvb_get_guint8(tvb, offset);
+        subitem = proto_tree_add_item(subtree, &dlms_hfi.read_data_result, tvb, offset, 1, ENC_NA);
+        proto_item_prepend_text(subitem, "[%u] ", i + 1);
+        subsubtree = proto_item_add_subtree(subitem, dlms_ett.sn_result);
+        offset += 1;
+        switch (choice) {
+        case DLMS_READ_DATA:
+            data_offset = offset;
+            dlms_dissect_data(tvb, pinfo, subsubtree, &offset);
+            if (sequence_of == 1) {
+                dlms_learn_sn_object_list(tvb, pinfo, data_offset);
+            }
+            break;
+        case DLMS_READ_DATA_ACCESS_ERROR:
+            dlms_dissect_data_access_result(tvb, pinfo, subsubtree, &offset);
+            break;
+        case DLMS_READ_DATA_BLOCK_RESULT:
+            block = dlms_dissect_sn_block(tvb, pinfo, subsubtree, &offset, TRUE);
+            rtvb = dlms_dissect_datablock_data(tvb, pinfo, tree, subsubtree, &block, DLMS_TRANSFER_DATABLOCK, 0, FALSE);
+            if (rtvb && sequence_of == 1) {
+                dlms_learn_sn_object_list(rtvb, pinfo, 0);
+            }
+            break;
+        case DLMS_READ_BLOCK_NUMBER:
+            proto_tree_add_item(subsubtree, &dlms_hfi.block_number, tvb, offset, 2, ENC_BIG_ENDIAN);
+            offset += 2;
+            break;
+        default: /* invalid result CHOICE, so the rest cannot be dissected */
+            THROW(ReportedBoundsError);
+        }
+    }
+    proto_item_set_end(item, tvb, offset);
+}
+
+static void
+dlms_dissect_write_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    proto_item *item;
+    proto_tree *subtree, *subsubtree;
+    int sequence_of, i, choice;
+
+    col_set_str(pinfo->cinfo, COL_INFO, "Write-Response");
+
+    subtree = proto_tree_add_subtree(tree, tvb, offset, 0, dlms_ett.sn_result, 0, "Results");
+    sequence_of = dlms_get_length(tvb, &offset);
+    for (i = 0; i < sequence_of; i++) {
+        choice = tvb_get_guint8(tvb, offset);
+        item = proto_tree_add_item(subtree, &dlms_hfi.write_data_result, tvb, offset, 1, ENC_NA);
+        proto_item_prepend_text(item, "[%u] ", i + 1);
+        subsubtree = proto_item_add_subtree(item, dlms_ett.sn_result);
+        offset += 1;
+        if (choice == DLMS_WRITE_DATA_ACCESS_ERROR) {
+            dlms_dissect_data_access_result(tvb, pinfo, subsubtree, &offset);
+        } else if (choice == DLMS_WRITE_BLOCK_NUMBER) {
+            proto_tree_add_item(subsubtree, &dlms_hfi.block_number, tvb, offset, 2, ENC_BIG_ENDIAN);
+            offset += 2;
+        } else if (choice != DLMS_WRITE_SUCCESS) { /* invalid result CHOICE, so the rest cannot be dissected */
+            THROW(ReportedBoundsError);
+        }
+    }
+}
+
+static void dlms_dissect_apdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset);
+
+static void
+dlms_dissect_general_block_transfer(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    proto_tree *subtree;
+    proto_item *item;
+    dlms_core_block block;
+    const guint8 *data;
+    size_t size, position;
+    int status;
+    dlms_packet_info *pi;
+    fragment_head *frags;
+    tvbuff_t *rtvb;
+
+    data = dlms_get_data(tvb, &size);
+    position = offset;
+    status = dlms_core_parse_general_block_transfer(data, size, &position, &block);
+
+    subtree = proto_tree_add_subtree(tree, tvb, offset, 1, dlms_ett.block_control, 0, "Block Control");
+    proto_tree_add_item(subtree, &dlms_hfi.gbt_last_block, tvb, offset, 1, ENC_NA);
+    proto_tree_add_item(subtree, &dlms_hfi.gbt_streaming, tvb, offset, 1, ENC_NA);
+    proto_tree_add_item(subtree, &dlms_hfi.gbt_window, tvb, offset, 1, ENC_NA);
+    proto_tree_add_item(tree, &dlms_hfi.gbt_block_number, tvb, offset + 1, 2, ENC_BIG_ENDIAN);
+    proto_tree_add_item(tree, &dlms_hfi.gbt_block_number_ack, tvb, offset + 3, 2, ENC_BIG_ENDIAN);
+    dlms_check_status(tvb, status);
+
+    col_add_fstr(pinfo->cinfo, COL_INFO, "General-Block-Transfer (block %u)", block.block_number);
+    if (block.last_block) {
+        col_append_str(pinfo->cinfo, COL_INFO, " (last block)");
+    }
+
+    item = proto_tree_add_item(tree, &dlms_hfi.data, tvb, (gint)block.length_offset,
+                               (gint)(block.data_offset - block.length_offset + block.data_length), ENC_NA);
+    proto_item_append_text(item, " (length %u)", block.data_length);
+    if (block.data_length == 0) {
+        return; /* acknowledgement of a streaming window */
+    }
+
+    dlms_account_block(tvb, pinfo, tree, DLMS_TRANSFER_GBT, block.block_number, block.last_block, block.data_length);
+
+    pi = dlms_get_packet_info(pinfo);
+    frags = dlms_add_fragment(tvb, (gint)block.data_offset, pinfo, tree, DLMS_REASSEMBLY_ID_GBT,
+                              &dlms_get_association(pinfo, pi)->gbt_blocks[dlms_get_side(pinfo, pi)],
+                              block.data_length, block.last_block == 0, block.block_number == 1);
+    rtvb = process_reassembled_data(tvb, (gint)block.data_offset, pinfo, "Reassembled", frags, &dlms_fragment_items, 0, tree);
+    if (rtvb) {
+        dlms_dissect_apdu(rtvb, pinfo, tree, 0);
+    }
+}
+
+/*
+ * Store a confirmed request awaiting its response, in the slot of its
+ * Invoke-Id, or by its whole long invoke id for ACCESS requests (whose ids
+ * may differ only in their higher bits)
+ */
+static void
+dlms_put_request(dlms_association *association, gboolean access, guint32 key, dlms_frame_data *fd)
+{
+    if (access) {
+        if (!association->access_pending) {
+            association->access_pending = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+        }
+        wmem_map_insert(association->access_pending, GUINT_TO_POINTER(key), fd);
+    } else {
+        association->pending[key] = fd;
+    }
+    association->last_slot = (int)key;
+    association->last_access = access;
+}
+
+/* Take the request that a response answers, if any */
+static dlms_frame_data *
+dlms_take_request(dlms_association *association, gboolean access, guint32 key)
+{
+    dlms_frame_data *request;
+
+    if (access) {
+        return association->access_pending
+            ? (dlms_frame_data *)wmem_map_remove(association->access_pending, GUINT_TO_POINTER(key)) : 0;
+    }
+    request = association->pending[key];
+    association->pending[key] = 0;
+    return request;
+}
+
+/*
+ * Track the direction of the APDU that starts at offset,
+ * match confirmed requests with their responses,
+ * and add the links between them to the tree.
+ */
+static void
+dlms_track_request_response(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    dlms_packet_info *pi;
+    dlms_association *association;
+    dlms_frame_data *fd, *request;
+    proto_item *item;
+    dlms_core_apdu apdu;
+    const guint8 *data;
+    size_t size;
+    int direction, slot, confirmed, setup_stage;
+    gboolean access;
+
+    data = dlms_get_data(tvb, &size);
+    dlms_check_status(tvb, dlms_core_classify_apdu(data, size, offset, &apdu));
+    direction = apdu.direction;
+    access = apdu.choice == DLMS_ACCESS_REQUEST || apdu.choice == DLMS_ACCESS_RESPONSE;
+    slot = access ? (int)apdu.long_invoke_id : apdu.slot;
+    confirmed = apdu.confirmed;
+    setup_stage = DLMS_SETUP_NONE;
+    if (apdu.choice == DLMS_AARQ) {
+        setup_stage = DLMS_SETUP_AARQ;
+    } else if (apdu.choice == DLMS_AARE) {
+        setup_stage = DLMS_SETUP_AARE;
+    } else if (apdu.hls_pass_3) {
+        setup_stage = DLMS_SETUP_HLS_PASS_3;
+    } else if (apdu.choice == DLMS_GET_REQUEST || apdu.choice == DLMS_SET_REQUEST
+               || apdu.choice == DLMS_ACTION_REQUEST || apdu.choice == DLMS_ACCESS_REQUEST
+               || apdu.choice == DLMS_READ_REQUEST || apdu.choice == DLMS_WRITE_REQUEST) {
+        setup_stage = DLMS_SETUP_FIRST_REQUEST;
+    }
+
+    pi = dlms_get_packet_info(pinfo);
+    association = dlms_get_association(pinfo, pi);
+    fd = pi->frame_data = dlms_get_frame_data(pinfo);
+    if (direction == DLMS_DIRECTION_UNKNOWN && association->server_known && pi->srcport != pi->dstport) {
+        direction = pi->srcport == association->server_port
+            ? DLMS_DIRECTION_SERVER_TO_CLIENT
+            : DLMS_DIRECTION_CLIENT_TO_SERVER;
+    }
+    pi->direction = direction;
+
+    if (!PINFO_FD_VISITED(pinfo)) {
+        if (!association->server_known && direction != DLMS_DIRECTION_UNKNOWN) {
+            association->server_known = TRUE;
+            association->server_port = direction == DLMS_DIRECTION_CLIENT_TO_SERVER ? pi->dstport : pi->srcport;
+            association->meter = direction == DLMS_DIRECTION_CLIENT_TO_SERVER
+                ? dlms_endpoint_name(wmem_file_scope(), &pi->dst, pi->dstport, pi->is_hdlc)
+                : dlms_endpoint_name(wmem_file_scope(), &pi->src, pi->srcport, pi->is_hdlc);
+        }
+        if (direction == DLMS_DIRECTION_CLIENT_TO_SERVER && confirmed) {
+            dlms_put_request(association, access, (guint32)slot, fd);
+        } else if (direction == DLMS_DIRECTION_SERVER_TO_CLIENT) {
+            if (slot < 0 && apdu.choice == DLMS_EXCEPTION_RESPONSE) {
+                slot = association->last_slot;
+                access = association->last_access;
+            }
+            request = slot >= 0 ? dlms_take_request(association, access, (guint32)slot) : 0;
+            if (request) {
+                request->response_frame = fd->frame;
+                fd->request_frame = request->frame;
+                if (request->descriptors && wmem_array_get_count(request->descriptors) == 1) {
+                    fd->request_descriptor = *(const dlms_descriptor_text **)wmem_array_index(request->descriptors, 0);
+                }
+                nstime_delta(&fd->response_time, &fd->time, &request->time);
+                if (request->frame == association->setup.hls_frame) {
+                    setup_stage = DLMS_SETUP_HLS_PASS_4;
+                }
+            }
+        }
+        if (setup_stage != DLMS_SETUP_NONE) {
+            dlms_track_setup(pinfo, pi, setup_stage);
+        }
+    }
+
+    if (fd && fd->response_frame) {
+        item = proto_tree_add_uint(tree, &dlms_hfi.response_in, tvb, 0, 0, fd->response_frame);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+    if (fd && fd->request_frame) {
+        item = proto_tree_add_uint(tree, &dlms_hfi.response_to, tvb, 0, 0, fd->request_frame);
+        PROTO_ITEM_SET_GENERATED(item);
+        item = proto_tree_add_time(tree, &dlms_hfi.response_time, tvb, 0, 0, &fd->response_time);
+        PROTO_ITEM_SET_GENERATED(item);
+    }
+}
+
+/* Dissect a DLMS Application Packet Data Unit (APDU) */
+static void
+dlms_dissect_apdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gint offset)
+{
+    unsigned choice;
+    dlms_packet_info *pi;
+
+    pi = dlms_get_packet_info(pinfo);
+    if (!pi->apdu_length) {
+        pi->apdu_length = tvb_reported_length_remaining(tvb, offset);
+    }
+
+    dlms_track_request_response(tvb, pinfo, tree, offset);
+
+    proto_tree_add_item(tree, &dlms_hfi.apdu, tvb, offset, 1, ENC_NA);
+    choice = tvb_get_guint8(tvb, offset);
+    offset += 1;
+    if (choice == DLMS_DATA_NOTIFICATION) {
+        dlms_dissect_data_notification(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_READ_REQUEST) {
+        dlms_dissect_read_request(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_WRITE_REQUEST) {
+        dlms_dissect_write_request(tvb, pinfo, tree, offset, "Write-Request");
+    } else if (choice == DLMS_UNCONFIRMED_WRITE_REQUEST) {
+        dlms_dissect_write_request(tvb, pinfo, tree, offset, "Unconfirmed-Write-Request");
+    } else if (choice == DLMS_READ_RESPONSE) {
+        dlms_dissect_read_response(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_WRITE_RESPONSE) {
+        dlms_dissect_write_response(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_AARQ) {
+        dlms_dissect_aarq(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_AARE) {
+        dlms_dissect_aare(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_RLRQ) {
+        col_set_str(pinfo->cinfo, COL_INFO, "RLRQ");
+    } else if (choice == DLMS_RLRE) {
+        col_set_str(pinfo->cinfo, COL_INFO, "RLRE");
+    } else if (choice == DLMS_GET_REQUEST) {
+        dlms_dissect_get_request(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_SET_REQUEST) {
+        dlms_dissect_set_request(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_EVENT_NOTIFICATION_REQUEST) {
+        dlms_dissect_event_notification_request(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_ACTION_REQUEST) {
+        dlms_dissect_action_request(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_GET_RESPONSE) {
+        dlms_dissect_get_response(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_SET_RESPONSE) {
+        dlms_dissect_set_response(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_ACTION_RESPONSE) {
+        dlms_dissect_action_response(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_EXCEPTION_RESPONSE) {
+        dlms_dissect_exception_response(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_ACCESS_REQUEST) {
+        dlms_dissect_access_request(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_ACCESS_RESPONSE) {
+        dlms_dissect_access_response(tvb, pinfo, tree, offset);
+    } else if (choice == DLMS_GENERAL_BLOCK_TRANSFER) {
+        dlms_dissect_general_block_transfer(tvb, pinfo, tree, offset);
+    } else if (dlms_core_is_ciphered_apdu(choice)) {
+        col_set_str(pinfo->cinfo, COL_INFO, val_to_str_const(choice, dlms_apdu_names, "Ciphered APDU"));
+        dlms_dissect_ciphered_apdu(tvb, pinfo, tree, offset - 1);
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Unknown APDU");
+    }
+}
+
+/* Dissect a check sequence field (HCS or FCS) of an HDLC frame */
+static void
+dlms_dissect_hdlc_check_sequence(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, int offset, int ok, header_field_info *hfi)
+{
+    proto_item *item;
+
+    item = proto_tree_add_item(tree, hfi, tvb, offset, 2, ENC_NA);
+    if (!ok) {
+        expert_add_info(pinfo, item, &dlms_ei.check_sequence);
+    }
+}
+
+/* Dissect the information field of an HDLC (SNRM or UA) frame */
+static void
+dlms_dissect_hdlc_information(tvbuff_t *tvb, proto_tree *tree, gint *offset, dlms_hdlc_parameters *parameters)
+{
+    proto_tree *subtree;
+
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.hdlc_information, 0, "Information");
+    unsigned format = tvb_get_guint8(tvb, *offset);
+    *offset += 1;
+    if (format == 0x81) { /* format identifier */
+        unsigned group = tvb_get_guint8(tvb, *offset);
+        *offset += 1;
+        if (group == 0x80) { /* group identifier */
+            unsigned i, length = tvb_get_guint8(tvb, *offset);
+            *offset += 1;
+            for (i = 0; i < length; ) { /* parameters */
+                proto_item *item;
+                unsigned parameter = tvb_get_guint8(tvb, *offset);
+                unsigned j, parameter_length = tvb_get_guint8(tvb, *offset + 1);
+                unsigned value = 0;
+                for (j = 0; j < parameter_length; j++) {
+                    value = (value << 8) + tvb_get_guint8(tvb, *offset + 2 + j);
+                }
+                item = proto_tree_add_item(subtree, &dlms_hfi.hdlc_parameter, tvb, *offset, 2 + parameter_length, ENC_NA);
+                proto_item_set_text(item, "%s: %u",
+                    parameter == 5 ? "Maximum Information Field Length Transmit" :
+                    parameter == 6 ? "Maximum Information Field Length Receive" :
+                    parameter == 7 ? "Window Size Transmit" :
+                    parameter == 8 ? "Window Size Receive" :
+                    "Unknown Information Field Parameter",
+                    value);
+                if (parameter == 5) {
+                    parameters->max_information_length_transmit = value;
+                } else if (parameter == 6) {
+                    parameters->max_information_length_receive = value;
+                } else if (parameter == 7) {
+                    parameters->window_transmit = value;
+                } else if (parameter == 8) {
+                    parameters->window_receive = value;
+                }
+                i += 2 + parameter_length;
+                *offset += 2 + parameter_length;
+            }
+        }
+    }
+}
+
+/* Dissect an HDLC address field (1, 2 or 4 bytes) */
+static void
+dlms_dissect_hdlc_address(tvbuff_t *tvb, proto_tree *tree, gint offset, const dlms_core_hdlc_address *address, const char *name)
+{
+    proto_tree *subtree;
+
+    subtree = proto_tree_add_subtree(tree, tvb, offset, address->length, dlms_ett.hdlc_address, 0, name);
+    if (address->length == 1) {
+        proto_tree_add_item(subtree, &dlms_hfi.hdlc_address, tvb, offset, 1, ENC_NA);
+    } else {
+        proto_tree_add_uint(subtree, &dlms_hfi.hdlc_logical_device, tvb, offset, address->length / 2, address->upper);
+        proto_tree_add_uint(subtree, &dlms_hfi.hdlc_physical_device, tvb, offset + address->length / 2,
+                            address->length / 2, address->lower);
+    }
+}
+
+/* Dissect a DLMS APDU in an HDLC frame */
+static void
+dlms_dissect_hdlc(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+    proto_tree *subtree, *subsubtree;
+    proto_item *item;
+    fragment_head *frags;
+    tvbuff_t *rtvb; /* reassembled tvb */
+    unsigned length, segmentation, control;
+    dlms_packet_info *pi;
+    dlms_frame_data *fd;
+    dlms_core_hdlc frame;
+    const guint8 *data;
+    size_t size;
+    int status;
+    dlms_hdlc_parameters parameters = {
+        DLMS_HDLC_DEFAULT_INFORMATION_LENGTH, DLMS_HDLC_DEFAULT_INFORMATION_LENGTH,
+        DLMS_HDLC_DEFAULT_WINDOW, DLMS_HDLC_DEFAULT_WINDOW
+    };
+    gboolean link_setup = FALSE; /* SNRM or UA, which negotiate the link parameters */
+    gint control_offset;
+    dlms_association *association;
+
+    /* The check sequences are only verified on the first pass */
+    fd = dlms_get_frame_data(pinfo);
+    data = dlms_get_data(tvb, &size);
+    if (fd && (fd->hdlc_checks & DLMS_HDLC_CHECKED)) {
+        status = dlms_core_parse_hdlc_header(data, size, 0, &frame);
+        frame.hcs_ok = (fd->hdlc_checks & DLMS_HDLC_HCS_OK) != 0;
+        frame.fcs_ok = (fd->hdlc_checks & DLMS_HDLC_FCS_OK) != 0;
+    } else {
+        status = dlms_core_parse_hdlc(data, size, 0, &frame);
+        if (fd && status == DLMS_CORE_OK) {
+            fd->hdlc_checks = DLMS_HDLC_CHECKED
+                | (frame.hcs_ok ? DLMS_HDLC_HCS_OK : 0) | (frame.fcs_ok ? DLMS_HDLC_FCS_OK : 0);
+        }
+    }
+
+    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.hdlc, 0, "HDLC");
+
+    /* Opening flag */
+    proto_tree_add_item(subtree, &dlms_hfi.hdlc_flag, tvb, 0, 1, ENC_NA);
+
+    /* Frame format field */
+    subsubtree = proto_tree_add_subtree(subtree, tvb, 1, 2, dlms_ett.hdlc_format, 0, "Frame Format");
+    proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_type, tvb, 1, 2, ENC_BIG_ENDIAN);
+    proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_segmentation, tvb, 1, 2, ENC_BIG_ENDIAN);
+    segmentation = frame.segmentation;
+    proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_length, tvb, 1, 2, ENC_BIG_ENDIAN);
+    length = frame.length; /* length of HDLC frame excluding the opening and closing flag fields */
+
+    /* The address fields are 1, 2 or 4 bytes long, so nothing past them can be shown if they are not valid */
+    if (!frame.source_address.length) {
+        dlms_check_status(tvb, status);
+    }
+
+    pi = dlms_get_packet_info(pinfo);
+    pi->dstport = dlms_hdlc_port(&frame.destination_address);
+    pi->srcport = dlms_hdlc_port(&frame.source_address);
+    pi->has_ports = TRUE;
+    pi->is_hdlc = TRUE;
+
+    /* Destination and source address fields */
+    dlms_dissect_hdlc_address(tvb, subtree, 3, &frame.destination_address, "Destination Address");
+    dlms_dissect_hdlc_address(tvb, subtree, 3 + frame.destination_address.length, &frame.source_address, "Source Address");
+
+    /* Control field */
+    control_offset = (gint)frame.control_offset;
+    subsubtree = proto_tree_add_subtree(subtree, tvb, control_offset, 1, dlms_ett.hdlc_control, 0, "Control");
+    control = frame.control;
+    dlms_check_status(tvb, status);
+
+    /* Header check sequence field */
+    if (frame.has_hcs) {
+        dlms_dissect_hdlc_check_sequence(tvb, pinfo, subtree, (gint)frame.hcs_offset, frame.hcs_ok, &dlms_hfi.hdlc_hcs);
+    }
+
+    /* Control sub-fields and information field */
+    if ((control & 0x01) == 0x00) {
+        col_add_str(pinfo->cinfo, COL_INFO, "HDLC I"); /* Information */
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_i, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_rsn, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_ssn, tvb, control_offset, 1, ENC_NA);
+
+        subsubtree = proto_tree_add_subtree_format(subtree, tvb, (gint)frame.information_offset, (gint)frame.information_length, dlms_ett.hdlc_information, 0, "Information Field (length %u)", (guint)frame.information_length);
+        association = dlms_get_association(pinfo, pi);
+        frags = dlms_add_fragment(tvb, (gint)frame.information_offset, pinfo, subsubtree, DLMS_REASSEMBLY_ID_HDLC,
+                                  &association->hdlc_segments[dlms_get_side(pinfo, pi)],
+                                  (guint32)frame.information_length, segmentation, FALSE);
+        rtvb = process_reassembled_data(tvb, (gint)frame.information_offset, pinfo, "Reassembled", frags, &dlms_fragment_items, 0, tree);
+        if (rtvb) {
+            proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_llc, rtvb, 0, 3, ENC_NA);
+            dlms_dissect_apdu(rtvb, pinfo, tree, 3);
+        }
+    } else if ((control & 0x0f) == 0x01) {
+        col_set_str(pinfo->cinfo, COL_INFO, "HDLC RR"); /* Receive Ready */
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_rr_rnr, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_rsn, tvb, control_offset, 1, ENC_NA);
+    } else if ((control & 0x0f) == 0x05) {
+        col_set_str(pinfo->cinfo, COL_INFO, "HDLC RNR"); /* Receive Not Ready */
+        item = proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_rr_rnr, tvb, control_offset, 1, ENC_NA);
+        expert_add_info(pinfo, item, &dlms_ei.no_success);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_rsn, tvb, control_offset, 1, ENC_NA);
+    } else if ((control & 0xef) == 0x83) { /* Set Normal Response Mode */
+        col_set_str(pinfo->cinfo, COL_INFO, "HDLC SNRM");
+        if (!PINFO_FD_VISITED(pinfo)) {
+            dlms_track_setup(pinfo, pi, DLMS_SETUP_SNRM);
+        }
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+        if (frame.has_hcs) {
+            gint offset = (gint)frame.information_offset;
+            dlms_dissect_hdlc_information(tvb, subtree, &offset, &parameters);
+        }
+        link_setup = TRUE;
+    } else if ((control & 0xef) == 0x43) {
+        col_set_str(pinfo->cinfo, COL_INFO, "HDLC DISC"); /* Disconnect */
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+    } else if ((control & 0xef) == 0x63) {
+        col_set_str(pinfo->cinfo, COL_INFO, "HDLC UA"); /* Unnumbered Acknowledge */
+        if (!PINFO_FD_VISITED(pinfo)) {
+            dlms_track_setup(pinfo, pi, DLMS_SETUP_UA);
+        }
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+        if (frame.has_hcs) {
+            gint offset = (gint)frame.information_offset;
+            dlms_dissect_hdlc_information(tvb, subtree, &offset, &parameters);
+        }
+        link_setup = TRUE;
+    } else if ((control & 0xef) == 0x0f) {
+        col_set_str(pinfo->cinfo, COL_INFO, "HDLC DM"); /* Disconnected Mode */
+        item = proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, control_offset, 1, ENC_NA);
+        expert_add_info(pinfo, item, &dlms_ei.no_success);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+    } else if ((control & 0xef) == 0x87) {
+        col_set_str(pinfo->cinfo, COL_INFO, "HDLC FRMR"); /* Frame Reject */
+        item = proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, control_offset, 1, ENC_NA);
+        expert_add_info(pinfo, item, &dlms_ei.no_success);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+    } else if ((control & 0xef) == 0x03) {
+        col_set_str(pinfo->cinfo, COL_INFO, "HDLC UI"); /* Unnumbered Information */
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, control_offset, 1, ENC_NA);
+        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, control_offset, 1, ENC_NA);
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Unknown HDLC frame");
+    }
+
+    /* Link analysis */
+    if (!PINFO_FD_VISITED(pinfo)) {
+        dlms_track_hdlc(pinfo, pi, control, (unsigned)frame.information_length, link_setup ? &parameters : 0);
+    }
+    fd = dlms_get_frame_data(pinfo);
+    if (fd && fd->hdlc) {
+        dlms_dissect_hdlc_analysis(tvb, pinfo, subtree, fd->hdlc);
+    }
+
+    /* Frame check sequence field */
+    dlms_dissect_hdlc_check_sequence(tvb, pinfo, subtree, length - 1, frame.fcs_ok, &dlms_hfi.hdlc_fcs);
+
+    /* Closing flag */
+    proto_tree_add_item(subtree, &dlms_hfi.hdlc_flag, tvb, length + 1, 1, ENC_NA);
+}
+
+/* Dissect a DLMS APDU in an IEC 61334-4-32 convergence layer data frame (PLC) */
+static void
+dlms_dissect_432(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+    proto_tree_add_item(tree, &dlms_hfi.iec432llc, tvb, 0, 3, ENC_NA);
+    dlms_dissect_apdu(tvb, pinfo, tree, 3);
+}
+
+/* Dissect a DLMS APDU in a Wrapper Protocol Data Unit (TCP/UDP/IP) */
+static void
+dlms_dissect_wrapper(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+    proto_item *item;
+    proto_tree *subtree;
+    dlms_packet_info *pi;
+
+    item = proto_tree_add_item(tree, &dlms_hfi.wrapper_header, tvb, 0, 8, ENC_NA);
+    subtree = proto_item_add_subtree(item, dlms_ett.wrapper);
+    proto_tree_add_item(subtree, &dlms_hfi.wrapper_version, tvb, 0, 2, ENC_BIG_ENDIAN);
+    proto_tree_add_item(subtree, &dlms_hfi.wrapper_source_wport, tvb, 2, 2, ENC_BIG_ENDIAN);
+    proto_tree_add_item(subtree, &dlms_hfi.wrapper_destination_wport, tvb, 4, 2, ENC_BIG_ENDIAN);
+    proto_tree_add_item(subtree, &dlms_hfi.wrapper_length, tvb, 6, 2, ENC_BIG_ENDIAN);
+
+    pi = dlms_get_packet_info(pinfo);
+    pi->srcport = tvb_get_ntohs(tvb, 2);
+    pi->dstport = tvb_get_ntohs(tvb, 4);
+    pi->has_ports = TRUE;
+
+    dlms_dissect_apdu(tvb, pinfo, tree, 8);
+}
+
+/* Update the times the meter of the association of the PDU was first and last seen */
+static void
+dlms_track_meter(packet_info *pinfo, const dlms_packet_info *pi)
+{
+    dlms_meter_times *times;
+
+    if (PINFO_FD_VISITED(pinfo) || !pi->association || !pi->association->meter) {
+        return;
+    }
+    times = (dlms_meter_times *)wmem_map_lookup(dlms_meter_times_map, pi->association->meter);
+    if (!times) {
+        times = wmem_new(wmem_file_scope(), dlms_meter_times);
+        times->first_seen = pinfo->abs_ts;
+        wmem_map_insert(dlms_meter_times_map, pi->association->meter, times);
+    }
+    times->last_seen = pinfo->abs_ts;
+}
+
+/* Dissect a single wrapper PDU, HDLC frame, 4-32 frame or APDU */
+static int
+dlms_dissect_pdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+{
+    header_field_info *hfi;
+    proto_item *item;
+    proto_tree *subtree;
+    unsigned first_byte;
+    dlms_packet_info *pi;
+
+    col_set_str(pinfo->cinfo, COL_PROTOCOL, "DLMS");
+
+    hfi = proto_registrar_get_nth(dlms_proto);
+    item = proto_tree_add_item(tree, hfi, tvb, 0, -1, ENC_NA);
+    subtree = proto_item_add_subtree(item, dlms_ett.dlms);
+
+    pi = dlms_new_packet_info(pinfo);
+    copy_address_shallow(&pi->src, &pinfo->src);
+    copy_address_shallow(&pi->dst, &pinfo->dst);
+    pi->length = tvb_reported_length(tvb);
+
+    first_byte = tvb_get_guint8(tvb, 0);
+    if (first_byte == 0x7e) {
+        dlms_dissect_hdlc(tvb, pinfo, subtree);
+    } else if (first_byte == 0x90) {
+        dlms_dissect_432(tvb, pinfo, subtree);
+    } else if (first_byte == 0) {
+        dlms_dissect_wrapper(tvb, pinfo, subtree);
+    } else {
+        dlms_dissect_apdu(tvb, pinfo, subtree, 0);
+    }
+
+    if (pi->has_ports) {
+        item = proto_tree_add_uint(subtree, &dlms_hfi.srcport, tvb, 0, 0, pi->srcport);
+        PROTO_ITEM_SET_GENERATED(item);
+        item = proto_tree_add_uint(subtree, &dlms_hfi.dstport, tvb, 0, 0, pi->dstport);
+        PROTO_ITEM_SET_GENERATED(item);
+        item = proto_tree_add_uint(subtree, &dlms_hfi.port, tvb, 0, 0, pi->srcport);
+        PROTO_ITEM_SET_GENERATED(item);
+        PROTO_ITEM_SET_HIDDEN(item);
+        item = proto_tree_add_uint(subtree, &dlms_hfi.port, tvb, 0, 0, pi->dstport);
+        PROTO_ITEM_SET_GENERATED(item);
+        PROTO_ITEM_SET_HIDDEN(item);
+    }
+
+    dlms_get_association(pinfo, pi);
+    if (!pi->frame_data) {
+        pi->frame_data = (dlms_frame_data *)p_get_proto_data(wmem_file_scope(), pinfo, dlms_proto,
+                                                             DLMS_PROTO_DATA_FRAME + pi->pdu);
+    }
+    if (pi->frame_data && pi->frame_data->setup) {
+        dlms_dissect_setup(tvb, subtree, pi->frame_data->setup);
+    }
+    dlms_track_meter(pinfo, pi);
+
+    tap_queue_packet(dlms_tap, pinfo, pi);
+
+    return tvb_captured_length(tvb);
+}
+
+/* Get the length of the wrapper PDU or HDLC frame (with its flags) at offset in a TCP stream */
+static guint
+dlms_get_tcp_pdu_len(packet_info *pinfo _U_, tvbuff_t *tvb, int offset, void *data _U_)
+{
+    if (tvb_get_guint8(tvb, offset) == 0x7e) {
+        return (((tvb_get_guint8(tvb, offset + 1) & 0x07) << 8) | tvb_get_guint8(tvb, offset + 2)) + 2;
+    }
+
+    return 8 + tvb_get_ntohs(tvb, offset + 6);
+}
+
+/*
+ * Dissect a UDP payload or TCP segment. Over TCP, the wrapper PDUs and HDLC
+ * frames are delimited by their length fields, as a segment may carry
+ * several of them or only part of one.
+ */
+static int
+dlms_dissect(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+{
+    guint first_byte;
+
+    if (pinfo->ptype == PT_TCP) {
+        first_byte = tvb_get_guint8(tvb, 0);
+        if (first_byte == 0 || first_byte == 0x7e) {
+            tcp_dissect_pdus(tvb, pinfo, tree, dlms_desegment, 8, dlms_get_tcp_pdu_len, dlms_dissect_pdu, data);
+            return tvb_captured_length(tvb);
+        }
+    }
+
+    return dlms_dissect_pdu(tvb, pinfo, tree, data);
+}
+
+/*
+ * Check whether a UDP payload or TCP segment starts with a wrapper PDU, an
+ * HDLC frame or an IEC 61334-4-32 LLC header followed by an APDU. The checks
+ * go from the cheapest to the most expensive, and most payloads of other
+ * protocols fail at the first byte. Over UDP, wrapper PDUs and HDLC frames
+ * must fill the datagram; TCP segments may carry more after them, or only the
+ * start of them, which is reassembled with the next segments. The 4-32 frames
+ * of PLC have no length to delimit them in a stream, nor enough structure to
+ * tell them from other TCP payloads, so they are only recognised over UDP.
+ */
+static gboolean
+dlms_heur_check(tvbuff_t *tvb, gboolean is_tcp)
+{
+    const guint8 *p;
+    guint captured, reported, length, hcs;
+    dlms_core_hdlc_address destination, source;
+
+    captured = tvb_captured_length(tvb);
+    if (captured < 4) {
+        return FALSE;
+    }
+    reported = tvb_reported_length(tvb);
+    p = tvb_get_ptr(tvb, 0, MIN(captured, 14)); /* up to the HCS of a frame with 4 byte addresses */
+
+    switch (p[0]) {
+    case 0x00: /* wrapper version 1, length, APDU */
+        if (captured < 9 || p[1] != 0x01) {
+            return FALSE;
+        }
+        length = 8 + ((p[6] << 8) | p[7]);
+        if (length < 9 || (!is_tcp && length != reported)) {
+            return FALSE;
+        }
+        return try_val_to_str(p[8], dlms_apdu_names) != 0;
+    case 0x7e: /* HDLC frame format type 3, length, and check sequence */
+        if (captured < 9 || (p[1] >> 4) != 0xa) {
+            return FALSE;
+        }
+        length = (((p[1] & 0x07) << 8) | p[2]) + 2;
+        if (length < 9 || (!is_tcp && length != reported)) {
+            return FALSE;
+        }
+        /* the header check sequence, or the frame check sequence of a frame without information */
+        if (dlms_core_parse_hdlc_address(p, MIN(captured, 14), 3, &destination) != DLMS_CORE_OK
+            || dlms_core_parse_hdlc_address(p, MIN(captured, 14), 3 + destination.length, &source) != DLMS_CORE_OK) {
+            return FALSE;
+        }
+        hcs = 3 + destination.length + source.length + 1;
+        if (hcs + 2 > MIN(captured, length)) {
+            return FALSE;
+        }
+        return dlms_core_hdlc_check_sequence(p + 1, hcs - 1) == (p[hcs] | (p[hcs + 1] << 8));
+    case 0x90: /* 4-32 LLC (destination and source LSAP, quality), APDU of at least 2 bytes */
+        if (is_tcp || captured < 5 || (p[1] != 0x90 && p[1] != 0x91) || p[2] != 0x00) {
+            return FALSE;
+        }
+        return try_val_to_str(p[3], dlms_apdu_names) != 0;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Dissect a UDP payload or TCP segment on a port other than those of the
+ * DLMS dissector, if it looks like DLMS. The first recognised packet of a
+ * conversation attaches the DLMS dissector to it, so that the rest of the
+ * conversation goes straight to the dissector instead of the heuristics.
+ */
+static gboolean
+dlms_dissect_heur(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data, gboolean is_tcp)
+{
+    if (!dlms_heur_check(tvb, is_tcp)) {
+        return FALSE;
+    }
+    conversation_set_dissector(find_or_create_conversation(pinfo), dlms_handle);
+    dlms_dissect(tvb, pinfo, tree, data);
+
+    return TRUE;
+}
+
+static gboolean
+dlms_dissect_heur_udp(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+{
+    return dlms_dissect_heur(tvb, pinfo, tree, data, FALSE);
+}
+
+static gboolean
+dlms_dissect_heur_tcp(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+{
+    return dlms_dissect_heur(tvb, pinfo, tree, data, TRUE);
+}
+
+/* Get the display filter field name for a column of the conversation table */
+static const char *
+dlms_conversation_get_filter_type(conv_item_t *conv, conv_filter_type_e filter)
+{
+    if (filter == CONV_FT_SRC_PORT) {
+        return "dlms.srcport";
+    } else if (filter == CONV_FT_DST_PORT) {
+        return "dlms.dstport";
+    } else if (filter == CONV_FT_ANY_PORT) {
+        return "dlms.port";
+    } else if (conv->src_address.type == AT_IPv4) {
+        return filter == CONV_FT_SRC_ADDRESS ? "ip.src" : filter == CONV_FT_DST_ADDRESS ? "ip.dst" : "ip.addr";
+    } else if (conv->src_address.type == AT_IPv6) {
+        return filter == CONV_FT_SRC_ADDRESS ? "ipv6.src" : filter == CONV_FT_DST_ADDRESS ? "ipv6.dst" : "ipv6.addr";
+    }
+    return CONV_FILTER_INVALID;
+}
+
+static ct_dissector_info_t dlms_conversation_dissector_info = { &dlms_conversation_get_filter_type };
+
+/* Add a packet to the conversation table */
+static gboolean
+dlms_conversation_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+
+    add_conversation_table_data((conv_hash_t *)tapdata, &pi->src, &pi->dst, pi->srcport, pi->dstport,
+                                1, pi->length, &pinfo->rel_ts, &pinfo->abs_ts, &dlms_conversation_dissector_info, PT_NONE);
+
+    return TRUE;
+}
+
+/* Get the display filter field name for a column of the endpoint table */
+static const char *
+dlms_hostlist_get_filter_type(hostlist_talker_t *host, conv_filter_type_e filter)
+{
+    if (filter == CONV_FT_ANY_PORT) {
+        return "dlms.port";
+    } else if (filter == CONV_FT_ANY_ADDRESS && host->myaddress.type == AT_IPv4) {
+        return "ip.addr";
+    } else if (filter == CONV_FT_ANY_ADDRESS && host->myaddress.type == AT_IPv6) {
+        return "ipv6.addr";
+    }
+    return HOST_FILTER_INVALID;
+}
+
+static hostlist_dissector_info_t dlms_hostlist_dissector_info = { &dlms_hostlist_get_filter_type };
+
+/* Add a packet to the endpoint table */
+static gboolean
+dlms_hostlist_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    conv_hash_t *hash = (conv_hash_t *)tapdata;
+
+    add_hostlist_table_data(hash, &pi->src, pi->srcport, TRUE, 1, pi->length, &dlms_hostlist_dissector_info, PT_NONE);
+    add_hostlist_table_data(hash, &pi->dst, pi->dstport, FALSE, 1, pi->length, &dlms_hostlist_dissector_info, PT_NONE);
+
+    return TRUE;
+}
+
+/*
+ * Statistics of the traffic to and from each meter (-z dlms,meters), with the
+ * times the meter was first and last seen, in milliseconds since the first
+ * frame
+ */
+static int dlms_stats_tree_meters_node;
+
+/* Milliseconds from the first frame to a time */
+static gint
+dlms_stats_tree_capture_ms(packet_info *pinfo, const nstime_t *time)
+{
+    nstime_t start, delta;
+
+    nstime_delta(&start, &pinfo->abs_ts, &pinfo->rel_ts);
+    nstime_delta(&delta, time, &start);
+    return (gint)(nstime_to_sec(&delta) * 1000);
+}
+
+static void
+dlms_stats_tree_meters_init(stats_tree *st)
+{
+    dlms_stats_tree_meters_node = stats_tree_create_node(st, "Meters", 0, TRUE);
+}
+
+static int
+dlms_stats_tree_meters_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    const dlms_frame_data *fd = pi->frame_data;
+    const dlms_meter_times *times;
+    const gchar *meter;
+    int node;
+
+    meter = pi->association && pi->association->meter ? pi->association->meter : "Unknown";
+    tick_stat_node(st, "Meters", 0, FALSE);
+    node = tick_stat_node(st, meter, dlms_stats_tree_meters_node, TRUE);
+    increase_stat_node(st, "Bytes", node, FALSE, pi->length);
+    times = pi->association && pi->association->meter
+        ? (const dlms_meter_times *)wmem_map_lookup(dlms_meter_times_map, pi->association->meter) : 0;
+    if (times) {
+        set_stat_node(st, "First Seen (ms)", node, FALSE, dlms_stats_tree_capture_ms(pinfo, &times->first_seen));
+        set_stat_node(st, "Last Seen (ms)", node, FALSE, dlms_stats_tree_capture_ms(pinfo, &times->last_seen));
+    }
+    if (fd && fd->request_frame) {
+        avg_stat_node_add_value(st, "Response Time (ms)", node, FALSE, (gint)(nstime_to_sec(&fd->response_time) * 1000));
+    }
+
+    return 1;
+}
+
+static void
+dlms_register_protoinfo(void)
+{
+    dlms_proto = proto_register_protocol("Device Language Message Specification", "DLMS", "dlms");
+
+    /* Register the dlms_hfi header field info structures */
+    {
+        header_field_info *hfi[sizeof(dlms_hfi) / sizeof(header_field_info)];
+        unsigned i;
+        for (i = 0; i < array_length(hfi); i++) {
+            hfi[i] = (header_field_info *)&dlms_hfi + i;
+        }
+        proto_register_fields(dlms_proto, hfi, array_length(hfi));
+    }
+
+    /* Initialise and register the dlms_ett protocol subtree indices */
+    {
+        gint *ett[sizeof(dlms_ett) / sizeof(gint)];
+        unsigned i;
+        for (i = 0; i < array_length(ett); i++) {
+            ett[i] = (gint *)&dlms_ett + i;
+            *ett[i] = -1;
+        }
+        proto_register_subtree_array(ett, array_length(ett));
+    }
+
+    /* Register the dlms_ei expert info fields */
+    {
+        static ei_register_info ei[] = {
+            { &dlms_ei.no_success, { "dlms.no_success", PI_RESPONSE_CODE, PI_NOTE, "No success response", EXPFILL } },
+            { &dlms_ei.not_implemented, { "dlms.not_implemented", PI_UNDECODED, PI_WARN, "Not implemented in the DLMS dissector", EXPFILL } },
+            { &dlms_ei.check_sequence, { "dlms.check_sequence", PI_CHECKSUM, PI_WARN, "Bad HDLC check sequence field value", EXPFILL } },
+            { &dlms_ei.low_block_fill, { "dlms.transfer.low_fill", PI_SEQUENCE, PI_NOTE, "Blocks use a small part of the negotiated PDU size", EXPFILL } },
+            { &dlms_ei.unneeded_block_transfer, { "dlms.transfer.unneeded", PI_SEQUENCE, PI_NOTE, "Block transfer used where a single PDU would fit", EXPFILL } },
+            { &dlms_ei.hdlc_retransmission, { "dlms.hdlc.analysis.retransmission", PI_SEQUENCE, PI_NOTE, "HDLC I frame retransmission", EXPFILL } },
+            { &dlms_ei.hdlc_out_of_sequence, { "dlms.hdlc.analysis.out_of_sequence", PI_SEQUENCE, PI_WARN, "HDLC I frame out of sequence", EXPFILL } },
+            { &dlms_ei.hdlc_window_exceeded, { "dlms.hdlc.analysis.window_exceeded", PI_SEQUENCE, PI_WARN, "More HDLC I frames in a row than the negotiated window size", EXPFILL } },
+            { &dlms_ei.image_retransmission, { "dlms.image.retransmission", PI_SEQUENCE, PI_NOTE, "Image block retransmission", EXPFILL } },
+            { &dlms_ei.image_missing, { "dlms.image.missing", PI_SEQUENCE, PI_WARN, "Image blocks missing", EXPFILL } },
+            { &dlms_ei.invocation_counter_gap, { "dlms.security.gap", PI_SEQUENCE, PI_WARN, "Invocation counter gap (APDUs lost)", EXPFILL } },
+            { &dlms_ei.invocation_counter_duplicate, { "dlms.security.duplicate", PI_SEQUENCE, PI_NOTE, "Repeated invocation counter (retransmission or replay)", EXPFILL } },
+            { &dlms_ei.invocation_counter_regression, { "dlms.security.regression", PI_SECURITY, PI_WARN, "Invocation counter below the previous one (replay or counter reset)", EXPFILL } },
+            { &dlms_ei.reassembly_evicted, { "dlms.reassembly.evicted", PI_REASSEMBLE, PI_WARN, "Reassembly evicted after this fragment", EXPFILL } },
+            { &dlms_ei.reassembly_discarded, { "dlms.reassembly.discarded", PI_REASSEMBLE, PI_NOTE, "Fragment of an evicted reassembly, not reassembled", EXPFILL } },
+        };
+        expert_module_t *em = expert_register_protocol(dlms_proto);
+        expert_register_field_array(em, ei, array_length(ei));
+    }
+
+    /* Register the reassembly table */
+    {
+        static const reassembly_table_functions f = {
+            dlms_reassembly_hash_func,
+            dlms_reassembly_equal_func,
+            dlms_reassembly_key_func,
+            dlms_reassembly_key_func,
+            dlms_reassembly_free_key_func,
+            dlms_reassembly_free_key_func,
+        };
+        reassembly_table_init(&dlms_reassembly_table, &f);
+    }
+    dlms_reassembly_chains = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), g_direct_hash, g_direct_equal);
+    register_init_routine(dlms_reassembly_init);
+
+    /* Register the preferences of the reassembly and of its limits */
+    {
+        module_t *module = prefs_register_protocol(dlms_proto, dlms_apply_prefs);
+        prefs_register_uint_preference(module, "reassembly_max_chain_bytes", "Maximum bytes of a reassembly",
+                                       "Reassemblies of HDLC segments or blocks past this number of bytes are abandoned (0 for no limit)",
+                                       10, &dlms_reassembly_max_chain_bytes);
+        prefs_register_uint_preference(module, "reassembly_max_pending_bytes", "Maximum bytes of all the pending reassemblies",
+                                       "Past this number of bytes in reassemblies not complete yet, the least recently extended ones are abandoned (0 for no limit)",
+                                       10, &dlms_reassembly_max_pending_bytes);
+        prefs_register_uint_preference(module, "reassembly_max_idle_frames", "Maximum frames without a fragment of a reassembly",
+                                       "Reassemblies not extended in this number of frames are abandoned (0 for no limit)",
+                                       10, &dlms_reassembly_max_idle_frames);
+        prefs_register_uint_preference(module, "reassembly_max_idle_seconds", "Maximum seconds without a fragment of a reassembly",
+                                       "Reassemblies not extended in this number of seconds are abandoned (0 for no limit)",
+                                       10, &dlms_reassembly_max_idle_seconds);
+        prefs_register_bool_preference(module, "desegment", "Reassemble DLMS PDUs spanning multiple TCP segments",
+                                       "Whether the wrapper PDUs and HDLC frames split across TCP segments are reassembled",
+                                       &dlms_desegment);
+        prefs_register_string_preference(module, "objects_of_interest", "Objects of interest",
+                                         "If set, only the values of these attributes and methods are decoded, and the others are skipped: "
+                                         "obis[/class_id[/attribute_id or m<method_id>]], separated by commas, e.g. 1-0:1.8.0*255/3/2, 1.0.99.1.0.255/7/m1",
+                                         &dlms_interest_pref);
+    }
+
+    dlms_descriptor_texts = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
+                                                   dlms_descriptor_hash_func, dlms_descriptor_equal_func);
+    dlms_sn_object_lists = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), g_str_hash, g_str_equal);
+    dlms_image_sessions = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), g_str_hash, g_str_equal);
+    dlms_push_meters = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), g_str_hash, g_str_equal);
+    dlms_push_seconds = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), g_direct_hash, g_direct_equal);
+    dlms_meter_times_map = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), g_str_hash, g_str_equal);
+    dlms_invocation_counters = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), g_str_hash, g_str_equal);
+
+    /* Register the table of the dissectors of the class values, and index the built-in classes */
+    dlms_class_table = register_dissector_table(DLMS_CLASS_ID_TABLE, "DLMS/COSEM class_id", dlms_proto, FT_UINT16, BASE_DEC);
+    if (!dlms_classes) {
+        dlms_index_classes();
+    }
+
+    /* Register the tap, and the conversation and endpoint tables fed by it */
+    dlms_tap = register_tap("dlms");
+    register_conversation_table(dlms_proto, FALSE, dlms_conversation_packet, dlms_hostlist_packet);
+
+    /* Register the DLMS dissector and the UDP port assigned by IANA for DLMS */
+    dlms_handle = register_dissector("DLMS", dlms_dissect, dlms_proto);
+    dissector_add_uint("udp.port", 4059, dlms_handle);
+
+    /* Register the heuristic dissectors, for DLMS on other UDP and TCP ports */
+    heur_dissector_add("udp", dlms_dissect_heur_udp, "DLMS over UDP", "dlms_udp", dlms_proto, HEURISTIC_ENABLE);
+    heur_dissector_add("tcp", dlms_dissect_heur_tcp, "DLMS over TCP", "dlms_tcp", dlms_proto, HEURISTIC_ENABLE);
+}
+
+/*
+ * Statistics of the connection setup durations (-z dlms,setup).
+ * The percentiles need all the samples, which are kept sorted per stats tree instance.
+ */
+struct dlms_setup_samples {
+    guint32 last_frame; /* to detect a retap, which feeds the frames again from the first */
+    GArray *ms[DLMS_SETUP_STAGES + 1]; /* durations in milliseconds, per stage (and total) */
+};
+typedef struct dlms_setup_samples dlms_setup_samples;
+
+static GHashTable *dlms_setup_samples_table; /* dlms_setup_samples by stats_tree */
+
+static void
+dlms_stats_tree_setup_init(stats_tree *st)
+{
+    dlms_setup_samples *samples;
+    int root, i;
+
+    if (!dlms_setup_samples_table) {
+        dlms_setup_samples_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    /* a retap initialises the tree again, and starts over with no samples */
+    samples = (dlms_setup_samples *)g_hash_table_lookup(dlms_setup_samples_table, st);
+    if (samples) {
+        for (i = 0; i < (int)array_length(samples->ms); i++) {
+            g_array_set_size(samples->ms[i], 0);
+        }
+        samples->last_frame = 0;
+    } else {
+        samples = g_new0(dlms_setup_samples, 1);
+        for (i = 0; i < (int)array_length(samples->ms); i++) {
+            samples->ms[i] = g_array_new(FALSE, FALSE, sizeof(gint));
+        }
+        g_hash_table_insert(dlms_setup_samples_table, st, samples);
+    }
+
+    root = stats_tree_create_node(st, "Connection Setup (ms)", 0, TRUE);
+    for (i = DLMS_SETUP_UA; i <= DLMS_SETUP_STAGES; i++) {
+        stats_tree_create_node(st, val_to_str_const(i, dlms_setup_stage_names, "Unknown"), root, TRUE);
+    }
+}
+
+static void
+dlms_stats_tree_setup_cleanup(stats_tree *st)
+{
+    dlms_setup_samples *samples;
+    unsigned i;
+
+    samples = (dlms_setup_samples *)g_hash_table_lookup(dlms_setup_samples_table, st);
+    if (samples) {
+        for (i = 0; i < array_length(samples->ms); i++) {
+            g_array_free(samples->ms[i], TRUE);
+        }
+        g_free(samples);
+        g_hash_table_remove(dlms_setup_samples_table, st);
+    }
+}
+
+/* Add a duration sample to a stage, and update the average and percentiles of the stage */
+static void
+dlms_stats_tree_setup_add(stats_tree *st, GArray *ms, int stage, const nstime_t *duration)
+{
+    static const int percentiles[] = { 50, 90, 99 };
+    const gchar *name;
+    gint value;
+    guint low, high, middle, i;
+    int node;
+
+    value = (gint)(nstime_to_sec(duration) * 1000);
+    low = 0;
+    high = ms->len;
+    while (low < high) {
+        middle = (low + high) / 2;
+        if (g_array_index(ms, gint, middle) <= value) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    g_array_insert_val(ms, low, value);
+
+    name = val_to_str_const(stage, dlms_setup_stage_names, "Unknown");
+    node = avg_stat_node_add_value(st, name, stats_tree_parent_id_by_name(st, "Connection Setup (ms)"), FALSE, value);
+    for (i = 0; i < array_length(percentiles); i++) {
+        gchar label[32];
+        g_snprintf(label, sizeof label, "%dth percentile", percentiles[i]);
+        set_stat_node(st, label, node, FALSE, g_array_index(ms, gint, (ms->len - 1) * percentiles[i] / 100));
+    }
+}
+
+static int
+dlms_stats_tree_setup_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    const dlms_setup_result *result = pi->frame_data ? pi->frame_data->setup : 0;
+    dlms_setup_samples *samples;
+    unsigned i;
+
+    if (!result) {
+        return 0;
+    }
+    samples = (dlms_setup_samples *)g_hash_table_lookup(dlms_setup_samples_table, st);
+    /* several PDUs of a frame may each end a stage, so only an earlier frame means a retap */
+    if (pinfo->num < samples->last_frame) {
+        for (i = 0; i < array_length(samples->ms); i++) {
+            g_array_set_size(samples->ms[i], 0);
+        }
+    }
+    samples->last_frame = pinfo->num;
+
+    dlms_stats_tree_setup_add(st, samples->ms[result->stage], result->stage, &result->duration);
+    if (result->stage == DLMS_SETUP_FIRST_REQUEST) {
+        dlms_stats_tree_setup_add(st, samples->ms[DLMS_SETUP_STAGES], DLMS_SETUP_STAGES, &result->total);
+    }
+
+    return 1;
+}
+
+/* Statistics of the HDLC links, to tell whether windowing limits the throughput (-z dlms,hdlc) */
+static int dlms_stats_tree_hdlc_node;
+
+static void
+dlms_stats_tree_hdlc_init(stats_tree *st)
+{
+    dlms_stats_tree_hdlc_node = stats_tree_create_node(st, "HDLC Links", 0, TRUE);
+}
+
+static int
+dlms_stats_tree_hdlc_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    const dlms_hdlc_result *result = pi->frame_data ? pi->frame_data->hdlc : 0;
+    const gchar *name;
+    int node;
+
+    if (!result || !(result->flags & (DLMS_HDLC_I_FRAME | DLMS_HDLC_RNR_STALL))) {
+        return 0;
+    }
+    if (pi->association && pi->association->meter) {
+        name = pi->association->meter;
+    } else {
+        name = wmem_strdup_printf(wmem_packet_scope(), "HDLC %s - %s",
+                                  dlms_port_name(wmem_packet_scope(), MIN(pi->srcport, pi->dstport), TRUE),
+                                  dlms_port_name(wmem_packet_scope(), MAX(pi->srcport, pi->dstport), TRUE));
+    }
+    tick_stat_node(st, "HDLC Links", 0, FALSE);
+    node = tick_stat_node(st, name, dlms_stats_tree_hdlc_node, TRUE);
+
+    if (result->flags & DLMS_HDLC_I_FRAME) {
+        tick_stat_node(st, "I Frames", node, FALSE);
+        if (result->flags & DLMS_HDLC_RETRANSMISSION) {
+            tick_stat_node(st, "Retransmissions", node, FALSE);
+        }
+        if (result->flags & DLMS_HDLC_OUT_OF_SEQUENCE) {
+            tick_stat_node(st, "Out Of Sequence", node, FALSE);
+        }
+        if (result->flags & DLMS_HDLC_WINDOW_EXCEEDED) {
+            tick_stat_node(st, "Window Exceeded", node, FALSE);
+        }
+        if (result->flags & DLMS_HDLC_FINAL) {
+            avg_stat_node_add_value(st, "Frames In Window", node, FALSE, result->window);
+            set_stat_node(st, "Negotiated Window Size", node, FALSE, result->negotiated_window);
+        }
+        avg_stat_node_add_value(st, "Information Field Fill (%)", node, FALSE, dlms_hdlc_information_fill(result));
+    }
+    if (result->flags & DLMS_HDLC_RNR_STALL) {
+        avg_stat_node_add_value(st, "RNR Stall Time (ms)", node, FALSE, (gint)(nstime_to_sec(&result->rnr_stall) * 1000));
+    }
+
+    return 1;
+}
+
+/* Summary of the image transfer sessions (-z dlms,image) */
+static int dlms_stats_tree_image_node;
+
+static void
+dlms_stats_tree_image_init(stats_tree *st)
+{
+    dlms_stats_tree_image_node = stats_tree_create_node(st, "Image Transfer Sessions", 0, TRUE);
+}
+
+static int
+dlms_stats_tree_image_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    const dlms_image_result *result = pi->frame_data ? pi->frame_data->image : 0;
+    const gchar *name;
+    int node;
+
+    if (!result) {
+        return 0;
+    }
+    name = wmem_strdup_printf(wmem_packet_scope(), "%s session %u", result->session->meter, result->session->number);
+    tick_stat_node(st, "Image Transfer Sessions", 0, FALSE);
+    node = tick_stat_node(st, name, dlms_stats_tree_image_node, TRUE);
+    set_stat_node(st, "Image Size", node, FALSE, result->image_size);
+    set_stat_node(st, "Block Size", node, FALSE, result->block_size);
+    set_stat_node(st, "Blocks Sent", node, FALSE, result->blocks_sent);
+    set_stat_node(st, "Blocks Transferred", node, FALSE, result->blocks);
+    set_stat_node(st, "Blocks Retransmitted", node, FALSE, result->retransmissions);
+    set_stat_node(st, "Blocks Missing", node, FALSE, result->missing);
+    set_stat_node(st, "Throughput (bytes/s)", node, FALSE, result->throughput);
+    if (result->flags & DLMS_IMAGE_VERIFIED) {
+        set_stat_node(st, "Verify Time (ms)", node, FALSE, (gint)(nstime_to_sec(&result->duration) * 1000));
+    } else if (result->flags & DLMS_IMAGE_ACTIVATED) {
+        set_stat_node(st, "Activate Time (ms)", node, FALSE, (gint)(nstime_to_sec(&result->duration) * 1000));
+    }
+
+    return 1;
+}
+
+/* Push rate, inter-arrival times and clock drift per meter (-z dlms,push) */
+static int dlms_stats_tree_push_node;
+
+static void
+dlms_stats_tree_push_init(stats_tree *st)
 {
-    int i, j;
-    unsigned cs;
-    proto_item *item;
+    dlms_stats_tree_push_node = stats_tree_create_node(st, "Pushes", 0, TRUE);
+}
 
-    cs = 0xffff;
-    for (i = 0; i < length; i++) {
-        cs = cs ^ tvb_get_guint8(tvb, offset + i);
-        for (j = 0; j < 8; j++) {
-            if (cs & 1) {
-                cs = (cs >> 1) ^ 0x8408;
-            } else {
-                cs = cs >> 1;
-            }
+static int
+dlms_stats_tree_push_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    static const struct {
+        double below; /* seconds */
+        const gchar *name;
+    } intervals[] = {
+        { 1, "0 - 1 s" }, { 10, "1 - 10 s" }, { 60, "10 s - 1 min" }, { 900, "1 - 15 min" },
+        { 3600, "15 min - 1 h" }, { 86400, "1 h - 1 day" }, { G_MAXDOUBLE, "1 day or more" },
+    };
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    const dlms_push_result *result = pi->frame_data ? pi->frame_data->push : 0;
+    double seconds;
+    unsigned i;
+    int node, interval_node;
+
+    if (!result) {
+        return 0;
+    }
+    tick_stat_node(st, "Pushes", 0, FALSE);
+    avg_stat_node_add_value(st, "Pushes In The Same Second", dlms_stats_tree_push_node, FALSE, result->same_second);
+    node = tick_stat_node(st, result->meter, dlms_stats_tree_push_node, TRUE);
+    if (result->flags & DLMS_PUSH_INTERVAL) {
+        seconds = nstime_to_sec(&result->interval);
+        interval_node = avg_stat_node_add_value(st, "Inter-Arrival Time (s)", node, TRUE, (gint)seconds);
+        i = 0;
+        while (seconds >= intervals[i].below) {
+            i++;
         }
+        tick_stat_node(st, intervals[i].name, interval_node, FALSE);
+    }
+    if (result->flags & DLMS_PUSH_CLOCK_DRIFT) {
+        avg_stat_node_add_value(st, "Clock Drift (s)", node, FALSE, (gint)nstime_to_sec(&result->clock_drift));
     }
-    cs = cs ^ 0xffff;
 
-    item = proto_tree_add_item(tree, hfi, tvb, offset + length, 2, ENC_NA);
-    if (tvb_get_letohs(tvb, offset + length) != cs) {
-        expert_add_info(pinfo, item, &dlms_ei.check_sequence);
-    }        
+    return 1;
 }
 
-/* Dissect the information field of an HDLC (SNRM or UA) frame */
+/* Invocation counter gaps, duplicates and regressions of the ciphered APDUs per meter (-z dlms,security) */
+static int dlms_stats_tree_security_node;
+
 static void
-dlms_dissect_hdlc_information(tvbuff_t *tvb, proto_tree *tree, gint *offset)
+dlms_stats_tree_security_init(stats_tree *st)
 {
-    proto_tree *subtree;
+    dlms_stats_tree_security_node = stats_tree_create_node(st, "Ciphered APDUs", 0, TRUE);
+}
 
-    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.hdlc_information, 0, "Information");
-    unsigned format = tvb_get_guint8(tvb, *offset);
-    *offset += 1;
-    if (format == 0x81) { /* format identifier */
-        unsigned group = tvb_get_guint8(tvb, *offset);
-        *offset += 1;
-        if (group == 0x80) { /* group identifier */
-            unsigned i, length = tvb_get_guint8(tvb, *offset);
-            *offset += 1;
-            for (i = 0; i < length; ) { /* parameters */
-                proto_item *item;
-                unsigned parameter = tvb_get_guint8(tvb, *offset);
-                unsigned j, parameter_length = tvb_get_guint8(tvb, *offset + 1);
-                unsigned value = 0;
-                for (j = 0; j < parameter_length; j++) {
-                    value = (value << 8) + tvb_get_guint8(tvb, *offset + 2 + j);
-                }
-                item = proto_tree_add_item(subtree, &dlms_hfi.hdlc_parameter, tvb, *offset, 2 + parameter_length, ENC_NA);
-                proto_item_set_text(item, "%s: %u",
-                    parameter == 5 ? "Maximum Information Field Length Transmit" :
-                    parameter == 6 ? "Maximum Information Field Length Receive" :
-                    parameter == 7 ? "Window Size Transmit" :
-                    parameter == 8 ? "Window Size Receive" :
-                    "Unknown Information Field Parameter",
-                    value);
-                i += 2 + parameter_length;
-                *offset += 2 + parameter_length;
-            }
-        }
+static int
+dlms_stats_tree_security_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    const dlms_security_result *result = pi->frame_data ? pi->frame_data->security : 0;
+    int node;
+
+    if (!result) {
+        return 0;
     }
+    tick_stat_node(st, "Ciphered APDUs", 0, FALSE);
+    node = tick_stat_node(st, result->meter ? result->meter : result->sender, dlms_stats_tree_security_node, TRUE);
+    node = tick_stat_node(st, result->sender, node, TRUE);
+    if (result->flags & DLMS_SECURITY_GAP) {
+        tick_stat_node(st, "Gaps", node, FALSE);
+        increase_stat_node(st, "APDUs Lost", node, FALSE, result->lost);
+    } else if (result->flags & DLMS_SECURITY_DUPLICATE) {
+        tick_stat_node(st, "Duplicates", node, FALSE);
+    } else if (result->flags & DLMS_SECURITY_REGRESSION) {
+        tick_stat_node(st, "Regressions", node, FALSE);
+    }
+
+    return 1;
 }
 
-/* Dissect a DLMS APDU in an HDLC frame */
+/* Evictions of reassembly chains and pending bytes (-z dlms,reassembly) */
+static int dlms_stats_tree_reassembly_node;
+
 static void
-dlms_dissect_hdlc(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+dlms_stats_tree_reassembly_init(stats_tree *st)
 {
-    proto_tree *subtree, *subsubtree;
-    proto_item *item;
-    fragment_head *frags;
-    tvbuff_t *rtvb; /* reassembled tvb */
-    unsigned length, segmentation, control;
+    dlms_stats_tree_reassembly_node = stats_tree_create_node(st, "Evicted Reassemblies", 0, TRUE);
+    stats_tree_create_node(st, "Evicted Bytes", 0, FALSE);
+    stats_tree_create_node(st, "Discarded Fragments", 0, FALSE);
+}
 
-    subtree = proto_tree_add_subtree(tree, tvb, 0, 0, dlms_ett.hdlc, 0, "HDLC");
+static int
+dlms_stats_tree_reassembly_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    const dlms_reassembly_result *result = pi->frame_data ? pi->frame_data->reassembly : 0;
+    guint32 reason;
 
-    /* Opening flag */
-    proto_tree_add_item(subtree, &dlms_hfi.hdlc_flag, tvb, 0, 1, ENC_NA);
+    if (!result) {
+        return 0;
+    }
+    for (reason = 1; reason < DLMS_EVICTED_REASONS; reason++) {
+        if (result->evictions[reason]) {
+            increase_stat_node(st, "Evicted Reassemblies", 0, FALSE, result->evictions[reason]);
+            increase_stat_node(st, val_to_str_const(reason, dlms_evicted_names, "Unknown"),
+                               dlms_stats_tree_reassembly_node, FALSE, result->evictions[reason]);
+        }
+    }
+    increase_stat_node(st, "Evicted Bytes", 0, FALSE, result->evicted_bytes);
+    increase_stat_node(st, "Discarded Fragments", 0, FALSE, result->discarded);
+    avg_stat_node_add_value(st, "Pending Bytes", 0, FALSE, (gint)result->pending_bytes);
 
-    /* Frame format field */
-    subsubtree = proto_tree_add_subtree(subtree, tvb, 1, 2, dlms_ett.hdlc_format, 0, "Frame Format");
-    proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_type, tvb, 1, 2, ENC_BIG_ENDIAN);
-    proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_segmentation, tvb, 1, 2, ENC_BIG_ENDIAN);
-    segmentation = (tvb_get_ntohs(tvb, 1) >> 11) & 1;
-    proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_length, tvb, 1, 2, ENC_BIG_ENDIAN);
-    length = tvb_get_ntohs(tvb, 1) & 0x7ff; /* length of HDLC frame excluding the opening and closing flag fields */
+    return 1;
+}
 
-    /* Destination address field */
-    subsubtree = proto_tree_add_subtree(subtree, tvb, 3, 1, dlms_ett.hdlc_address, 0, "Destination Address");
-    proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_address, tvb, 3, 1, ENC_NA);
+/*
+ * Export of the Data values (-z dlms,export,jsonl|datexml,file[,filter]):
+ * one record per planar value in JSON Lines, or one Record element per Data
+ * value in XML, written as they are decoded from the packet bytes, without
+ * building a tree. The Record element is our own; only the Data inside it
+ * takes the form of the Data elements of the XML representation of the DLMS
+ * Green Book, which is not the Green Book XML of the whole PDU.
+ */
+struct dlms_export {
+    FILE *out;
+    gboolean xml;
+};
+typedef struct dlms_export dlms_export;
+
+/* State of the export of one Data value */
+struct dlms_export_context {
+    FILE *out;
+    const guint8 *data;
+    packet_info *pinfo;
+    const gchar *meter;
+    const gchar *member; /* the obis, class_id and attribute or method fields (JSON Lines) */
+    gboolean date_time; /* whether the attribute is a date-time octet-string (JSON Lines) */
+    unsigned counters[DLMS_CORE_MAX_DEPTH + 1]; /* element number at each depth (JSON Lines) */
+    unsigned open; /* number of open Array and Structure elements (XML) */
+    guint8 open_choices[DLMS_CORE_MAX_DEPTH + 1]; /* their data types (XML) */
+};
+typedef struct dlms_export_context dlms_export_context;
 
-    /* Source address field */
-    subsubtree = proto_tree_add_subtree(subtree, tvb, 4, 1, dlms_ett.hdlc_address, 0, "Source Address");
-    proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_address, tvb, 4, 1, ENC_NA);
+static const char *
+dlms_export_type_name(unsigned choice)
+{
+    static const char *const names[] = {
+        "null-data", "array", "structure", "boolean", "bit-string", "double-long",
+        "double-long-unsigned", 0, 0, "octet-string", "visible-string", 0, "utf8-string",
+        "bcd", 0, "integer", "long", "unsigned", "long-unsigned", "compact-array", "long64",
+        "long64-unsigned", "enum", "float32", "float64", "date-time", "date", "time"
+    };
+    if (choice == 255) return "dont-care";
+    if (choice < array_length(names) && names[choice]) return names[choice];
+    return "unknown";
+}
 
-    /* Control field */
-    subsubtree = proto_tree_add_subtree(subtree, tvb, 5, 1, dlms_ett.hdlc_control, 0, "Control");
-    control = tvb_get_guint8(tvb, 5);
+/* Element names of the data types in the XML representation */
+static const char *
+dlms_export_xml_name(unsigned choice)
+{
+    static const char *const names[] = {
+        "NullData", "Array", "Structure", "Boolean", "BitString", "Int32",
+        "UInt32", 0, 0, "OctetString", "String", 0, "Utf8String",
+        "Bcd", 0, "Int8", "Int16", "UInt8", "UInt16", "CompactArray", "Int64",
+        "UInt64", "Enum", "Float32", "Float64", "DateTime", "Date", "Time"
+    };
+    if (choice == 255) return "DontCare";
+    if (choice < array_length(names) && names[choice]) return names[choice];
+    return "Unknown";
+}
 
-    /* Header check sequence field */
-    if (length > 7) {
-        dlms_dissect_hdlc_check_sequence(tvb, pinfo, subtree, 1, 5, &dlms_hfi.hdlc_hcs);
-    }
+/* Write a string as a JSON string, or as an XML attribute value */
+static void
+dlms_export_string(FILE *out, const guint8 *s, size_t length, gboolean xml)
+{
+    size_t i;
 
-    /* Control sub-fields and information field */
-    if ((control & 0x01) == 0x00) {
-        col_add_str(pinfo->cinfo, COL_INFO, "HDLC I"); /* Information */
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_i, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_rsn, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_ssn, tvb, 5, 1, ENC_NA);
-
-        subsubtree = proto_tree_add_subtree_format(subtree, tvb, 8, length - 9, dlms_ett.hdlc_information, 0, "Information Field (length %u)", length - 9);
-        frags = fragment_add_seq_next(&dlms_reassembly_table, tvb, 8, pinfo, DLMS_REASSEMBLY_ID_HDLC, 0, length - 9, segmentation);
-        rtvb = process_reassembled_data(tvb, 8, pinfo, "Reassembled", frags, &dlms_fragment_items, 0, tree);
-        if (rtvb) {
-            proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_llc, rtvb, 0, 3, ENC_NA);
-            dlms_dissect_apdu(rtvb, pinfo, tree, 3);
-        }
-    } else if ((control & 0x0f) == 0x01) {
-        col_set_str(pinfo->cinfo, COL_INFO, "HDLC RR"); /* Receive Ready */
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_rr_rnr, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_rsn, tvb, 5, 1, ENC_NA);
-    } else if ((control & 0x0f) == 0x05) {
-        col_set_str(pinfo->cinfo, COL_INFO, "HDLC RNR"); /* Receive Not Ready */
-        item = proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_rr_rnr, tvb, 5, 1, ENC_NA);
-        expert_add_info(pinfo, item, &dlms_ei.no_success);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_rsn, tvb, 5, 1, ENC_NA);
-    } else if ((control & 0xef) == 0x83) { /* Set Normal Response Mode */
-        col_set_str(pinfo->cinfo, COL_INFO, "HDLC SNRM");
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-        if (length > 7) {
-            gint offset = 8;
-            dlms_dissect_hdlc_information(tvb, subtree, &offset);
-        }
-    } else if ((control & 0xef) == 0x43) {
-        col_set_str(pinfo->cinfo, COL_INFO, "HDLC DISC"); /* Disconnect */
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-    } else if ((control & 0xef) == 0x63) {
-        col_set_str(pinfo->cinfo, COL_INFO, "HDLC UA"); /* Unnumbered Acknowledge */
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-        if (length > 7) {
-            gint offset = 8;
-            dlms_dissect_hdlc_information(tvb, subtree, &offset);
+    putc('"', out);
+    for (i = 0; i < length; i++) {
+        if (xml && s[i] == '&') {
+            fputs("&amp;", out);
+        } else if (xml && s[i] == '<') {
+            fputs("&lt;", out);
+        } else if (xml && s[i] == '"') {
+            fputs("&quot;", out);
+        } else if (xml && (s[i] < 0x20 || s[i] >= 0x7f)) {
+            fprintf(out, "&#x%x;", s[i]);
+        } else if (!xml && (s[i] == '"' || s[i] == '\\')) {
+            putc('\\', out);
+            putc(s[i], out);
+        } else if (!xml && (s[i] < 0x20 || s[i] >= 0x7f)) {
+            fprintf(out, "\\u%04x", s[i]);
+        } else {
+            putc(s[i], out);
         }
-    } else if ((control & 0xef) == 0x0f) {
-        col_set_str(pinfo->cinfo, COL_INFO, "HDLC DM"); /* Disconnected Mode */
-        item = proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, 5, 1, ENC_NA);
-        expert_add_info(pinfo, item, &dlms_ei.no_success);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-    } else if ((control & 0xef) == 0x87) {
-        col_set_str(pinfo->cinfo, COL_INFO, "HDLC FRMR"); /* Frame Reject */
-        item = proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, 5, 1, ENC_NA);
-        expert_add_info(pinfo, item, &dlms_ei.no_success);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-    } else if ((control & 0xef) == 0x03) {
-        col_set_str(pinfo->cinfo, COL_INFO, "HDLC UI"); /* Unnumbered Information */
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_frame_other, tvb, 5, 1, ENC_NA);
-        proto_tree_add_item(subsubtree, &dlms_hfi.hdlc_pf, tvb, 5, 1, ENC_NA);
-    } else {
-        col_set_str(pinfo->cinfo, COL_INFO, "Unknown HDLC frame");
     }
+    putc('"', out);
+}
 
-    /* Frame check sequence field */
-    dlms_dissect_hdlc_check_sequence(tvb, pinfo, subtree, 1, length - 2, &dlms_hfi.hdlc_fcs);
+/* Write bytes in hexadecimal, in uppercase as in the XML representation */
+static void
+dlms_export_hex(FILE *out, const guint8 *data, size_t length, gboolean xml)
+{
+    size_t i;
 
-    /* Closing flag */
-    proto_tree_add_item(subtree, &dlms_hfi.hdlc_flag, tvb, length + 1, 1, ENC_NA);
+    for (i = 0; i < length; i++) {
+        fprintf(out, xml ? "%02X" : "%02x", data[i]);
+    }
 }
 
-/* Dissect a DLMS APDU in an IEC 61334-4-32 convergence layer data frame (PLC) */
-static void
-dlms_dissect_432(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+/* Whether an attribute is a date-time in an octet-string, to write it as a date and time rather than bytes */
+static gboolean
+dlms_export_is_date_time(const dlms_class_value *descriptor)
 {
-    proto_tree_add_item(tree, &dlms_hfi.iec432llc, tvb, 0, 3, ENC_NA);
-    dlms_dissect_apdu(tvb, pinfo, tree, 3);
+    static const unsigned attributes[][2] = {
+        { 4, 5 }, /* Extended register capture_time */
+        { 5, 6 }, /* Demand register capture_time */
+        { 5, 7 }, /* Demand register start_time_current */
+        { 8, 2 }, /* Clock time */
+        { 8, 5 }, /* Clock daylight_savings_begin */
+        { 8, 6 }, /* Clock daylight_savings_end */
+        { 20, 10 }, /* Activity calendar activate_passive_calendar_time */
+    };
+    unsigned i;
+
+    if (!descriptor || descriptor->is_method) return FALSE;
+    for (i = 0; i < array_length(attributes); i++) {
+        if (descriptor->class_id == attributes[i][0] && descriptor->member_id == attributes[i][1]) return TRUE;
+    }
+    return FALSE;
+}
+
+static void *
+dlms_export_jsonl_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    dlms_export_context *c = (dlms_export_context *)context;
+
+    if (d->depth < DLMS_CORE_MAX_DEPTH) {
+        c->counters[d->depth]++;
+        c->counters[d->depth + 1] = 0;
+    }
+    return parent;
 }
 
-/* Dissect a DLMS APDU in a Wrapper Protocol Data Unit (TCP/UDP/IP) */
 static void
-dlms_dissect_wrapper(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+dlms_export_jsonl_end(void *context, void *parent, void *element_parent, const dlms_core_data *d)
 {
-    proto_tree_add_item(tree, &dlms_hfi.wrapper_header, tvb, 0, 8, ENC_NA);
-    dlms_dissect_apdu(tvb, pinfo, tree, 8);
 }
 
-static int
-dlms_dissect(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+static void
+dlms_export_jsonl_value(void *context, void *parent, const dlms_core_data *d)
 {
-    header_field_info *hfi;
-    proto_item *item;
-    proto_tree *subtree;
-    unsigned first_byte;
+    dlms_export_context *c = (dlms_export_context *)context;
+    const guint8 *contents = c->data + d->contents_offset;
+    dlms_core_date_time dt;
+    unsigned i;
 
-    col_set_str(pinfo->cinfo, COL_PROTOCOL, "DLMS");
+    if (d->depth <= DLMS_CORE_MAX_DEPTH) {
+        c->counters[d->depth]++;
+    }
+    fprintf(c->out, "{\"time\":%ld.%09d,\"frame\":%u,\"meter\":",
+            (long)c->pinfo->abs_ts.secs, c->pinfo->abs_ts.nsecs, c->pinfo->num);
+    dlms_export_string(c->out, (const guint8 *)c->meter, strlen(c->meter), FALSE);
+    fprintf(c->out, "%s,\"path\":\"", c->member);
+    for (i = 1; i <= d->depth && i <= DLMS_CORE_MAX_DEPTH; i++) {
+        fprintf(c->out, i > 1 ? ".%u" : "%u", c->counters[i]);
+    }
+    fprintf(c->out, "\",\"type\":\"%s\",\"value\":", dlms_export_type_name(d->choice));
+    switch (d->choice) {
+    case 0:
+        fputs("null", c->out);
+        break;
+    case 3:
+        fputs(d->value.u ? "true" : "false", c->out);
+        break;
+    case 5: case 15: case 16: case 20:
+        fprintf(c->out, "%" G_GINT64_MODIFIER "d", (gint64)d->value.i);
+        break;
+    case 6: case 13: case 17: case 18: case 21: case 22:
+        fprintf(c->out, "%" G_GINT64_MODIFIER "u", (guint64)d->value.u);
+        break;
+    case 23: case 24:
+        if (d->value.f == d->value.f && d->value.f - d->value.f == 0) {
+            fprintf(c->out, d->choice == 23 ? "%.9g" : "%.17g", d->value.f);
+        } else {
+            fputs("null", c->out); /* NaN and infinities have no JSON number */
+        }
+        break;
+    case 10: case 12:
+        dlms_export_string(c->out, contents, d->length, FALSE);
+        break;
+    case 9: case 25:
+        if ((d->choice == 25 || (c->date_time && d->depth == 0 && d->length == 12))
+            && dlms_core_parse_date_time(contents, 12, &dt) == DLMS_CORE_OK) {
+            fprintf(c->out, "\"%04u-%02u-%02u %02u:%02u:%02u.%02u\"",
+                    dt.year, dt.month, dt.day_of_month, dt.hour, dt.minute, dt.second, dt.hundredths);
+            break;
+        }
+        /* fall through */
+    default: /* bytes in hexadecimal */
+        putc('"', c->out);
+        dlms_export_hex(c->out, contents, d->choice == 4 ? (d->length + 7) / 8 : d->length, FALSE);
+        putc('"', c->out);
+        break;
+    }
+    fputs("}\n", c->out);
+}
 
-    hfi = proto_registrar_get_nth(dlms_proto);
-    item = proto_tree_add_item(tree, hfi, tvb, 0, -1, ENC_NA);
-    subtree = proto_item_add_subtree(item, dlms_ett.dlms);
+static void *
+dlms_export_xml_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    dlms_export_context *c = (dlms_export_context *)context;
 
-    first_byte = tvb_get_guint8(tvb, 0);
-    if (first_byte == 0x7e) {
-        dlms_dissect_hdlc(tvb, pinfo, subtree);
-    } else if (first_byte == 0x90) {
-        dlms_dissect_432(tvb, pinfo, subtree);
-    } else if (first_byte == 0) {
-        dlms_dissect_wrapper(tvb, pinfo, subtree);
-    } else {
-        dlms_dissect_apdu(tvb, pinfo, subtree, 0);
+    /* The elements of a compact array are written as those of an array */
+    fprintf(c->out, "<%s Qty=\"%04X\">", d->choice == 2 ? "Structure" : "Array", d->length);
+    if (c->open < array_length(c->open_choices)) {
+        c->open_choices[c->open++] = (guint8)d->choice;
     }
-
-    return tvb_captured_length(tvb);
+    return parent;
 }
 
 static void
-dlms_register_protoinfo(void)
+dlms_export_xml_end(void *context, void *parent, void *element_parent, const dlms_core_data *d)
 {
-    dlms_proto = proto_register_protocol("Device Language Message Specification", "DLMS", "dlms");
+    dlms_export_context *c = (dlms_export_context *)context;
 
-    /* Register the dlms_hfi header field info structures */
-    {
-        header_field_info *hfi[sizeof(dlms_hfi) / sizeof(header_field_info)];
-        unsigned i;
-        for (i = 0; i < array_length(hfi); i++) {
-            hfi[i] = (header_field_info *)&dlms_hfi + i;
-        }
-        proto_register_fields(dlms_proto, hfi, array_length(hfi));
+    fputs(d->choice == 2 ? "</Structure>" : "</Array>", c->out);
+    if (c->open) {
+        c->open--;
     }
+}
 
-    /* Initialise and register the dlms_ett protocol subtree indices */
-    {
-        gint *ett[sizeof(dlms_ett) / sizeof(gint)];
-        unsigned i;
-        for (i = 0; i < array_length(ett); i++) {
-            ett[i] = (gint *)&dlms_ett + i;
-            *ett[i] = -1;
+static void
+dlms_export_xml_value(void *context, void *parent, const dlms_core_data *d)
+{
+    dlms_export_context *c = (dlms_export_context *)context;
+    const guint8 *contents = c->data + d->contents_offset;
+    unsigned i;
+
+    fprintf(c->out, "<%s", dlms_export_xml_name(d->choice));
+    switch (d->choice) {
+    case 0: case 255:
+        break;
+    case 3:
+        fputs(d->value.u ? " Value=\"true\"" : " Value=\"false\"", c->out);
+        break;
+    case 4:
+        fputs(" Value=\"", c->out);
+        for (i = 0; i < d->length; i++) {
+            putc(contents[i / 8] & (0x80 >> (i % 8)) ? '1' : '0', c->out);
         }
-        proto_register_subtree_array(ett, array_length(ett));
+        putc('"', c->out);
+        break;
+    case 10: case 12:
+        fputs(" Value=", c->out);
+        dlms_export_string(c->out, contents, d->length, TRUE);
+        break;
+    case 9:
+        fputs(" Value=\"", c->out);
+        dlms_export_hex(c->out, contents, d->length, TRUE);
+        putc('"', c->out);
+        break;
+    default: /* the contents in hexadecimal */
+        fputs(" Value=\"", c->out);
+        dlms_export_hex(c->out, c->data + d->offset + !d->compact, d->end_offset - d->offset - !d->compact, TRUE);
+        putc('"', c->out);
+        break;
     }
+    fputs(" />", c->out);
+}
 
-    /* Register the dlms_ei expert info fields */
-    {
-        static ei_register_info ei[] = {
-            { &dlms_ei.no_success, { "dlms.no_success", PI_RESPONSE_CODE, PI_NOTE, "No success response", EXPFILL } },
-            { &dlms_ei.not_implemented, { "dlms.not_implemented", PI_UNDECODED, PI_WARN, "Not implemented in the DLMS dissector", EXPFILL } },
-            { &dlms_ei.check_sequence, { "dlms.check_sequence", PI_CHECKSUM, PI_WARN, "Bad HDLC check sequence field value", EXPFILL } },
-        };
-        expert_module_t *em = expert_register_protocol(dlms_proto);
-        expert_register_field_array(em, ei, array_length(ei));
+static gboolean
+dlms_export_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+    static const dlms_core_data_visitor jsonl_visitor = {
+        dlms_export_jsonl_begin, dlms_export_jsonl_end, dlms_export_jsonl_value
+    };
+    static const dlms_core_data_visitor xml_visitor = {
+        dlms_export_xml_begin, dlms_export_xml_end, dlms_export_xml_value
+    };
+    const dlms_export *export = (const dlms_export *)tapdata;
+    const dlms_packet_info *pi = (const dlms_packet_info *)data;
+    const dlms_export_value *value;
+    const dlms_class_value *descriptor;
+    const gchar *meter;
+    dlms_export_context c;
+    gchar obis[32], member[96];
+    size_t size, position;
+    guint i;
+
+    if (!pi->values) {
+        return FALSE;
     }
+    meter = pi->association && pi->association->meter ? pi->association->meter : "";
+    for (i = 0; i < wmem_array_get_count(pi->values); i++) {
+        value = (const dlms_export_value *)wmem_array_index(pi->values, i);
+        descriptor = value->descriptor;
+        if (descriptor) {
+            g_snprintf(obis, sizeof obis, "%u-%u:%u.%u.%u*%u",
+                       (unsigned)(descriptor->instance_id >> 40) & 0xff, (unsigned)(descriptor->instance_id >> 32) & 0xff,
+                       (unsigned)(descriptor->instance_id >> 24) & 0xff, (unsigned)(descriptor->instance_id >> 16) & 0xff,
+                       (unsigned)(descriptor->instance_id >> 8) & 0xff, (unsigned)descriptor->instance_id & 0xff);
+        }
 
-    /* Register the reassembly table */
-    {
-        static const reassembly_table_functions f = {
-            dlms_reassembly_hash_func,
-            dlms_reassembly_equal_func,
-            dlms_reassembly_key_func,
-            dlms_reassembly_key_func,
-            dlms_reassembly_free_key_func,
-            dlms_reassembly_free_key_func,
-        };
-        reassembly_table_init(&dlms_reassembly_table, &f);
+        memset(&c, 0, sizeof c);
+        c.out = export->out;
+        c.pinfo = pinfo;
+        c.meter = meter;
+        c.data = dlms_get_data(value->tvb, &size);
+        position = (size_t)value->offset;
+        if (dlms_core_skip_data(c.data, size, &position) != DLMS_CORE_OK) {
+            continue; /* truncated or invalid, so no record rather than a partial one */
+        }
+        position = (size_t)value->offset;
+        if (export->xml) {
+            fprintf(c.out, "<Record Time=\"%ld.%09d\" Frame=\"%u\" Meter=", (long)pinfo->abs_ts.secs, pinfo->abs_ts.nsecs, pinfo->num);
+            dlms_export_string(c.out, (const guint8 *)meter, strlen(meter), TRUE);
+            if (descriptor) {
+                fprintf(c.out, " ClassId=\"%u\" Obis=\"%s\" %s=\"%u\"", descriptor->class_id, obis,
+                        descriptor->is_method ? "MethodId" : "AttributeId", descriptor->member_id);
+            }
+            fputs("><Data>", c.out);
+            if (dlms_core_parse_data(c.data, size, &position, &xml_visitor, &c, 0) != DLMS_CORE_OK) {
+                while (c.open) { /* close the elements left open by the error */
+                    fputs(c.open_choices[--c.open] == 2 ? "</Structure>" : "</Array>", c.out);
+                }
+            }
+            fputs("</Data></Record>\n", c.out);
+        } else {
+            member[0] = 0;
+            if (descriptor) {
+                g_snprintf(member, sizeof member, ",\"obis\":\"%s\",\"class_id\":%u,\"%s\":%u", obis, descriptor->class_id,
+                           descriptor->is_method ? "method" : "attribute", descriptor->member_id);
+            }
+            c.member = member;
+            c.date_time = dlms_export_is_date_time(descriptor);
+            dlms_core_parse_data(c.data, size, &position, &jsonl_visitor, &c, 0);
+        }
     }
 
-    /* Register the DLMS dissector and the UDP port assigned by IANA for DLMS */
-    {
-        dissector_handle_t dh = register_dissector("DLMS", dlms_dissect, dlms_proto);
-        dissector_add_uint("udp.port", 4059, dh);
+    return FALSE;
+}
+
+static void
+dlms_export_draw(void *tapdata)
+{
+    fflush(((dlms_export *)tapdata)->out);
+}
+
+static void
+dlms_export_init(const char *opt_arg, void *userdata)
+{
+    dlms_export *export;
+    gchar **args;
+    GString *error;
+    FILE *out;
+
+    /* dlms,export,format,file[,filter] */
+    args = g_strsplit(opt_arg, ",", 5);
+    if (g_strv_length(args) < 4 || (strcmp(args[2], "jsonl") && strcmp(args[2], "datexml"))) {
+        report_failure("Usage: -z dlms,export,jsonl|datexml,file[,filter]");
+        g_strfreev(args);
+        return;
+    }
+    out = strcmp(args[3], "-") ? ws_fopen(args[3], "w") : stdout;
+    if (!out) {
+        report_failure("Cannot open %s for the DLMS export: %s", args[3], g_strerror(errno));
+        g_strfreev(args);
+        return;
+    }
+    setvbuf(out, 0, _IOFBF, 1 << 20);
+
+    export = g_new0(dlms_export, 1);
+    export->out = out;
+    export->xml = strcmp(args[2], "datexml") == 0;
+    error = register_tap_listener("dlms", export, args[4], TL_REQUIRES_NOTHING, 0, dlms_export_packet, dlms_export_draw);
+    if (error) {
+        report_failure("Cannot register the DLMS export: %s", error->str);
+        g_string_free(error, TRUE);
+        g_free(export);
+    } else {
+        dlms_export_listeners++;
     }
+    g_strfreev(args);
+}
+
+static void
+dlms_register_tap_listeners(void)
+{
+    static stat_tap_ui export_ui = { REGISTER_STAT_GROUP_GENERIC, 0, "dlms,export", dlms_export_init, 0, 0 };
+
+    stats_tree_register_plugin("dlms", "dlms,meters", "DLMS/Meters", 0,
+                               dlms_stats_tree_meters_packet, dlms_stats_tree_meters_init, 0);
+    stats_tree_register_plugin("dlms", "dlms,setup", "DLMS/Connection Setup", 0,
+                               dlms_stats_tree_setup_packet, dlms_stats_tree_setup_init, dlms_stats_tree_setup_cleanup);
+    stats_tree_register_plugin("dlms", "dlms,hdlc", "DLMS/HDLC Links", 0,
+                               dlms_stats_tree_hdlc_packet, dlms_stats_tree_hdlc_init, 0);
+    stats_tree_register_plugin("dlms", "dlms,image", "DLMS/Image Transfers", 0,
+                               dlms_stats_tree_image_packet, dlms_stats_tree_image_init, 0);
+    stats_tree_register_plugin("dlms", "dlms,push", "DLMS/Pushes", 0,
+                               dlms_stats_tree_push_packet, dlms_stats_tree_push_init, 0);
+    stats_tree_register_plugin("dlms", "dlms,security", "DLMS/Invocation Counters", 0,
+                               dlms_stats_tree_security_packet, dlms_stats_tree_security_init, 0);
+    stats_tree_register_plugin("dlms", "dlms,reassembly", "DLMS/Reassembly", 0,
+                               dlms_stats_tree_reassembly_packet, dlms_stats_tree_reassembly_init, 0);
+    register_stat_tap_ui(&export_ui, 0);
 }
 
 /*
@@ -2124,8 +6744,11 @@ WS_DLL_PUBLIC_DEF void
 plugin_register(void)
 {
     static proto_plugin p;
+    static tap_plugin t;
     p.register_protoinfo = dlms_register_protoinfo;
     proto_register_plugin(&p);
+    t.register_tap_listener = dlms_register_tap_listeners;
+    tap_register_plugin(&t);
 }
 
 #else /* wireshark < 2.6 */
@@ -2137,4 +6760,10 @@ plugin_register(void)
     dlms_register_protoinfo();
 }
 
+WS_DLL_PUBLIC_DEF void
+plugin_register_tap_listener(void)
+{
+    dlms_register_tap_listeners();
+}
+
 #endif
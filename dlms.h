@@ -0,0 +1,68 @@
+/*
+ * dlms.h - Interface of the DLMS dissector plugin for other dissectors
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Dissectors of manufacturer-specific (or any other) COSEM classes plug
+ * into the DLMS dissector in two ways:
+ *
+ * - The names of a class, its attributes and its methods are registered
+ *   with dlms_register_class, and used in the COSEM descriptors.
+ *
+ * - A dissector registered for a class_id in the "dlms.class_id" dissector
+ *   table (with dissector_add_uint, or DissectorTable.get in Lua) is handed
+ *   the values of the attributes and the parameters of the methods of the
+ *   class: those of Get-Response-Normal, Set-Request-Normal,
+ *   Event-Notification-Request, Action-Request-Normal and
+ *   Action-Response-Normal APDUs. The tvb holds the A-XDR encoded Data,
+ *   which the DLMS dissector has already added to the tree, and the data
+ *   is a dlms_class_value that tells which attribute or method it is.
+ */
+
+#ifndef DLMS_H
+#define DLMS_H
+
+#include <ws_symbol_export.h>
+
+#ifndef DLMS_PUBLIC
+#define DLMS_PUBLIC WS_DLL_PUBLIC
+#endif
+
+#define DLMS_CLASS_ID_TABLE "dlms.class_id"
+
+/* The attribute or method whose value the dlms.class_id dissectors are handed */
+struct dlms_class_value {
+    unsigned class_id;
+    guint64 instance_id; /* OBIS code, in the 48 low-order bits */
+    unsigned member_id; /* attribute_id or method_id */
+    gboolean is_method;
+};
+typedef struct dlms_class_value dlms_class_value;
+
+/*
+ * Register the names of a class, adding it or replacing the built-in one.
+ * The attributes are the names of attribute 2 onwards (attribute 1 is always
+ * logical_name) and the methods those of method 1 onwards, each terminated
+ * by a NULL pointer; names past the 19th attribute and the 11th method are
+ * left out. The strings are not copied.
+ */
+DLMS_PUBLIC void
+dlms_register_class(unsigned class_id, const char *name, const char *const *attributes, const char *const *methods);
+
+#endif
@@ -0,0 +1,1261 @@
+/*
+ * dlms_bench.c - Synthetic DLMS captures and decoding benchmark
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Usage: dlms-bench [-s scale] [-n runs] [-w directory] [scenario ...]
+ *        dlms-bench -r cases
+ *
+ * Each scenario is a capture generated from a fixed seed, so the same scale
+ * gives the same bytes on every run and every commit. Without -w, each
+ * scenario is generated and decoded with the decoding core in a child process,
+ * repeatedly for at least 100 ms per run. The best of the runs is reported
+ * as frames/s and MB/s of capture, along with the peak resident set size of
+ * the child. The number of decoded values is reported too, and should not
+ * change between commits. This is a micro-benchmark of the decoding core:
+ * the throughput of the dissector is that measured with tshark by bench.sh.
+ *
+ * With -w, the captures are written to directory/scenario.pcap instead,
+ * to benchmark the dissector with tshark (see bench.sh). The wrapper-tcp
+ * scenario needs "-d tcp.port==4059,DLMS" as DLMS is only registered on UDP.
+ *
+ * With -r, the encoder and the decoding core are checked against each other
+ * on the given number of random cases instead.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "dlms_encode.h"
+
+/* A growable byte buffer */
+struct buffer {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+};
+
+static void
+buffer_reserve(struct buffer *b, size_t n)
+{
+    if (b->capacity - b->length < n) {
+        size_t capacity = b->capacity ? b->capacity : 256;
+        while (capacity - b->length < n) {
+            capacity *= 2;
+        }
+        b->data = realloc(b->data, capacity);
+        if (!b->data) {
+            perror("realloc");
+            exit(1);
+        }
+        b->capacity = capacity;
+    }
+}
+
+static void
+buffer_append(struct buffer *b, const void *data, size_t n)
+{
+    buffer_reserve(b, n);
+    memcpy(b->data + b->length, data, n);
+    b->length += n;
+}
+
+static void
+put_8(struct buffer *b, unsigned value)
+{
+    uint8_t v = (uint8_t)value;
+    buffer_append(b, &v, 1);
+}
+
+static void
+put_16(struct buffer *b, unsigned value)
+{
+    put_8(b, value >> 8);
+    put_8(b, value);
+}
+
+static void
+put_32(struct buffer *b, uint32_t value)
+{
+    put_16(b, value >> 16);
+    put_16(b, value & 0xffff);
+}
+
+static void
+put_le_16(struct buffer *b, unsigned value)
+{
+    put_8(b, value);
+    put_8(b, value >> 8);
+}
+
+static void
+put_le_32(struct buffer *b, uint32_t value)
+{
+    put_le_16(b, value & 0xffff);
+    put_le_16(b, value >> 16);
+}
+
+/* Deterministic pseudo-random numbers (xorshift64*) */
+static uint64_t rng_state;
+
+static uint32_t
+rng(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 2685821657736338717u) >> 32);
+}
+
+/* Data */
+
+static void
+encode_date_time(dlms_encoder *e, unsigned minutes)
+{
+    dlms_core_date_time dt;
+
+    dt.year = 2018;
+    dt.month = 1 + minutes / 44640 % 12;
+    dt.day_of_month = 1 + minutes / 1440 % 28;
+    dt.day_of_week = 0xff;
+    dt.hour = minutes / 60 % 24;
+    dt.minute = minutes % 60;
+    dt.second = 0;
+    dt.hundredths = 0;
+    dlms_encode_date_time(e, &dt);
+}
+
+/* Encode a profile generic buffer of rows of a date-time and columns - 1 values */
+static void
+encode_profile(dlms_encoder *e, unsigned rows, unsigned columns)
+{
+    unsigned i, j;
+
+    dlms_encode_array(e, rows);
+    for (i = 0; i < rows; i++) {
+        dlms_encode_structure(e, columns);
+        encode_date_time(e, i * 15);
+        for (j = 1; j < columns; j++) {
+            if (j % 4 == 3) {
+                dlms_encode_signed(e, 16, (int16_t)rng()); /* long */
+            } else if (j % 4 == 0) {
+                dlms_encode_unsigned(e, 22, rng() & 0xff); /* enum */
+            } else {
+                dlms_encode_unsigned(e, 6, rng()); /* double-long-unsigned */
+            }
+        }
+    }
+}
+
+/* Encode a compact array of structures of a double-long-unsigned, a long and an enum */
+static void
+encode_compact_array(dlms_encoder *e, unsigned rows)
+{
+    static const uint8_t description[] = { 2, 3, 6, 16, 22 };
+    size_t mark;
+    unsigned i;
+
+    dlms_encode_compact_array_begin(e, description, sizeof description, &mark);
+    for (i = 0; i < rows; i++) {
+        dlms_encode_structure(e, 3);
+        dlms_encode_unsigned(e, 6, rng());
+        dlms_encode_signed(e, 16, (int16_t)rng());
+        dlms_encode_unsigned(e, 22, rng() & 0xff);
+    }
+    dlms_encode_compact_array_end(e, mark);
+}
+
+static const uint8_t profile_obis[6] = { 1, 0, 99, 1, 0, 255 };
+static const uint8_t register_obis[6] = { 1, 0, 1, 8, 0, 255 };
+
+/* Captures */
+
+/* A capture being generated, as the image of a pcap file */
+struct capture {
+    struct buffer file;
+    unsigned frames;
+    uint32_t tcp_sequence[2];
+};
+
+#define CLIENT_PORT 40000
+#define SERVER_PORT 4059
+
+/* Add an Ethernet/IPv4/UDP or TCP frame between the client and the server */
+static void
+capture_add(struct capture *c, int tcp, int from_server, const uint8_t *payload, size_t length)
+{
+    static const uint8_t mac[2][6] = { { 2, 0, 0, 0, 0, 1 }, { 2, 0, 0, 0, 0, 2 } };
+    static const uint8_t ip[2][4] = { { 10, 0, 0, 1 }, { 10, 0, 0, 2 } };
+    struct buffer *b = &c->file;
+    uint64_t time = (uint64_t)c->frames * 10000; /* 10 ms apart */
+    unsigned transport_length = (tcp ? 20 : 8) + (unsigned)length;
+    size_t ip_offset;
+    uint32_t sum;
+    unsigned i;
+
+    put_le_32(b, 1514764800 + (uint32_t)(time / 1000000));
+    put_le_32(b, (uint32_t)(time % 1000000));
+    put_le_32(b, 14 + 20 + transport_length);
+    put_le_32(b, 14 + 20 + transport_length);
+
+    buffer_append(b, mac[!from_server], 6);
+    buffer_append(b, mac[from_server], 6);
+    put_16(b, 0x0800);
+
+    ip_offset = b->length;
+    put_8(b, 0x45);
+    put_8(b, 0);
+    put_16(b, 20 + transport_length);
+    put_16(b, c->frames & 0xffff);
+    put_16(b, 0x4000); /* don't fragment */
+    put_8(b, 64);
+    put_8(b, tcp ? 6 : 17);
+    put_16(b, 0);
+    buffer_append(b, ip[from_server], 4);
+    buffer_append(b, ip[!from_server], 4);
+    for (sum = 0, i = 0; i < 20; i += 2) {
+        sum += (b->data[ip_offset + i] << 8) | b->data[ip_offset + i + 1];
+    }
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    b->data[ip_offset + 10] = (uint8_t)(~sum >> 8);
+    b->data[ip_offset + 11] = (uint8_t)~sum;
+
+    put_16(b, from_server ? SERVER_PORT : CLIENT_PORT);
+    put_16(b, from_server ? CLIENT_PORT : SERVER_PORT);
+    if (tcp) {
+        put_32(b, c->tcp_sequence[from_server]);
+        put_32(b, c->tcp_sequence[!from_server]);
+        put_8(b, 0x50);
+        put_8(b, 0x18); /* PSH, ACK */
+        put_16(b, 65535);
+        put_16(b, 0);
+        put_16(b, 0);
+        c->tcp_sequence[from_server] += (uint32_t)length;
+    } else {
+        put_16(b, transport_length);
+        put_16(b, 0); /* no checksum */
+    }
+    buffer_append(b, payload, length);
+    c->frames++;
+}
+
+/* Add a wrapper PDU with the APDU encoded in a, between client wPort 16 and a server wPort */
+static void
+capture_add_wrapper_to(struct capture *c, int tcp, int from_server, unsigned server_wport, const dlms_encoder *a)
+{
+    dlms_encoder e;
+
+    dlms_encoder_init(&e);
+    dlms_encode_wrapper(&e, from_server ? server_wport : 16, from_server ? 16 : server_wport, a->data, a->length);
+    capture_add(c, tcp, from_server, e.data, e.length);
+    dlms_encoder_free(&e);
+}
+
+/* Add a wrapper PDU with the APDU encoded in a, between client wPort 16 and server wPort 1 */
+static void
+capture_add_wrapper(struct capture *c, int tcp, int from_server, const dlms_encoder *a)
+{
+    capture_add_wrapper_to(c, tcp, from_server, 1, a);
+}
+
+/* HDLC link between client address 16 and server address 1 */
+struct hdlc_link {
+    unsigned ssn[2], rsn[2];
+};
+
+/* Add an HDLC frame, with an information field if information is not null */
+static void
+capture_add_hdlc(struct capture *c, int from_server, unsigned control, int segmentation,
+                 const uint8_t *information, size_t length)
+{
+    dlms_encoder e;
+
+    dlms_encoder_init(&e);
+    dlms_encode_hdlc(&e, segmentation, from_server ? 16 : 1, from_server ? 1 : 16, control, information, length);
+    capture_add(c, 0, from_server, e.data, e.length);
+    dlms_encoder_free(&e);
+}
+
+/* Add the APDU encoded in a in HDLC I frames of at most 128 bytes of information, acknowledged with RR frames */
+static void
+capture_add_hdlc_apdu(struct capture *c, struct hdlc_link *l, int from_server, const dlms_encoder *a)
+{
+    dlms_encoder e;
+    size_t offset;
+
+    dlms_encoder_init(&e);
+    dlms_encode_8(&e, 0xe6);
+    dlms_encode_8(&e, from_server ? 0xe7 : 0xe6);
+    dlms_encode_8(&e, 0);
+    dlms_encode_bytes(&e, a->data, a->length);
+    for (offset = 0; offset < e.length; offset += 128) {
+        size_t n = e.length - offset < 128 ? e.length - offset : 128;
+        int last = offset + n == e.length;
+        unsigned control = (l->rsn[from_server] << 5) | 0x10 | (l->ssn[from_server] << 1);
+        capture_add_hdlc(c, from_server, control, !last, e.data + offset, n);
+        l->ssn[from_server] = (l->ssn[from_server] + 1) & 7;
+        l->rsn[!from_server] = l->ssn[from_server];
+        if (!last) {
+            capture_add_hdlc(c, !from_server, (l->rsn[!from_server] << 5) | 0x11, 0, 0, 0);
+        }
+    }
+    dlms_encoder_free(&e);
+}
+
+/* Scenarios */
+
+static void
+generate_hdlc_segmented(struct capture *c, unsigned scale)
+{
+    struct hdlc_link l = { { 0, 0 }, { 0, 0 } };
+    dlms_encoder e;
+    unsigned i;
+
+    dlms_encoder_init(&e);
+    for (i = 0; i < 20 * scale; i++) {
+        e.length = 0;
+        dlms_encode_get_request_normal(&e, 0xc1, 7, profile_obis, 2);
+        capture_add_hdlc_apdu(c, &l, 0, &e);
+        e.length = 0;
+        dlms_encode_get_response_normal(&e, 0xc1);
+        encode_profile(&e, 48, 5);
+        capture_add_hdlc_apdu(c, &l, 1, &e);
+    }
+    dlms_encoder_free(&e);
+}
+
+static void
+generate_wrapper_tcp(struct capture *c, unsigned scale)
+{
+    dlms_encoder e;
+    unsigned i;
+
+    dlms_encoder_init(&e);
+    for (i = 0; i < 1000 * scale; i++) {
+        e.length = 0;
+        dlms_encode_get_request_normal(&e, 0xc0 | (i & 15), 3, register_obis, 2);
+        capture_add_wrapper(c, 1, 0, &e);
+        e.length = 0;
+        dlms_encode_get_response_normal(&e, 0xc0 | (i & 15));
+        dlms_encode_unsigned(&e, 6, rng());
+        capture_add_wrapper(c, 1, 1, &e);
+    }
+    dlms_encoder_free(&e);
+}
+
+static void
+generate_datablock(struct capture *c, unsigned scale)
+{
+    dlms_encoder e, data;
+    unsigned i, block;
+    size_t offset;
+
+    dlms_encoder_init(&e);
+    dlms_encoder_init(&data);
+    for (i = 0; i < 5 * scale; i++) {
+        data.length = 0;
+        encode_profile(&data, 400, 8);
+        e.length = 0;
+        dlms_encode_get_request_normal(&e, 0xc2, 7, profile_obis, 2);
+        capture_add_wrapper(c, 0, 0, &e);
+        for (offset = 0, block = 1; offset < data.length; offset += 512, block++) {
+            size_t n = data.length - offset < 512 ? data.length - offset : 512;
+            if (block > 1) {
+                e.length = 0;
+                dlms_encode_get_request_next(&e, 0xc2, block - 1);
+                capture_add_wrapper(c, 0, 0, &e);
+            }
+            e.length = 0;
+            dlms_encode_get_response_with_datablock(&e, 0xc2, offset + n == data.length, block,
+                                                    data.data + offset, (uint32_t)n);
+            capture_add_wrapper(c, 0, 1, &e);
+        }
+    }
+    dlms_encoder_free(&e);
+    dlms_encoder_free(&data);
+}
+
+static void
+generate_gbt(struct capture *c, unsigned scale)
+{
+    dlms_encoder e, apdu;
+    unsigned i, block;
+    size_t offset;
+
+    dlms_encoder_init(&e);
+    dlms_encoder_init(&apdu);
+    for (i = 0; i < 5 * scale; i++) {
+        apdu.length = 0;
+        dlms_encode_get_response_normal(&apdu, 0xc3);
+        encode_profile(&apdu, 400, 8);
+        e.length = 0;
+        dlms_encode_get_request_normal(&e, 0xc3, 7, profile_obis, 2);
+        capture_add_wrapper(c, 0, 0, &e);
+        for (offset = 0, block = 1; offset < apdu.length; offset += 1024, block++) {
+            size_t n = apdu.length - offset < 1024 ? apdu.length - offset : 1024;
+            int last = offset + n == apdu.length;
+            e.length = 0;
+            dlms_encode_general_block_transfer(&e, last, 1, 4, block, 0, apdu.data + offset, (uint32_t)n);
+            capture_add_wrapper(c, 0, 1, &e);
+            if (!last && block % 4 == 0) {
+                e.length = 0;
+                dlms_encode_general_block_transfer(&e, 0, 0, 4, 0, block, 0, 0);
+                capture_add_wrapper(c, 0, 0, &e);
+            }
+        }
+    }
+    dlms_encoder_free(&e);
+    dlms_encoder_free(&apdu);
+}
+
+static void
+generate_compact_array(struct capture *c, unsigned scale)
+{
+    dlms_encoder e;
+    unsigned i;
+
+    dlms_encoder_init(&e);
+    for (i = 0; i < 100 * scale; i++) {
+        e.length = 0;
+        dlms_encode_get_request_normal(&e, 0xc4, 7, profile_obis, 2);
+        capture_add_wrapper(c, 0, 0, &e);
+        e.length = 0;
+        dlms_encode_get_response_normal(&e, 0xc4);
+        encode_compact_array(&e, 200);
+        capture_add_wrapper(c, 0, 1, &e);
+    }
+    dlms_encoder_free(&e);
+}
+
+static void
+generate_profile(struct capture *c, unsigned scale)
+{
+    dlms_encoder e;
+    unsigned i;
+
+    dlms_encoder_init(&e);
+    for (i = 0; i < 10 * scale; i++) {
+        e.length = 0;
+        dlms_encode_get_request_normal(&e, 0xc5, 7, profile_obis, 2);
+        capture_add_wrapper(c, 0, 0, &e);
+        e.length = 0;
+        dlms_encode_get_response_normal(&e, 0xc5);
+        encode_profile(&e, 1000, 8);
+        capture_add_wrapper(c, 0, 1, &e);
+    }
+    dlms_encoder_free(&e);
+}
+
+static void
+generate_notification(struct capture *c, unsigned scale)
+{
+    dlms_encoder e;
+    unsigned i, j;
+
+    dlms_encoder_init(&e);
+    for (i = 0; i < 2000 * scale; i++) {
+        e.length = 0;
+        dlms_encode_data_notification(&e, i & 0xffffff, 0);
+        dlms_encode_structure(&e, 6);
+        encode_date_time(&e, i);
+        for (j = 0; j < 5; j++) {
+            dlms_encode_unsigned(&e, 6, rng());
+        }
+        capture_add_wrapper(c, 0, 1, &e);
+    }
+    dlms_encoder_free(&e);
+}
+
+/*
+ * Two meters behind a gateway, with server wPorts 1 and 2 on the same UDP
+ * conversation, whose blocks of the same Invoke-Id are interleaved: datablocks
+ * on even rounds, General-Block-Transfer on odd ones. The blocks of the two
+ * meters are only reassembled right when they are told apart.
+ */
+static void
+generate_two_meters(struct capture *c, unsigned scale)
+{
+    dlms_encoder e, data[2];
+    size_t offset[2];
+    unsigned i, m, block;
+
+    dlms_encoder_init(&e);
+    dlms_encoder_init(&data[0]);
+    dlms_encoder_init(&data[1]);
+    for (i = 0; i < 4 * scale; i++) {
+        int gbt = i & 1;
+        for (m = 0; m < 2; m++) {
+            data[m].length = 0;
+            if (gbt) {
+                dlms_encode_get_response_normal(&data[m], 0xc6);
+            }
+            encode_profile(&data[m], 200, 8);
+            offset[m] = 0;
+            e.length = 0;
+            dlms_encode_get_request_normal(&e, 0xc6, 7, profile_obis, 2);
+            capture_add_wrapper_to(c, 0, 0, m + 1, &e);
+        }
+        for (block = 1; offset[0] < data[0].length || offset[1] < data[1].length; block++) {
+            for (m = 0; m < 2; m++) {
+                size_t n = data[m].length - offset[m] < 512 ? data[m].length - offset[m] : 512;
+                int last = offset[m] + n == data[m].length;
+                if (offset[m] >= data[m].length) {
+                    continue;
+                }
+                if (!gbt && block > 1) {
+                    e.length = 0;
+                    dlms_encode_get_request_next(&e, 0xc6, block - 1);
+                    capture_add_wrapper_to(c, 0, 0, m + 1, &e);
+                }
+                e.length = 0;
+                if (gbt) {
+                    dlms_encode_general_block_transfer(&e, last, 0, 1, block, block - 1, data[m].data + offset[m], (uint32_t)n);
+                } else {
+                    dlms_encode_get_response_with_datablock(&e, 0xc6, last, block, data[m].data + offset[m], (uint32_t)n);
+                }
+                capture_add_wrapper_to(c, 0, 1, m + 1, &e);
+                if (gbt && !last) {
+                    e.length = 0;
+                    dlms_encode_general_block_transfer(&e, 0, 0, 1, 0, block, 0, 0);
+                    capture_add_wrapper_to(c, 0, 0, m + 1, &e);
+                }
+                offset[m] += n;
+            }
+        }
+    }
+    dlms_encoder_free(&e);
+    dlms_encoder_free(&data[0]);
+    dlms_encoder_free(&data[1]);
+}
+
+struct scenario {
+    const char *name;
+    void (*generate)(struct capture *c, unsigned scale);
+};
+
+static const struct scenario scenarios[] = {
+    { "hdlc-segmented", generate_hdlc_segmented },
+    { "wrapper-tcp", generate_wrapper_tcp },
+    { "datablock", generate_datablock },
+    { "gbt", generate_gbt },
+    { "compact-array", generate_compact_array },
+    { "profile", generate_profile },
+    { "notification", generate_notification },
+    { "two-meters", generate_two_meters },
+};
+
+#define SCENARIOS (sizeof scenarios / sizeof scenarios[0])
+
+static void
+generate(struct capture *c, const struct scenario *s, unsigned scale)
+{
+    struct buffer *b = &c->file;
+
+    memset(c, 0, sizeof *c);
+    rng_state = 0x9e3779b97f4a7c15u;
+    put_le_32(b, 0xa1b2c3d4);
+    put_le_16(b, 2);
+    put_le_16(b, 4);
+    put_le_32(b, 0);
+    put_le_32(b, 0);
+    put_le_32(b, 65535);
+    put_le_32(b, 1); /* Ethernet */
+    s->generate(c, scale);
+}
+
+/* Decoding with the core functions that the dissector uses, but without building a protocol tree */
+
+struct decoder {
+    struct buffer segments[2];
+    struct buffer blocks[2]; /* of the server wPort 1 (and HDLC), and of the server wPort 2 */
+    unsigned long values;
+};
+
+static void *
+count_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    (void)d;
+    ((struct decoder *)context)->values++;
+    return parent;
+}
+
+static void
+count_end(void *context, void *parent, void *element_parent, const dlms_core_data *d)
+{
+    (void)context;
+    (void)parent;
+    (void)element_parent;
+    (void)d;
+}
+
+static void
+count_value(void *context, void *parent, const dlms_core_data *d)
+{
+    (void)parent;
+    (void)d;
+    ((struct decoder *)context)->values++;
+}
+
+static const dlms_core_data_visitor count_visitor = { count_begin, count_end, count_value };
+
+static void
+decode_apdu(struct decoder *dec, struct buffer *blocks, const uint8_t *data, size_t size)
+{
+    dlms_core_apdu apdu;
+    dlms_core_service service;
+    dlms_core_block block;
+    size_t offset;
+
+    if (dlms_core_classify_apdu(data, size, 0, &apdu) != DLMS_CORE_OK) {
+        return;
+    }
+    if (apdu.choice == DLMS_GET_RESPONSE && apdu.service == 2) {
+        offset = 3;
+        if (dlms_core_parse_datablock_g(data, size, &offset, &block) == DLMS_CORE_OK && block.result == 0) {
+            if (block.block_number == 1) {
+                blocks->length = 0;
+            }
+            buffer_append(blocks, data + block.data_offset, block.data_length);
+            if (block.last_block) {
+                offset = 0;
+                dlms_core_parse_data(blocks->data, blocks->length, &offset, &count_visitor, dec, 0);
+            }
+        }
+    } else if (apdu.choice == DLMS_GENERAL_BLOCK_TRANSFER) {
+        offset = 1;
+        if (dlms_core_parse_general_block_transfer(data, size, &offset, &block) == DLMS_CORE_OK
+            && block.data_length) {
+            if (block.block_number == 1) {
+                blocks->length = 0;
+            }
+            buffer_append(blocks, data + block.data_offset, block.data_length);
+            if (block.last_block) {
+                struct buffer apdu_data = *blocks;
+                memset(blocks, 0, sizeof *blocks);
+                decode_apdu(dec, blocks, apdu_data.data, apdu_data.length);
+                free(apdu_data.data);
+            }
+        }
+    } else if (dlms_core_parse_service(data, size, 0, &service) == DLMS_CORE_OK && service.has_data) {
+        offset = service.data_offset;
+        dlms_core_parse_data(data, size, &offset, &count_visitor, dec, 0);
+    }
+}
+
+static void
+decode_payload(struct decoder *dec, int from_server, const uint8_t *data, size_t size)
+{
+    dlms_core_hdlc frame;
+    struct buffer *segments = &dec->segments[from_server];
+
+    if (data[0] == 0x7e) {
+        if (dlms_core_parse_hdlc(data, size, 0, &frame) == DLMS_CORE_OK
+            && (frame.control & 1) == 0 && frame.hcs_ok && frame.fcs_ok) {
+            buffer_append(segments, data + frame.information_offset, frame.information_length);
+            if (!frame.segmentation) {
+                if (segments->length > 3) {
+                    decode_apdu(dec, &dec->blocks[0], segments->data + 3, segments->length - 3);
+                }
+                segments->length = 0;
+            }
+        }
+    } else if (size >= 8 && data[0] == 0 && data[1] == 1) {
+        unsigned server_wport = from_server ? (data[2] << 8) | data[3] : (data[4] << 8) | data[5];
+        decode_apdu(dec, &dec->blocks[server_wport == 2], data + 8, size - 8);
+    }
+}
+
+/* Decode the frames of a generated capture (Ethernet, IPv4 without options, UDP or TCP) */
+static void
+decode_capture(struct decoder *dec, const struct capture *c)
+{
+    const uint8_t *data = c->file.data;
+    size_t offset = 24;
+
+    while (offset < c->file.length) {
+        const uint8_t *p = data + offset + 16;
+        size_t length = data[offset + 8] | (data[offset + 9] << 8) | ((size_t)data[offset + 10] << 16);
+        size_t header_length = 14 + 20 + (p[23] == 6 ? 20 : 8);
+        int from_server = ((p[34] << 8) | p[35]) == SERVER_PORT;
+        decode_payload(dec, from_server, p + header_length, length - header_length);
+        offset += 16 + length;
+    }
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Benchmark a scenario, in a child process so as to measure its peak memory */
+static void
+benchmark(const struct scenario *s, unsigned scale, unsigned runs)
+{
+    struct rusage usage;
+    int fds[2], status;
+    pid_t pid;
+    char result[256];
+    ssize_t n;
+
+    if (pipe(fds) < 0 || (pid = fork()) < 0) {
+        perror("dlms-bench");
+        exit(1);
+    }
+    if (pid == 0) {
+        struct capture c;
+        struct decoder dec;
+        double best = 0;
+        unsigned run;
+
+        close(fds[0]);
+        generate(&c, s, scale);
+        memset(&dec, 0, sizeof dec);
+        for (run = 0; run < runs; run++) {
+            double start = now(), elapsed;
+            unsigned passes = 0;
+            do { /* at least 100 ms per run, for a meaningful time */
+                dec.values = 0;
+                decode_capture(&dec, &c);
+                passes++;
+                elapsed = now() - start;
+            } while (elapsed < 0.1);
+            elapsed /= passes;
+            if (run == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+        if (best <= 0) {
+            best = 1e-9;
+        }
+        n = snprintf(result, sizeof result, "%-16s %8u %12.0f %10.1f %10lu",
+                     s->name, c.frames, c.frames / best, c.file.length / best / 1e6, dec.values);
+        if (write(fds[1], result, (size_t)n) != n) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    n = read(fds[0], result, sizeof result - 1);
+    close(fds[0]);
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || n <= 0) {
+        fprintf(stderr, "dlms-bench: %s failed\n", s->name);
+        exit(1);
+    }
+    result[n] = 0;
+    printf("%s %10ld\n", result, usage.ru_maxrss);
+    fflush(stdout);
+}
+
+static void
+write_capture(const struct scenario *s, unsigned scale, const char *directory)
+{
+    struct capture c;
+    char path[4096];
+    FILE *f;
+
+    generate(&c, s, scale);
+    snprintf(path, sizeof path, "%s/%s.pcap", directory, s->name);
+    f = fopen(path, "wb");
+    if (!f || fwrite(c.file.data, 1, c.file.length, f) != c.file.length || fclose(f) != 0) {
+        fprintf(stderr, "dlms-bench: %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    printf("%s %u %zu\n", s->name, c.frames, c.file.length);
+    free(c.file.data);
+}
+
+/*
+ * Round trip checks (-r): random Data and APDUs are encoded, then decoded
+ * with the core, which must report exactly what was encoded, and must report
+ * every proper prefix of the encoding as truncated.
+ */
+
+static void
+buffer_printf(struct buffer *b, const char *format, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, format);
+    n = vsnprintf(0, 0, format, ap);
+    va_end(ap);
+    buffer_reserve(b, (size_t)n + 1);
+    va_start(ap, format);
+    vsnprintf((char *)b->data + b->length, (size_t)n + 1, format, ap);
+    va_end(ap);
+    b->length += (size_t)n;
+}
+
+/* Log a planar value in the same format for the encoder and the decoder */
+static void
+log_value(struct buffer *log, unsigned choice, unsigned depth, unsigned index, int compact,
+          int64_t i, uint64_t u, double f, const uint8_t *bytes, uint32_t length)
+{
+    uint32_t k, n;
+
+    buffer_printf(log, "V %u %u %u %d", choice, depth, index, compact);
+    switch (choice) {
+    case 5: case 15: case 16: case 20:
+        buffer_printf(log, " %lld", (long long)i);
+        break;
+    case 3: case 6: case 13: case 17: case 18: case 21: case 22:
+        buffer_printf(log, " %llu", (unsigned long long)u);
+        break;
+    case 23: case 24:
+        buffer_printf(log, " %a", f);
+        break;
+    case 4: case 9: case 10: case 12: case 25: case 26: case 27:
+        n = choice == 4 ? (length + 7) / 8 : length;
+        buffer_printf(log, " %u:", length);
+        for (k = 0; k < n; k++) {
+            buffer_printf(log, "%02x", bytes[k]);
+        }
+        break;
+    }
+    buffer_printf(log, "\n");
+}
+
+static const unsigned planar_choices[] = { 3, 4, 5, 6, 9, 10, 12, 13, 15, 16, 17, 18, 20, 21, 22, 23, 24, 25, 26, 27, 0, 255 };
+
+/* Encode a random planar value (not null-data nor dont-care inside compact arrays) */
+static void
+random_planar(dlms_encoder *e, struct buffer *log, unsigned choice, unsigned depth, unsigned index)
+{
+    uint8_t bytes[300];
+    uint64_t u = ((uint64_t)rng() << 32) | rng();
+    uint32_t length, k;
+    double f;
+    float f32;
+
+    switch (choice) {
+    case 0: case 255:
+        dlms_encode_null(e, choice);
+        log_value(log, choice, depth, index, e->compact != 0, 0, 0, 0, 0, 0);
+        break;
+    case 5: case 15: case 16: case 20:
+        if (choice == 15) u = (uint64_t)(int64_t)(int8_t)u;
+        if (choice == 16) u = (uint64_t)(int64_t)(int16_t)u;
+        if (choice == 5) u = (uint64_t)(int64_t)(int32_t)u;
+        dlms_encode_signed(e, choice, (int64_t)u);
+        log_value(log, choice, depth, index, e->compact != 0, (int64_t)u, 0, 0, 0, 0);
+        break;
+    case 3: case 6: case 13: case 17: case 18: case 21: case 22:
+        u &= choice == 21 ? ~(uint64_t)0 : choice == 6 ? 0xffffffff : choice == 18 ? 0xffff : 0xff;
+        dlms_encode_unsigned(e, choice, u);
+        log_value(log, choice, depth, index, e->compact != 0, 0, u, 0, 0, 0);
+        break;
+    case 23:
+        k = (uint32_t)u;
+        memcpy(&f32, &k, sizeof f32);
+        f = f32;
+        dlms_encode_float(e, choice, f);
+        log_value(log, choice, depth, index, e->compact != 0, 0, 0, f, 0, 0);
+        break;
+    case 24:
+        memcpy(&f, &u, sizeof f);
+        dlms_encode_float(e, choice, f);
+        log_value(log, choice, depth, index, e->compact != 0, 0, 0, f, 0, 0);
+        break;
+    default:
+        length = choice == 25 ? 12 : choice == 26 ? 5 : choice == 27 ? 4 : rng() % (rng() % 8 ? 20 : 300);
+        for (k = 0; k < (choice == 4 ? (length + 7) / 8 : length); k++) {
+            bytes[k] = (uint8_t)rng();
+        }
+        if (choice == 4 && length % 8) {
+            bytes[length / 8] &= (uint8_t)(0xff00 >> (length % 8)); /* unused bits */
+        }
+        dlms_encode_string(e, choice, bytes, length);
+        log_value(log, choice, depth, index, e->compact != 0, 0, 0, 0, bytes, length);
+        break;
+    }
+}
+
+/*
+ * Add a random TypeDescription. Its elements are never empty, since the number
+ * of elements of a compact array is only known from the size of its contents.
+ */
+static void
+random_description(struct buffer *description, unsigned depth)
+{
+    unsigned r = rng() % 8, i, n;
+
+    if (depth < 3 && r == 0) {
+        put_8(description, 1);
+        put_16(description, 1 + rng() % 3);
+        random_description(description, depth + 1);
+    } else if (depth < 3 && r == 1) {
+        n = 1 + rng() % 3;
+        put_8(description, 2);
+        put_8(description, n);
+        for (i = 0; i < n; i++) {
+            random_description(description, depth + 1);
+        }
+    } else {
+        put_8(description, planar_choices[rng() % (sizeof planar_choices / sizeof planar_choices[0] - 2)]);
+    }
+}
+
+/* Encode random contents for the TypeDescription at *position, and move past it */
+static void
+random_compact_content(dlms_encoder *e, struct buffer *log, const uint8_t *description, size_t *position,
+                       unsigned depth, unsigned index)
+{
+    unsigned choice = description[(*position)++], i, n;
+    size_t element;
+
+    if (choice == 1) {
+        n = (description[*position] << 8) | description[*position + 1];
+        *position += 2;
+        element = *position;
+        buffer_printf(log, "B 1 %u %u %u 1\n", depth, index, n);
+        for (i = 0; i < n; i++) {
+            *position = element;
+            random_compact_content(e, log, description, position, depth + 1, i + 1);
+        }
+        buffer_printf(log, "E 1 %u %u %u\n", depth, index, n);
+    } else if (choice == 2) {
+        n = description[(*position)++];
+        buffer_printf(log, "B 2 %u %u %u 1\n", depth, index, n);
+        for (i = 0; i < n; i++) {
+            random_compact_content(e, log, description, position, depth + 1, 0);
+        }
+        buffer_printf(log, "E 2 %u %u %u\n", depth, index, n);
+    } else {
+        random_planar(e, log, choice, depth, index);
+    }
+}
+
+/* Encode a random Data value */
+static void
+random_data(dlms_encoder *e, struct buffer *log, unsigned depth, unsigned index)
+{
+    unsigned r = rng() % (depth < 4 ? 12 : 8), i, n;
+
+    if (r >= 8) {
+        if (r == 11) {
+            struct buffer description = { 0, 0, 0 };
+            size_t mark, position;
+            random_description(&description, 0);
+            n = rng() % 5;
+            buffer_printf(log, "B 19 %u %u 0 0\n", depth, index);
+            dlms_encode_compact_array_begin(e, description.data, description.length, &mark);
+            for (i = 0; i < n; i++) {
+                position = 0;
+                random_compact_content(e, log, description.data, &position, depth + 1, i + 1);
+            }
+            dlms_encode_compact_array_end(e, mark);
+            buffer_printf(log, "E 19 %u %u %u\n", depth, index, n);
+            free(description.data);
+        } else {
+            unsigned choice = r == 8 ? 1 : 2;
+            n = rng() % 5;
+            buffer_printf(log, "B %u %u %u %u 0\n", choice, depth, index, n);
+            if (choice == 1) {
+                dlms_encode_array(e, n);
+            } else {
+                dlms_encode_structure(e, n);
+            }
+            for (i = 0; i < n; i++) {
+                random_data(e, log, depth + 1, choice == 1 ? i + 1 : 0);
+            }
+            buffer_printf(log, "E %u %u %u %u\n", choice, depth, index, n);
+        }
+    } else {
+        random_planar(e, log, planar_choices[rng() % (sizeof planar_choices / sizeof planar_choices[0])],
+                      depth, index);
+    }
+}
+
+struct log_context {
+    const uint8_t *data;
+    struct buffer *log;
+};
+
+static void *
+log_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    struct log_context *lc = context;
+    buffer_printf(lc->log, "B %u %u %u %u %d\n", d->choice, d->depth, d->index, d->length, d->compact);
+    return parent;
+}
+
+static void
+log_end(void *context, void *parent, void *element_parent, const dlms_core_data *d)
+{
+    struct log_context *lc = context;
+    (void)parent;
+    (void)element_parent;
+    buffer_printf(lc->log, "E %u %u %u %u\n", d->choice, d->depth, d->index, d->length);
+}
+
+static void
+log_decoded_value(void *context, void *parent, const dlms_core_data *d)
+{
+    struct log_context *lc = context;
+    (void)parent;
+    log_value(lc->log, d->choice, d->depth, d->index, d->compact, d->value.i, d->value.u, d->value.f,
+              lc->data + d->contents_offset, d->length);
+}
+
+static const dlms_core_data_visitor log_visitor = { log_begin, log_end, log_decoded_value };
+
+static void
+round_trip_failure(unsigned n, const char *what, const dlms_encoder *e)
+{
+    size_t i;
+
+    fprintf(stderr, "dlms-bench: round trip %u: %s\n", n, what);
+    for (i = 0; i < e->length; i++) {
+        fprintf(stderr, "%02x", e->data[i]);
+    }
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+/* Check that the data encoded in e decodes to the same log, and that its prefixes are truncated */
+static void
+round_trip_data(unsigned n, const dlms_encoder *e, const struct buffer *expected)
+{
+    struct buffer log = { 0, 0, 0 };
+    struct log_context lc;
+    size_t offset = 0, size;
+    int status;
+
+    lc.data = e->data;
+    lc.log = &log;
+    status = dlms_core_parse_data(e->data, e->length, &offset, &log_visitor, &lc, 0);
+    if (status != DLMS_CORE_OK || offset != e->length) {
+        round_trip_failure(n, "data not decoded", e);
+    }
+    if (log.length != expected->length || memcmp(log.data, expected->data, log.length) != 0) {
+        fwrite(expected->data, 1, expected->length, stderr);
+        fprintf(stderr, "--\n");
+        fwrite(log.data, 1, log.length, stderr);
+        round_trip_failure(n, "data decoded differently", e);
+    }
+    for (size = 0; size < e->length; size++) {
+        log.length = 0;
+        offset = 0;
+        if (dlms_core_parse_data(e->data, size, &offset, &log_visitor, &lc, 0) != DLMS_CORE_TRUNCATED) {
+            round_trip_failure(n, "prefix not truncated", e);
+        }
+    }
+    free(log.data);
+}
+
+static unsigned
+get_16(const uint8_t *p)
+{
+    return ((unsigned)p[0] << 8) | p[1];
+}
+
+/* Check a random APDU, wrapper PDU or HDLC frame */
+static void
+round_trip_apdu(unsigned n, dlms_encoder *e)
+{
+    uint8_t obis[6], data[200];
+    unsigned invoke_id = rng() & 0xff, id = rng() & 0xff, class_id = rng() & 0xffff;
+    uint32_t number = rng(), length = rng() % sizeof data, k;
+    unsigned r = rng() % 5;
+    dlms_core_apdu apdu;
+    dlms_core_block block;
+    dlms_core_hdlc frame;
+    size_t offset;
+
+    for (k = 0; k < 6; k++) {
+        obis[k] = (uint8_t)rng();
+    }
+    for (k = 0; k < length; k++) {
+        data[k] = (uint8_t)rng();
+    }
+    if (r == 0) {
+        dlms_encode_get_request_normal(e, invoke_id, class_id, obis, id);
+        if (dlms_core_classify_apdu(e->data, e->length, 0, &apdu) != DLMS_CORE_OK
+            || apdu.choice != DLMS_GET_REQUEST || apdu.service != 1 || apdu.slot != (int)(invoke_id & 15)
+            || apdu.confirmed != ((invoke_id & 0x40) != 0) || e->length != 13
+            || get_16(e->data + 3) != class_id || memcmp(e->data + 5, obis, 6) || e->data[11] != id) {
+            round_trip_failure(n, "get-request-normal", e);
+        }
+    } else if (r == 1) {
+        dlms_encode_get_response_with_datablock(e, invoke_id, number & 1, number, data, length);
+        offset = 3;
+        if (dlms_core_classify_apdu(e->data, e->length, 0, &apdu) != DLMS_CORE_OK
+            || apdu.choice != DLMS_GET_RESPONSE || apdu.service != 2 || apdu.slot != (int)(invoke_id & 15)
+            || dlms_core_parse_datablock_g(e->data, e->length, &offset, &block) != DLMS_CORE_OK
+            || block.last_block != (number & 1) || block.block_number != number || block.result != 0
+            || block.data_length != length || memcmp(e->data + block.data_offset, data, length)
+            || offset != e->length) {
+            round_trip_failure(n, "get-response-with-datablock", e);
+        }
+    } else if (r == 2) {
+        dlms_encode_general_block_transfer(e, number & 1, (number >> 1) & 1, id & 0x3f,
+                                           number >> 16, class_id, data, length);
+        offset = 1;
+        if (dlms_core_parse_general_block_transfer(e->data, e->length, &offset, &block) != DLMS_CORE_OK
+            || block.last_block != (number & 1) || block.streaming != ((number >> 1) & 1)
+            || block.window != (id & 0x3f) || block.block_number != number >> 16
+            || block.block_number_ack != class_id || block.data_length != length
+            || memcmp(e->data + block.data_offset, data, length) || offset != e->length) {
+            round_trip_failure(n, "general-block-transfer", e);
+        }
+    } else if (r == 3) {
+        dlms_encode_wrapper(e, class_id, number & 0xffff, data, length);
+        if (e->length != 8 + length || get_16(e->data + 2) != class_id
+            || get_16(e->data + 4) != (number & 0xffff)
+            || get_16(e->data + 6) != length || memcmp(e->data + 8, data, length)) {
+            round_trip_failure(n, "wrapper", e);
+        }
+    } else {
+        static const unsigned address_lengths[3] = { 1, 2, 4 };
+        int has_information = rng() & 1;
+        dlms_core_hdlc_address destination, source;
+        destination.length = address_lengths[rng() % 3];
+        destination.upper = rng() & (destination.length == 4 ? 0x3fff : 0x7f);
+        destination.lower = destination.length == 1 ? 0 : rng() & (destination.length == 4 ? 0x3fff : 0x7f);
+        source.length = 1;
+        source.upper = invoke_id & 0x7f;
+        source.lower = 0;
+        dlms_encode_hdlc_addressed(e, number & 1, &destination, &source, class_id & 0xff,
+                                   has_information ? data : 0, length);
+        if (dlms_core_parse_hdlc(e->data, e->length, 0, &frame) != DLMS_CORE_OK
+            || frame.type != 10 || frame.segmentation != (number & 1)
+            || memcmp(&frame.destination_address, &destination, sizeof destination)
+            || frame.destination != destination.upper || frame.source != (invoke_id & 0x7f)
+            || frame.control != (class_id & 0xff) || !frame.fcs_ok || frame.length + 2 != e->length
+            || frame.has_hcs != has_information || (has_information && (!frame.hcs_ok
+            || frame.information_length != length || memcmp(e->data + frame.information_offset, data, length)))) {
+            round_trip_failure(n, "hdlc", e);
+        }
+    }
+    if (e->status != DLMS_CORE_OK) {
+        round_trip_failure(n, "encoder failed", e);
+    }
+}
+
+static void
+round_trip(unsigned cases)
+{
+    struct buffer log = { 0, 0, 0 };
+    dlms_encoder e;
+    unsigned n;
+
+    dlms_encoder_init(&e);
+    rng_state = 0x9e3779b97f4a7c15u;
+    for (n = 0; n < cases; n++) {
+        e.length = 0;
+        log.length = 0;
+        random_data(&e, &log, 0, 0);
+        if (e.status != DLMS_CORE_OK) {
+            round_trip_failure(n, "encoder failed", &e);
+        }
+        round_trip_data(n, &e, &log);
+        e.length = 0;
+        round_trip_apdu(n, &e);
+    }
+    dlms_encoder_free(&e);
+    free(log.data);
+    printf("%u round trips passed\n", cases);
+}
+
+static void
+usage(void)
+{
+    size_t i;
+
+    fprintf(stderr, "Usage: dlms-bench [-s scale] [-n runs] [-w directory] [scenario ...]\n"
+            "       dlms-bench -r cases\nScenarios:");
+    for (i = 0; i < SCENARIOS; i++) {
+        fprintf(stderr, " %s", scenarios[i].name);
+    }
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *directory = 0;
+    unsigned scale = 1, runs = 5, cases = 0;
+    int c, i, selected;
+    size_t j;
+
+    while ((c = getopt(argc, argv, "s:n:w:r:")) != -1) {
+        if (c == 's') {
+            scale = (unsigned)strtoul(optarg, 0, 10);
+        } else if (c == 'n') {
+            runs = (unsigned)strtoul(optarg, 0, 10);
+        } else if (c == 'w') {
+            directory = optarg;
+        } else if (c == 'r') {
+            cases = (unsigned)strtoul(optarg, 0, 10);
+        } else {
+            usage();
+        }
+    }
+    if (scale < 1 || runs < 1) {
+        usage();
+    }
+    if (cases) {
+        round_trip(cases);
+        return 0;
+    }
+    for (i = optind; i < argc; i++) {
+        for (j = 0; j < SCENARIOS && strcmp(argv[i], scenarios[j].name); j++) {
+        }
+        if (j == SCENARIOS) {
+            usage();
+        }
+    }
+
+    if (directory) {
+        mkdir(directory, 0777);
+    } else {
+        printf("%-16s %8s %12s %10s %10s %10s\n", "core decoder", "frames", "frames/s", "MB/s", "values", "peak KB");
+    }
+    for (j = 0; j < SCENARIOS; j++) {
+        selected = optind == argc;
+        for (i = optind; i < argc; i++) {
+            selected |= strcmp(argv[i], scenarios[j].name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        if (directory) {
+            write_capture(&scenarios[j], scale, directory);
+        } else {
+            benchmark(&scenarios[j], scale, runs);
+        }
+    }
+
+    return 0;
+}
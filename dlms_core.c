@@ -0,0 +1,1117 @@
+/*
+ * dlms_core.c - Device Language Message Specification decoding core
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "dlms_core.h"
+
+/* Whether the buffer has n more bytes at offset */
+static int
+dlms_core_has(size_t size, size_t offset, size_t n)
+{
+    return offset <= size && n <= size - offset;
+}
+
+static unsigned
+dlms_core_get_16(const uint8_t *p)
+{
+    return ((unsigned)p[0] << 8) | p[1];
+}
+
+static uint32_t
+dlms_core_get_32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t
+dlms_core_get_64(const uint8_t *p)
+{
+    return ((uint64_t)dlms_core_get_32(p) << 32) | dlms_core_get_32(p + 4);
+}
+
+int
+dlms_core_classify_apdu(const uint8_t *data, size_t size, size_t offset, dlms_core_apdu *apdu)
+{
+    const uint8_t *p = data + offset;
+    uint32_t long_invoke_id;
+
+    memset(apdu, 0, sizeof *apdu);
+    apdu->direction = DLMS_DIRECTION_UNKNOWN;
+    apdu->slot = -1;
+    if (!dlms_core_has(size, offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    apdu->choice = p[0];
+
+    switch (apdu->choice) {
+    case DLMS_AARQ:
+    case DLMS_RLRQ:
+        apdu->direction = DLMS_DIRECTION_CLIENT_TO_SERVER;
+        apdu->slot = DLMS_REQUEST_SLOT_ACSE;
+        apdu->confirmed = 1;
+        break;
+    case DLMS_AARE:
+    case DLMS_RLRE:
+        apdu->direction = DLMS_DIRECTION_SERVER_TO_CLIENT;
+        apdu->slot = DLMS_REQUEST_SLOT_ACSE;
+        break;
+    case DLMS_READ_REQUEST:
+    case DLMS_WRITE_REQUEST:
+        apdu->direction = DLMS_DIRECTION_CLIENT_TO_SERVER;
+        apdu->slot = DLMS_REQUEST_SLOT_SN;
+        apdu->confirmed = 1;
+        break;
+    case DLMS_READ_RESPONSE:
+    case DLMS_WRITE_RESPONSE:
+        apdu->direction = DLMS_DIRECTION_SERVER_TO_CLIENT;
+        apdu->slot = DLMS_REQUEST_SLOT_SN;
+        break;
+    case DLMS_UNCONFIRMED_WRITE_REQUEST:
+        apdu->direction = DLMS_DIRECTION_CLIENT_TO_SERVER;
+        break;
+    case DLMS_GET_REQUEST:
+    case DLMS_SET_REQUEST:
+    case DLMS_ACTION_REQUEST:
+        if (!dlms_core_has(size, offset, 3)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        apdu->service = p[1];
+        apdu->direction = DLMS_DIRECTION_CLIENT_TO_SERVER;
+        apdu->slot = p[2] & 0x0f;
+        apdu->confirmed = (p[2] & 0x40) != 0;
+        if (apdu->choice == DLMS_ACTION_REQUEST && apdu->service == 1 /* action-request-normal */) {
+            if (!dlms_core_has(size, offset, 12)) {
+                return DLMS_CORE_TRUNCATED;
+            }
+            apdu->hls_pass_3 = dlms_core_get_16(p + 3) == 15 /* association ln */
+                && p[11] == 1 /* reply_to_hls_authentication */;
+        }
+        break;
+    case DLMS_GET_RESPONSE:
+    case DLMS_SET_RESPONSE:
+    case DLMS_ACTION_RESPONSE:
+        if (!dlms_core_has(size, offset, 3)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        apdu->service = p[1];
+        apdu->direction = DLMS_DIRECTION_SERVER_TO_CLIENT;
+        apdu->slot = p[2] & 0x0f;
+        break;
+    case DLMS_ACCESS_REQUEST:
+    case DLMS_ACCESS_RESPONSE:
+        if (!dlms_core_has(size, offset, 5)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        long_invoke_id = dlms_core_get_32(p + 1);
+        apdu->slot = long_invoke_id & 0x0f;
+        apdu->long_invoke_id = long_invoke_id & 0xffffff;
+        if (apdu->choice == DLMS_ACCESS_REQUEST) {
+            apdu->direction = DLMS_DIRECTION_CLIENT_TO_SERVER;
+            apdu->confirmed = (long_invoke_id & 0x40000000) != 0;
+        } else {
+            apdu->direction = DLMS_DIRECTION_SERVER_TO_CLIENT;
+        }
+        break;
+    case DLMS_EXCEPTION_RESPONSE:
+    case DLMS_DATA_NOTIFICATION:
+    case DLMS_EVENT_NOTIFICATION_REQUEST:
+        apdu->direction = DLMS_DIRECTION_SERVER_TO_CLIENT;
+        break;
+    default:
+        /*
+         * A ciphered APDU hides its Invoke-Id, but not its direction:
+         * the glo- and ded- tags are those of the plain APDUs plus 8 (and
+         * plus 16), or plus 32 (and plus 64) for the short name services
+         * and the InitiateRequest and InitiateResponse.
+         */
+        if (apdu->choice >= DLMS_GLO_GET_REQUEST && apdu->choice <= DLMS_DED_ACTION_RESPONSE) {
+            unsigned plain = DLMS_GET_REQUEST + (apdu->choice - DLMS_GLO_GET_REQUEST) % 8;
+            apdu->direction = plain == DLMS_GET_REQUEST || plain == DLMS_SET_REQUEST || plain == DLMS_ACTION_REQUEST
+                ? DLMS_DIRECTION_CLIENT_TO_SERVER
+                : DLMS_DIRECTION_SERVER_TO_CLIENT;
+        } else if (dlms_core_is_ciphered_apdu(apdu->choice) && apdu->choice < DLMS_GLO_GET_REQUEST) {
+            unsigned plain = (apdu->choice - DLMS_GLO_INITIATE_REQUEST) % 32 + 1;
+            apdu->direction = plain == 1 /* InitiateRequest */ || plain == DLMS_READ_REQUEST
+                || plain == DLMS_WRITE_REQUEST || plain == DLMS_UNCONFIRMED_WRITE_REQUEST
+                ? DLMS_DIRECTION_CLIENT_TO_SERVER
+                : DLMS_DIRECTION_SERVER_TO_CLIENT;
+        }
+        break;
+    }
+
+    return DLMS_CORE_OK;
+}
+
+int
+dlms_core_is_ciphered_apdu(unsigned choice)
+{
+    switch (choice) {
+    case 33: case 37: case 38: case 40: case 44: case 45: case 46: case 54: case 56: /* glo- */
+    case 65: case 69: case 70: case 72: case 76: case 77: case 78: case 86: case 88: /* ded- */
+    case DLMS_GENERAL_GLO_CIPHERING:
+    case DLMS_GENERAL_DED_CIPHERING:
+        return 1;
+    }
+    return choice >= DLMS_GLO_GET_REQUEST && choice <= DLMS_DED_ACTION_RESPONSE && choice % 8 != 6;
+}
+
+/*
+ * Parse the tag and security header of a ciphered APDU: the system title
+ * (general-glo-ciphering and general-ded-ciphering only), then the length
+ * of the ciphered content, the security control byte and the invocation counter
+ */
+int
+dlms_core_parse_security_header(const uint8_t *data, size_t size, size_t *offset, dlms_core_security *security)
+{
+    size_t position = *offset;
+    uint32_t length;
+    int status;
+
+    memset(security, 0, sizeof *security);
+    if (!dlms_core_has(size, position, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    security->choice = data[position++];
+    if (!dlms_core_is_ciphered_apdu(security->choice)) {
+        return DLMS_CORE_INVALID;
+    }
+    if (security->choice == DLMS_GENERAL_GLO_CIPHERING || security->choice == DLMS_GENERAL_DED_CIPHERING) {
+        status = dlms_core_get_length(data, size, &position, &security->system_title_length);
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        if (!dlms_core_has(size, position, security->system_title_length)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        security->system_title_offset = position;
+        position += security->system_title_length;
+    }
+    status = dlms_core_get_length(data, size, &position, &length);
+    if (status != DLMS_CORE_OK) {
+        return status;
+    }
+    if (length < 5) {
+        return DLMS_CORE_INVALID;
+    }
+    if (!dlms_core_has(size, position, 5)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    security->security_control = data[position];
+    security->security_control_offset = position;
+    security->invocation_counter = dlms_core_get_32(data + position + 1);
+    security->ciphered_offset = position + 5;
+    security->ciphered_length = length - 5;
+    if (!dlms_core_has(size, security->ciphered_offset, security->ciphered_length)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    *offset = security->ciphered_offset + security->ciphered_length;
+
+    return DLMS_CORE_OK;
+}
+
+/* Calculate the HDLC check sequence (HCS or FCS) of length bytes */
+uint16_t
+dlms_core_hdlc_check_sequence(const uint8_t *data, size_t length)
+{
+    size_t i;
+    int j;
+    unsigned cs;
+
+    cs = 0xffff;
+    for (i = 0; i < length; i++) {
+        cs = cs ^ data[i];
+        for (j = 0; j < 8; j++) {
+            if (cs & 1) {
+                cs = (cs >> 1) ^ 0x8408;
+            } else {
+                cs = cs >> 1;
+            }
+        }
+    }
+
+    return (uint16_t)(cs ^ 0xffff);
+}
+
+/*
+ * Parse an HDLC address field: the bytes up to the first one with the
+ * extension bit (bit 0) set, which are 1, 2 or 4. Of 4 bytes, the upper and
+ * lower HDLC addresses take 14 bits each, 7 bits from each byte.
+ */
+int
+dlms_core_parse_hdlc_address(const uint8_t *data, size_t size, size_t offset, dlms_core_hdlc_address *address)
+{
+    const uint8_t *p = data + offset;
+    unsigned n;
+
+    memset(address, 0, sizeof *address);
+    for (n = 0; n < 4; n++) {
+        if (!dlms_core_has(size, offset, n + 1)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        if (p[n] & 1) {
+            break;
+        }
+    }
+    if (n == 4 || n == 2) {
+        return DLMS_CORE_INVALID; /* no extension bit in 4 bytes, or 3 bytes */
+    }
+    address->length = n + 1;
+    if (address->length == 1) {
+        address->upper = p[0] >> 1;
+    } else if (address->length == 2) {
+        address->upper = p[0] >> 1;
+        address->lower = p[1] >> 1;
+    } else {
+        address->upper = (p[0] >> 1) << 7 | (p[1] >> 1);
+        address->lower = (p[2] >> 1) << 7 | (p[3] >> 1);
+    }
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse the HDLC frame that starts with the opening flag at offset, but not its check sequences */
+int
+dlms_core_parse_hdlc_header(const uint8_t *data, size_t size, size_t offset, dlms_core_hdlc *frame)
+{
+    unsigned format, header_length;
+    int status;
+
+    memset(frame, 0, sizeof *frame);
+    if (!dlms_core_has(size, offset, 3)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    format = dlms_core_get_16(data + offset + 1);
+    frame->type = format >> 12;
+    frame->segmentation = (format >> 11) & 1;
+    frame->length = format & 0x7ff;
+    status = dlms_core_parse_hdlc_address(data, size, offset + 3, &frame->destination_address);
+    if (status != DLMS_CORE_OK) {
+        return status;
+    }
+    status = dlms_core_parse_hdlc_address(data, size, offset + 3 + frame->destination_address.length,
+                                          &frame->source_address);
+    if (status != DLMS_CORE_OK) {
+        return status;
+    }
+    frame->destination = frame->destination_address.upper;
+    frame->source = frame->source_address.upper;
+    frame->control_offset = offset + 3 + frame->destination_address.length + frame->source_address.length;
+    if (!dlms_core_has(size, frame->control_offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    frame->control = data[frame->control_offset];
+
+    /* format, addresses and control, then the frame check sequence */
+    header_length = 2 + frame->destination_address.length + frame->source_address.length + 1;
+    if (frame->length < header_length + 2) {
+        return DLMS_CORE_INVALID;
+    }
+    if (!dlms_core_has(size, offset, frame->length + 2)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+
+    if (frame->length > header_length + 2) {
+        frame->has_hcs = 1;
+        frame->hcs_offset = frame->control_offset + 1;
+        frame->information_offset = frame->hcs_offset + 2;
+        frame->information_length = frame->length > header_length + 4 ? frame->length - header_length - 4 : 0;
+    }
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse the HDLC frame that starts with the opening flag at offset */
+int
+dlms_core_parse_hdlc(const uint8_t *data, size_t size, size_t offset, dlms_core_hdlc *frame)
+{
+    const uint8_t *p = data + offset;
+    size_t hcs;
+    int status;
+
+    status = dlms_core_parse_hdlc_header(data, size, offset, frame);
+    if (status != DLMS_CORE_OK) {
+        return status;
+    }
+    if (frame->has_hcs) {
+        hcs = frame->hcs_offset - offset;
+        frame->hcs_ok = dlms_core_hdlc_check_sequence(p + 1, hcs - 1) == (p[hcs] | (p[hcs + 1] << 8));
+    }
+    frame->fcs_ok = dlms_core_hdlc_check_sequence(p + 1, frame->length - 2)
+        == (p[frame->length - 1] | (p[frame->length] << 8));
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse the value encoded in the specified length octets in definite form */
+int
+dlms_core_get_length(const uint8_t *data, size_t size, size_t *offset, uint32_t *length)
+{
+    unsigned i, n;
+
+    if (!dlms_core_has(size, *offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    *length = data[*offset];
+    if ((*length & 0x80) == 0) {
+        *offset += 1;
+        return DLMS_CORE_OK;
+    }
+
+    n = *length & 0x7f;
+    if (n > 4) {
+        return DLMS_CORE_INVALID; /* does not fit in 32 bits */
+    }
+    if (!dlms_core_has(size, *offset + 1, n)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    *length = 0;
+    for (i = 0; i < n; i++) {
+        *length = (*length << 8) + data[*offset + 1 + i];
+    }
+    *offset += 1 + n;
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse the raw data (length and bytes) of a block */
+static int
+dlms_core_parse_block_data(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block)
+{
+    int status;
+
+    block->length_offset = *offset;
+    status = dlms_core_get_length(data, size, offset, &block->data_length);
+    if (status != DLMS_CORE_OK) {
+        return status;
+    }
+    block->data_offset = *offset;
+    if (!dlms_core_has(size, *offset, block->data_length)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    *offset += block->data_length;
+
+    return DLMS_CORE_OK;
+}
+
+int
+dlms_core_parse_datablock_g(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block)
+{
+    memset(block, 0, sizeof *block);
+    if (!dlms_core_has(size, *offset, 6)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    block->last_block = data[*offset];
+    block->block_number = dlms_core_get_32(data + *offset + 1);
+    block->result = data[*offset + 5];
+    *offset += 6;
+    if (block->result == 0) {
+        return dlms_core_parse_block_data(data, size, offset, block);
+    } else if (block->result == 1) {
+        if (!dlms_core_has(size, *offset, 1)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        block->data_access_result = data[*offset];
+        *offset += 1;
+        return DLMS_CORE_OK;
+    }
+
+    return DLMS_CORE_INVALID;
+}
+
+int
+dlms_core_parse_datablock_sa(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block)
+{
+    memset(block, 0, sizeof *block);
+    if (!dlms_core_has(size, *offset, 5)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    block->last_block = data[*offset];
+    block->block_number = dlms_core_get_32(data + *offset + 1);
+    *offset += 5;
+
+    return dlms_core_parse_block_data(data, size, offset, block);
+}
+
+int
+dlms_core_parse_data_block_result(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block)
+{
+    memset(block, 0, sizeof *block);
+    if (!dlms_core_has(size, *offset, 3)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    block->last_block = data[*offset];
+    block->block_number = dlms_core_get_16(data + *offset + 1);
+    *offset += 3;
+
+    return dlms_core_parse_block_data(data, size, offset, block);
+}
+
+/* Parse a General-Block-Transfer APDU, from the block control field (after the APDU tag) */
+int
+dlms_core_parse_general_block_transfer(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block)
+{
+    unsigned block_control;
+
+    memset(block, 0, sizeof *block);
+    if (!dlms_core_has(size, *offset, 5)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    block_control = data[*offset];
+    block->last_block = block_control >> 7;
+    block->streaming = (block_control >> 6) & 1;
+    block->window = block_control & 0x3f;
+    block->block_number = dlms_core_get_16(data + *offset + 1);
+    block->block_number_ack = dlms_core_get_16(data + *offset + 3);
+    *offset += 5;
+
+    return dlms_core_parse_block_data(data, size, offset, block);
+}
+
+/* Parse a COSEM attribute or method descriptor */
+static int
+dlms_core_parse_descriptor(const uint8_t *data, size_t size, size_t *offset, dlms_core_service *service)
+{
+    if (!dlms_core_has(size, *offset, 9)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    service->has_descriptor = 1;
+    service->descriptor.offset = *offset;
+    service->descriptor.class_id = dlms_core_get_16(data + *offset);
+    memcpy(service->descriptor.instance_id, data + *offset + 2, 6);
+    service->descriptor.member_id = data[*offset + 8];
+    *offset += 9;
+
+    return DLMS_CORE_OK;
+}
+
+static int
+dlms_core_parse_block_number(const uint8_t *data, size_t size, size_t *offset, dlms_core_service *service)
+{
+    if (!dlms_core_has(size, *offset, 4)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    service->has_block_number = 1;
+    service->block_number = dlms_core_get_32(data + *offset);
+    service->block_number_offset = *offset;
+    *offset += 4;
+
+    return DLMS_CORE_OK;
+}
+
+static int
+dlms_core_parse_data_access_result(const uint8_t *data, size_t size, size_t *offset, dlms_core_service *service)
+{
+    if (!dlms_core_has(size, *offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    service->has_data_access_result = 1;
+    service->data_access_result = data[*offset];
+    service->data_access_result_offset = *offset;
+    *offset += 1;
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse a date-time octet string, preceded by a presence byte if it is optional */
+static int
+dlms_core_parse_service_date_time(const uint8_t *data, size_t size, size_t *offset, dlms_core_service *service,
+                                  int optional)
+{
+    int status;
+
+    if (optional) {
+        if (!dlms_core_has(size, *offset, 1)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        *offset += 1;
+        if (!data[*offset - 1]) {
+            return DLMS_CORE_OK;
+        }
+    }
+    service->date_time_offset = *offset;
+    status = dlms_core_get_length(data, size, offset, &service->date_time_length);
+    if (status != DLMS_CORE_OK) {
+        return status;
+    }
+    if (!dlms_core_has(size, *offset, service->date_time_length)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    service->has_date_time = 1;
+    service->date_time_contents_offset = *offset;
+    *offset += service->date_time_length;
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse a Get-Data-Result: Data, or a data-access-result */
+static int
+dlms_core_parse_get_data_result(const uint8_t *data, size_t size, size_t *offset, dlms_core_service *service)
+{
+    if (!dlms_core_has(size, *offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    *offset += 1;
+    if (data[*offset - 1] == 0) {
+        service->has_data = 1;
+        service->data_offset = *offset;
+        return DLMS_CORE_OK;
+    } else if (data[*offset - 1] == 1) {
+        return dlms_core_parse_data_access_result(data, size, offset, service);
+    }
+
+    return DLMS_CORE_INVALID;
+}
+
+/*
+ * Parse an Action-Response-With-Optional-Data, setting the action result
+ * and Get-Data-Result fields of service. The optional return parameters
+ * may be left out altogether at the end of the APDU.
+ */
+int
+dlms_core_parse_action_response_with_optional_data(const uint8_t *data, size_t size, size_t *offset,
+                                                   dlms_core_service *service)
+{
+    if (!dlms_core_has(size, *offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    service->has_action_result = 1;
+    service->action_result = data[*offset];
+    service->action_result_offset = *offset;
+    *offset += 1;
+    if (*offset >= size) {
+        return DLMS_CORE_OK;
+    }
+    *offset += 1;
+    if (data[*offset - 1]) { /* return-parameters */
+        return dlms_core_parse_get_data_result(data, size, offset, service);
+    }
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse the fields of a service APDU, from its tag at offset */
+int
+dlms_core_parse_service(const uint8_t *data, size_t size, size_t offset, dlms_core_service *service)
+{
+    int status = DLMS_CORE_OK;
+
+    memset(service, 0, sizeof *service);
+    if (!dlms_core_has(size, offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    service->choice = data[offset];
+    offset += 1;
+
+    switch (service->choice) {
+    case DLMS_GET_REQUEST:
+    case DLMS_SET_REQUEST:
+    case DLMS_ACTION_REQUEST:
+    case DLMS_GET_RESPONSE:
+    case DLMS_SET_RESPONSE:
+    case DLMS_ACTION_RESPONSE:
+        if (!dlms_core_has(size, offset, 2)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        service->service = data[offset];
+        service->invoke_id = data[offset + 1];
+        service->invoke_id_offset = offset + 1;
+        offset += 2;
+        break;
+    case DLMS_DATA_NOTIFICATION:
+    case DLMS_ACCESS_REQUEST:
+    case DLMS_ACCESS_RESPONSE:
+        if (!dlms_core_has(size, offset, 4)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        service->invoke_id = dlms_core_get_32(data + offset);
+        service->invoke_id_offset = offset;
+        offset += 4;
+        status = dlms_core_parse_service_date_time(data, size, &offset, service, 0);
+        if (service->choice == DLMS_DATA_NOTIFICATION) {
+            service->has_data = 1; /* notification-body */
+            service->data_offset = offset;
+        }
+        break;
+    case DLMS_EVENT_NOTIFICATION_REQUEST:
+        status = dlms_core_parse_service_date_time(data, size, &offset, service, 1);
+        if (status == DLMS_CORE_OK) {
+            status = dlms_core_parse_descriptor(data, size, &offset, service);
+        }
+        service->has_data = 1; /* attribute-value */
+        service->data_offset = offset;
+        break;
+    case DLMS_EXCEPTION_RESPONSE:
+        if (!dlms_core_has(size, offset, 2)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        service->state_error = data[offset];
+        service->service_error = data[offset + 1];
+        offset += 2;
+        break;
+    default:
+        return DLMS_CORE_INVALID;
+    }
+    if (status != DLMS_CORE_OK) {
+        return status;
+    }
+
+    switch (service->choice) {
+    case DLMS_GET_REQUEST:
+        if (service->service == 1 /* get-request-normal */) {
+            status = dlms_core_parse_descriptor(data, size, &offset, service);
+        } else if (service->service == 2 /* get-request-next */) {
+            status = dlms_core_parse_block_number(data, size, &offset, service);
+        }
+        break;
+    case DLMS_SET_REQUEST:
+        if (service->service == 1 /* set-request-normal */ || service->service == 2 /* with-first-datablock */) {
+            status = dlms_core_parse_descriptor(data, size, &offset, service);
+        }
+        break;
+    case DLMS_ACTION_REQUEST:
+        if (service->service == 1 /* action-request-normal */) {
+            status = dlms_core_parse_descriptor(data, size, &offset, service);
+            if (status == DLMS_CORE_OK) {
+                if (!dlms_core_has(size, offset, 1)) {
+                    return DLMS_CORE_TRUNCATED;
+                }
+                offset += 1;
+                if (data[offset - 1]) { /* method-invocation-parameters */
+                    service->has_data = 1;
+                    service->data_offset = offset;
+                }
+            }
+        } else if (service->service == 2 /* action-request-next-pblock */) {
+            status = dlms_core_parse_block_number(data, size, &offset, service);
+        } else if (service->service == 4 /* action-request-with-first-pblock */) {
+            status = dlms_core_parse_descriptor(data, size, &offset, service);
+        }
+        break;
+    case DLMS_GET_RESPONSE:
+        if (service->service == 1 /* get-response-normal */) {
+            status = dlms_core_parse_get_data_result(data, size, &offset, service);
+        }
+        break;
+    case DLMS_SET_RESPONSE:
+        if (service->service == 1 /* set-response-normal */ || service->service == 3 /* last-datablock */) {
+            status = dlms_core_parse_data_access_result(data, size, &offset, service);
+        }
+        if (status == DLMS_CORE_OK && (service->service == 2 /* set-response-datablock */ || service->service == 3)) {
+            status = dlms_core_parse_block_number(data, size, &offset, service);
+        }
+        break;
+    case DLMS_ACTION_RESPONSE:
+        if (service->service == 1 /* action-response-normal */) {
+            status = dlms_core_parse_action_response_with_optional_data(data, size, &offset, service);
+        } else if (service->service == 4 /* action-response-next-pblock */) {
+            status = dlms_core_parse_block_number(data, size, &offset, service);
+        }
+        break;
+    }
+    service->offset = offset;
+
+    return status;
+}
+
+/* Parse a date-time from an octet-string, if it looks like one */
+int
+dlms_core_parse_date_time(const uint8_t *data, size_t length, dlms_core_date_time *dt)
+{
+    if (length != 12) return DLMS_CORE_INVALID;
+    dt->year = dlms_core_get_16(data);
+    dt->month = data[2];
+    if (dt->month < 1 || (dt->month > 12 && dt->month < 0xfd)) return DLMS_CORE_INVALID;
+    dt->day_of_month = data[3];
+    if (dt->day_of_month < 1 || (dt->day_of_month > 31 && dt->day_of_month < 0xfd)) return DLMS_CORE_INVALID;
+    dt->day_of_week = data[4];
+    if (dt->day_of_week < 1 || (dt->day_of_week > 7 && dt->day_of_week < 0xff)) return DLMS_CORE_INVALID;
+    dt->hour = data[5];
+    if (dt->hour > 23 && dt->hour < 0xff) return DLMS_CORE_INVALID;
+    dt->minute = data[6];
+    if (dt->minute > 59 && dt->minute < 0xff) return DLMS_CORE_INVALID;
+    dt->second = data[7];
+    if (dt->second > 59 && dt->second < 0xff) return DLMS_CORE_INVALID;
+    dt->hundredths = data[8];
+    if (dt->hundredths > 99 && dt->hundredths < 0xff) return DLMS_CORE_INVALID;
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse the contents of a planar data type (not array nor structure), after its tag */
+static int
+dlms_core_parse_planar(const uint8_t *data, size_t size, size_t *offset, dlms_core_data *d)
+{
+    const uint8_t *p;
+    size_t n; /* number of fixed-size bytes of the value */
+    int status;
+
+    if (d->choice == 4 || d->choice == 9 || d->choice == 10 || d->choice == 12) {
+        /* bit-string, octet-string, visible-string, utf8-string */
+        status = dlms_core_get_length(data, size, offset, &d->length);
+        if (status != DLMS_CORE_OK) {
+            d->length = 0;
+            return status;
+        }
+        n = d->choice == 4 ? (d->length + 7) / 8 : d->length;
+        if (!dlms_core_has(size, *offset, n)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        d->contents_offset = *offset;
+        *offset += n;
+        return DLMS_CORE_OK;
+    }
+
+    switch (d->choice) {
+    case 0: /* null-data */
+    case 255: /* dont-care */
+        n = 0;
+        break;
+    case 3: /* boolean */
+    case 13: /* bcd */
+    case 15: /* integer */
+    case 17: /* unsigned */
+    case 22: /* enum */
+        n = 1;
+        break;
+    case 16: /* long */
+    case 18: /* long-unsigned */
+        n = 2;
+        break;
+    case 5: /* double-long */
+    case 6: /* double-long-unsigned */
+    case 23: /* float32 */
+    case 27: /* time */
+        n = 4;
+        break;
+    case 26: /* date */
+        n = 5;
+        break;
+    case 20: /* long64 */
+    case 21: /* long64-unsigned */
+    case 24: /* float64 */
+        n = 8;
+        break;
+    case 25: /* date-time */
+        n = 12;
+        break;
+    default:
+        return DLMS_CORE_INVALID;
+    }
+    if (!dlms_core_has(size, *offset, n)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    p = data + *offset;
+    d->contents_offset = *offset;
+    d->length = (uint32_t)n;
+
+    switch (d->choice) {
+    case 3: case 13: case 17: case 22:
+        d->value.u = p[0];
+        break;
+    case 15:
+        d->value.i = (int8_t)p[0];
+        break;
+    case 16:
+        d->value.i = (int16_t)dlms_core_get_16(p);
+        break;
+    case 18:
+        d->value.u = dlms_core_get_16(p);
+        break;
+    case 5:
+        d->value.i = (int32_t)dlms_core_get_32(p);
+        break;
+    case 6:
+        d->value.u = dlms_core_get_32(p);
+        break;
+    case 20:
+        d->value.i = (int64_t)dlms_core_get_64(p);
+        break;
+    case 21:
+        d->value.u = dlms_core_get_64(p);
+        break;
+    case 23: {
+        uint32_t bits = dlms_core_get_32(p);
+        float f;
+        memcpy(&f, &bits, sizeof f);
+        d->value.f = f;
+        break;
+    }
+    case 24: {
+        uint64_t bits = dlms_core_get_64(p);
+        memcpy(&d->value.f, &bits, sizeof d->value.f);
+        break;
+    }
+    }
+    *offset += n;
+
+    return DLMS_CORE_OK;
+}
+
+/*
+ * Calculate the number of bytes used by a TypeDescription of a compact array.
+ * Types without contents (null-data, dont-care, and empty arrays and structures)
+ * are invalid, so that every element of the compact array takes at least one
+ * byte of its contents, and the number of values reported stays proportional
+ * to the size of the contents.
+ */
+static int
+dlms_core_get_type_description_length(const uint8_t *data, size_t size, size_t offset, unsigned depth,
+                                      size_t *length)
+{
+    size_t end_offset;
+    uint32_t sequence_of;
+    int status;
+
+    if (depth > DLMS_CORE_MAX_DEPTH) {
+        return DLMS_CORE_INVALID;
+    }
+    if (!dlms_core_has(size, offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    if (data[offset] == 1) { /* array */
+        if (!dlms_core_has(size, offset, 3)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        if (dlms_core_get_16(data + offset + 1) == 0) {
+            return DLMS_CORE_INVALID;
+        }
+        status = dlms_core_get_type_description_length(data, size, offset + 3, depth + 1, length);
+        *length += 1 + 2;
+        return status;
+    } else if (data[offset] == 2) { /* structure */
+        end_offset = offset + 1;
+        status = dlms_core_get_length(data, size, &end_offset, &sequence_of);
+        if (status == DLMS_CORE_OK && sequence_of == 0) {
+            return DLMS_CORE_INVALID;
+        }
+        while (status == DLMS_CORE_OK && sequence_of--) {
+            status = dlms_core_get_type_description_length(data, size, end_offset, depth + 1, length);
+            end_offset += *length;
+        }
+        *length = end_offset - offset;
+        return status;
+    } else if (data[offset] == 0 || data[offset] == 255) { /* null-data or dont-care */
+        return DLMS_CORE_INVALID;
+    }
+    *length = 1;
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse a value in the contents of a compact array, as described by the TypeDescription at description_offset */
+static int
+dlms_core_parse_compact_array_content(const uint8_t *data, size_t size, size_t description_offset, size_t *offset,
+                                      const dlms_core_data_visitor *visitor, void *context, void *parent,
+                                      unsigned depth, unsigned index)
+{
+    dlms_core_data d;
+    void *element_parent;
+    size_t description_length;
+    uint32_t i;
+    int status;
+
+    memset(&d, 0, sizeof d);
+    d.depth = depth;
+    d.index = index;
+    d.compact = 1;
+    d.offset = *offset;
+    if (!dlms_core_has(size, description_offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    d.choice = data[description_offset];
+    description_offset += 1;
+
+    if (d.choice == 1) { /* array */
+        if (!dlms_core_has(size, description_offset, 2)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        d.length = dlms_core_get_16(data + description_offset);
+        description_offset += 2;
+        element_parent = visitor->begin(context, parent, &d);
+        for (i = 0; i < d.length; i++) {
+            status = dlms_core_parse_compact_array_content(data, size, description_offset, offset,
+                                                           visitor, context, element_parent, depth + 1, i + 1);
+            if (status != DLMS_CORE_OK) {
+                return status;
+            }
+        }
+    } else if (d.choice == 2) { /* structure */
+        status = dlms_core_get_length(data, size, &description_offset, &d.length);
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        element_parent = visitor->begin(context, parent, &d);
+        for (i = 0; i < d.length; i++) {
+            status = dlms_core_parse_compact_array_content(data, size, description_offset, offset,
+                                                           visitor, context, element_parent, depth + 1, 0);
+            if (status == DLMS_CORE_OK) {
+                status = dlms_core_get_type_description_length(data, size, description_offset, depth + 1,
+                                                               &description_length);
+                description_offset += description_length;
+            }
+            if (status != DLMS_CORE_OK) {
+                return status;
+            }
+        }
+    } else { /* planar type */
+        status = dlms_core_parse_planar(data, size, offset, &d);
+        d.end_offset = *offset;
+        if (status != DLMS_CORE_TRUNCATED) {
+            visitor->value(context, parent, &d);
+        }
+        return status;
+    }
+    d.end_offset = *offset;
+    visitor->end(context, parent, element_parent, &d);
+
+    return DLMS_CORE_OK;
+}
+
+static int
+dlms_core_parse_value(const uint8_t *data, size_t size, size_t *offset,
+                      const dlms_core_data_visitor *visitor, void *context, void *parent,
+                      unsigned depth, unsigned index)
+{
+    dlms_core_data d;
+    void *element_parent;
+    size_t content_end;
+    uint32_t i;
+    int status;
+
+    memset(&d, 0, sizeof d);
+    d.depth = depth;
+    d.index = index;
+    d.offset = *offset;
+    if (depth > DLMS_CORE_MAX_DEPTH) {
+        return DLMS_CORE_INVALID;
+    }
+    if (!dlms_core_has(size, *offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    d.choice = data[*offset];
+    *offset += 1;
+
+    if (d.choice == 1 || d.choice == 2) { /* array or structure */
+        status = dlms_core_get_length(data, size, offset, &d.length);
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        element_parent = visitor->begin(context, parent, &d);
+        for (i = 0; i < d.length; i++) {
+            status = dlms_core_parse_value(data, size, offset, visitor, context, element_parent,
+                                           depth + 1, d.choice == 1 ? i + 1 : 0);
+            if (status != DLMS_CORE_OK) {
+                return status;
+            }
+        }
+    } else if (d.choice == 19) { /* compact-array */
+        d.description_offset = *offset;
+        status = dlms_core_get_type_description_length(data, size, *offset, depth + 1, &d.description_length);
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        *offset += d.description_length;
+        d.length_offset = *offset;
+        status = dlms_core_get_length(data, size, offset, &d.contents_length);
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        d.contents_offset = *offset;
+        element_parent = visitor->begin(context, parent, &d);
+        content_end = *offset + d.contents_length;
+        while (*offset < content_end) {
+            status = dlms_core_parse_compact_array_content(data, size, d.description_offset, offset,
+                                                           visitor, context, element_parent, depth + 1, ++d.length);
+            if (status != DLMS_CORE_OK) {
+                return status;
+            }
+        }
+    } else { /* planar type */
+        status = dlms_core_parse_planar(data, size, offset, &d);
+        d.end_offset = *offset;
+        if (status != DLMS_CORE_TRUNCATED) {
+            visitor->value(context, parent, &d);
+        }
+        return status;
+    }
+    d.end_offset = *offset;
+    visitor->end(context, parent, element_parent, &d);
+
+    return DLMS_CORE_OK;
+}
+
+/* Parse A-XDR encoded Data, reporting its values to the visitor */
+int
+dlms_core_parse_data(const uint8_t *data, size_t size, size_t *offset,
+                     const dlms_core_data_visitor *visitor, void *context, void *parent)
+{
+    return dlms_core_parse_value(data, size, offset, visitor, context, parent, 0, 0);
+}
+
+static int
+dlms_core_skip_value(const uint8_t *data, size_t size, size_t *offset, unsigned depth)
+{
+    dlms_core_data d;
+    size_t description_length;
+    uint32_t i;
+    int status;
+
+    if (depth > DLMS_CORE_MAX_DEPTH) {
+        return DLMS_CORE_INVALID;
+    }
+    if (!dlms_core_has(size, *offset, 1)) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    memset(&d, 0, sizeof d);
+    d.choice = data[*offset];
+    *offset += 1;
+
+    if (d.choice == 1 || d.choice == 2) { /* array or structure */
+        status = dlms_core_get_length(data, size, offset, &d.length);
+        for (i = 0; status == DLMS_CORE_OK && i < d.length; i++) {
+            status = dlms_core_skip_value(data, size, offset, depth + 1);
+        }
+        return status;
+    } else if (d.choice == 19) { /* compact-array, skipped by the length of its contents */
+        status = dlms_core_get_type_description_length(data, size, *offset, depth + 1, &description_length);
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        *offset += description_length;
+        status = dlms_core_get_length(data, size, offset, &d.contents_length);
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        if (!dlms_core_has(size, *offset, d.contents_length)) {
+            return DLMS_CORE_TRUNCATED;
+        }
+        *offset += d.contents_length;
+        return DLMS_CORE_OK;
+    }
+
+    return dlms_core_parse_planar(data, size, offset, &d);
+}
+
+/* Move past A-XDR encoded Data without reporting its values */
+int
+dlms_core_skip_data(const uint8_t *data, size_t size, size_t *offset)
+{
+    return dlms_core_skip_value(data, size, offset, 0);
+}
@@ -0,0 +1,314 @@
+/*
+ * dlms_core.h - Device Language Message Specification decoding core
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The decoding core parses HDLC frames, APDU headers, datablocks and
+ * A-XDR data from plain byte buffers, independently of Wireshark.
+ * It keeps no global state, so it may be used from any number of threads.
+ *
+ * All parse functions take the buffer, its size and the offset to parse at,
+ * which they advance past what they parsed. They return DLMS_CORE_OK,
+ * or DLMS_CORE_TRUNCATED when the buffer ends before the encoding does,
+ * or DLMS_CORE_INVALID when the encoding is not valid.
+ */
+
+#ifndef DLMS_CORE_H
+#define DLMS_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Results of the parse functions */
+#define DLMS_CORE_OK 0
+#define DLMS_CORE_TRUNCATED (-1)
+#define DLMS_CORE_INVALID (-2)
+
+/* Choice values for the currently supported ACSE and xDLMS APDUs */
+#define DLMS_READ_REQUEST 5
+#define DLMS_WRITE_REQUEST 6
+#define DLMS_READ_RESPONSE 12
+#define DLMS_WRITE_RESPONSE 13
+#define DLMS_DATA_NOTIFICATION 15
+#define DLMS_UNCONFIRMED_WRITE_REQUEST 22
+#define DLMS_AARQ 96
+#define DLMS_AARE 97
+#define DLMS_RLRQ 98
+#define DLMS_RLRE 99
+#define DLMS_GET_REQUEST 192
+#define DLMS_SET_REQUEST 193
+#define DLMS_EVENT_NOTIFICATION_REQUEST 194
+#define DLMS_ACTION_REQUEST 195
+#define DLMS_GET_RESPONSE 196
+#define DLMS_SET_RESPONSE 197
+#define DLMS_ACTION_RESPONSE 199
+#define DLMS_EXCEPTION_RESPONSE 216
+#define DLMS_ACCESS_REQUEST 217
+#define DLMS_ACCESS_RESPONSE 218
+#define DLMS_GENERAL_BLOCK_TRANSFER 224
+
+/*
+ * Choice values for the ciphered APDUs: the service-specific ones with a
+ * global (glo-) or dedicated (ded-) key, between these ranges, and the
+ * general-glo-ciphering and general-ded-ciphering APDUs, which carry the
+ * system title of the sender
+ */
+#define DLMS_GLO_INITIATE_REQUEST 33
+#define DLMS_GLO_INITIATE_RESPONSE 40
+#define DLMS_DED_INITIATE_REQUEST 65
+#define DLMS_DED_INITIATE_RESPONSE 72
+#define DLMS_GLO_GET_REQUEST 200
+#define DLMS_DED_ACTION_RESPONSE 215
+#define DLMS_GENERAL_GLO_CIPHERING 219
+#define DLMS_GENERAL_DED_CIPHERING 220
+
+/* Direction of an APDU, as far as it can be told from its type */
+enum {
+    DLMS_DIRECTION_UNKNOWN,
+    DLMS_DIRECTION_CLIENT_TO_SERVER,
+    DLMS_DIRECTION_SERVER_TO_CLIENT,
+};
+
+/*
+ * Requests are tracked per Invoke-Id, plus one slot for the ACSE services
+ * and one for the short name referencing services (which have no Invoke-Id)
+ */
+#define DLMS_REQUEST_SLOTS 18
+#define DLMS_REQUEST_SLOT_ACSE 16
+#define DLMS_REQUEST_SLOT_SN 17
+
+/* Classification of an APDU from its first bytes */
+struct dlms_core_apdu {
+    unsigned choice; /* APDU tag (DLMS_AARQ, ...) */
+    unsigned service; /* choice of the service variant (1 for get-request-normal, ...), 0 if none */
+    int direction; /* DLMS_DIRECTION_* */
+    int slot; /* request slot (Invoke-Id or DLMS_REQUEST_SLOT_ACSE), -1 if none */
+    uint32_t long_invoke_id; /* of ACCESS requests and responses, whose slot is only its 4 low-order bits */
+    int confirmed; /* whether a request expects a response */
+    int hls_pass_3; /* whether an action-request invokes reply_to_hls_authentication of an association LN */
+};
+typedef struct dlms_core_apdu dlms_core_apdu;
+
+int dlms_core_classify_apdu(const uint8_t *data, size_t size, size_t offset, dlms_core_apdu *apdu);
+
+/* Security control byte of a ciphered APDU */
+#define DLMS_SECURITY_SUITE 0x0f
+#define DLMS_SECURITY_AUTHENTICATION 0x10
+#define DLMS_SECURITY_ENCRYPTION 0x20
+#define DLMS_SECURITY_BROADCAST_KEY 0x40
+#define DLMS_SECURITY_COMPRESSION 0x80
+
+/* Length of the authentication tag of an authenticated ciphered APDU */
+#define DLMS_SECURITY_TAG_LENGTH 12
+
+/* The cleartext security header of a ciphered APDU */
+struct dlms_core_security {
+    unsigned choice; /* APDU tag */
+    size_t system_title_offset; /* general-glo-ciphering and general-ded-ciphering only, else 0 */
+    uint32_t system_title_length;
+    unsigned security_control;
+    uint32_t invocation_counter;
+    size_t security_control_offset;
+    size_t ciphered_offset; /* offset of the ciphered text, after the invocation counter */
+    uint32_t ciphered_length; /* including the authentication tag (if any) */
+};
+typedef struct dlms_core_security dlms_core_security;
+
+/* Whether an APDU tag is that of a ciphered APDU with a security header */
+int dlms_core_is_ciphered_apdu(unsigned choice);
+int dlms_core_parse_security_header(const uint8_t *data, size_t size, size_t *offset, dlms_core_security *security);
+
+/*
+ * An HDLC address field of 1, 2 or 4 bytes (the last one with the extension
+ * bit set): the upper HDLC address (logical device) and, in the 2 and 4 byte
+ * server addresses, the lower HDLC address (physical device)
+ */
+struct dlms_core_hdlc_address {
+    unsigned upper;
+    unsigned lower; /* 0 in 1 byte addresses */
+    unsigned length; /* number of bytes */
+};
+typedef struct dlms_core_hdlc_address dlms_core_hdlc_address;
+
+/* An HDLC frame (opening flag to closing flag) */
+struct dlms_core_hdlc {
+    unsigned type; /* frame format type */
+    unsigned segmentation; /* frame format segmentation bit */
+    unsigned length; /* frame format length sub-field (frame length excluding the flags) */
+    unsigned destination; /* upper HDLC address of the destination */
+    unsigned source; /* upper HDLC address of the source */
+    dlms_core_hdlc_address destination_address; /* the whole destination and source address fields */
+    dlms_core_hdlc_address source_address;
+    unsigned control; /* control field */
+    size_t control_offset; /* offset of the control field */
+    size_t hcs_offset; /* offset of the header check sequence (if has_hcs) */
+    int has_hcs; /* whether the frame has an information field, and so a header check sequence */
+    int hcs_ok; /* whether the header check sequence is correct */
+    int fcs_ok; /* whether the frame check sequence is correct */
+    size_t information_offset; /* offset of the information field */
+    size_t information_length; /* length of the information field */
+};
+typedef struct dlms_core_hdlc dlms_core_hdlc;
+
+uint16_t dlms_core_hdlc_check_sequence(const uint8_t *data, size_t length);
+int dlms_core_parse_hdlc_address(const uint8_t *data, size_t size, size_t offset, dlms_core_hdlc_address *address);
+int dlms_core_parse_hdlc(const uint8_t *data, size_t size, size_t offset, dlms_core_hdlc *frame);
+/* The same, without verifying the check sequences (hcs_ok and fcs_ok are left 0) */
+int dlms_core_parse_hdlc_header(const uint8_t *data, size_t size, size_t offset, dlms_core_hdlc *frame);
+
+/* A DataBlock-G, DataBlock-SA or General-Block-Transfer block */
+struct dlms_core_block {
+    unsigned last_block;
+    unsigned block_number;
+    unsigned block_number_ack; /* General-Block-Transfer only */
+    unsigned streaming; /* General-Block-Transfer only */
+    unsigned window; /* General-Block-Transfer only */
+    unsigned result; /* DataBlock-G only: 0 for raw-data, 1 for data-access-result */
+    unsigned data_access_result; /* DataBlock-G only, if result is 1 */
+    size_t length_offset; /* offset of the length of the raw data */
+    size_t data_offset; /* offset of the raw data */
+    uint32_t data_length; /* length of the raw data */
+};
+typedef struct dlms_core_block dlms_core_block;
+
+int dlms_core_parse_datablock_g(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block);
+int dlms_core_parse_datablock_sa(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block);
+/* The data-block-result of a ReadResponse (short name referencing), with a 16-bit block number */
+int dlms_core_parse_data_block_result(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block);
+int dlms_core_parse_general_block_transfer(const uint8_t *data, size_t size, size_t *offset, dlms_core_block *block);
+
+/* Lengths in definite form */
+int dlms_core_get_length(const uint8_t *data, size_t size, size_t *offset, uint32_t *length);
+
+/* A COSEM attribute or method descriptor */
+struct dlms_core_descriptor {
+    size_t offset;
+    unsigned class_id;
+    uint8_t instance_id[6]; /* OBIS code */
+    unsigned member_id; /* attribute_id or method_id */
+};
+typedef struct dlms_core_descriptor dlms_core_descriptor;
+
+/*
+ * The fields of the body of a Get, Set, Action, Event-Notification,
+ * Exception-Response, Data-Notification or ACCESS APDU that precede its
+ * Data, datablock, pblock, access selection or lists, which are parsed with
+ * the functions for them, from offset (or from data_offset if has_data).
+ */
+struct dlms_core_service {
+    unsigned choice; /* APDU tag */
+    unsigned service; /* choice of the service variant, 0 for the APDUs without variants */
+    uint32_t invoke_id; /* Invoke-Id-And-Priority, or Long-Invoke-Id-And-Priority */
+    size_t invoke_id_offset; /* 0 if none */
+    int has_descriptor;
+    dlms_core_descriptor descriptor;
+    int has_date_time;
+    size_t date_time_offset; /* of the length of the date-time octet string */
+    size_t date_time_contents_offset;
+    uint32_t date_time_length;
+    int has_block_number;
+    uint32_t block_number;
+    size_t block_number_offset;
+    int has_action_result;
+    unsigned action_result;
+    size_t action_result_offset;
+    int has_data_access_result; /* of a Get-Data-Result or a Set-Response */
+    unsigned data_access_result;
+    size_t data_access_result_offset;
+    int has_data; /* whether Data follows at data_offset */
+    size_t data_offset;
+    unsigned state_error, service_error; /* Exception-Response only */
+    size_t offset; /* end of the fields above */
+};
+typedef struct dlms_core_service dlms_core_service;
+
+int dlms_core_parse_service(const uint8_t *data, size_t size, size_t offset, dlms_core_service *service);
+/* An Action-Response-With-Optional-Data (of Action-Response-Normal, or of each element of the list) */
+int dlms_core_parse_action_response_with_optional_data(const uint8_t *data, size_t size, size_t *offset,
+                                                       dlms_core_service *service);
+
+/* A date-time octet-string (COSEM date-time, without deviation and clock status) */
+struct dlms_core_date_time {
+    unsigned year, month, day_of_month, day_of_week;
+    unsigned hour, minute, second, hundredths;
+};
+typedef struct dlms_core_date_time dlms_core_date_time;
+
+int dlms_core_parse_date_time(const uint8_t *data, size_t length, dlms_core_date_time *date_time);
+
+/*
+ * Limit of the nesting depth of Data (and of the TypeDescription of a compact
+ * array), beyond which it is reported as invalid rather than recursed into.
+ */
+#define DLMS_CORE_MAX_DEPTH 32
+
+/* A value of A-XDR encoded Data, as reported to a data visitor */
+struct dlms_core_data {
+    unsigned choice; /* data type (1 for array, 2 for structure, ...) */
+    unsigned depth; /* nesting depth, 0 for the outermost value */
+    unsigned index; /* position in its array or compact array, from 1 (0 in a structure or outermost) */
+    int compact; /* whether it is contents of a compact array (with no tag) */
+    size_t offset; /* start of the value */
+    size_t end_offset; /* end of the value (not known yet when a composite value begins) */
+    uint32_t length; /* elements of a composite value, bytes of a string, or bits of a bit-string */
+    size_t contents_offset; /* start of the bytes of a string or of the contents of a compact array */
+    size_t description_offset; /* start of the TypeDescription of a compact array */
+    size_t description_length; /* length of the TypeDescription of a compact array */
+    size_t length_offset; /* start of the length of the contents of a compact array */
+    uint32_t contents_length; /* length of the contents of a compact array */
+    union {
+        int64_t i; /* signed integer types */
+        uint64_t u; /* boolean, unsigned integer, bcd and enum types */
+        double f; /* floating point types */
+    } value;
+};
+typedef struct dlms_core_data dlms_core_data;
+
+/*
+ * Callbacks of a data visitor. A composite value (array, structure or
+ * compact array) is reported by begin, then its elements, then end;
+ * begin returns the parent to pass along with its elements.
+ * Planar values are reported by value. The context is passed unchanged.
+ */
+struct dlms_core_data_visitor {
+    void *(*begin)(void *context, void *parent, const dlms_core_data *data);
+    void (*end)(void *context, void *parent, void *element_parent, const dlms_core_data *data);
+    void (*value)(void *context, void *parent, const dlms_core_data *data);
+};
+typedef struct dlms_core_data_visitor dlms_core_data_visitor;
+
+int dlms_core_parse_data(const uint8_t *data, size_t size, size_t *offset,
+                         const dlms_core_data_visitor *visitor, void *context, void *parent);
+
+/*
+ * Move past A-XDR encoded Data without reporting its values, for the values
+ * of no interest: the contents of compact arrays are skipped by their
+ * length, without checking them against their TypeDescription.
+ */
+int dlms_core_skip_data(const uint8_t *data, size_t size, size_t *offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,611 @@
+/*
+ * dlms_encode.c - Device Language Message Specification encoder
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "dlms_encode.h"
+
+void
+dlms_encoder_init(dlms_encoder *e)
+{
+    memset(e, 0, sizeof *e);
+    e->status = DLMS_CORE_OK;
+}
+
+void
+dlms_encoder_free(dlms_encoder *e)
+{
+    free(e->data);
+    dlms_encoder_init(e);
+}
+
+/* Make room for n more bytes */
+static int
+dlms_encode_reserve(dlms_encoder *e, size_t n)
+{
+    size_t capacity;
+    uint8_t *data;
+
+    if (e->status != DLMS_CORE_OK) {
+        return e->status;
+    }
+    if (e->capacity - e->length >= n) {
+        return DLMS_CORE_OK;
+    }
+    capacity = e->capacity ? e->capacity : 256;
+    while (capacity - e->length < n) {
+        if (capacity > (size_t)-1 / 2) {
+            return e->status = DLMS_CORE_INVALID;
+        }
+        capacity *= 2;
+    }
+    data = realloc(e->data, capacity);
+    if (!data) {
+        return e->status = DLMS_CORE_INVALID;
+    }
+    e->data = data;
+    e->capacity = capacity;
+
+    return DLMS_CORE_OK;
+}
+
+int
+dlms_encode_bytes(dlms_encoder *e, const void *data, size_t length)
+{
+    if (dlms_encode_reserve(e, length) != DLMS_CORE_OK) {
+        return e->status;
+    }
+    if (length) {
+        memcpy(e->data + e->length, data, length);
+        e->length += length;
+    }
+    return DLMS_CORE_OK;
+}
+
+int
+dlms_encode_8(dlms_encoder *e, unsigned value)
+{
+    uint8_t b = (uint8_t)value;
+    return dlms_encode_bytes(e, &b, 1);
+}
+
+int
+dlms_encode_16(dlms_encoder *e, unsigned value)
+{
+    uint8_t b[2] = { (uint8_t)(value >> 8), (uint8_t)value };
+    return dlms_encode_bytes(e, b, 2);
+}
+
+int
+dlms_encode_32(dlms_encoder *e, uint32_t value)
+{
+    uint8_t b[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+    return dlms_encode_bytes(e, b, 4);
+}
+
+static int
+dlms_encode_64(dlms_encoder *e, uint64_t value)
+{
+    dlms_encode_32(e, (uint32_t)(value >> 32));
+    return dlms_encode_32(e, (uint32_t)value);
+}
+
+/* Encode a length in definite form, in as few bytes as possible */
+static size_t
+dlms_encode_length_bytes(uint8_t *b, uint32_t length)
+{
+    size_t n = 0;
+    uint32_t l;
+
+    if (length < 0x80) {
+        b[0] = (uint8_t)length;
+        return 1;
+    }
+    for (l = length; l; l >>= 8) {
+        n++;
+    }
+    b[0] = (uint8_t)(0x80 | n);
+    for (l = 0; l < n; l++) {
+        b[n - l] = (uint8_t)(length >> (8 * l));
+    }
+    return n + 1;
+}
+
+int
+dlms_encode_length(dlms_encoder *e, uint32_t length)
+{
+    uint8_t b[5];
+    return dlms_encode_bytes(e, b, dlms_encode_length_bytes(b, length));
+}
+
+/* Encode the tag of a value, unless it is in the contents of a compact array */
+static int
+dlms_encode_tag(dlms_encoder *e, unsigned choice)
+{
+    return e->compact ? e->status : dlms_encode_8(e, choice);
+}
+
+int
+dlms_encode_null(dlms_encoder *e, unsigned choice)
+{
+    if (choice != 0 && choice != 255) {
+        return e->status = DLMS_CORE_INVALID;
+    }
+    return dlms_encode_tag(e, choice);
+}
+
+int
+dlms_encode_array(dlms_encoder *e, uint32_t count)
+{
+    if (e->compact) { /* the count is in the TypeDescription */
+        return e->status;
+    }
+    dlms_encode_8(e, 1);
+    return dlms_encode_length(e, count);
+}
+
+int
+dlms_encode_structure(dlms_encoder *e, uint32_t count)
+{
+    if (e->compact) {
+        return e->status;
+    }
+    dlms_encode_8(e, 2);
+    return dlms_encode_length(e, count);
+}
+
+int
+dlms_encode_signed(dlms_encoder *e, unsigned choice, int64_t value)
+{
+    dlms_encode_tag(e, choice);
+    switch (choice) {
+    case 15: /* integer */
+        return dlms_encode_8(e, (uint8_t)value);
+    case 16: /* long */
+        return dlms_encode_16(e, (uint16_t)value);
+    case 5: /* double-long */
+        return dlms_encode_32(e, (uint32_t)value);
+    case 20: /* long64 */
+        return dlms_encode_64(e, (uint64_t)value);
+    }
+    return e->status = DLMS_CORE_INVALID;
+}
+
+int
+dlms_encode_unsigned(dlms_encoder *e, unsigned choice, uint64_t value)
+{
+    dlms_encode_tag(e, choice);
+    switch (choice) {
+    case 3: /* boolean */
+    case 13: /* bcd */
+    case 17: /* unsigned */
+    case 22: /* enum */
+        return dlms_encode_8(e, (unsigned)value);
+    case 18: /* long-unsigned */
+        return dlms_encode_16(e, (unsigned)value);
+    case 6: /* double-long-unsigned */
+        return dlms_encode_32(e, (uint32_t)value);
+    case 21: /* long64-unsigned */
+        return dlms_encode_64(e, value);
+    }
+    return e->status = DLMS_CORE_INVALID;
+}
+
+int
+dlms_encode_float(dlms_encoder *e, unsigned choice, double value)
+{
+    dlms_encode_tag(e, choice);
+    if (choice == 23) {
+        float f = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof bits);
+        return dlms_encode_32(e, bits);
+    } else if (choice == 24) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof bits);
+        return dlms_encode_64(e, bits);
+    }
+    return e->status = DLMS_CORE_INVALID;
+}
+
+int
+dlms_encode_string(dlms_encoder *e, unsigned choice, const uint8_t *data, uint32_t length)
+{
+    switch (choice) {
+    case 4: /* bit-string */
+        dlms_encode_tag(e, choice);
+        dlms_encode_length(e, length);
+        return dlms_encode_bytes(e, data, (length + 7) / 8);
+    case 9: /* octet-string */
+    case 10: /* visible-string */
+    case 12: /* utf8-string */
+        dlms_encode_tag(e, choice);
+        dlms_encode_length(e, length);
+        return dlms_encode_bytes(e, data, length);
+    case 25: /* date-time */
+    case 26: /* date */
+    case 27: /* time */
+        if (length != (choice == 25 ? 12u : choice == 26 ? 5u : 4u)) {
+            break;
+        }
+        dlms_encode_tag(e, choice);
+        return dlms_encode_bytes(e, data, length);
+    }
+    return e->status = DLMS_CORE_INVALID;
+}
+
+/* Encode the bytes of a date-time, with unspecified deviation and clock status */
+static void
+dlms_encode_date_time_bytes(uint8_t *b, const dlms_core_date_time *dt)
+{
+    b[0] = (uint8_t)(dt->year >> 8);
+    b[1] = (uint8_t)dt->year;
+    b[2] = (uint8_t)dt->month;
+    b[3] = (uint8_t)dt->day_of_month;
+    b[4] = (uint8_t)dt->day_of_week;
+    b[5] = (uint8_t)dt->hour;
+    b[6] = (uint8_t)dt->minute;
+    b[7] = (uint8_t)dt->second;
+    b[8] = (uint8_t)dt->hundredths;
+    b[9] = 0x80;
+    b[10] = 0x00;
+    b[11] = 0xff;
+}
+
+/* Encode a date-time as an octet-string */
+int
+dlms_encode_date_time(dlms_encoder *e, const dlms_core_date_time *dt)
+{
+    uint8_t b[12];
+
+    dlms_encode_date_time_bytes(b, dt);
+    return dlms_encode_string(e, 9, b, sizeof b);
+}
+
+/*
+ * The length of the contents of a compact array is only known at the end,
+ * when it is inserted at the mark (the offset of the contents).
+ */
+int
+dlms_encode_compact_array_begin(dlms_encoder *e, const uint8_t *description, size_t description_length,
+                                 size_t *mark)
+{
+    dlms_encode_tag(e, 19);
+    dlms_encode_bytes(e, description, description_length);
+    *mark = e->length;
+    e->compact++;
+
+    return e->status;
+}
+
+int
+dlms_encode_compact_array_end(dlms_encoder *e, size_t mark)
+{
+    uint8_t b[5];
+    size_t n;
+
+    if (e->compact == 0 || mark > e->length || e->length - mark > 0xffffffff) {
+        return e->status = DLMS_CORE_INVALID;
+    }
+    e->compact--;
+    n = dlms_encode_length_bytes(b, (uint32_t)(e->length - mark));
+    if (dlms_encode_reserve(e, n) != DLMS_CORE_OK) {
+        return e->status;
+    }
+    memmove(e->data + mark + n, e->data + mark, e->length - mark);
+    memcpy(e->data + mark, b, n);
+    e->length += n;
+
+    return DLMS_CORE_OK;
+}
+
+/* Encode the class, instance and attribute or method of a descriptor */
+static int
+dlms_encode_descriptor(dlms_encoder *e, unsigned class_id, const uint8_t *obis, unsigned id)
+{
+    dlms_encode_16(e, class_id);
+    dlms_encode_bytes(e, obis, 6);
+    return dlms_encode_8(e, id);
+}
+
+int
+dlms_encode_get_request_normal(dlms_encoder *e, unsigned invoke_id, unsigned class_id,
+                               const uint8_t *obis, unsigned attribute)
+{
+    dlms_encode_8(e, DLMS_GET_REQUEST);
+    dlms_encode_8(e, 1);
+    dlms_encode_8(e, invoke_id);
+    dlms_encode_descriptor(e, class_id, obis, attribute);
+    return dlms_encode_8(e, 0); /* no access selection */
+}
+
+int
+dlms_encode_get_request_next(dlms_encoder *e, unsigned invoke_id, uint32_t block_number)
+{
+    dlms_encode_8(e, DLMS_GET_REQUEST);
+    dlms_encode_8(e, 2);
+    dlms_encode_8(e, invoke_id);
+    return dlms_encode_32(e, block_number);
+}
+
+int
+dlms_encode_get_response_normal(dlms_encoder *e, unsigned invoke_id)
+{
+    dlms_encode_8(e, DLMS_GET_RESPONSE);
+    dlms_encode_8(e, 1);
+    dlms_encode_8(e, invoke_id);
+    return dlms_encode_8(e, 0); /* data */
+}
+
+int
+dlms_encode_get_response_error(dlms_encoder *e, unsigned invoke_id, unsigned data_access_result)
+{
+    dlms_encode_8(e, DLMS_GET_RESPONSE);
+    dlms_encode_8(e, 1);
+    dlms_encode_8(e, invoke_id);
+    dlms_encode_8(e, 1); /* data-access-result */
+    return dlms_encode_8(e, data_access_result);
+}
+
+int
+dlms_encode_get_response_with_datablock(dlms_encoder *e, unsigned invoke_id, int last_block,
+                                        uint32_t block_number, const uint8_t *data, uint32_t length)
+{
+    dlms_encode_8(e, DLMS_GET_RESPONSE);
+    dlms_encode_8(e, 2);
+    dlms_encode_8(e, invoke_id);
+    dlms_encode_8(e, last_block != 0);
+    dlms_encode_32(e, block_number);
+    dlms_encode_8(e, 0); /* raw-data */
+    dlms_encode_length(e, length);
+    return dlms_encode_bytes(e, data, length);
+}
+
+int
+dlms_encode_set_request_normal(dlms_encoder *e, unsigned invoke_id, unsigned class_id,
+                               const uint8_t *obis, unsigned attribute)
+{
+    dlms_encode_8(e, DLMS_SET_REQUEST);
+    dlms_encode_8(e, 1);
+    dlms_encode_8(e, invoke_id);
+    dlms_encode_descriptor(e, class_id, obis, attribute);
+    return dlms_encode_8(e, 0); /* no access selection */
+}
+
+int
+dlms_encode_set_response_normal(dlms_encoder *e, unsigned invoke_id, unsigned data_access_result)
+{
+    dlms_encode_8(e, DLMS_SET_RESPONSE);
+    dlms_encode_8(e, 1);
+    dlms_encode_8(e, invoke_id);
+    return dlms_encode_8(e, data_access_result);
+}
+
+int
+dlms_encode_action_request_normal(dlms_encoder *e, unsigned invoke_id, unsigned class_id,
+                                  const uint8_t *obis, unsigned method, int has_parameters)
+{
+    dlms_encode_8(e, DLMS_ACTION_REQUEST);
+    dlms_encode_8(e, 1);
+    dlms_encode_8(e, invoke_id);
+    dlms_encode_descriptor(e, class_id, obis, method);
+    return dlms_encode_8(e, has_parameters != 0);
+}
+
+int
+dlms_encode_action_response_normal(dlms_encoder *e, unsigned invoke_id, unsigned action_result)
+{
+    dlms_encode_8(e, DLMS_ACTION_RESPONSE);
+    dlms_encode_8(e, 1);
+    dlms_encode_8(e, invoke_id);
+    dlms_encode_8(e, action_result);
+    return dlms_encode_8(e, 0); /* no return parameters */
+}
+
+int
+dlms_encode_data_notification(dlms_encoder *e, uint32_t long_invoke_id, const dlms_core_date_time *date_time)
+{
+    dlms_encode_8(e, DLMS_DATA_NOTIFICATION);
+    dlms_encode_32(e, long_invoke_id);
+    if (date_time) { /* octet-string of a date-time, without tag */
+        uint8_t b[12];
+        dlms_encode_date_time_bytes(b, date_time);
+        dlms_encode_8(e, sizeof b);
+        return dlms_encode_bytes(e, b, sizeof b);
+    }
+    return dlms_encode_8(e, 0);
+}
+
+int
+dlms_encode_general_block_transfer(dlms_encoder *e, int last_block, int streaming, unsigned window,
+                                   unsigned block_number, unsigned block_number_ack,
+                                   const uint8_t *data, uint32_t length)
+{
+    dlms_encode_8(e, DLMS_GENERAL_BLOCK_TRANSFER);
+    dlms_encode_8(e, (last_block ? 0x80 : 0) | (streaming ? 0x40 : 0) | (window & 0x3f));
+    dlms_encode_16(e, block_number);
+    dlms_encode_16(e, block_number_ack);
+    dlms_encode_length(e, length);
+    return dlms_encode_bytes(e, data, length);
+}
+
+int
+dlms_encode_exception_response(dlms_encoder *e, unsigned state_error, unsigned service_error)
+{
+    dlms_encode_8(e, DLMS_EXCEPTION_RESPONSE);
+    dlms_encode_8(e, state_error);
+    return dlms_encode_8(e, service_error);
+}
+
+/* Application context name of logical name referencing with no ciphering */
+static const uint8_t dlms_encode_application_context_name[] = {
+    0xa1, 0x09, 0x06, 0x07, 0x60, 0x85, 0x74, 0x05, 0x08, 0x01, 0x01
+};
+
+/* Encode the user-information of an AARQ or AARE, with an InitiateRequest or InitiateResponse */
+static int
+dlms_encode_user_information(dlms_encoder *e, int response, uint32_t conformance, unsigned max_receive_pdu_size)
+{
+    dlms_encode_8(e, 0xbe);
+    dlms_encode_8(e, 0x10);
+    dlms_encode_8(e, 0x04); /* octet string */
+    dlms_encode_8(e, 0x0e);
+    if (response) {
+        dlms_encode_8(e, 0x08);
+        dlms_encode_8(e, 0); /* no negotiated-quality-of-service */
+    } else {
+        dlms_encode_8(e, 0x01);
+        dlms_encode_8(e, 0); /* no dedicated-key */
+        dlms_encode_8(e, 0); /* default response-allowed */
+        dlms_encode_8(e, 0); /* no proposed-quality-of-service */
+    }
+    dlms_encode_8(e, 6); /* DLMS version */
+    dlms_encode_16(e, 0x5f1f);
+    dlms_encode_8(e, 0x04);
+    dlms_encode_8(e, 0); /* unused bits */
+    dlms_encode_8(e, conformance >> 16);
+    dlms_encode_16(e, conformance & 0xffff);
+    dlms_encode_16(e, max_receive_pdu_size);
+    if (response) {
+        return dlms_encode_16(e, 0x0007); /* vaa-name */
+    }
+    return e->status;
+}
+
+int
+dlms_encode_aarq(dlms_encoder *e, uint32_t conformance, unsigned max_receive_pdu_size)
+{
+    dlms_encode_8(e, DLMS_AARQ);
+    dlms_encode_8(e, sizeof dlms_encode_application_context_name + 18);
+    dlms_encode_bytes(e, dlms_encode_application_context_name, sizeof dlms_encode_application_context_name);
+    return dlms_encode_user_information(e, 0, conformance, max_receive_pdu_size);
+}
+
+int
+dlms_encode_aare(dlms_encoder *e, unsigned result, unsigned diagnostic,
+                 uint32_t conformance, unsigned max_receive_pdu_size)
+{
+    static const uint8_t result_header[] = { 0xa2, 0x03, 0x02, 0x01 };
+    static const uint8_t diagnostic_header[] = { 0xa3, 0x05, 0xa1, 0x03, 0x02, 0x01 };
+
+    dlms_encode_8(e, DLMS_AARE);
+    dlms_encode_8(e, sizeof dlms_encode_application_context_name + 5 + 7 + 18);
+    dlms_encode_bytes(e, dlms_encode_application_context_name, sizeof dlms_encode_application_context_name);
+    dlms_encode_bytes(e, result_header, sizeof result_header);
+    dlms_encode_8(e, result);
+    dlms_encode_bytes(e, diagnostic_header, sizeof diagnostic_header); /* acse-service-user */
+    dlms_encode_8(e, diagnostic);
+    return dlms_encode_user_information(e, 1, conformance, max_receive_pdu_size);
+}
+
+int
+dlms_encode_rlrq(dlms_encoder *e)
+{
+    dlms_encode_8(e, DLMS_RLRQ);
+    return dlms_encode_8(e, 0);
+}
+
+int
+dlms_encode_rlre(dlms_encoder *e)
+{
+    dlms_encode_8(e, DLMS_RLRE);
+    return dlms_encode_8(e, 0);
+}
+
+int
+dlms_encode_wrapper(dlms_encoder *e, unsigned source, unsigned destination, const uint8_t *apdu, size_t length)
+{
+    if (length > 0xffff) {
+        return e->status = DLMS_CORE_INVALID;
+    }
+    dlms_encode_16(e, 1); /* version */
+    dlms_encode_16(e, source);
+    dlms_encode_16(e, destination);
+    dlms_encode_16(e, (unsigned)length);
+    return dlms_encode_bytes(e, apdu, length);
+}
+
+/* Encode an HDLC address field of 1, 2 or 4 bytes */
+static int
+dlms_encode_hdlc_address(dlms_encoder *e, const dlms_core_hdlc_address *address)
+{
+    unsigned limit = address->length == 4 ? 0x3fff : 0x7f;
+
+    if ((address->length != 1 && address->length != 2 && address->length != 4)
+        || address->upper > limit || address->lower > limit || (address->length == 1 && address->lower)) {
+        return e->status = DLMS_CORE_INVALID;
+    }
+    if (address->length == 1) {
+        return dlms_encode_8(e, (address->upper << 1) | 1);
+    } else if (address->length == 2) {
+        dlms_encode_8(e, address->upper << 1);
+        return dlms_encode_8(e, (address->lower << 1) | 1);
+    }
+    dlms_encode_8(e, (address->upper >> 7) << 1);
+    dlms_encode_8(e, (address->upper & 0x7f) << 1);
+    dlms_encode_8(e, (address->lower >> 7) << 1);
+    return dlms_encode_8(e, ((address->lower & 0x7f) << 1) | 1);
+}
+
+/* Encode an HDLC frame of format type 3, with an information field (and HCS) if information is not null */
+int
+dlms_encode_hdlc_addressed(dlms_encoder *e, int segmentation, const dlms_core_hdlc_address *destination,
+                           const dlms_core_hdlc_address *source, unsigned control,
+                           const uint8_t *information, size_t length)
+{
+    size_t start = e->length;
+    size_t header_length = 2 + destination->length + source->length + 1; /* format, addresses, control */
+    size_t frame_length = header_length + 2 + (information ? 2 + length : 0);
+
+    if (frame_length > 0x7ff) {
+        return e->status = DLMS_CORE_INVALID;
+    }
+    dlms_encode_8(e, 0x7e);
+    dlms_encode_16(e, 0xa000 | (segmentation ? 0x800 : 0) | (unsigned)frame_length);
+    dlms_encode_hdlc_address(e, destination);
+    dlms_encode_hdlc_address(e, source);
+    dlms_encode_8(e, control);
+    if (information) {
+        uint16_t hcs;
+        if (e->status != DLMS_CORE_OK) {
+            return e->status;
+        }
+        hcs = dlms_core_hdlc_check_sequence(e->data + start + 1, header_length);
+        dlms_encode_8(e, hcs & 0xff);
+        dlms_encode_8(e, hcs >> 8);
+        dlms_encode_bytes(e, information, length);
+    }
+    if (e->status == DLMS_CORE_OK) {
+        uint16_t fcs = dlms_core_hdlc_check_sequence(e->data + start + 1, frame_length - 2);
+        dlms_encode_8(e, fcs & 0xff);
+        dlms_encode_8(e, fcs >> 8);
+    }
+    return dlms_encode_8(e, 0x7e);
+}
+
+/* The same, with one byte addresses */
+int
+dlms_encode_hdlc(dlms_encoder *e, int segmentation, unsigned destination, unsigned source,
+                 unsigned control, const uint8_t *information, size_t length)
+{
+    dlms_core_hdlc_address d = { destination, 0, 1 }, s = { source, 0, 1 };
+
+    return dlms_encode_hdlc_addressed(e, segmentation, &d, &s, control, information, length);
+}
@@ -0,0 +1,122 @@
+/*
+ * dlms_encode.h - Device Language Message Specification encoder
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The encoder is the counterpart of the decoding core: it appends A-XDR data,
+ * APDUs, wrapper PDUs and HDLC frames to a growing buffer.
+ *
+ * All encode functions return the status of the encoder, which is DLMS_CORE_OK
+ * until a function fails (out of memory, or invalid arguments) and then
+ * stays DLMS_CORE_INVALID, so that a sequence of calls needs only one check.
+ *
+ * The values of a compact array are encoded with the same functions, between
+ * dlms_encode_compact_array_begin and dlms_encode_compact_array_end, which
+ * then leave out the tags (and the element counts of arrays and structures).
+ */
+
+#ifndef DLMS_ENCODE_H
+#define DLMS_ENCODE_H
+
+#include "dlms_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dlms_encoder {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+    int status;
+    unsigned compact; /* nesting level of compact arrays being encoded */
+};
+typedef struct dlms_encoder dlms_encoder;
+
+void dlms_encoder_init(dlms_encoder *e);
+void dlms_encoder_free(dlms_encoder *e);
+
+/* Raw bytes, big-endian integers and lengths in definite form */
+int dlms_encode_bytes(dlms_encoder *e, const void *data, size_t length);
+int dlms_encode_8(dlms_encoder *e, unsigned value);
+int dlms_encode_16(dlms_encoder *e, unsigned value);
+int dlms_encode_32(dlms_encoder *e, uint32_t value);
+int dlms_encode_length(dlms_encoder *e, uint32_t length);
+
+/* Data, by type (choice): null-data and dont-care */
+int dlms_encode_null(dlms_encoder *e, unsigned choice);
+/* array and structure, followed by their count elements */
+int dlms_encode_array(dlms_encoder *e, uint32_t count);
+int dlms_encode_structure(dlms_encoder *e, uint32_t count);
+/* double-long, integer, long and long64 */
+int dlms_encode_signed(dlms_encoder *e, unsigned choice, int64_t value);
+/* boolean, double-long-unsigned, bcd, unsigned, long-unsigned, long64-unsigned and enum */
+int dlms_encode_unsigned(dlms_encoder *e, unsigned choice, uint64_t value);
+/* float32 and float64 */
+int dlms_encode_float(dlms_encoder *e, unsigned choice, double value);
+/* bit-string (length in bits), octet-string, visible-string, utf8-string, date-time, date and time */
+int dlms_encode_string(dlms_encoder *e, unsigned choice, const uint8_t *data, uint32_t length);
+int dlms_encode_date_time(dlms_encoder *e, const dlms_core_date_time *date_time);
+
+/* compact-array: the TypeDescription, then its contents up to the end */
+int dlms_encode_compact_array_begin(dlms_encoder *e, const uint8_t *description, size_t description_length,
+                                    size_t *mark);
+int dlms_encode_compact_array_end(dlms_encoder *e, size_t mark);
+
+/* APDUs, up to the Data that follows them where there is one */
+int dlms_encode_get_request_normal(dlms_encoder *e, unsigned invoke_id, unsigned class_id,
+                                   const uint8_t *obis, unsigned attribute);
+int dlms_encode_get_request_next(dlms_encoder *e, unsigned invoke_id, uint32_t block_number);
+int dlms_encode_get_response_normal(dlms_encoder *e, unsigned invoke_id); /* followed by Data */
+int dlms_encode_get_response_error(dlms_encoder *e, unsigned invoke_id, unsigned data_access_result);
+int dlms_encode_get_response_with_datablock(dlms_encoder *e, unsigned invoke_id, int last_block,
+                                            uint32_t block_number, const uint8_t *data, uint32_t length);
+int dlms_encode_set_request_normal(dlms_encoder *e, unsigned invoke_id, unsigned class_id,
+                                   const uint8_t *obis, unsigned attribute); /* followed by Data */
+int dlms_encode_set_response_normal(dlms_encoder *e, unsigned invoke_id, unsigned data_access_result);
+int dlms_encode_action_request_normal(dlms_encoder *e, unsigned invoke_id, unsigned class_id,
+                                      const uint8_t *obis, unsigned method,
+                                      int has_parameters); /* followed by Data if has_parameters */
+int dlms_encode_action_response_normal(dlms_encoder *e, unsigned invoke_id, unsigned action_result);
+int dlms_encode_data_notification(dlms_encoder *e, uint32_t long_invoke_id,
+                                  const dlms_core_date_time *date_time); /* followed by Data */
+int dlms_encode_general_block_transfer(dlms_encoder *e, int last_block, int streaming, unsigned window,
+                                       unsigned block_number, unsigned block_number_ack,
+                                       const uint8_t *data, uint32_t length);
+int dlms_encode_exception_response(dlms_encoder *e, unsigned state_error, unsigned service_error);
+int dlms_encode_aarq(dlms_encoder *e, uint32_t conformance, unsigned max_receive_pdu_size);
+int dlms_encode_aare(dlms_encoder *e, unsigned result, unsigned diagnostic,
+                     uint32_t conformance, unsigned max_receive_pdu_size);
+int dlms_encode_rlrq(dlms_encoder *e);
+int dlms_encode_rlre(dlms_encoder *e);
+
+/* Transport: a wrapper PDU, and an HDLC frame (with one byte addresses, or with any address fields) */
+int dlms_encode_wrapper(dlms_encoder *e, unsigned source, unsigned destination,
+                        const uint8_t *apdu, size_t length);
+int dlms_encode_hdlc(dlms_encoder *e, int segmentation, unsigned destination, unsigned source,
+                     unsigned control, const uint8_t *information, size_t length);
+int dlms_encode_hdlc_addressed(dlms_encoder *e, int segmentation, const dlms_core_hdlc_address *destination,
+                               const dlms_core_hdlc_address *source, unsigned control,
+                               const uint8_t *information, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
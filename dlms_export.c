@@ -0,0 +1,1019 @@
+/*
+ * dlms_export.c - Export DLMS meter readings from a capture file
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Usage: dlms-export [-j threads] [-o readings.csv] [-c columns-dir] capture.pcap
+ *
+ * The capture file (pcap or pcapng) is mapped into memory and its packets are
+ * split into flows (UDP or TCP conversations). The flows are decoded in
+ * parallel, each by the first idle thread, starting with the largest ones.
+ * The readings are the values of Get-Response and Data-Notification APDUs,
+ * one row per planar value (so a profile buffer gives one row per cell):
+ *
+ *   timestamp,meter,obis,class_id,attribute,path,type,value
+ *
+ * The path locates the value within its array and structure elements (1.3 is
+ * the third element of the first element), and is empty for a planar reading.
+ *
+ * The columns directory receives the same rows as little-endian column buffers
+ * laid out as in Apache Arrow: timestamp.i64 (nanoseconds since the epoch),
+ * class_id.i32, attribute.i32, number.f64 (NaN for non-numeric values), and for
+ * the string columns meter, obis, path, type and value an .offsets file
+ * (i32, one more than the number of rows) and a .data file.
+ *
+ * TCP segments are expected to hold whole wrapper PDUs or HDLC frames.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dlms_core.h"
+
+/* A growable byte buffer */
+struct buffer {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+};
+
+static void
+buffer_reserve(struct buffer *b, size_t n)
+{
+    if (b->capacity - b->length < n) {
+        size_t capacity = b->capacity ? b->capacity : 256;
+        while (capacity - b->length < n) {
+            capacity *= 2;
+        }
+        b->data = realloc(b->data, capacity);
+        if (!b->data) {
+            perror("realloc");
+            exit(1);
+        }
+        b->capacity = capacity;
+    }
+}
+
+static void
+buffer_append(struct buffer *b, const void *data, size_t n)
+{
+    buffer_reserve(b, n);
+    memcpy(b->data + b->length, data, n);
+    b->length += n;
+}
+
+static void
+buffer_printf(struct buffer *b, const char *format, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, format);
+    n = vsnprintf(0, 0, format, ap);
+    va_end(ap);
+    buffer_reserve(b, (size_t)n + 1);
+    va_start(ap, format);
+    vsnprintf((char *)b->data + b->length, (size_t)n + 1, format, ap);
+    va_end(ap);
+    b->length += n;
+}
+
+/* A transport endpoint (IPv4 or IPv6 address and UDP or TCP port) */
+struct endpoint {
+    uint8_t family; /* 4 or 6 */
+    uint8_t address[16];
+    uint16_t port;
+};
+
+/* A packet of a flow */
+struct packet {
+    const uint8_t *payload; /* UDP or TCP payload */
+    size_t length;
+    int64_t time; /* nanoseconds since the epoch */
+    int from_a; /* whether it was sent by endpoint a of its flow */
+};
+
+/* A reading, with its strings in the string buffer of its flow */
+struct reading {
+    int64_t time;
+    int32_t class_id;
+    int32_t attribute;
+    double number;
+    size_t meter, obis, path, type, value; /* offsets of nul-terminated strings */
+};
+
+/* Request pending a response, per invoke id */
+struct pending {
+    int valid;
+    unsigned class_id;
+    uint8_t obis[6];
+    unsigned attribute;
+};
+
+/* An association within a flow, between two wPorts or HDLC addresses */
+struct link {
+    unsigned a, b; /* wPort or HDLC address of each flow endpoint (see hdlc_port) */
+    int hdlc;
+    struct buffer segments[2]; /* HDLC segments being reassembled, per direction */
+    struct pending pending[16];
+    struct buffer blocks; /* datablock or General-Block-Transfer data being reassembled */
+    int block_slot;
+};
+
+struct flow {
+    struct endpoint a, b;
+    struct packet *packets;
+    size_t count, capacity;
+    size_t bytes;
+    struct link *links;
+    size_t link_count;
+    struct reading *readings;
+    size_t reading_count, reading_capacity;
+    struct buffer strings;
+};
+
+/* The flows of the capture, in the order of their first packet */
+static struct flow *flows;
+static size_t flow_count, flow_capacity;
+
+/* Open addressing hash table of flow indices + 1, by endpoint pair */
+static size_t *flow_table;
+static size_t flow_table_size;
+
+static int
+endpoint_compare(const struct endpoint *x, const struct endpoint *y)
+{
+    int c = memcmp(x->address, y->address, sizeof x->address);
+    if (c == 0) {
+        c = (int)x->port - (int)y->port;
+    }
+    return c;
+}
+
+static size_t
+flow_hash(const struct endpoint *lo, const struct endpoint *hi)
+{
+    const struct endpoint *e[2] = { lo, hi };
+    size_t h = 14695981039346656037u;
+    int i, j;
+
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < 16; j++) {
+            h = (h ^ e[i]->address[j]) * 1099511628211u;
+        }
+        h = (h ^ e[i]->port) * 1099511628211u;
+    }
+    return h;
+}
+
+/* Find or create the flow between two endpoints */
+static struct flow *
+flow_get(const struct endpoint *src, const struct endpoint *dst, int *from_a)
+{
+    const struct endpoint *lo, *hi;
+    size_t i, *slot;
+    struct flow *f;
+
+    if (endpoint_compare(src, dst) <= 0) {
+        lo = src;
+        hi = dst;
+    } else {
+        lo = dst;
+        hi = src;
+    }
+
+    if (flow_count * 2 >= flow_table_size) {
+        size_t old_size = flow_table_size;
+        size_t *old_table = flow_table;
+        flow_table_size = old_size ? old_size * 2 : 1024;
+        flow_table = calloc(flow_table_size, sizeof *flow_table);
+        for (i = 0; i < old_size; i++) {
+            if (old_table[i]) {
+                f = &flows[old_table[i] - 1];
+                slot = &flow_table[flow_hash(&f->a, &f->b) & (flow_table_size - 1)];
+                while (*slot) {
+                    slot = slot + 1 == flow_table + flow_table_size ? flow_table : slot + 1;
+                }
+                *slot = old_table[i];
+            }
+        }
+        free(old_table);
+    }
+
+    slot = &flow_table[flow_hash(lo, hi) & (flow_table_size - 1)];
+    while (*slot) {
+        f = &flows[*slot - 1];
+        if (endpoint_compare(&f->a, lo) == 0 && endpoint_compare(&f->b, hi) == 0) {
+            *from_a = endpoint_compare(src, lo) == 0;
+            return f;
+        }
+        slot = slot + 1 == flow_table + flow_table_size ? flow_table : slot + 1;
+    }
+
+    if (flow_count == flow_capacity) {
+        flow_capacity = flow_capacity ? flow_capacity * 2 : 256;
+        flows = realloc(flows, flow_capacity * sizeof *flows);
+    }
+    f = &flows[flow_count++];
+    memset(f, 0, sizeof *f);
+    f->a = *lo;
+    f->b = *hi;
+    *slot = flow_count;
+    *from_a = endpoint_compare(src, lo) == 0;
+
+    return f;
+}
+
+static void
+flow_add_packet(const struct endpoint *src, const struct endpoint *dst, const uint8_t *payload, size_t length, int64_t time)
+{
+    struct flow *f;
+    struct packet *p;
+    int from_a;
+
+    if (length == 0) {
+        return;
+    }
+    f = flow_get(src, dst, &from_a);
+    if (f->count == f->capacity) {
+        f->capacity = f->capacity ? f->capacity * 2 : 16;
+        f->packets = realloc(f->packets, f->capacity * sizeof *f->packets);
+    }
+    p = &f->packets[f->count++];
+    p->payload = payload;
+    p->length = length;
+    p->time = time;
+    p->from_a = from_a;
+    f->bytes += length;
+}
+
+/* Link-layer types of the supported capture interfaces */
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_IPV6 229
+
+/* Split a captured frame into a flow packet, if it carries UDP or TCP */
+static void
+dissect_frame(int linktype, const uint8_t *data, size_t length, int64_t time)
+{
+    struct endpoint src, dst;
+    unsigned ethertype, protocol, header_length;
+
+    if (linktype == LINKTYPE_ETHERNET) {
+        if (length < 14) return;
+        ethertype = (data[12] << 8) | data[13];
+        data += 14;
+        length -= 14;
+        while (ethertype == 0x8100 && length >= 4) { /* VLAN tags */
+            ethertype = (data[2] << 8) | data[3];
+            data += 4;
+            length -= 4;
+        }
+    } else if (linktype == LINKTYPE_LINUX_SLL) {
+        if (length < 16) return;
+        ethertype = (data[14] << 8) | data[15];
+        data += 16;
+        length -= 16;
+    } else if (linktype == LINKTYPE_RAW || linktype == LINKTYPE_IPV4 || linktype == LINKTYPE_IPV6) {
+        if (length < 1) return;
+        ethertype = (data[0] >> 4) == 6 ? 0x86dd : 0x0800;
+    } else {
+        return;
+    }
+
+    memset(&src, 0, sizeof src);
+    memset(&dst, 0, sizeof dst);
+    if (ethertype == 0x0800) {
+        unsigned total_length;
+        if (length < 20 || (data[0] >> 4) != 4) return;
+        header_length = (data[0] & 0x0f) * 4;
+        total_length = (data[2] << 8) | data[3];
+        if (((data[6] << 8) | data[7]) & 0x3fff) return; /* fragment */
+        if (header_length < 20 || total_length < header_length || length < header_length) return;
+        if (total_length < length) length = total_length;
+        protocol = data[9];
+        src.family = dst.family = 4;
+        memcpy(src.address, data + 12, 4);
+        memcpy(dst.address, data + 16, 4);
+    } else if (ethertype == 0x86dd) {
+        if (length < 40 || (data[0] >> 4) != 6) return;
+        header_length = 40;
+        if (40 + (size_t)((data[4] << 8) | data[5]) < length) length = 40 + (size_t)((data[4] << 8) | data[5]);
+        protocol = data[6];
+        src.family = dst.family = 6;
+        memcpy(src.address, data + 8, 16);
+        memcpy(dst.address, data + 24, 16);
+    } else {
+        return;
+    }
+    data += header_length;
+    length -= header_length;
+
+    if (protocol == 17) { /* UDP */
+        if (length < 8) return;
+        header_length = 8;
+    } else if (protocol == 6) { /* TCP */
+        if (length < 20) return;
+        header_length = (data[12] >> 4) * 4;
+        if (header_length < 20 || length < header_length) return;
+    } else {
+        return;
+    }
+    src.port = (data[0] << 8) | data[1];
+    dst.port = (data[2] << 8) | data[3];
+    flow_add_packet(&src, &dst, data + header_length, length - header_length, time);
+}
+
+static uint32_t
+get_32(const uint8_t *p, int swap)
+{
+    return swap
+        ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]
+        : ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static uint16_t
+get_16(const uint8_t *p, int swap)
+{
+    return swap ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+}
+
+/* Split the packets of a pcap file into flows */
+static int
+read_pcap(const uint8_t *data, size_t size)
+{
+    uint32_t magic = get_32(data, 0);
+    int swap = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+    int nanoseconds = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+    int linktype = (int)get_32(data + 20, swap);
+    size_t offset = 24;
+
+    while (offset + 16 <= size) {
+        uint32_t captured = get_32(data + offset + 8, swap);
+        int64_t time = (int64_t)get_32(data + offset, swap) * 1000000000
+            + (int64_t)get_32(data + offset + 4, swap) * (nanoseconds ? 1 : 1000);
+        if (captured > size - offset - 16) {
+            fprintf(stderr, "dlms-export: truncated packet record at offset %zu\n", offset);
+            break;
+        }
+        dissect_frame(linktype, data + offset + 16, captured, time);
+        offset += 16 + captured;
+    }
+    return 0;
+}
+
+/* Split the packets of a pcapng file into flows */
+static int
+read_pcapng(const uint8_t *data, size_t size)
+{
+    int linktypes[64];
+    int64_t units[64]; /* timestamp units per second, per interface */
+    unsigned interfaces = 0;
+    size_t offset = 0;
+    int swap = 0;
+
+    while (offset + 12 <= size) {
+        uint32_t type = get_32(data + offset, swap);
+        uint32_t length;
+        if (type == 0x0a0d0d0a) { /* section header block */
+            swap = get_32(data + offset + 8, 0) == 0x4d3c2b1a;
+            interfaces = 0;
+        }
+        length = get_32(data + offset + 4, swap);
+        if (length < 12 || length > size - offset) {
+            fprintf(stderr, "dlms-export: bad block at offset %zu\n", offset);
+            return 1;
+        }
+        if (type == 1 && length >= 20 && interfaces < 64) { /* interface description block */
+            size_t o = offset + 16;
+            linktypes[interfaces] = get_16(data + offset + 8, swap);
+            units[interfaces] = 1000000;
+            while (o + 4 <= offset + length - 4) {
+                unsigned code = get_16(data + o, swap), option_length = get_16(data + o + 2, swap);
+                if (code == 0) break;
+                if (code == 9 && option_length >= 1) { /* if_tsresol */
+                    unsigned resolution = data[o + 4];
+                    int64_t u = 1;
+                    unsigned i;
+                    for (i = 0; i < (resolution & 0x7f) && u < 1000000000000000000; i++) {
+                        u *= resolution & 0x80 ? 2 : 10;
+                    }
+                    units[interfaces] = u;
+                }
+                o += 4 + ((option_length + 3) & ~3u);
+            }
+            interfaces++;
+        } else if (type == 6 && length >= 32) { /* enhanced packet block */
+            uint32_t interface = get_32(data + offset + 8, swap);
+            uint64_t ts = ((uint64_t)get_32(data + offset + 12, swap) << 32) | get_32(data + offset + 16, swap);
+            uint32_t captured = get_32(data + offset + 20, swap);
+            if (interface < interfaces && captured <= length - 32) {
+                int64_t u = units[interface];
+                int64_t time = (int64_t)(ts / u) * 1000000000 + (int64_t)(ts % u) * 1000000000 / u;
+                dissect_frame(linktypes[interface], data + offset + 28, captured, time);
+            }
+        } else if (type == 3 && length >= 16 && interfaces > 0) { /* simple packet block */
+            uint32_t captured = get_32(data + offset + 8, swap);
+            if (captured > length - 16) captured = length - 16;
+            dissect_frame(linktypes[0], data + offset + 12, captured, 0);
+        }
+        offset += length;
+    }
+    return 0;
+}
+
+/* Decoding of the flows, by the worker threads */
+
+static const char *
+type_name(unsigned choice)
+{
+    static const char *const names[] = {
+        "null-data", "array", "structure", "boolean", "bit-string", "double-long",
+        "double-long-unsigned", 0, 0, "octet-string", "visible-string", 0, "utf8-string",
+        "bcd", 0, "integer", "long", "unsigned", "long-unsigned", "compact-array", "long64",
+        "long64-unsigned", "enum", "float32", "float64", "date-time", "date", "time"
+    };
+    if (choice == 255) return "dont-care";
+    if (choice < sizeof names / sizeof names[0] && names[choice]) return names[choice];
+    return "unknown";
+}
+
+static size_t
+add_string(struct flow *f, const char *s, size_t n)
+{
+    size_t offset = f->strings.length;
+    buffer_append(&f->strings, s, n);
+    buffer_append(&f->strings, "", 1);
+    return offset;
+}
+
+/* State of the decoding of the Data of one reading */
+struct reading_context {
+    struct flow *flow;
+    const uint8_t *data;
+    struct reading template; /* time, class, attribute, meter and obis of the rows */
+    unsigned counters[32]; /* element number at each depth */
+};
+
+static void *
+reading_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    struct reading_context *rc = context;
+
+    if (d->depth < 32) {
+        rc->counters[d->depth]++;
+        if (d->depth + 1 < 32) {
+            rc->counters[d->depth + 1] = 0;
+        }
+    }
+    return parent;
+}
+
+static void
+reading_end(void *context, void *parent, void *element_parent, const dlms_core_data *d)
+{
+    (void)context;
+    (void)parent;
+    (void)element_parent;
+    (void)d;
+}
+
+static void
+reading_value(void *context, void *parent, const dlms_core_data *d)
+{
+    struct reading_context *rc = context;
+    struct flow *f = rc->flow;
+    struct reading *r;
+    char text[64];
+    const uint8_t *contents = rc->data + d->contents_offset;
+    dlms_core_date_time dt;
+    unsigned i;
+    size_t path_start;
+
+    (void)parent;
+    if (d->depth < 32) {
+        rc->counters[d->depth]++;
+    }
+    if (f->reading_count == f->reading_capacity) {
+        f->reading_capacity = f->reading_capacity ? f->reading_capacity * 2 : 64;
+        f->readings = realloc(f->readings, f->reading_capacity * sizeof *f->readings);
+    }
+    r = &f->readings[f->reading_count++];
+    *r = rc->template;
+    r->number = NAN;
+
+    path_start = f->strings.length;
+    for (i = 1; i <= d->depth && i < 32; i++) {
+        buffer_printf(&f->strings, i > 1 ? ".%u" : "%u", rc->counters[i]);
+    }
+    buffer_append(&f->strings, "", 1);
+    r->path = path_start;
+    r->type = add_string(f, type_name(d->choice), strlen(type_name(d->choice)));
+
+    r->value = f->strings.length;
+    switch (d->choice) {
+    case 3:
+        buffer_printf(&f->strings, "%s", d->value.u ? "true" : "false");
+        r->number = d->value.u ? 1 : 0;
+        break;
+    case 5: case 15: case 16: case 20:
+        buffer_printf(&f->strings, "%lld", (long long)d->value.i);
+        r->number = (double)d->value.i;
+        break;
+    case 6: case 13: case 17: case 18: case 21: case 22:
+        buffer_printf(&f->strings, "%llu", (unsigned long long)d->value.u);
+        r->number = (double)d->value.u;
+        break;
+    case 23:
+        buffer_printf(&f->strings, "%.9g", d->value.f);
+        r->number = d->value.f;
+        break;
+    case 24:
+        buffer_printf(&f->strings, "%.17g", d->value.f);
+        r->number = d->value.f;
+        break;
+    case 10: case 12:
+        buffer_append(&f->strings, contents, d->length);
+        break;
+    case 9: case 25:
+        if (dlms_core_parse_date_time(contents, d->choice == 25 ? 12 : d->length, &dt) == DLMS_CORE_OK) {
+            snprintf(text, sizeof text, "%04u-%02u-%02u %02u:%02u:%02u.%02u",
+                     dt.year, dt.month, dt.day_of_month, dt.hour, dt.minute, dt.second, dt.hundredths);
+            buffer_printf(&f->strings, "%s", text);
+            break;
+        }
+        /* fall through */
+    default: /* bytes in hexadecimal */
+        for (i = 0; i < (d->choice == 4 ? (d->length + 7) / 8 : d->length); i++) {
+            buffer_printf(&f->strings, "%02x", contents[i]);
+        }
+        break;
+    }
+    buffer_append(&f->strings, "", 1);
+}
+
+static const dlms_core_data_visitor reading_visitor = { reading_begin, reading_end, reading_value };
+
+/* Name the server end of a link */
+static size_t
+meter_name(struct flow *f, struct link *l, int server_is_a)
+{
+    const struct endpoint *e = server_is_a ? &f->a : &f->b;
+    unsigned address = server_is_a ? l->a : l->b;
+    size_t offset = f->strings.length;
+
+    if (e->family == 4) {
+        buffer_printf(&f->strings, "%u.%u.%u.%u", e->address[0], e->address[1], e->address[2], e->address[3]);
+    } else {
+        int i;
+        for (i = 0; i < 16; i += 2) {
+            buffer_printf(&f->strings, i ? ":%x" : "%x", (e->address[i] << 8) | e->address[i + 1]);
+        }
+    }
+    if (l->hdlc && (address >> 16)) {
+        buffer_printf(&f->strings, " %u HDLC %u/%u", e->port, address & 0xffff, address >> 16);
+    } else {
+        buffer_printf(&f->strings, " %u %s %u", e->port, l->hdlc ? "HDLC" : "wPort", address);
+    }
+    buffer_append(&f->strings, "", 1);
+
+    return offset;
+}
+
+static void
+add_readings(struct flow *f, struct link *l, int server_is_a, int64_t time, const struct pending *request,
+             const uint8_t *data, size_t size, size_t offset)
+{
+    struct reading_context rc;
+    const uint8_t *o;
+
+    memset(&rc, 0, sizeof rc);
+    rc.flow = f;
+    rc.data = data;
+    rc.template.time = time;
+    rc.template.meter = meter_name(f, l, server_is_a);
+    if (request) {
+        o = request->obis;
+        rc.template.class_id = (int32_t)request->class_id;
+        rc.template.attribute = (int32_t)request->attribute;
+        rc.template.obis = f->strings.length;
+        buffer_printf(&f->strings, "%u-%u:%u.%u.%u*%u", o[0], o[1], o[2], o[3], o[4], o[5]);
+        buffer_append(&f->strings, "", 1);
+    } else {
+        rc.template.obis = add_string(f, "", 0);
+    }
+    dlms_core_parse_data(data, size, &offset, &reading_visitor, &rc, 0);
+}
+
+static void decode_apdu(struct flow *f, struct link *l, int from_a, int64_t time, const uint8_t *data, size_t size);
+
+/* Add a block to the blocks being reassembled, and decode them after the last block */
+static void
+add_block(struct flow *f, struct link *l, int from_a, int64_t time, int slot, const uint8_t *data,
+          const dlms_core_block *block, int is_gbt)
+{
+    if (block->block_number == 1) {
+        l->blocks.length = 0;
+        l->block_slot = slot;
+    }
+    buffer_append(&l->blocks, data + block->data_offset, block->data_length);
+    if (block->last_block) {
+        if (is_gbt) {
+            struct buffer apdu = l->blocks;
+            memset(&l->blocks, 0, sizeof l->blocks);
+            decode_apdu(f, l, from_a, time, apdu.data, apdu.length);
+            free(apdu.data);
+        } else if (l->pending[l->block_slot & 15].valid) {
+            add_readings(f, l, from_a, time, &l->pending[l->block_slot & 15], l->blocks.data, l->blocks.length, 0);
+        }
+        l->blocks.length = 0;
+    }
+}
+
+static void
+decode_apdu(struct flow *f, struct link *l, int from_a, int64_t time, const uint8_t *data, size_t size)
+{
+    dlms_core_apdu apdu;
+    dlms_core_service service;
+    dlms_core_block block;
+    size_t offset;
+
+    if (dlms_core_classify_apdu(data, size, 0, &apdu) != DLMS_CORE_OK) {
+        return;
+    }
+    if (apdu.choice == DLMS_GET_REQUEST && apdu.service == 1) { /* get-request-normal */
+        if (dlms_core_parse_service(data, size, 0, &service) == DLMS_CORE_OK) {
+            struct pending *p = &l->pending[apdu.slot];
+            p->valid = 1;
+            p->class_id = service.descriptor.class_id;
+            memcpy(p->obis, service.descriptor.instance_id, 6);
+            p->attribute = service.descriptor.member_id;
+        }
+    } else if (apdu.choice == DLMS_GET_RESPONSE && apdu.service == 1) { /* get-response-normal */
+        if (dlms_core_parse_service(data, size, 0, &service) == DLMS_CORE_OK && service.has_data
+            && l->pending[apdu.slot].valid) {
+            add_readings(f, l, from_a, time, &l->pending[apdu.slot], data, size, service.data_offset);
+        }
+    } else if (apdu.choice == DLMS_GET_RESPONSE && apdu.service == 2) { /* get-response-with-datablock */
+        offset = 3;
+        if (dlms_core_parse_datablock_g(data, size, &offset, &block) == DLMS_CORE_OK && block.result == 0) {
+            add_block(f, l, from_a, time, apdu.slot, data, &block, 0);
+        }
+    } else if (apdu.choice == DLMS_GENERAL_BLOCK_TRANSFER) {
+        offset = 1;
+        if (dlms_core_parse_general_block_transfer(data, size, &offset, &block) == DLMS_CORE_OK && block.data_length) {
+            add_block(f, l, from_a, time, -1, data, &block, 1);
+        }
+    } else if (apdu.choice == DLMS_DATA_NOTIFICATION) {
+        if (dlms_core_parse_service(data, size, 0, &service) == DLMS_CORE_OK) {
+            add_readings(f, l, from_a, time, 0, data, size, service.data_offset);
+        }
+    }
+}
+
+/* The upper HDLC address, and the lower one in the high-order 16 bits for 2 and 4 byte addresses */
+static unsigned
+hdlc_port(const dlms_core_hdlc_address *address)
+{
+    return address->length == 1 ? address->upper : (address->lower << 16) | address->upper;
+}
+
+static struct link *
+get_link(struct flow *f, unsigned a, unsigned b, int hdlc)
+{
+    size_t i;
+
+    for (i = 0; i < f->link_count; i++) {
+        if (f->links[i].a == a && f->links[i].b == b && f->links[i].hdlc == hdlc) {
+            return &f->links[i];
+        }
+    }
+    f->links = realloc(f->links, (f->link_count + 1) * sizeof *f->links);
+    memset(&f->links[f->link_count], 0, sizeof *f->links);
+    f->links[f->link_count].a = a;
+    f->links[f->link_count].b = b;
+    f->links[f->link_count].hdlc = hdlc;
+    return &f->links[f->link_count++];
+}
+
+static void
+decode_packet(struct flow *f, const struct packet *p)
+{
+    const uint8_t *data = p->payload;
+    size_t size = p->length, offset = 0;
+    struct link *l;
+
+    if (data[0] == 0x7e) {
+        while (offset < size && data[offset] == 0x7e) {
+            dlms_core_hdlc frame;
+            struct buffer *segments;
+            if (dlms_core_parse_hdlc(data, size, offset, &frame) != DLMS_CORE_OK) {
+                return;
+            }
+            l = p->from_a
+                ? get_link(f, hdlc_port(&frame.source_address), hdlc_port(&frame.destination_address), 1)
+                : get_link(f, hdlc_port(&frame.destination_address), hdlc_port(&frame.source_address), 1);
+            if ((frame.control & 0x01) == 0 && frame.fcs_ok) { /* I frame */
+                segments = &l->segments[p->from_a];
+                buffer_append(segments, data + frame.information_offset, frame.information_length);
+                if (!frame.segmentation) {
+                    if (segments->length > 3) { /* after the LLC header */
+                        decode_apdu(f, l, p->from_a, p->time, segments->data + 3, segments->length - 3);
+                    }
+                    segments->length = 0;
+                }
+            }
+            offset += frame.length + 2;
+            if (offset < size && data[offset] == 0x7e && offset + 1 < size && data[offset + 1] != 0x7e) {
+                offset--; /* the closing flag is also the opening flag of the next frame */
+            }
+            while (offset < size && offset + 1 < size && data[offset] == 0x7e && data[offset + 1] == 0x7e) {
+                offset++;
+            }
+        }
+    } else if (size >= 8 && data[0] == 0 && data[1] == 1) { /* wrapper */
+        while (offset + 8 <= size) {
+            unsigned source = (data[offset + 2] << 8) | data[offset + 3];
+            unsigned destination = (data[offset + 4] << 8) | data[offset + 5];
+            size_t length = (data[offset + 6] << 8) | data[offset + 7];
+            if (length > size - offset - 8) {
+                return;
+            }
+            l = p->from_a ? get_link(f, source, destination, 0) : get_link(f, destination, source, 0);
+            decode_apdu(f, l, p->from_a, p->time, data + offset + 8, length);
+            offset += 8 + length;
+        }
+    } else {
+        decode_apdu(f, get_link(f, 0, 0, 0), p->from_a, p->time, data, size);
+    }
+}
+
+/* The worker threads take the flows in order of decreasing size */
+static size_t *flow_order;
+static atomic_size_t next_flow;
+
+static void *
+worker(void *arg)
+{
+    size_t i, j;
+
+    while ((i = atomic_fetch_add(&next_flow, 1)) < flow_count) {
+        struct flow *f = &flows[flow_order[i]];
+        for (j = 0; j < f->count; j++) {
+            decode_packet(f, &f->packets[j]);
+        }
+    }
+    return arg;
+}
+
+static int
+compare_flow_size(const void *x, const void *y)
+{
+    size_t a = flows[*(const size_t *)x].bytes, b = flows[*(const size_t *)y].bytes;
+    return a < b ? 1 : a > b ? -1 : 0;
+}
+
+/* Output */
+
+static void
+write_csv_string(FILE *out, const char *s)
+{
+    if (strpbrk(s, ",\"\r\n") == 0) {
+        fputs(s, out);
+        return;
+    }
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void
+write_csv(FILE *out)
+{
+    size_t i, j;
+
+    fputs("timestamp,meter,obis,class_id,attribute,path,type,value\n", out);
+    for (i = 0; i < flow_count; i++) {
+        struct flow *f = &flows[i];
+        const char *s = (const char *)f->strings.data;
+        for (j = 0; j < f->reading_count; j++) {
+            const struct reading *r = &f->readings[j];
+            int64_t seconds = r->time / 1000000000;
+            fprintf(out, "%lld.%09lld,", (long long)seconds, (long long)(r->time - seconds * 1000000000));
+            write_csv_string(out, s + r->meter);
+            fprintf(out, ",%s,%d,%d,%s,%s,", s + r->obis, r->class_id, r->attribute, s + r->path, s + r->type);
+            write_csv_string(out, s + r->value);
+            fputc('\n', out);
+        }
+    }
+}
+
+static FILE *
+open_column(const char *directory, const char *name)
+{
+    char path[4096];
+    FILE *f;
+
+    snprintf(path, sizeof path, "%s/%s", directory, name);
+    f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "dlms-export: %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    return f;
+}
+
+static void
+write_le(FILE *out, uint64_t value, int bytes)
+{
+    uint8_t b[8];
+    int i;
+
+    for (i = 0; i < bytes; i++) {
+        b[i] = (uint8_t)(value >> (8 * i));
+    }
+    fwrite(b, 1, (size_t)bytes, out);
+}
+
+static void
+write_columns(const char *directory)
+{
+    static const char *const string_columns[] = { "meter", "obis", "path", "type", "value" };
+    FILE *timestamp, *class_id, *attribute, *number, *offsets[5], *strings[5];
+    uint64_t string_length[5] = { 0 };
+    char name[64];
+    size_t i, j, k;
+
+    mkdir(directory, 0777);
+    timestamp = open_column(directory, "timestamp.i64");
+    class_id = open_column(directory, "class_id.i32");
+    attribute = open_column(directory, "attribute.i32");
+    number = open_column(directory, "number.f64");
+    for (k = 0; k < 5; k++) {
+        snprintf(name, sizeof name, "%s.offsets", string_columns[k]);
+        offsets[k] = open_column(directory, name);
+        snprintf(name, sizeof name, "%s.data", string_columns[k]);
+        strings[k] = open_column(directory, name);
+        write_le(offsets[k], 0, 4);
+    }
+
+    for (i = 0; i < flow_count; i++) {
+        struct flow *f = &flows[i];
+        const char *s = (const char *)f->strings.data;
+        for (j = 0; j < f->reading_count; j++) {
+            const struct reading *r = &f->readings[j];
+            const size_t string_offsets[5] = { r->meter, r->obis, r->path, r->type, r->value };
+            uint64_t bits;
+            write_le(timestamp, (uint64_t)r->time, 8);
+            write_le(class_id, (uint32_t)r->class_id, 4);
+            write_le(attribute, (uint32_t)r->attribute, 4);
+            memcpy(&bits, &r->number, sizeof bits);
+            write_le(number, bits, 8);
+            for (k = 0; k < 5; k++) {
+                size_t n = strlen(s + string_offsets[k]);
+                fwrite(s + string_offsets[k], 1, n, strings[k]);
+                string_length[k] += n;
+                write_le(offsets[k], string_length[k], 4);
+            }
+        }
+    }
+
+    fclose(timestamp);
+    fclose(class_id);
+    fclose(attribute);
+    fclose(number);
+    for (k = 0; k < 5; k++) {
+        fclose(offsets[k]);
+        fclose(strings[k]);
+    }
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: dlms-export [-j threads] [-o readings.csv] [-c columns-dir] capture.pcap\n");
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *csv_path = 0, *columns_path = 0;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t *tids;
+    struct stat st;
+    const uint8_t *data;
+    uint32_t magic;
+    size_t i, readings;
+    int c, fd, status;
+
+    while ((c = getopt(argc, argv, "j:o:c:")) != -1) {
+        if (c == 'j') {
+            threads = strtol(optarg, 0, 10);
+        } else if (c == 'o') {
+            csv_path = optarg;
+        } else if (c == 'c') {
+            columns_path = optarg;
+        } else {
+            usage();
+        }
+    }
+    if (optind + 1 != argc || threads < 1) {
+        usage();
+    }
+
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "dlms-export: %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    if (st.st_size < 24) {
+        fprintf(stderr, "dlms-export: %s: not a capture file\n", argv[optind]);
+        return 1;
+    }
+    data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    madvise((void *)data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    magic = get_32(data, 0);
+    if (magic == 0x0a0d0d0a) {
+        status = read_pcapng(data, (size_t)st.st_size);
+    } else if (magic == 0xa1b2c3d4 || magic == 0xd4c3b2a1 || magic == 0xa1b23c4d || magic == 0x4d3cb2a1) {
+        status = read_pcap(data, (size_t)st.st_size);
+    } else {
+        fprintf(stderr, "dlms-export: %s: not a pcap or pcapng file\n", argv[optind]);
+        return 1;
+    }
+
+    flow_order = malloc((flow_count + 1) * sizeof *flow_order);
+    for (i = 0; i < flow_count; i++) {
+        flow_order[i] = i;
+    }
+    qsort(flow_order, flow_count, sizeof *flow_order, compare_flow_size);
+    if ((size_t)threads > flow_count) {
+        threads = flow_count ? (long)flow_count : 1;
+    }
+    tids = malloc((size_t)threads * sizeof *tids);
+    for (i = 0; i < (size_t)threads; i++) {
+        pthread_create(&tids[i], 0, worker, 0);
+    }
+    for (i = 0; i < (size_t)threads; i++) {
+        pthread_join(tids[i], 0);
+    }
+
+    if (csv_path || !columns_path) {
+        FILE *out = csv_path && strcmp(csv_path, "-") ? fopen(csv_path, "w") : stdout;
+        if (!out) {
+            fprintf(stderr, "dlms-export: %s: %s\n", csv_path, strerror(errno));
+            return 1;
+        }
+        write_csv(out);
+        if (out != stdout) {
+            fclose(out);
+        }
+    }
+    if (columns_path) {
+        write_columns(columns_path);
+    }
+
+    readings = 0;
+    for (i = 0; i < flow_count; i++) {
+        readings += flows[i].reading_count;
+    }
+    fprintf(stderr, "dlms-export: %zu flows, %zu readings, %ld threads\n", flow_count, readings, threads);
+
+    return status;
+}
@@ -0,0 +1,753 @@
+/*
+ * dlms_fuzz.c - Fuzzing harness of the Device Language Message Specification decoding core
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Usage: dlms-fuzz [input-file-or-directory...]
+ *        dlms-fuzz -x capture.pcap corpus-directory
+ *
+ * The harness decodes an input as the dissector would decode a UDP payload
+ * or TCP stream, with the decoding core: a sequence of HDLC frames (with their
+ * segments reassembled), of wrapper PDUs, an IEC 61334-4-32 frame or a raw
+ * APDU, and then the A-XDR data of the APDUs (including that of the blocks of
+ * a datablock or General-Block-Transfer).
+ *
+ * FUZZ_ENTRY selects the entry point: FUZZ_ANY (the default) dispatches on the
+ * first byte like dlms_dissect, FUZZ_HDLC, FUZZ_WRAPPER, FUZZ_432 and FUZZ_APDU
+ * decode every input with that entry point. With FUZZ_LIBFUZZER, the harness
+ * is LLVMFuzzerTestOneInput for libFuzzer (-fsanitize=fuzzer); otherwise it has
+ * a main that decodes each input file (or stdin), for AFL and for replaying a
+ * corpus. See fuzz.sh.
+ *
+ * Besides the crashes found by the sanitizers, an input aborts when the values
+ * reported by the core are inconsistent with the input, or when its decoding
+ * is super-linear: more than FUZZ_ITEMS_PER_BYTE items (frames, blocks and
+ * data values, as many as the dissector adds tree items for) per input byte,
+ * or more time than DLMS_FUZZ_US_PER_BYTE (environment variable, 20 by
+ * default, 0 to disable) microseconds per byte plus 20 milliseconds.
+ *
+ * -x extracts the UDP payloads of a pcap capture into corpus-directory/hdlc,
+ * wrapper, 432 and apdu, and the APDUs of the HDLC and 4-32 frames into apdu
+ * and (as wrapper PDUs) wrapper, as seeds for the entry points.
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "dlms_core.h"
+
+#define FUZZ_ANY 0
+#define FUZZ_HDLC 1
+#define FUZZ_WRAPPER 2
+#define FUZZ_432 3
+#define FUZZ_APDU 4
+
+#ifndef FUZZ_ENTRY
+#define FUZZ_ENTRY FUZZ_ANY
+#endif
+
+/*
+ * Items per input byte beyond which decoding is super-linear. A compact array
+ * element of one byte may be nested in as many structures as the depth limit,
+ * each reported by a begin and an end.
+ */
+#define FUZZ_ITEMS_PER_BYTE (2 * DLMS_CORE_MAX_DEPTH + 4)
+#define FUZZ_ITEMS_BASE 64
+
+/* Nesting of General-Block-Transfer APDUs in the blocks of others */
+#define FUZZ_MAX_APDU_DEPTH 2
+
+struct fuzz {
+    const uint8_t *input;
+    size_t input_size;
+    unsigned long long items;
+};
+
+static void
+fuzz_fail(const struct fuzz *f, const char *reason)
+{
+    fprintf(stderr, "dlms-fuzz: %s (input of %zu bytes, %llu items)\n", reason, f->input_size, f->items);
+    abort();
+}
+
+/* Count the values reported by the core, and check that they lie within the buffer */
+static void
+fuzz_check_data(struct fuzz *f, const dlms_core_data *d, size_t size)
+{
+    f->items++;
+    if (d->depth > DLMS_CORE_MAX_DEPTH || d->offset > size) {
+        fuzz_fail(f, "value out of bounds");
+    }
+    if (d->choice == 9 || d->choice == 10 || d->choice == 12) {
+        if (d->contents_offset > size || d->length > size - d->contents_offset) {
+            fuzz_fail(f, "string out of bounds");
+        }
+    }
+}
+
+struct fuzz_context {
+    struct fuzz *f;
+    size_t size;
+};
+
+static void *
+fuzz_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    struct fuzz_context *c = (struct fuzz_context *)context;
+
+    fuzz_check_data(c->f, d, c->size);
+    if (d->choice == 19 && (d->description_length == 0 || d->contents_offset > c->size)) {
+        fuzz_fail(c->f, "compact array out of bounds");
+    }
+    return parent;
+}
+
+static void
+fuzz_end(void *context, void *parent, void *element_parent, const dlms_core_data *d)
+{
+    struct fuzz_context *c = (struct fuzz_context *)context;
+
+    (void)parent;
+    (void)element_parent;
+    if (d->end_offset < d->offset || d->end_offset > c->size) {
+        fuzz_fail(c->f, "composite value out of bounds");
+    }
+}
+
+static void
+fuzz_value(void *context, void *parent, const dlms_core_data *d)
+{
+    struct fuzz_context *c = (struct fuzz_context *)context;
+
+    (void)parent;
+    fuzz_check_data(c->f, d, c->size);
+    if (d->end_offset < d->offset || d->end_offset > c->size) {
+        fuzz_fail(c->f, "value out of bounds");
+    }
+}
+
+static const dlms_core_data_visitor fuzz_visitor = { fuzz_begin, fuzz_end, fuzz_value };
+
+static int
+fuzz_data(struct fuzz *f, const uint8_t *data, size_t size, size_t *offset)
+{
+    struct fuzz_context c = { f, size };
+    size_t start = *offset;
+    size_t skipped = start;
+    int status;
+
+    status = dlms_core_parse_data(data, size, offset, &fuzz_visitor, &c, 0);
+    if (status == DLMS_CORE_OK && (*offset <= start || *offset > size)) {
+        fuzz_fail(f, "data parsed out of bounds");
+    }
+    if (status == DLMS_CORE_OK && (dlms_core_skip_data(data, size, &skipped) != DLMS_CORE_OK || skipped != *offset)) {
+        fuzz_fail(f, "data skipped to another end than parsed");
+    }
+    return status;
+}
+
+/* Move past n bytes */
+static int
+fuzz_skip(const uint8_t *data, size_t size, size_t *offset, size_t n)
+{
+    (void)data;
+    if (*offset > size || n > size - *offset) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    *offset += n;
+    return DLMS_CORE_OK;
+}
+
+/* Move past an optional selective access descriptor (selector and Data) */
+static int
+fuzz_selective_access(struct fuzz *f, const uint8_t *data, size_t size, size_t *offset)
+{
+    if (*offset >= size) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    if (data[(*offset)++] == 0) {
+        return DLMS_CORE_OK;
+    }
+    if (fuzz_skip(data, size, offset, 1) != DLMS_CORE_OK) {
+        return DLMS_CORE_TRUNCATED;
+    }
+    return fuzz_data(f, data, size, offset);
+}
+
+/* Check a block as parsed by the core */
+static int
+fuzz_block(struct fuzz *f, const dlms_core_block *block, size_t size, size_t offset)
+{
+    f->items++;
+    if (block->data_length && (block->data_offset > size || block->data_length > size - block->data_offset
+                               || block->data_offset + block->data_length != offset)) {
+        fuzz_fail(f, "block out of bounds");
+    }
+    return DLMS_CORE_OK;
+}
+
+/* Check the fields of a service APDU as parsed by the core */
+static void
+fuzz_service(struct fuzz *f, const dlms_core_service *service, size_t size)
+{
+    if (service->offset > size
+        || (service->has_descriptor && service->descriptor.offset + 9 > service->offset)
+        || (service->has_date_time && (service->date_time_contents_offset > service->offset
+                                       || service->date_time_length > service->offset - service->date_time_contents_offset))
+        || (service->has_block_number && service->block_number_offset + 4 > service->offset)
+        || (service->has_data_access_result && service->data_access_result_offset >= service->offset)
+        || (service->has_data && service->data_offset > size)) {
+        fuzz_fail(f, "service fields out of bounds");
+    }
+}
+
+static int fuzz_apdu(struct fuzz *f, const uint8_t *data, size_t size, size_t offset, unsigned depth);
+
+/* Decode the Data of a whole transfer in a single block, as the dissector does once reassembled */
+static void
+fuzz_block_data(struct fuzz *f, const uint8_t *data, const dlms_core_block *block)
+{
+    size_t position = block->data_offset;
+
+    if (block->data_length && block->last_block && block->block_number == 1) {
+        fuzz_data(f, data, block->data_offset + block->data_length, &position);
+    }
+}
+
+static int
+fuzz_apdu(struct fuzz *f, const uint8_t *data, size_t size, size_t offset, unsigned depth)
+{
+    dlms_core_apdu apdu;
+    dlms_core_service service;
+    dlms_core_block block;
+    dlms_core_date_time dt;
+    dlms_core_security security;
+    size_t p = offset + 1;
+    uint32_t length, i;
+    int status;
+
+    status = dlms_core_classify_apdu(data, size, offset, &apdu);
+    if (status != DLMS_CORE_OK) {
+        return status;
+    }
+    f->items++;
+
+    status = dlms_core_parse_service(data, size, offset, &service);
+    if (status == DLMS_CORE_OK) {
+        fuzz_service(f, &service, size);
+    }
+
+    switch (apdu.choice) {
+    case DLMS_GET_REQUEST:
+        p += 2;
+        if (apdu.service == 1) { /* get-request-normal */
+            if (status != DLMS_CORE_OK) {
+                return status;
+            }
+            p = service.offset;
+            return fuzz_selective_access(f, data, size, &p);
+        } else if (apdu.service == 3) { /* get-request-with-list */
+            status = dlms_core_get_length(data, size, &p, &length);
+            for (i = 0; status == DLMS_CORE_OK && i < length; i++) {
+                status = fuzz_skip(data, size, &p, 9);
+                if (status == DLMS_CORE_OK) {
+                    status = fuzz_selective_access(f, data, size, &p);
+                }
+            }
+            return status;
+        }
+        break;
+    case DLMS_SET_REQUEST:
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        p = service.offset;
+        if (apdu.service == 1 || apdu.service == 2) { /* normal, or with-first-datablock */
+            status = fuzz_selective_access(f, data, size, &p);
+            if (status == DLMS_CORE_OK && apdu.service == 1) {
+                status = fuzz_data(f, data, size, &p);
+            } else if (status == DLMS_CORE_OK) {
+                status = dlms_core_parse_datablock_sa(data, size, &p, &block);
+                if (status == DLMS_CORE_OK) {
+                    fuzz_block(f, &block, size, p);
+                    fuzz_block_data(f, data, &block);
+                }
+            }
+            return status;
+        } else if (apdu.service == 3) { /* with-datablock */
+            status = dlms_core_parse_datablock_sa(data, size, &p, &block);
+            return status ? status : fuzz_block(f, &block, size, p);
+        }
+        break;
+    case DLMS_ACTION_REQUEST:
+        if (status == DLMS_CORE_OK && service.has_data) { /* method-invocation-parameters */
+            p = service.data_offset;
+            return fuzz_data(f, data, size, &p);
+        }
+        return status;
+    case DLMS_GET_RESPONSE:
+        p += 2;
+        if (apdu.service == 1) { /* get-response-normal */
+            if (status == DLMS_CORE_OK && service.has_data) {
+                p = service.data_offset;
+                return fuzz_data(f, data, size, &p);
+            }
+            return status;
+        } else if (apdu.service == 2) { /* get-response-with-datablock */
+            status = dlms_core_parse_datablock_g(data, size, &p, &block);
+            if (status == DLMS_CORE_OK) {
+                fuzz_block(f, &block, size, p);
+                fuzz_block_data(f, data, &block);
+            }
+            return status;
+        } else if (apdu.service == 3) { /* get-response-with-list */
+            status = dlms_core_get_length(data, size, &p, &length);
+            for (i = 0; status == DLMS_CORE_OK && i < length; i++) {
+                if (p >= size) {
+                    return DLMS_CORE_TRUNCATED;
+                }
+                status = data[p] == 0 ? (p++, fuzz_data(f, data, size, &p)) : fuzz_skip(data, size, &p, 2);
+            }
+            return status;
+        }
+        break;
+    case DLMS_READ_RESPONSE:
+        status = dlms_core_get_length(data, size, &p, &length);
+        for (i = 0; status == DLMS_CORE_OK && i < length; i++) {
+            if (p >= size) {
+                return DLMS_CORE_TRUNCATED;
+            }
+            switch (data[p++]) {
+            case 0: /* data */
+                status = fuzz_data(f, data, size, &p);
+                break;
+            case 1: /* data-access-error */
+                status = fuzz_skip(data, size, &p, 1);
+                break;
+            case 2: /* data-block-result */
+                status = dlms_core_parse_data_block_result(data, size, &p, &block);
+                if (status == DLMS_CORE_OK) {
+                    fuzz_block(f, &block, size, p);
+                    fuzz_block_data(f, data, &block);
+                }
+                break;
+            case 3: /* block-number */
+                status = fuzz_skip(data, size, &p, 2);
+                break;
+            default:
+                return DLMS_CORE_INVALID;
+            }
+        }
+        return status;
+    case DLMS_ACTION_RESPONSE:
+    case DLMS_EVENT_NOTIFICATION_REQUEST:
+        if (status == DLMS_CORE_OK && service.has_data) { /* return parameters, or attribute-value */
+            p = service.data_offset;
+            return fuzz_data(f, data, size, &p);
+        }
+        return status;
+    case DLMS_DATA_NOTIFICATION:
+        if (status != DLMS_CORE_OK) {
+            return status;
+        }
+        dlms_core_parse_date_time(data + service.date_time_contents_offset, service.date_time_length, &dt);
+        p = service.data_offset;
+        return fuzz_data(f, data, size, &p);
+    case DLMS_GENERAL_BLOCK_TRANSFER:
+        status = dlms_core_parse_general_block_transfer(data, size, &p, &block);
+        if (status == DLMS_CORE_OK) {
+            fuzz_block(f, &block, size, p);
+            if (block.data_length && block.last_block && block.block_number == 1 && depth < FUZZ_MAX_APDU_DEPTH) {
+                fuzz_apdu(f, data, block.data_offset + block.data_length, block.data_offset, depth + 1);
+            }
+        }
+        return status;
+    }
+    if (dlms_core_is_ciphered_apdu(apdu.choice)) {
+        p = offset;
+        return dlms_core_parse_security_header(data, size, &p, &security);
+    }
+
+    return DLMS_CORE_OK;
+}
+
+/* Decode the APDU after an LLC header, if the information has one */
+static void
+fuzz_llc_apdu(struct fuzz *f, const uint8_t *data, size_t size)
+{
+    if (size >= 3 && data[0] == 0xe6 && (data[1] == 0xe6 || data[1] == 0xe7)) {
+        fuzz_apdu(f, data, size, 3, 0);
+    }
+}
+
+static void
+fuzz_hdlc(struct fuzz *f, const uint8_t *data, size_t size)
+{
+    dlms_core_hdlc frame;
+    uint8_t *information;
+    size_t offset = 0, length = 0;
+
+    information = malloc(size + 1);
+    if (!information) {
+        return;
+    }
+    while (offset < size && data[offset] == 0x7e) {
+        if (dlms_core_parse_hdlc(data, size, offset, &frame) != DLMS_CORE_OK) {
+            break;
+        }
+        f->items++;
+        if (frame.information_length > frame.length || frame.information_offset + frame.information_length > size) {
+            fuzz_fail(f, "HDLC information out of bounds");
+        }
+        if ((frame.control & 0x01) == 0 || (frame.control & 0xef) == 0x03) { /* I or UI frame */
+            memcpy(information + length, data + frame.information_offset, frame.information_length);
+            length += frame.information_length;
+            if (!frame.segmentation) {
+                fuzz_llc_apdu(f, information, length);
+                length = 0;
+            }
+        }
+        /* the closing flag may also be the opening flag of the next frame */
+        offset += frame.length + 1;
+        if (offset + 1 < size && data[offset + 1] == 0x7e) {
+            offset++;
+        }
+    }
+    free(information);
+}
+
+static void
+fuzz_wrapper(struct fuzz *f, const uint8_t *data, size_t size)
+{
+    size_t offset = 0, end;
+
+    while (size - offset >= 8) {
+        end = offset + 8 + ((data[offset + 6] << 8) | data[offset + 7]);
+        f->items++;
+        fuzz_apdu(f, data, end < size ? end : size, offset + 8, 0);
+        if (end >= size) {
+            break;
+        }
+        offset = end;
+    }
+}
+
+static void
+fuzz_432(struct fuzz *f, const uint8_t *data, size_t size)
+{
+    if (size >= 3) {
+        fuzz_apdu(f, data, size, 3, 0);
+    }
+}
+
+static double
+fuzz_seconds(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* Decode an input, and abort if it was decoded in super-linear time or items */
+static void
+fuzz_input(const uint8_t *data, size_t size)
+{
+    static double us_per_byte = -1;
+    struct fuzz f = { data, size, 0 };
+    const char *env;
+    double start;
+    int entry = FUZZ_ENTRY;
+
+    if (us_per_byte < 0) {
+        env = getenv("DLMS_FUZZ_US_PER_BYTE");
+        us_per_byte = env ? atof(env) : 20;
+    }
+    if (size == 0) {
+        return;
+    }
+    if (entry == FUZZ_ANY) {
+        entry = data[0] == 0x7e ? FUZZ_HDLC : data[0] == 0x90 ? FUZZ_432 : data[0] == 0 ? FUZZ_WRAPPER : FUZZ_APDU;
+    }
+
+    start = fuzz_seconds();
+    if (entry == FUZZ_HDLC) {
+        fuzz_hdlc(&f, data, size);
+    } else if (entry == FUZZ_WRAPPER) {
+        fuzz_wrapper(&f, data, size);
+    } else if (entry == FUZZ_432) {
+        fuzz_432(&f, data, size);
+    } else {
+        fuzz_apdu(&f, data, size, 0, 0);
+    }
+
+    if (f.items > FUZZ_ITEMS_PER_BYTE * (unsigned long long)size + FUZZ_ITEMS_BASE) {
+        fuzz_fail(&f, "super-linear number of items");
+    }
+    if (us_per_byte > 0 && fuzz_seconds() - start > 0.02 + us_per_byte * size / 1e6) {
+        fuzz_fail(&f, "super-linear decoding time");
+    }
+}
+
+#ifdef FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    fuzz_input(data, size);
+    return 0;
+}
+
+#else
+
+static uint8_t *
+read_file(FILE *file, size_t *size)
+{
+    uint8_t *data = 0, *grown;
+    size_t capacity = 0, n;
+
+    *size = 0;
+    do {
+        if (*size == capacity) {
+            capacity = capacity ? 2 * capacity : 65536;
+            grown = realloc(data, capacity);
+            if (!grown) {
+                free(data);
+                return 0;
+            }
+            data = grown;
+        }
+        n = fread(data + *size, 1, capacity - *size, file);
+        *size += n;
+    } while (n);
+
+    return data;
+}
+
+static int
+run_file(const char *name)
+{
+    FILE *file;
+    uint8_t *data;
+    size_t size;
+
+    file = name ? fopen(name, "rb") : stdin;
+    if (!file) {
+        perror(name);
+        return 0;
+    }
+    data = read_file(file, &size);
+    if (name) {
+        fclose(file);
+    }
+    if (data) {
+        fuzz_input(data, size);
+        free(data);
+    }
+    return 1;
+}
+
+/* Run an input file, or the files of a directory */
+static unsigned
+run_path(const char *path)
+{
+    struct stat st;
+    struct dirent *entry;
+    DIR *dir;
+    char name[4096];
+    unsigned n = 0;
+
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return run_file(path);
+    }
+    dir = opendir(path);
+    if (!dir) {
+        perror(path);
+        return 0;
+    }
+    while ((entry = readdir(dir)) != 0) {
+        if (entry->d_name[0] != '.') {
+            snprintf(name, sizeof name, "%s/%s", path, entry->d_name);
+            n += run_path(name);
+        }
+    }
+    closedir(dir);
+
+    return n;
+}
+
+/* Write a seed file, named after the hash of its contents */
+static void
+write_seed(const char *directory, const char *entry, const uint8_t *data, size_t size)
+{
+    char name[4096];
+    uint64_t hash = 0xcbf29ce484222325;
+    size_t i;
+    FILE *file;
+
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3;
+    }
+    snprintf(name, sizeof name, "%s/%s", directory, entry);
+    mkdir(name, 0777);
+    snprintf(name, sizeof name, "%s/%s/%016llx", directory, entry, (unsigned long long)hash);
+    file = fopen(name, "wb");
+    if (!file) {
+        perror(name);
+        exit(1);
+    }
+    fwrite(data, 1, size, file);
+    fclose(file);
+}
+
+/* Write an APDU as seed of the apdu and wrapper entry points */
+static void
+write_apdu_seeds(const char *directory, const uint8_t *apdu, size_t size)
+{
+    uint8_t *wrapper;
+
+    if (size == 0 || size > 0xffff) {
+        return;
+    }
+    write_seed(directory, "apdu", apdu, size);
+    wrapper = malloc(8 + size);
+    if (!wrapper) {
+        return;
+    }
+    memcpy(wrapper, "\x00\x01\x00\x10\x00\x01", 6);
+    wrapper[6] = (uint8_t)(size >> 8);
+    wrapper[7] = (uint8_t)size;
+    memcpy(wrapper + 8, apdu, size);
+    write_seed(directory, "wrapper", wrapper, 8 + size);
+    free(wrapper);
+}
+
+/* Extract the seeds of a UDP payload (or TCP segment) */
+static void
+extract_payload(const char *directory, const uint8_t *data, size_t size)
+{
+    dlms_core_hdlc frame;
+
+    if (size == 0) {
+        return;
+    }
+    if (data[0] == 0x7e) {
+        write_seed(directory, "hdlc", data, size);
+        if (dlms_core_parse_hdlc(data, size, 0, &frame) == DLMS_CORE_OK && !frame.segmentation
+            && frame.information_length > 3) {
+            write_apdu_seeds(directory, data + frame.information_offset + 3, frame.information_length - 3);
+        }
+    } else if (data[0] == 0x90) {
+        write_seed(directory, "432", data, size);
+        if (size > 3) {
+            write_apdu_seeds(directory, data + 3, size - 3);
+        }
+    } else if (data[0] == 0) {
+        write_seed(directory, "wrapper", data, size);
+        if (size > 8) {
+            write_seed(directory, "apdu", data + 8, size - 8);
+        }
+    } else {
+        write_apdu_seeds(directory, data, size);
+    }
+}
+
+/* Extract the seeds of the Ethernet, IPv4, UDP or TCP packets of a pcap capture */
+static int
+extract(const char *capture, const char *directory)
+{
+    FILE *file;
+    uint8_t *data;
+    size_t size, offset, length, ip, transport;
+    unsigned n = 0;
+
+    file = fopen(capture, "rb");
+    if (!file) {
+        perror(capture);
+        return 1;
+    }
+    data = read_file(file, &size);
+    fclose(file);
+    if (!data || size < 24 || memcmp(data, "\xd4\xc3\xb2\xa1", 4) != 0 || data[20] != 1) {
+        fprintf(stderr, "dlms-fuzz: %s is not a little-endian Ethernet pcap capture\n", capture);
+        return 1;
+    }
+    mkdir(directory, 0777);
+
+    for (offset = 24; size - offset >= 16; offset += 16 + length) {
+        length = data[offset + 8] | (data[offset + 9] << 8) | (data[offset + 10] << 16)
+            | ((size_t)data[offset + 11] << 24);
+        if (length > size - offset - 16) {
+            break;
+        }
+        ip = offset + 16 + 14;
+        if (length < 14 + 20 || data[ip - 2] != 0x08 || data[ip - 1] != 0 || (data[ip] >> 4) != 4) {
+            continue;
+        }
+        transport = ip + (data[ip] & 0x0f) * 4;
+        if (data[ip + 9] == 17 && transport + 8 <= offset + 16 + length) {
+            extract_payload(directory, data + transport + 8, offset + 16 + length - transport - 8);
+            n++;
+        } else if (data[ip + 9] == 6 && transport + 20 <= offset + 16 + length) {
+            transport += (data[transport + 12] >> 4) * 4;
+            if (transport < offset + 16 + length) {
+                extract_payload(directory, data + transport, offset + 16 + length - transport);
+                n++;
+            }
+        }
+    }
+    free(data);
+    printf("%u payloads\n", n);
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned n = 0;
+    int i;
+
+    if (argc == 4 && strcmp(argv[1], "-x") == 0) {
+        return extract(argv[2], argv[3]);
+    }
+    if (argc > 1 && argv[1][0] == '-') {
+        fprintf(stderr, "usage: dlms-fuzz [input-file-or-directory...]\n"
+                        "       dlms-fuzz -x capture.pcap corpus-directory\n");
+        return 2;
+    }
+    if (argc == 1) {
+        n = run_file(0);
+    }
+    for (i = 1; i < argc; i++) {
+        n += run_path(argv[i]);
+    }
+    if (argc > 1) {
+        printf("%u inputs decoded\n", n);
+    }
+
+    return 0;
+}
+
+#endif
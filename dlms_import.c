@@ -0,0 +1,581 @@
+/*
+ * dlms_import.c - Import serial sniffer and head-end hex logs into pcapng
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Usage: dlms-import [-r] [-x] [-d date] [-z zone] [-o capture.pcapng] [log]
+ *
+ * Each record of a hex log starts on a line with a timestamp or a direction,
+ * followed by the bytes in hexadecimal, which may continue on the next lines:
+ *
+ *   2018-05-04 12:34:56.789 TX: 7E A0 07 03 21 93 0F 01 7E
+ *   [12:34:56.812] <- 7ea0... (time of day, on the date given with -d)
+ *   1525437296.835 RX 00 01 00 01 00 10 00 0D ... (seconds since the epoch)
+ *   0010: 7E A0 ... (continuation, with an offset)
+ *
+ * The timestamp is a date and time (with an optional Z or UTC offset, else
+ * in the zone given with -z, UTC by default), a time of day, or seconds
+ * since the epoch. The direction is TX, SEND, SENT, OUT, > or -> for what
+ * the logging side sent (outbound), and RX, RECV, RECEIVED, IN, < or <- for
+ * what it received (inbound); -x swaps them. Other words before the bytes
+ * are ignored, and so are lines without a timestamp, direction or bytes.
+ *
+ * The bytes of each direction are split into HDLC frames on their flags and
+ * the length of their frame format field, whatever the records they are
+ * logged in, as serial sniffers cut them at arbitrary points. The records
+ * that do not start with a flag (wrapper PDUs, 4-32 frames or raw APDUs) are
+ * written as they are. With -r, the log is a raw capture of serial bytes,
+ * split into HDLC frames, with no direction and the time of -d.
+ *
+ * The capture has the Wireshark upper PDU link type, each packet tagged for
+ * the DLMS dissector, with the direction in the packet flags and the line of
+ * the log in the packet comment. The log is read as a stream, with constant
+ * memory, so it can be piped in and be of any size.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define LINE_MAX_LENGTH (1 << 20) /* longer lines are continued as bytes */
+#define RECORD_MAX_LENGTH 65544 /* a wrapper PDU of the largest length */
+#define HDLC_MAX_LENGTH (2047 + 2) /* frame format length, plus the flags */
+
+#define DIRECTION_NONE 0
+#define DIRECTION_INBOUND 1 /* values of the direction bits of the pcapng packet flags */
+#define DIRECTION_OUTBOUND 2
+
+/* Bytes of a direction being split into HDLC frames */
+struct stream {
+    uint8_t frame[HDLC_MAX_LENGTH];
+    size_t length; /* 0 while looking for a flag, 1 after an opening flag */
+    size_t needed; /* length of the frame, once its frame format field is in */
+    int64_t time; /* of the record of the first byte after the opening flag */
+    unsigned long line;
+};
+
+/* A record of the log */
+struct record {
+    uint8_t data[RECORD_MAX_LENGTH];
+    size_t length;
+    int open; /* whether a record was started */
+    int hdlc; /* whether its bytes go to the HDLC stream of its direction */
+    int direction;
+    int64_t time; /* microseconds since the epoch */
+    unsigned long line;
+};
+
+static FILE *out;
+static struct stream streams[3]; /* by direction */
+static struct record record;
+static int swap_directions;
+static int64_t day_start; /* of the date given with -d, for times of day */
+static int64_t last_time_of_day = -1;
+static int64_t zone_offset; /* microseconds to subtract from local times */
+static unsigned long packets, frames, discarded;
+
+/* Days since 1970-01-01 of a civil date */
+static int64_t
+days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    int64_t era;
+    unsigned yoe, doy, doe;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = (unsigned)(y - era * 400);
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static void
+put_block(const void *data, size_t length)
+{
+    if (fwrite(data, 1, length, out) != length) {
+        perror("dlms-import: write");
+        exit(1);
+    }
+}
+
+static void
+put_32(uint32_t value)
+{
+    put_block(&value, 4);
+}
+
+/* Write the section header and interface description blocks, in host byte order */
+static void
+write_header(void)
+{
+    static const uint8_t shb_tail[12] = { 1, 0, 0, 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+    put_32(0x0a0d0d0a);
+    put_32(28);
+    put_32(0x1a2b3c4d);
+    put_block(shb_tail, sizeof shb_tail); /* version 1.0, unknown section length */
+    put_32(28);
+
+    put_32(1);
+    put_32(20);
+    put_32(252); /* LINKTYPE_WIRESHARK_UPPER_PDU, with microsecond timestamps */
+    put_32(0); /* no snapshot length */
+    put_32(20);
+}
+
+/* Write an enhanced packet block with the DLMS dissector tag, the direction flags and the line comment */
+static void
+write_packet(int64_t time, int direction, unsigned long line, const uint8_t *data, size_t length)
+{
+    static const uint8_t tags[12] = {
+        0, 12, 0, 4, 'D', 'L', 'M', 'S', /* EXP_PDU_TAG_PROTO_NAME */
+        0, 0, 0, 0 /* EXP_PDU_TAG_END_OF_OPT */
+    };
+    static const uint8_t padding[4];
+    char comment[32];
+    size_t comment_length, packet_length, block_length;
+    uint16_t option[2];
+
+    comment_length = (size_t)snprintf(comment, sizeof comment, "line %lu", line);
+    packet_length = sizeof tags + length;
+    block_length = 28 + ((packet_length + 3) & ~(size_t)3) + 4 + ((comment_length + 3) & ~(size_t)3);
+    if (direction) {
+        block_length += 8;
+    }
+    block_length += 4 + 4;
+
+    put_32(6);
+    put_32((uint32_t)block_length);
+    put_32(0); /* interface */
+    put_32((uint32_t)((uint64_t)time >> 32));
+    put_32((uint32_t)time);
+    put_32((uint32_t)packet_length);
+    put_32((uint32_t)packet_length);
+    put_block(tags, sizeof tags);
+    put_block(data, length);
+    put_block(padding, (4 - packet_length % 4) % 4);
+    option[0] = 1; /* opt_comment */
+    option[1] = (uint16_t)comment_length;
+    put_block(option, sizeof option);
+    put_block(comment, comment_length);
+    put_block(padding, (4 - comment_length % 4) % 4);
+    if (direction) {
+        option[0] = 2; /* epb_flags */
+        option[1] = 4;
+        put_block(option, sizeof option);
+        put_32((uint32_t)direction);
+    }
+    put_32(0); /* opt_endofopt */
+    put_32((uint32_t)block_length);
+    packets++;
+}
+
+/* Feed bytes to the HDLC stream of a direction, writing each frame as it completes */
+static void
+stream_feed(struct stream *s, int direction, int64_t time, unsigned long line, const uint8_t *data, size_t length)
+{
+    size_t i;
+    uint8_t b;
+
+    for (i = 0; i < length; i++) {
+        b = data[i];
+        if (s->length == 0) { /* looking for a flag */
+            if (b == 0x7e) {
+                s->frame[s->length++] = b;
+            } else {
+                discarded++;
+            }
+            continue;
+        }
+        if (s->length == 1) {
+            if (b == 0x7e) {
+                continue; /* inter-frame fill */
+            }
+            if ((b & 0xf0) != 0xa0) { /* not a frame format field of type 3 */
+                s->length = 0;
+                discarded++;
+                continue;
+            }
+            s->time = time;
+            s->line = line;
+        }
+        s->frame[s->length++] = b;
+        if (s->length == 3) {
+            s->needed = (((size_t)s->frame[1] & 0x07) << 8 | s->frame[2]) + 2;
+            if (s->needed < 6) {
+                s->length = 0;
+                discarded += 3;
+            }
+        } else if (s->length > 3 && s->length == s->needed) {
+            if (b == 0x7e) {
+                write_packet(s->time, direction, s->line, s->frame, s->length);
+                frames++;
+                s->length = 1; /* the closing flag may be the opening flag of the next frame */
+            } else {
+                discarded += s->length;
+                s->length = 0;
+            }
+        }
+    }
+}
+
+/* Write the current record, as a packet or to the HDLC stream of its direction */
+static void
+record_flush(void)
+{
+    if (record.length) {
+        if (record.hdlc) {
+            stream_feed(&streams[record.direction], record.direction, record.time, record.line,
+                        record.data, record.length);
+        } else {
+            write_packet(record.time, record.direction, record.line, record.data, record.length);
+        }
+    }
+    record.length = 0;
+}
+
+static void
+record_add(uint8_t b)
+{
+    if (record.length == 0 && !record.hdlc) {
+        /* Its bytes are HDLC if they start with a flag or continue a frame */
+        record.hdlc = b == 0x7e || streams[record.direction].length > 1;
+    }
+    if (record.length == sizeof record.data) {
+        fprintf(stderr, "dlms-import: line %lu: record longer than %u bytes, split\n",
+                record.line, (unsigned)sizeof record.data);
+        record_flush();
+    }
+    record.data[record.length++] = b;
+    if (record.hdlc && record.length == sizeof record.data) {
+        record_flush(); /* the stream keeps the bytes it needs */
+    }
+}
+
+static int
+hex_value(int c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = tolower(c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static unsigned
+parse_digits(const char **p, unsigned count)
+{
+    unsigned value = 0;
+
+    while (count-- && isdigit((unsigned char)**p)) {
+        value = value * 10 + (unsigned)(*(*p)++ - '0');
+    }
+    return value;
+}
+
+/* Parse the fraction of a second after a point or comma, in microseconds */
+static int64_t
+parse_fraction(const char **p)
+{
+    int64_t us = 0, scale = 100000;
+
+    if ((**p == '.' || **p == ',') && isdigit((unsigned char)(*p)[1])) {
+        (*p)++;
+        while (isdigit((unsigned char)**p)) {
+            us += (**p - '0') * scale;
+            scale /= 10;
+            (*p)++;
+        }
+    }
+    return us;
+}
+
+static int
+is_separator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '[' || c == ']' || c == '|'
+        || c == ',' || c == ';' || c == '(' || c == ')';
+}
+
+/* Parse a timestamp at *p, in microseconds since the epoch, moving past it */
+static int
+parse_timestamp(const char **p, int64_t *time)
+{
+    const char *s = *p;
+    unsigned year = 0, month = 0, day = 0, hour, minute, second;
+    int64_t us, offset = zone_offset;
+    int has_date = 0;
+    char *end;
+
+    if (isdigit((unsigned char)s[0]) && isdigit((unsigned char)s[1]) && isdigit((unsigned char)s[2])
+        && isdigit((unsigned char)s[3]) && (s[4] == '-' || s[4] == '/') && isdigit((unsigned char)s[5])
+        && isdigit((unsigned char)s[6]) && s[7] == s[4] && isdigit((unsigned char)s[8])) {
+        year = parse_digits(&s, 4);
+        s++;
+        month = parse_digits(&s, 2);
+        s++;
+        day = parse_digits(&s, 2);
+        if (*s != 'T' && *s != ' ') {
+            return 0;
+        }
+        s++;
+        has_date = 1;
+    }
+    if (isdigit((unsigned char)s[0]) && isdigit((unsigned char)s[1]) && s[2] == ':'
+        && isdigit((unsigned char)s[3]) && isdigit((unsigned char)s[4]) && s[5] == ':') {
+        hour = parse_digits(&s, 2);
+        s++;
+        minute = parse_digits(&s, 2);
+        s++;
+        second = parse_digits(&s, 2);
+        us = ((int64_t)hour * 3600 + minute * 60 + second) * 1000000 + parse_fraction(&s);
+        if (*s == 'Z') {
+            offset = 0;
+            s++;
+        } else if (has_date && (*s == '+' || *s == '-') && isdigit((unsigned char)s[1])) {
+            int sign = *s++ == '-' ? -1 : 1;
+            hour = parse_digits(&s, 2);
+            s += *s == ':';
+            minute = parse_digits(&s, 2);
+            offset = sign * ((int64_t)hour * 3600 + minute * 60) * 1000000;
+        }
+        if (has_date) {
+            *time = days_from_civil(year, month, day) * 86400000000LL + us - offset;
+        } else {
+            /* A time of day before the previous one by more than 12 hours is on the next day */
+            if (last_time_of_day >= 0 && us + 43200000000LL < last_time_of_day) {
+                day_start += 86400000000LL;
+            }
+            last_time_of_day = us;
+            *time = day_start + us - offset;
+        }
+    } else if (!has_date && s[0] >= '1' && s[0] <= '9') {
+        /* Seconds since the epoch, with 9 to 11 digits (so as not to be taken for bytes) */
+        int64_t seconds = strtoll(s, &end, 10);
+        if (end - s < 9 || end - s > 11 || !(*end == '.' || *end == ',' || is_separator(*end) || !*end)) {
+            return 0;
+        }
+        s = end;
+        *time = seconds * 1000000 + parse_fraction(&s);
+    } else {
+        return 0;
+    }
+    *p = s;
+    return 1;
+}
+
+/* Direction named by a word of the log (DIRECTION_NONE if none) */
+static int
+parse_direction(const char *word, size_t length)
+{
+    static const char *const outbound[] = { "tx", "send", "sent", "out", ">", "->", "-->", ">>", 0 };
+    static const char *const inbound[] = { "rx", "recv", "received", "in", "<", "<-", "<--", "<<", 0 };
+    int i;
+
+    for (i = 0; outbound[i]; i++) {
+        if (strlen(outbound[i]) == length && strncasecmp(word, outbound[i], length) == 0) {
+            return swap_directions ? DIRECTION_INBOUND : DIRECTION_OUTBOUND;
+        }
+    }
+    for (i = 0; inbound[i]; i++) {
+        if (strlen(inbound[i]) == length && strncasecmp(word, inbound[i], length) == 0) {
+            return swap_directions ? DIRECTION_OUTBOUND : DIRECTION_INBOUND;
+        }
+    }
+    return DIRECTION_NONE;
+}
+
+/* Parse a line of a hex log (or the rest of a long one, if continued) */
+static void
+parse_line(const char *line, int continued, unsigned long number)
+{
+    const char *p = line, *word;
+    size_t length, i;
+    int64_t time = record.time;
+    int has_time = 0, direction = DIRECTION_NONE, in_bytes = continued;
+
+    while (is_separator(*p)) {
+        p++;
+    }
+    if (!continued) {
+        has_time = parse_timestamp(&p, &time);
+    }
+
+    for (;;) {
+        while (is_separator(*p)) {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        word = p;
+        while (*p && !is_separator(*p)) {
+            p++;
+        }
+        length = (size_t)(p - word);
+        if (word[length - 1] == ':' && length > 1) {
+            length--;
+            if (!in_bytes && parse_direction(word, length) == DIRECTION_NONE) {
+                continue; /* a label or the offset of a dump */
+            }
+        }
+        if (!in_bytes && direction == DIRECTION_NONE && (direction = parse_direction(word, length)) != DIRECTION_NONE) {
+            continue;
+        }
+        for (i = 0; i < length && hex_value(word[i]) >= 0; i++) {
+        }
+        if (i < length || length % 2) {
+            if (in_bytes) {
+                break; /* the bytes end at the first other word */
+            }
+            continue;
+        }
+
+        /* A line with a timestamp or a direction starts a record */
+        if (!in_bytes && (has_time || direction != DIRECTION_NONE || !record.open)) {
+            record_flush();
+            record.open = 1;
+            record.hdlc = 0;
+            record.time = time;
+            record.direction = direction;
+            record.line = number;
+        }
+        in_bytes = 1;
+        for (i = 0; i < length; i += 2) {
+            record_add((uint8_t)(hex_value(word[i]) << 4 | hex_value(word[i + 1])));
+        }
+    }
+
+    if (!in_bytes && (has_time || direction != DIRECTION_NONE)) {
+        /* The bytes of the record are on the next lines */
+        record_flush();
+        record.open = 1;
+        record.hdlc = 0;
+        record.time = time;
+        record.direction = direction;
+        record.line = number;
+    }
+}
+
+static void
+import_log(FILE *in)
+{
+    static char line[LINE_MAX_LENGTH];
+    unsigned long number = 0;
+    int continued = 0;
+    size_t length;
+
+    while (fgets(line, sizeof line, in)) {
+        if (!continued) {
+            number++;
+        }
+        parse_line(line, continued, number);
+        length = strlen(line);
+        continued = length && line[length - 1] != '\n';
+    }
+    record_flush();
+}
+
+static void
+import_raw(FILE *in)
+{
+    static uint8_t data[1 << 16];
+    size_t n;
+
+    while ((n = fread(data, 1, sizeof data, in)) > 0) {
+        stream_feed(&streams[DIRECTION_NONE], DIRECTION_NONE, day_start, 0, data, n);
+    }
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: dlms-import [-r] [-x] [-d yyyy-mm-dd] [-z +hh:mm] [-o capture.pcapng] [log]\n");
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *out_path = 0, *p;
+    unsigned year, month, day, hours, minutes;
+    FILE *in = stdin;
+    int c, raw = 0, sign;
+
+    while ((c = getopt(argc, argv, "rxd:z:o:")) != -1) {
+        if (c == 'r') {
+            raw = 1;
+        } else if (c == 'x') {
+            swap_directions = 1;
+        } else if (c == 'd') {
+            if (sscanf(optarg, "%u-%u-%u", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1 || day > 31) {
+                usage();
+            }
+            day_start = days_from_civil(year, month, day) * 86400000000LL;
+        } else if (c == 'z') {
+            p = optarg;
+            sign = *p == '-' ? -1 : 1;
+            p += *p == '-' || *p == '+';
+            hours = parse_digits(&p, 2);
+            p += *p == ':';
+            minutes = parse_digits(&p, 2);
+            zone_offset = sign * ((int64_t)hours * 3600 + minutes * 60) * 1000000;
+        } else if (c == 'o') {
+            out_path = optarg;
+        } else {
+            usage();
+        }
+    }
+    if (optind + 1 < argc) {
+        usage();
+    }
+
+    if (optind < argc && strcmp(argv[optind], "-")) {
+        in = fopen(argv[optind], raw ? "rb" : "r");
+        if (!in) {
+            fprintf(stderr, "dlms-import: %s: %s\n", argv[optind], strerror(errno));
+            return 1;
+        }
+    }
+    out = out_path && strcmp(out_path, "-") ? fopen(out_path, "wb") : stdout;
+    if (!out) {
+        fprintf(stderr, "dlms-import: %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+    setvbuf(out, 0, _IOFBF, 1 << 20);
+
+    write_header();
+    if (raw) {
+        import_raw(in);
+    } else {
+        import_log(in);
+    }
+    if (fflush(out) != 0) {
+        perror("dlms-import: write");
+        return 1;
+    }
+
+    fprintf(stderr, "dlms-import: %lu packets (%lu HDLC frames), %lu bytes discarded\n", packets, frames, discarded);
+    return 0;
+}
@@ -0,0 +1,1034 @@
+/*
+ * dlms_sim.c - Simulator of DLMS meters on localhost
+ *
+ * Copyright (C) 2018 Andre B. Oliveira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Usage: dlms-sim [-m meters] [-a address] [-u udp-port] [-t tcp-port] [-h hdlc-port]
+ *                 [-o objects-file] [-p max-pdu-size] [-n notifications/s] [-d host:port]
+ *
+ * The simulator serves the COSEM objects of a number of virtual meters (1000
+ * by default) on the wrapper over UDP and TCP (port 4059 by default) and on
+ * HDLC over TCP (port 4061 by default). Meter i (from 0) has wPort i + 1 and,
+ * for HDLC, upper address i + 1 with one byte addresses (so only the first 127
+ * meters are reachable with them), or lower (physical device) address i + 1
+ * with 2 and 4 byte addresses, whatever their upper address.
+ *
+ * The meters answer AARQ, RLRQ, Get (normal and next), Set (normal and with
+ * datablocks) and Action (normal). Responses that do not fit in the maximum
+ * PDU size are sent with datablocks, or with General-Block-Transfer if it was
+ * negotiated in the AARQ conformance. Requests in General-Block-Transfer APDUs
+ * are reassembled. With -n, the meters take turns to send Data-Notifications
+ * over UDP to -d (127.0.0.1:4060 by default) at the given total rate.
+ *
+ * The objects file has one attribute per line, as "class obis attribute kind
+ * [arguments]", where kind is one of:
+ *
+ *   clock                      date-time of now
+ *   counter increment          double-long-unsigned growing by increment per second
+ *   string format              octet-string, with %u replaced by the meter number
+ *   value type number          value of an integer type (unsigned, long-unsigned, enum, ...)
+ *   scaler-unit scaler unit    structure of an integer and an enum
+ *   profile rows columns       array of rows of a date-time and columns - 1 counters
+ *
+ * Set stores the value as is in the meter, for the next Get of the attribute.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "dlms_encode.h"
+
+/* Kinds of attribute values */
+enum {
+    KIND_CLOCK,
+    KIND_COUNTER,
+    KIND_STRING,
+    KIND_VALUE,
+    KIND_SCALER_UNIT,
+    KIND_PROFILE,
+};
+
+struct object {
+    unsigned class_id;
+    uint8_t obis[6];
+    unsigned attribute;
+    int kind;
+    unsigned type; /* data type of KIND_VALUE */
+    long arguments[2];
+    char format[64];
+};
+
+static struct object *objects;
+static unsigned object_count;
+
+static const char *const default_objects[] = {
+    "8 0.0.1.0.0.255 2 clock",
+    "1 0.0.42.0.0.255 2 string SIM%08u",
+    "3 1.0.1.8.0.255 2 counter 3",
+    "3 1.0.1.8.0.255 3 scaler-unit 0 30",
+    "3 1.0.2.8.0.255 2 counter 1",
+    "3 1.0.2.8.0.255 3 scaler-unit 0 30",
+    "1 0.0.96.1.0.255 2 string %u",
+    "1 0.0.96.14.0.255 2 value unsigned 1",
+    "7 1.0.99.1.0.255 2 profile 96 4",
+    "7 1.0.99.2.0.255 2 profile 1440 8",
+};
+
+/* Transfer in progress between a meter and its client */
+struct transfer {
+    dlms_encoder data; /* response Data sent with datablocks, or Set Data being received */
+    size_t offset; /* of the next block to send */
+    uint32_t block_number; /* last block sent or received */
+    unsigned invoke_id;
+    int object; /* for Set */
+    dlms_encoder gbt; /* request being received with General-Block-Transfer */
+};
+
+struct meter {
+    uint32_t conformance; /* negotiated */
+    unsigned max_pdu_size; /* negotiated */
+    dlms_encoder **values; /* values set, per object, if any */
+    struct transfer transfer;
+};
+
+static struct meter *meters;
+static unsigned meter_count = 1000;
+static unsigned max_pdu_size = 1024;
+static time_t start_time;
+
+/* general-block-transfer, block-transfer-with-get-or-read and -with-set-or-write, get, set, selective-access, action */
+#define SUPPORTED_CONFORMANCE 0x20181d
+/* Conformance until an AARQ negotiates it, without general-block-transfer */
+#define DEFAULT_CONFORMANCE 0x00181d
+#define HDLC_MAX_INFORMATION_LENGTH 128
+
+/* Parse an OBIS code written as a.b.c.d.e.f (or a-b:c.d.e*f) */
+static int
+parse_obis(const char *s, uint8_t *obis)
+{
+    unsigned v[6];
+    char c[3];
+
+    if (sscanf(s, "%u%c%u%c%u.%u.%u%c%u", &v[0], &c[0], &v[1], &c[1], &v[2], &v[3], &v[4], &c[2], &v[5]) != 9) {
+        return -1;
+    }
+    obis[0] = (uint8_t)v[0];
+    obis[1] = (uint8_t)v[1];
+    obis[2] = (uint8_t)v[2];
+    obis[3] = (uint8_t)v[3];
+    obis[4] = (uint8_t)v[4];
+    obis[5] = (uint8_t)v[5];
+    return 0;
+}
+
+static const struct {
+    const char *name;
+    unsigned type;
+} value_types[] = {
+    { "boolean", 3 }, { "double-long", 5 }, { "double-long-unsigned", 6 }, { "integer", 15 },
+    { "long", 16 }, { "unsigned", 17 }, { "long-unsigned", 18 }, { "long64", 20 },
+    { "long64-unsigned", 21 }, { "enum", 22 },
+};
+
+static int
+add_object(const char *line)
+{
+    struct object o;
+    char obis[32], kind[32], argument[64];
+    int n;
+
+    memset(&o, 0, sizeof o);
+    n = sscanf(line, "%u %31s %u %31s %63s %ld", &o.class_id, obis, &o.attribute, kind, argument, &o.arguments[1]);
+    if (n < 4 || parse_obis(obis, o.obis) < 0) {
+        return -1;
+    }
+    if (strcmp(kind, "clock") == 0) {
+        o.kind = KIND_CLOCK;
+    } else if (strcmp(kind, "counter") == 0 && n >= 5) {
+        o.kind = KIND_COUNTER;
+        o.arguments[0] = strtol(argument, 0, 10);
+    } else if (strcmp(kind, "string") == 0 && n >= 5) {
+        o.kind = KIND_STRING;
+        snprintf(o.format, sizeof o.format, "%s", argument);
+    } else if (strcmp(kind, "value") == 0 && n >= 6) {
+        size_t i;
+        o.kind = KIND_VALUE;
+        for (i = 0; i < sizeof value_types / sizeof value_types[0] && strcmp(value_types[i].name, argument); i++) {
+        }
+        if (i == sizeof value_types / sizeof value_types[0]) {
+            return -1;
+        }
+        o.type = value_types[i].type;
+        o.arguments[0] = o.arguments[1];
+    } else if (strcmp(kind, "scaler-unit") == 0 && n >= 6) {
+        o.kind = KIND_SCALER_UNIT;
+        o.arguments[0] = strtol(argument, 0, 10);
+    } else if (strcmp(kind, "profile") == 0 && n >= 6) {
+        o.kind = KIND_PROFILE;
+        o.arguments[0] = strtol(argument, 0, 10);
+    } else {
+        return -1;
+    }
+    objects = realloc(objects, (object_count + 1) * sizeof *objects);
+    objects[object_count++] = o;
+
+    return 0;
+}
+
+static int
+find_object(unsigned class_id, const uint8_t *obis, unsigned attribute)
+{
+    unsigned i;
+
+    for (i = 0; i < object_count; i++) {
+        if (objects[i].class_id == class_id && memcmp(objects[i].obis, obis, 6) == 0
+            && (attribute == 0 || objects[i].attribute == attribute)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void
+encode_time(dlms_encoder *e, time_t t)
+{
+    struct tm tm;
+    dlms_core_date_time dt;
+
+    gmtime_r(&t, &tm);
+    dt.year = (unsigned)tm.tm_year + 1900;
+    dt.month = (unsigned)tm.tm_mon + 1;
+    dt.day_of_month = (unsigned)tm.tm_mday;
+    dt.day_of_week = tm.tm_wday ? (unsigned)tm.tm_wday : 7;
+    dt.hour = (unsigned)tm.tm_hour;
+    dt.minute = (unsigned)tm.tm_min;
+    dt.second = (unsigned)tm.tm_sec;
+    dt.hundredths = 0;
+    dlms_encode_date_time(e, &dt);
+}
+
+/* The value of a counter of a meter at a time */
+static uint32_t
+counter(unsigned meter, const struct object *o, time_t t)
+{
+    return (uint32_t)(meter * 1000u + (uint32_t)((t - start_time + 86400) * o->arguments[0]));
+}
+
+/* Encode the value of an attribute of a meter */
+static void
+encode_value(dlms_encoder *e, unsigned meter, int object)
+{
+    const struct object *o = &objects[object];
+    time_t now = time(0);
+    char text[128];
+    long i, j;
+
+    if (meters[meter].values && meters[meter].values[object]) {
+        dlms_encode_bytes(e, meters[meter].values[object]->data, meters[meter].values[object]->length);
+        return;
+    }
+    switch (o->kind) {
+    case KIND_CLOCK:
+        encode_time(e, now);
+        break;
+    case KIND_COUNTER:
+        dlms_encode_unsigned(e, 6, counter(meter, o, now));
+        break;
+    case KIND_STRING:
+        snprintf(text, sizeof text, o->format, meter);
+        dlms_encode_string(e, 9, (const uint8_t *)text, (uint32_t)strlen(text));
+        break;
+    case KIND_VALUE:
+        if (o->type == 5 || o->type == 15 || o->type == 16 || o->type == 20) {
+            dlms_encode_signed(e, o->type, o->arguments[0]);
+        } else {
+            dlms_encode_unsigned(e, o->type, (uint64_t)o->arguments[0]);
+        }
+        break;
+    case KIND_SCALER_UNIT:
+        dlms_encode_structure(e, 2);
+        dlms_encode_signed(e, 15, o->arguments[0]);
+        dlms_encode_unsigned(e, 22, (uint64_t)o->arguments[1]);
+        break;
+    case KIND_PROFILE:
+        dlms_encode_array(e, (uint32_t)o->arguments[0]);
+        for (i = o->arguments[0]; i > 0; i--) {
+            time_t t = now - now % 900 - (i - 1) * 900;
+            dlms_encode_structure(e, (uint32_t)o->arguments[1]);
+            encode_time(e, t);
+            for (j = 1; j < o->arguments[1]; j++) {
+                dlms_encode_unsigned(e, 6, (uint32_t)(meter * 1000u + (uint32_t)j * 7u + (uint32_t)(t / 900)));
+            }
+        }
+        break;
+    }
+}
+
+/*
+ * The connections to the clients. Each sends APDUs, and receives them with
+ * send_apdu, which frames them as the transport of the connection requires.
+ */
+struct hdlc_link {
+    int connected;
+    unsigned vs, vr; /* send and receive state variables */
+    dlms_encoder segments; /* information being received */
+    dlms_encoder pending; /* LLC header and APDUs waiting to be sent */
+    size_t pending_offset; /* of the next segment to send */
+    size_t *ends; /* end offsets of the pending APDUs */
+    unsigned end_count;
+};
+
+enum {
+    TRANSPORT_UDP,
+    TRANSPORT_TCP_WRAPPER,
+    TRANSPORT_TCP_HDLC,
+};
+
+struct connection {
+    int fd;
+    int transport;
+    dlms_encoder input; /* stream bytes not parsed yet */
+    struct hdlc_link *links; /* per meter number (from 1), of meter_count + 1 */
+};
+
+/* Reply context: where to send the APDUs of a meter */
+struct reply {
+    struct connection *c;
+    struct sockaddr_in peer; /* for UDP */
+    unsigned meter_address; /* wPort or HDLC meter number of the meter */
+    unsigned client_address; /* wPort of the client */
+    dlms_core_hdlc_address hdlc_meter; /* HDLC addresses of the last frame, to answer with */
+    dlms_core_hdlc_address hdlc_client;
+};
+
+static void
+send_all(int fd, const uint8_t *data, size_t length)
+{
+    while (length) {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                struct pollfd p = { fd, POLLOUT, 0 };
+                poll(&p, 1, 1000);
+                continue;
+            }
+            return;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+}
+
+static int udp_fd = -1;
+
+static void
+hdlc_send(struct reply *r, unsigned control, int segmentation, const uint8_t *information, size_t length)
+{
+    dlms_encoder e;
+
+    dlms_encoder_init(&e);
+    dlms_encode_hdlc_addressed(&e, segmentation, &r->hdlc_client, &r->hdlc_meter, control, information, length);
+    send_all(r->c->fd, e.data, e.length);
+    dlms_encoder_free(&e);
+}
+
+/* Send the next segment of the pending APDUs of an HDLC link */
+static void
+hdlc_send_pending(struct reply *r, struct hdlc_link *l)
+{
+    size_t n = l->ends[0] - l->pending_offset;
+    int last = n <= HDLC_MAX_INFORMATION_LENGTH;
+
+    if (!last) {
+        n = HDLC_MAX_INFORMATION_LENGTH;
+    }
+    hdlc_send(r, (l->vr << 5) | 0x10 | (l->vs << 1), !last, l->pending.data + l->pending_offset, n);
+    l->vs = (l->vs + 1) & 7;
+    l->pending_offset += n;
+    if (last) {
+        memmove(l->ends, l->ends + 1, --l->end_count * sizeof *l->ends);
+        if (l->end_count == 0) {
+            l->pending.length = 0;
+            l->pending_offset = 0;
+        }
+    }
+}
+
+static void
+send_apdu(struct reply *r, const uint8_t *apdu, size_t length)
+{
+    dlms_encoder e;
+
+    dlms_encoder_init(&e);
+    if (r->c->transport == TRANSPORT_TCP_HDLC) {
+        struct hdlc_link *l = &r->c->links[r->meter_address];
+        int idle = l->end_count == 0;
+        dlms_encode_8(&l->pending, 0xe6);
+        dlms_encode_8(&l->pending, 0xe7);
+        dlms_encode_8(&l->pending, 0);
+        dlms_encode_bytes(&l->pending, apdu, length);
+        l->ends = realloc(l->ends, (l->end_count + 1) * sizeof *l->ends);
+        l->ends[l->end_count++] = l->pending.length;
+        if (idle) {
+            hdlc_send_pending(r, l);
+        }
+    } else {
+        dlms_encode_wrapper(&e, r->meter_address, r->client_address, apdu, length);
+        if (r->c->transport == TRANSPORT_UDP) {
+            sendto(udp_fd, e.data, e.length, 0, (struct sockaddr *)&r->peer, sizeof r->peer);
+        } else {
+            send_all(r->c->fd, e.data, e.length);
+        }
+    }
+    dlms_encoder_free(&e);
+}
+
+/* Send an APDU, in General-Block-Transfer blocks if it is too large and GBT was negotiated */
+static void
+send_response(struct reply *r, struct meter *m, const dlms_encoder *apdu)
+{
+    dlms_encoder e;
+    size_t offset, block_size = m->max_pdu_size - 10;
+    unsigned block;
+
+    if (apdu->length <= m->max_pdu_size || !(m->conformance & 0x200000)) {
+        send_apdu(r, apdu->data, apdu->length);
+        return;
+    }
+    dlms_encoder_init(&e);
+    for (offset = 0, block = 1; offset < apdu->length; offset += block_size, block++) {
+        size_t n = apdu->length - offset < block_size ? apdu->length - offset : block_size;
+        e.length = 0;
+        dlms_encode_general_block_transfer(&e, offset + n == apdu->length, 1, 1, block, 0,
+                                           apdu->data + offset, (uint32_t)n);
+        send_apdu(r, e.data, e.length);
+    }
+    dlms_encoder_free(&e);
+}
+
+/* Send the next block of the Get response of a meter */
+static void
+send_get_block(struct reply *r, struct meter *m)
+{
+    struct transfer *t = &m->transfer;
+    size_t n = t->data.length - t->offset, block_size = m->max_pdu_size - 16;
+    dlms_encoder e;
+
+    if (n > block_size) {
+        n = block_size;
+    }
+    t->block_number++;
+    dlms_encoder_init(&e);
+    dlms_encode_get_response_with_datablock(&e, t->invoke_id, t->offset + n == t->data.length, t->block_number,
+                                            t->data.data + t->offset, (uint32_t)n);
+    t->offset += n;
+    send_apdu(r, e.data, e.length);
+    dlms_encoder_free(&e);
+}
+
+/* Parse the InitiateRequest in the user-information of an AARQ */
+static void
+parse_aarq(struct meter *m, const uint8_t *p, size_t size)
+{
+    size_t offset = 2, end;
+    uint32_t conformance = 0;
+    unsigned pdu_size = 0xffff;
+
+    if (size < 2 || p[1] > size - 2) {
+        return;
+    }
+    end = 2 + p[1];
+    while (offset + 2 <= end && offset + 2 + p[offset + 1] <= end) {
+        if (p[offset] == 0xbe && p[offset + 1] >= 2 && p[offset + 2] == 0x04) {
+            const uint8_t *q = p + offset + 4;
+            size_t n = p[offset + 3], i = 1;
+            if (n > (size_t)p[offset + 1] - 2 || n < 1 || q[0] != 0x01) {
+                return;
+            }
+            if (i < n && q[i]) { /* dedicated-key */
+                i++;
+                i += i < n ? 1 + q[i] : 0;
+            } else {
+                i++;
+            }
+            i += i < n && q[i] ? 2 : 1; /* response-allowed */
+            i += i < n && q[i] ? 2 : 1; /* proposed-quality-of-service */
+            i++; /* proposed-dlms-version-number */
+            if (i + 9 <= n && q[i] == 0x5f && q[i + 1] == 0x1f) {
+                conformance = ((uint32_t)q[i + 4] << 16) | ((uint32_t)q[i + 5] << 8) | q[i + 6];
+                pdu_size = (q[i + 7] << 8) | q[i + 8];
+            }
+        }
+        offset += 2 + p[offset + 1];
+    }
+    m->conformance = conformance & SUPPORTED_CONFORMANCE;
+    m->max_pdu_size = pdu_size && pdu_size < max_pdu_size ? pdu_size : max_pdu_size;
+    if (m->max_pdu_size < 64) {
+        m->max_pdu_size = 64;
+    }
+}
+
+static void *
+ignore_begin(void *context, void *parent, const dlms_core_data *d)
+{
+    (void)context;
+    (void)d;
+    return parent;
+}
+
+static void
+ignore_end(void *context, void *parent, void *element_parent, const dlms_core_data *d)
+{
+    (void)context;
+    (void)parent;
+    (void)element_parent;
+    (void)d;
+}
+
+static void
+ignore_value(void *context, void *parent, const dlms_core_data *d)
+{
+    (void)context;
+    (void)parent;
+    (void)d;
+}
+
+static const dlms_core_data_visitor ignore_visitor = { ignore_begin, ignore_end, ignore_value };
+
+/* Store the value of a Set, if it is valid Data, and return the data-access-result */
+static unsigned
+set_value(unsigned meter, int object, const uint8_t *data, size_t length)
+{
+    struct meter *m = &meters[meter];
+    size_t offset = 0;
+
+    if (object < 0) {
+        return 4; /* object-undefined */
+    }
+    if (dlms_core_parse_data(data, length, &offset, &ignore_visitor, 0, 0) != DLMS_CORE_OK || offset != length) {
+        return 12; /* type-unmatched */
+    }
+    if (!m->values) {
+        m->values = calloc(object_count, sizeof *m->values);
+    }
+    if (!m->values[object]) {
+        m->values[object] = malloc(sizeof *m->values[object]);
+        dlms_encoder_init(m->values[object]);
+    }
+    m->values[object]->length = 0;
+    dlms_encode_bytes(m->values[object], data, length);
+
+    return 0;
+}
+
+static void handle_apdu(struct reply *r, unsigned meter, const uint8_t *p, size_t size);
+
+static void
+handle_apdu(struct reply *r, unsigned meter, const uint8_t *p, size_t size)
+{
+    struct meter *m = &meters[meter];
+    struct transfer *t = &m->transfer;
+    dlms_encoder e;
+    dlms_core_block block;
+    size_t offset;
+    int object;
+
+    if (size < 1) {
+        return;
+    }
+    dlms_encoder_init(&e);
+
+    if (p[0] == DLMS_AARQ) {
+        parse_aarq(m, p, size);
+        dlms_encode_aare(&e, 0, 0, m->conformance, m->max_pdu_size);
+    } else if (p[0] == DLMS_RLRQ) {
+        m->conformance = DEFAULT_CONFORMANCE;
+        m->max_pdu_size = max_pdu_size;
+        dlms_encode_rlre(&e);
+    } else if (p[0] == DLMS_GET_REQUEST && size >= 13 && p[1] == 1) { /* get-request-normal */
+        object = find_object((p[3] << 8) | p[4], p + 5, p[11]);
+        if (object < 0 || p[11] == 0) {
+            dlms_encode_get_response_error(&e, p[2], 4); /* object-undefined */
+        } else {
+            dlms_encode_get_response_normal(&e, p[2]);
+            encode_value(&e, meter, object);
+            if (e.length > m->max_pdu_size && !(m->conformance & 0x200000)) {
+                t->data.length = 0;
+                dlms_encode_bytes(&t->data, e.data + 4, e.length - 4);
+                t->offset = 0;
+                t->block_number = 0;
+                t->invoke_id = p[2];
+                send_get_block(r, m);
+                e.length = 0;
+            }
+        }
+    } else if (p[0] == DLMS_GET_REQUEST && size >= 7 && p[1] == 2) { /* get-request-next */
+        uint32_t number = ((uint32_t)p[3] << 24) | ((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 8) | p[6];
+        if (t->offset < t->data.length && number == t->block_number) {
+            send_get_block(r, m);
+        } else {
+            dlms_encode_get_response_error(&e, p[2], 14); /* no-long-get-in-progress */
+        }
+    } else if (p[0] == DLMS_SET_REQUEST && size >= 13 && p[1] == 1) { /* set-request-normal */
+        object = find_object((p[3] << 8) | p[4], p + 5, p[11]);
+        offset = 13 + (p[12] ? 1 : 0);
+        dlms_encode_set_response_normal(&e, p[2], size > offset ? set_value(meter, object, p + offset, size - offset) : 12);
+    } else if (p[0] == DLMS_SET_REQUEST && size >= 13 && (p[1] == 2 || p[1] == 3)) { /* with datablocks */
+        offset = p[1] == 2 ? 13 : 3;
+        if (p[1] == 2) {
+            t->object = find_object((p[3] << 8) | p[4], p + 5, p[11]);
+            t->data.length = 0;
+            if (p[12]) {
+                return; /* selective access is not supported */
+            }
+        }
+        if (dlms_core_parse_datablock_sa(p, size, &offset, &block) == DLMS_CORE_OK) {
+            dlms_encode_bytes(&t->data, p + block.data_offset, block.data_length);
+            t->block_number = block.block_number;
+            dlms_encode_8(&e, DLMS_SET_RESPONSE);
+            if (block.last_block) {
+                dlms_encode_8(&e, 3); /* set-response-last-datablock */
+                dlms_encode_8(&e, p[2]);
+                dlms_encode_8(&e, set_value(meter, t->object, t->data.data, t->data.length));
+            } else {
+                dlms_encode_8(&e, 2); /* set-response-datablock */
+                dlms_encode_8(&e, p[2]);
+            }
+            dlms_encode_32(&e, block.block_number);
+        }
+    } else if (p[0] == DLMS_ACTION_REQUEST && size >= 13 && p[1] == 1) { /* action-request-normal */
+        object = find_object((p[3] << 8) | p[4], p + 5, 0);
+        dlms_encode_action_response_normal(&e, p[2], object < 0 ? 4 : 0);
+    } else if (p[0] == DLMS_GENERAL_BLOCK_TRANSFER) {
+        offset = 1;
+        if (dlms_core_parse_general_block_transfer(p, size, &offset, &block) == DLMS_CORE_OK && block.data_length) {
+            if (block.block_number == 1) {
+                t->gbt.length = 0;
+            }
+            dlms_encode_bytes(&t->gbt, p + block.data_offset, block.data_length);
+            if (block.last_block) {
+                dlms_encoder request = t->gbt;
+                dlms_encoder_init(&t->gbt);
+                handle_apdu(r, meter, request.data, request.length);
+                dlms_encoder_free(&request);
+            }
+        }
+    } else if (p[0] == DLMS_GET_REQUEST || p[0] == DLMS_SET_REQUEST || p[0] == DLMS_ACTION_REQUEST) {
+        dlms_encode_exception_response(&e, 1, 2); /* service-not-allowed, service-not-supported */
+    }
+
+    if (e.length) {
+        send_response(r, m, &e);
+    }
+    dlms_encoder_free(&e);
+}
+
+/* Handle the wrapper PDUs of a UDP datagram or at the start of a TCP stream, return the bytes used */
+static size_t
+handle_wrapper(struct reply *r, const uint8_t *p, size_t size)
+{
+    size_t used = 0;
+
+    while (size - used >= 8) {
+        const uint8_t *q = p + used;
+        size_t length = ((size_t)q[6] << 8) | q[7];
+        unsigned destination = (q[4] << 8) | q[5];
+        if (size - used - 8 < length) {
+            break;
+        }
+        if (q[0] == 0 && q[1] == 1 && destination >= 1 && destination <= meter_count) {
+            r->client_address = (q[2] << 8) | q[3];
+            r->meter_address = destination;
+            handle_apdu(r, destination - 1, q + 8, length);
+        }
+        used += 8 + length;
+    }
+    return used;
+}
+
+/* Handle the HDLC frames at the start of a TCP stream, return the bytes used */
+static size_t
+handle_hdlc(struct reply *r, const uint8_t *p, size_t size)
+{
+    size_t used = 0;
+
+    while (used < size) {
+        dlms_core_hdlc frame;
+        struct hdlc_link *l;
+        unsigned control, meter;
+        int status;
+
+        if (p[used] != 0x7e) {
+            used++;
+            continue;
+        }
+        status = dlms_core_parse_hdlc(p, size, used, &frame);
+        if (status == DLMS_CORE_TRUNCATED) {
+            break;
+        }
+        if (status != DLMS_CORE_OK) {
+            used++;
+            continue;
+        }
+        used += frame.length + 2;
+        meter = frame.destination_address.length == 1 ? frame.destination : frame.destination_address.lower;
+        if (!frame.fcs_ok || meter < 1 || meter > meter_count) {
+            continue;
+        }
+        r->meter_address = meter;
+        r->hdlc_meter = frame.destination_address;
+        r->hdlc_client = frame.source_address;
+        l = &r->c->links[meter];
+        control = frame.control & ~0x10u;
+        if (control == 0x83) { /* SNRM */
+            l->connected = 1;
+            l->vs = l->vr = 0;
+            l->segments.length = 0;
+            l->pending.length = 0;
+            l->pending_offset = 0;
+            l->end_count = 0;
+            hdlc_send(r, 0x73, 0, 0, 0); /* UA */
+        } else if (control == 0x43) { /* DISC */
+            hdlc_send(r, l->connected ? 0x73 : 0x1f, 0, 0, 0); /* UA or DM */
+            l->connected = 0;
+        } else if (!l->connected) {
+            hdlc_send(r, 0x1f, 0, 0, 0); /* DM */
+        } else if ((control & 0x01) == 0) { /* I frame */
+            if (((control >> 1) & 7) != l->vr) {
+                hdlc_send(r, (l->vr << 5) | 0x11, 0, 0, 0); /* RR, to ask again */
+                continue;
+            }
+            l->vr = (l->vr + 1) & 7;
+            dlms_encode_bytes(&l->segments, p + frame.information_offset, frame.information_length);
+            if (frame.segmentation) {
+                hdlc_send(r, (l->vr << 5) | 0x11, 0, 0, 0); /* RR */
+            } else {
+                if (l->segments.length > 3) {
+                    dlms_encoder request = l->segments;
+                    dlms_encoder_init(&l->segments);
+                    handle_apdu(r, meter - 1, request.data + 3, request.length - 3);
+                    dlms_encoder_free(&request);
+                }
+                l->segments.length = 0;
+                if (l->end_count == 0) {
+                    hdlc_send(r, (l->vr << 5) | 0x11, 0, 0, 0); /* RR, as there is no response */
+                }
+            }
+        } else if ((control & 0x0f) == 0x01) { /* RR */
+            if (l->end_count) {
+                hdlc_send_pending(r, l);
+            }
+        }
+    }
+    return used;
+}
+
+/* Event loop */
+
+static struct connection **connections;
+static size_t connection_count;
+
+static int
+open_socket(int type, const char *address, unsigned port)
+{
+    struct sockaddr_in sa;
+    int fd = socket(AF_INET, type, 0), on = 1;
+
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    memset(&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, address, &sa.sin_addr) != 1) {
+        fprintf(stderr, "dlms-sim: bad address %s\n", address);
+        exit(2);
+    }
+    if (bind(fd, (struct sockaddr *)&sa, sizeof sa) < 0 || (type == SOCK_STREAM && listen(fd, 128) < 0)) {
+        fprintf(stderr, "dlms-sim: %s:%u: %s\n", address, port, strerror(errno));
+        exit(1);
+    }
+    return fd;
+}
+
+static void
+add_connection(int fd, int transport)
+{
+    struct connection *c = calloc(1, sizeof *c);
+
+    c->fd = fd;
+    c->transport = transport;
+    dlms_encoder_init(&c->input);
+    if (transport == TRANSPORT_TCP_HDLC) {
+        c->links = calloc(meter_count + 1, sizeof *c->links);
+    }
+    connections = realloc(connections, (connection_count + 1) * sizeof *connections);
+    connections[connection_count++] = c;
+}
+
+static void
+remove_connection(size_t i)
+{
+    struct connection *c = connections[i];
+    unsigned j;
+
+    close(c->fd);
+    dlms_encoder_free(&c->input);
+    if (c->links) {
+        for (j = 0; j <= meter_count; j++) {
+            dlms_encoder_free(&c->links[j].segments);
+            dlms_encoder_free(&c->links[j].pending);
+            free(c->links[j].ends);
+        }
+        free(c->links);
+    }
+    free(c);
+    connections[i] = connections[--connection_count];
+}
+
+/* Read from a TCP connection, and handle the complete PDUs or frames */
+static int
+read_connection(struct connection *c)
+{
+    uint8_t buffer[65536];
+    struct reply r;
+    ssize_t n = recv(c->fd, buffer, sizeof buffer, 0);
+    size_t used;
+
+    if (n <= 0) {
+        return n < 0 && errno == EINTR ? 0 : -1;
+    }
+    dlms_encode_bytes(&c->input, buffer, (size_t)n);
+    memset(&r, 0, sizeof r);
+    r.c = c;
+    used = c->transport == TRANSPORT_TCP_HDLC
+        ? handle_hdlc(&r, c->input.data, c->input.length)
+        : handle_wrapper(&r, c->input.data, c->input.length);
+    memmove(c->input.data, c->input.data + used, c->input.length - used);
+    c->input.length -= used;
+    if (c->input.status != DLMS_CORE_OK || c->input.length > 1 << 20) {
+        return -1;
+    }
+    return 0;
+}
+
+static double
+now_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Send a Data-Notification of the clock and counters of a meter */
+static void
+send_notification(unsigned meter, const struct sockaddr_in *destination)
+{
+    static uint32_t long_invoke_id;
+    dlms_encoder apdu, e;
+    unsigned i, counters = 0;
+    time_t now = time(0);
+
+    for (i = 0; i < object_count; i++) {
+        counters += objects[i].kind == KIND_COUNTER;
+    }
+    dlms_encoder_init(&apdu);
+    dlms_encoder_init(&e);
+    dlms_encode_data_notification(&apdu, long_invoke_id++ & 0xffffff, 0);
+    dlms_encode_structure(&apdu, 1 + counters);
+    encode_time(&apdu, now);
+    for (i = 0; i < object_count; i++) {
+        if (objects[i].kind == KIND_COUNTER) {
+            dlms_encode_unsigned(&apdu, 6, counter(meter, &objects[i], now));
+        }
+    }
+    dlms_encode_wrapper(&e, meter + 1, 102, apdu.data, apdu.length);
+    sendto(udp_fd, e.data, e.length, 0, (const struct sockaddr *)destination, sizeof *destination);
+    dlms_encoder_free(&apdu);
+    dlms_encoder_free(&e);
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: dlms-sim [-m meters] [-a address] [-u udp-port] [-t tcp-port] [-h hdlc-port]\n"
+                    "                [-o objects-file] [-p max-pdu-size] [-n notifications/s] [-d host:port]\n");
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *address = "127.0.0.1", *objects_file = 0, *notify = "127.0.0.1:4060";
+    unsigned udp_port = 4059, tcp_port = 4059, hdlc_port = 4061, i, next_meter = 0;
+    double rate = 0, next_notification = 0;
+    struct sockaddr_in notify_address;
+    struct pollfd *fds = 0;
+    int tcp_fd, hdlc_fd, c;
+    char host[64];
+    unsigned notify_port;
+
+    while ((c = getopt(argc, argv, "m:a:u:t:h:o:p:n:d:")) != -1) {
+        if (c == 'm') meter_count = (unsigned)strtoul(optarg, 0, 10);
+        else if (c == 'a') address = optarg;
+        else if (c == 'u') udp_port = (unsigned)strtoul(optarg, 0, 10);
+        else if (c == 't') tcp_port = (unsigned)strtoul(optarg, 0, 10);
+        else if (c == 'h') hdlc_port = (unsigned)strtoul(optarg, 0, 10);
+        else if (c == 'o') objects_file = optarg;
+        else if (c == 'p') max_pdu_size = (unsigned)strtoul(optarg, 0, 10);
+        else if (c == 'n') rate = strtod(optarg, 0);
+        else if (c == 'd') notify = optarg;
+        else usage();
+    }
+    if (optind != argc || meter_count < 1 || meter_count > 65534 || max_pdu_size < 64 || max_pdu_size > 65535) {
+        usage();
+    }
+    if (sscanf(notify, "%63[^:]:%u", host, &notify_port) != 2) {
+        usage();
+    }
+    memset(&notify_address, 0, sizeof notify_address);
+    notify_address.sin_family = AF_INET;
+    notify_address.sin_port = htons((uint16_t)notify_port);
+    if (inet_pton(AF_INET, host, &notify_address.sin_addr) != 1) {
+        usage();
+    }
+
+    if (objects_file) {
+        FILE *f = fopen(objects_file, "r");
+        char line[256];
+        unsigned number = 0;
+        if (!f) {
+            fprintf(stderr, "dlms-sim: %s: %s\n", objects_file, strerror(errno));
+            return 1;
+        }
+        while (fgets(line, sizeof line, f)) {
+            number++;
+            if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t\r\n")] == 0) {
+                continue;
+            }
+            if (add_object(line) < 0) {
+                fprintf(stderr, "dlms-sim: %s:%u: bad object\n", objects_file, number);
+                return 1;
+            }
+        }
+        fclose(f);
+    } else {
+        for (i = 0; i < sizeof default_objects / sizeof default_objects[0]; i++) {
+            add_object(default_objects[i]);
+        }
+    }
+
+    start_time = time(0);
+    meters = calloc(meter_count, sizeof *meters);
+    for (i = 0; i < meter_count; i++) {
+        meters[i].conformance = DEFAULT_CONFORMANCE;
+        meters[i].max_pdu_size = max_pdu_size;
+        dlms_encoder_init(&meters[i].transfer.data);
+        dlms_encoder_init(&meters[i].transfer.gbt);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    udp_fd = open_socket(SOCK_DGRAM, address, udp_port);
+    tcp_fd = open_socket(SOCK_STREAM, address, tcp_port);
+    hdlc_fd = open_socket(SOCK_STREAM, address, hdlc_port);
+    fprintf(stderr, "dlms-sim: %u meters, %u objects, wrapper on %s udp/%u and tcp/%u, HDLC on tcp/%u\n",
+            meter_count, object_count, address, udp_port, tcp_port, hdlc_port);
+
+    next_notification = now_seconds();
+    for (;;) {
+        size_t n = 3 + connection_count, j;
+        int timeout = -1;
+        if (rate > 0) {
+            double wait = next_notification - now_seconds();
+            timeout = wait > 0 ? (int)(wait * 1000) + 1 : 0;
+        }
+        fds = realloc(fds, n * sizeof *fds);
+        fds[0].fd = udp_fd;
+        fds[1].fd = tcp_fd;
+        fds[2].fd = hdlc_fd;
+        for (j = 0; j < connection_count; j++) {
+            fds[3 + j].fd = connections[j]->fd;
+        }
+        for (j = 0; j < n; j++) {
+            fds[j].events = POLLIN;
+            fds[j].revents = 0;
+        }
+        if (poll(fds, n, timeout) < 0 && errno != EINTR) {
+            perror("poll");
+            return 1;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint8_t buffer[65536];
+            struct connection udp;
+            struct reply r;
+            socklen_t length = sizeof r.peer;
+            ssize_t received;
+            memset(&udp, 0, sizeof udp);
+            udp.fd = udp_fd;
+            udp.transport = TRANSPORT_UDP;
+            memset(&r, 0, sizeof r);
+            r.c = &udp;
+            received = recvfrom(udp_fd, buffer, sizeof buffer, 0, (struct sockaddr *)&r.peer, &length);
+            if (received > 0) {
+                handle_wrapper(&r, buffer, (size_t)received);
+            }
+        }
+        for (j = 1; j <= 2; j++) {
+            if (fds[j].revents & POLLIN) {
+                int fd = accept(fds[j].fd, 0, 0);
+                if (fd >= 0) {
+                    add_connection(fd, j == 1 ? TRANSPORT_TCP_WRAPPER : TRANSPORT_TCP_HDLC);
+                }
+            }
+        }
+        for (j = n; j > 3; j--) { /* backwards, as removing moves the last connection */
+            if (fds[j - 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (read_connection(connections[j - 4]) < 0) {
+                    remove_connection(j - 4);
+                }
+            }
+        }
+
+        if (rate > 0) {
+            double now = now_seconds();
+            unsigned burst = 0;
+            while (next_notification <= now && burst++ < 10000) {
+                send_notification(next_meter, &notify_address);
+                next_meter = (next_meter + 1) % meter_count;
+                next_notification += 1 / rate;
+            }
+            if (next_notification < now) {
+                next_notification = now; /* do not try to catch up after a stall */
+            }
+        }
+    }
+}
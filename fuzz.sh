@@ -0,0 +1,33 @@
+#!/bin/sh
+# Fuzz the decoding core through one entry point: any (the default, which
+# dispatches on the first byte like the dissector), hdlc, wrapper, 432 or apdu.
+# With clang, the harness is built for libFuzzer and the remaining arguments
+# are passed to it (for example -max_total_time=600); with afl-clang-fast, it
+# is run by afl-fuzz; otherwise the seed corpus is only replayed with the
+# sanitizers. New inputs go to fuzz-work/<entry>, crashes and super-linear
+# inputs to the current directory (libFuzzer) or fuzz-work/<entry>-afl (AFL).
+set -e
+entry=${1:-any}
+[ $# -gt 0 ] && shift
+macro=FUZZ_$(echo "$entry" | tr a-z A-Z)
+case $entry in
+any) seeds="fuzz-corpus/hdlc fuzz-corpus/wrapper fuzz-corpus/432 fuzz-corpus/apdu" ;;
+hdlc|wrapper|432|apdu) seeds=fuzz-corpus/$entry ;;
+*) echo "usage: $0 [any|hdlc|wrapper|432|apdu] [fuzzer arguments]" >&2; exit 2 ;;
+esac
+sanitize=-fsanitize=address,undefined
+mkdir -p "fuzz-work/$entry"
+if echo 'int main(void){return 0;}' | clang -fsanitize=fuzzer -x c -o /dev/null - 2>/dev/null; then
+    clang -g -O1 $sanitize,fuzzer -DFUZZ_LIBFUZZER -DFUZZ_ENTRY=$macro \
+        -o "dlms-fuzz-$entry" dlms_fuzz.c dlms_core.c
+    exec "./dlms-fuzz-$entry" -timeout=5 "$@" "fuzz-work/$entry" $seeds
+elif command -v afl-clang-fast >/dev/null; then
+    afl-clang-fast -g -O1 -DFUZZ_ENTRY=$macro -o "dlms-fuzz-$entry" dlms_fuzz.c dlms_core.c
+    mkdir -p "fuzz-work/$entry-seeds"
+    for d in $seeds; do cp "$d"/* "fuzz-work/$entry-seeds"; done
+    exec afl-fuzz -i "fuzz-work/$entry-seeds" -o "fuzz-work/$entry-afl" "$@" -- "./dlms-fuzz-$entry" @@
+else
+    gcc -g -O1 $sanitize -fno-sanitize-recover=all -DFUZZ_ENTRY=$macro \
+        -o "dlms-fuzz-$entry" dlms_fuzz.c dlms_core.c
+    exec "./dlms-fuzz-$entry" $seeds
+fi